@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #include "Activation.h"
+#include "Kernels.h"
 
 /**
  *	Constructor
@@ -14,46 +20,229 @@ Activation::Activation(ActivationType actType): _activationType(actType)
  *	Returns this activation’s type
  * @return	ActivationType
  */
-ActivationType Activation::getActivationType()
+ActivationType Activation::getActivationType() const
 {
 	return this->_activationType;
 }
 
 /**
  * Relu activation
- * @param matrix 	Matrix
- * @return 			Matrix
+ * @param input		values
+ * @param output	results, may be input itself
+ * @param count		number of values
  */
-Matrix Activation::_relu(const Matrix& matrix)
+void Activation::_relu(const float* input, float* output, int count)
 {
-	Matrix newMatrix = Matrix(matrix);
-    for (int i = 0; i < newMatrix.getRows() * newMatrix.getCols(); ++i)
-    {
-        if (newMatrix[i] < 0)
-        {
-			newMatrix[i] = 0;
-        }
-    }
-    return newMatrix;
+	kernels().relu(input, output, count);
 }
 
 /**
- * Softmax activation
- * @param matrix 	Matrix
- * @return 			Matrix
+ * Process wide ExpMode, from EXP_MODE_ENV on first use
+ * @return	mode
  */
-Matrix Activation::_softmax(const Matrix& matrix)
+static std::atomic<int>& expMode()
 {
-	Matrix newMatrix = Matrix(matrix);
-    float count = 0;
-    for (int i = 0; i < matrix.getRows(); ++i)
-    {
-        newMatrix[i] = std::exp(newMatrix[i]);
-		count += newMatrix[i];
-    }
-    newMatrix = (1 / count) * newMatrix;
-
-    return newMatrix;
+	static std::atomic<int> mode([]
+								 {
+									 const char* value = std::getenv(EXP_MODE_ENV);
+									 return value != nullptr && std::strcmp(value, EXP_MODE_EXACT) == 0 ?
+											ExpExact : ExpFast;
+								 }());
+	return mode;
+}
+
+/**
+ * Stable softmax or log-softmax: the max of each slice is subtracted before exp,
+ * so no logit overflows
+ * @param input		rows * cols values, row-major
+ * @param output	results, may be input itself
+ * @param rows		rows
+ * @param cols		cols
+ * @param axis		SoftmaxAxis
+ * @param log		log-softmax instead of softmax
+ */
+void Activation::_softmax(const float* input, float* output, int rows, int cols, SoftmaxAxis axis, bool log)
+{
+	const KernelTable& table = kernels();
+	const KernelTable& expTable = getExpMode() == ExpExact ? *scalarKernels() : table;
+
+	// per thread scratch, grows once: normalizing allocates nothing in steady state
+	static thread_local std::vector<float> scratch;
+	static thread_local std::vector<float> maxes;
+	static thread_local std::vector<float> sums;
+
+	if (axis == SoftmaxRows || cols == 1)
+	{
+		// contiguous slices: max, then exp and sum in one pass, then one scale or shift
+		const int slices = axis == SoftmaxRows ? rows : 1;
+		const int length = axis == SoftmaxRows ? cols : rows;
+		if (log && (int) scratch.size() < length)
+		{
+			scratch.resize(length);
+		}
+		for (int slice = 0; slice < slices; ++slice)
+		{
+			const float* in = input + (long) slice * length;
+			float* out = output + (long) slice * length;
+			const float max = table.max(in, length);
+			if (log)
+			{
+				const float shift = max + std::log(expTable.expSum(in, max, scratch.data(), length));
+				for (int i = 0; i < length; ++i)
+				{
+					out[i] = in[i] - shift;
+				}
+			}
+			else
+			{
+				table.scale(out, 1 / expTable.expSum(in, max, out, length), out, length);
+			}
+		}
+		return;
+	}
+
+	// a batch, one sample per column: every pass runs along a contiguous row for all samples
+	maxes.assign(input, input + cols);
+	sums.assign(cols, 0);
+	scratch.resize(std::max((int) scratch.size(), cols));
+	for (int row = 1; row < rows; ++row)
+	{
+		const float* in = input + (long) row * cols;
+		for (int col = 0; col < cols; ++col)
+		{
+			maxes[col] = std::max(maxes[col], in[col]);
+		}
+	}
+	for (int row = 0; row < rows; ++row)
+	{
+		float* exps = log ? scratch.data() : output + (long) row * cols;
+		table.sub(input + (long) row * cols, maxes.data(), exps, cols);
+		expTable.exp(exps, exps, cols);
+		table.add(sums.data(), exps, sums.data(), cols);
+	}
+	for (int col = 0; col < cols; ++col)
+	{
+		sums[col] = log ? maxes[col] + std::log(sums[col]) : 1 / sums[col];
+	}
+	for (int row = 0; row < rows; ++row)
+	{
+		float* out = output + (long) row * cols;
+		if (log)
+		{
+			table.sub(input + (long) row * cols, sums.data(), out, cols);
+			continue;
+		}
+		for (int col = 0; col < cols; ++col)
+		{
+			out[col] *= sums[col];
+		}
+	}
+}
+
+/**
+ * Numerically stable softmax of every slice along axis
+ * @param input		rows * cols values, row-major
+ * @param output	results, may be input itself
+ * @param rows		rows
+ * @param cols		cols
+ * @param axis		SoftmaxAxis
+ */
+void Activation::softmax(const float* input, float* output, int rows, int cols, SoftmaxAxis axis)
+{
+	Activation::_softmax(input, output, rows, cols, axis, false);
+}
+
+/**
+ * Numerically stable log-softmax of every slice along axis,
+ * x - max - log(sum(exp(x - max)))
+ * @param input		rows * cols values, row-major
+ * @param output	results, may be input itself
+ * @param rows		rows
+ * @param cols		cols
+ * @param axis		SoftmaxAxis
+ */
+void Activation::logSoftmax(const float* input, float* output, int rows, int cols, SoftmaxAxis axis)
+{
+	Activation::_softmax(input, output, rows, cols, axis, true);
+}
+
+/**
+ * Numerically stable log-sum-exp of every slice along axis,
+ * max + log(sum(exp(x - max))), one value per slice and nothing else written:
+ * the softmax of a single element is exp(x - logSumExp), without normalizing the slice
+ * @param input		rows * cols values, row-major
+ * @param output	one value per slice, rows of them for SoftmaxRows, cols for SoftmaxColumns
+ * @param rows		rows
+ * @param cols		cols
+ * @param axis		SoftmaxAxis
+ */
+void Activation::logSumExp(const float* input, float* output, int rows, int cols, SoftmaxAxis axis)
+{
+	const KernelTable& table = kernels();
+	const KernelTable& expTable = getExpMode() == ExpExact ? *scalarKernels() : table;
+
+	// per thread scratch, grows once, as in _softmax
+	static thread_local std::vector<float> scratch;
+	static thread_local std::vector<float> sums;
+
+	if (axis == SoftmaxRows || cols == 1)
+	{
+		const int slices = axis == SoftmaxRows ? rows : 1;
+		const int length = axis == SoftmaxRows ? cols : rows;
+		if ((int) scratch.size() < length)
+		{
+			scratch.resize(length);
+		}
+		for (int slice = 0; slice < slices; ++slice)
+		{
+			const float* in = input + (long) slice * length;
+			const float max = table.max(in, length);
+			output[slice] = max + std::log(expTable.expSum(in, max, scratch.data(), length));
+		}
+		return;
+	}
+
+	// a batch, one sample per column: the maxes build up in output, then shift by the log sums
+	std::copy(input, input + cols, output);
+	sums.assign(cols, 0);
+	scratch.resize(std::max((int) scratch.size(), cols));
+	for (int row = 1; row < rows; ++row)
+	{
+		const float* in = input + (long) row * cols;
+		for (int col = 0; col < cols; ++col)
+		{
+			output[col] = std::max(output[col], in[col]);
+		}
+	}
+	for (int row = 0; row < rows; ++row)
+	{
+		table.sub(input + (long) row * cols, output, scratch.data(), cols);
+		expTable.exp(scratch.data(), scratch.data(), cols);
+		table.add(sums.data(), scratch.data(), sums.data(), cols);
+	}
+	for (int col = 0; col < cols; ++col)
+	{
+		output[col] += std::log(sums[col]);
+	}
+}
+
+/**
+ * Selects the exp of every softmax, process wide.
+ * Defaults to ExpFast unless EXP_MODE_ENV is EXP_MODE_EXACT.
+ * @param mode	ExpMode
+ */
+void Activation::setExpMode(ExpMode mode)
+{
+	expMode() = mode;
+}
+
+/**
+ * Returns the exp of every softmax
+ * @return	ExpMode
+ */
+ExpMode Activation::getExpMode()
+{
+	return (ExpMode) expMode().load();
 }
 
 /**
@@ -63,13 +252,53 @@ Matrix Activation::_softmax(const Matrix& matrix)
  * @return	Matrix
  */
 Matrix Activation::operator()(const Matrix& inputMatrix) const
+{
+	Matrix output(inputMatrix.getRows(), inputMatrix.getCols());
+	if (this->_activationType == Relu)
+	{
+		Activation::_relu(inputMatrix.data(), output.data(), inputMatrix.getRows() * inputMatrix.getCols());
+	}
+	else
+	{
+		// a row vector is one sample, otherwise every column is one
+		Activation::softmax(inputMatrix.data(), output.data(), inputMatrix.getRows(), inputMatrix.getCols(),
+							inputMatrix.getRows() == 1 ? SoftmaxRows : SoftmaxColumns);
+	}
+	return output;
+}
+
+/**
+ * Applies activation function on matrix in place
+ * @param matrix	Matrix
+ * @return	matrix
+ */
+Matrix& Activation::apply(Matrix& matrix) const
+{
+	if (this->_activationType == Softmax && matrix.getRows() == 1)
+	{
+		// a row vector is one sample
+		Activation::softmax(matrix.data(), matrix.data(), 1, matrix.getCols(), SoftmaxRows);
+		return matrix;
+	}
+	this->apply(matrix.data(), matrix.getRows(), matrix.getCols());
+	return matrix;
+}
+
+/**
+ * Applies activation function in place on raw values, e.g. a workspace buffer.
+ * Allocates nothing in steady state.
+ * @param values	rows * cols values, row-major
+ * @param rows		rows
+ * @param cols		cols, one sample each
+ */
+void Activation::apply(float* values, int rows, int cols) const
 {
 	if (this->_activationType == Relu)
 	{
-		return Activation::_relu(inputMatrix);
+		Activation::_relu(values, values, rows * cols);
 	}
 	else
 	{
-		return Activation::_softmax(inputMatrix);
+		Activation::softmax(values, values, rows, cols, SoftmaxColumns);
 	}
 }
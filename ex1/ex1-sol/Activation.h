@@ -12,6 +12,42 @@ enum ActivationType
 	Softmax
 };
 
+/**
+ * Slices a softmax normalizes over, in a row-major block
+ */
+enum SoftmaxAxis
+{
+	/**
+	 * Each column is one sample, e.g. a batch of column vectors
+	 */
+	SoftmaxColumns,
+	/**
+	 * Each row is one sample
+	 */
+	SoftmaxRows
+};
+
+/**
+ * exp implementations of the softmax
+ */
+enum ExpMode
+{
+	/**
+	 * SIMD polynomial of the selected kernels, relative error below 2 ulp
+	 */
+	ExpFast,
+	/**
+	 * libm, one element at a time
+	 */
+	ExpExact
+};
+
+/**
+ * Environment variable selecting the exp of the softmax: "exact" for libm
+ */
+#define EXP_MODE_ENV "MLP_EXP"
+#define EXP_MODE_EXACT "exact"
+
 /**
  * Class activation
  */
@@ -25,17 +61,23 @@ class Activation
 
 	/**
 	 * Relu activation
-	 * @param matrix 	Matrix
-	 * @return 			Matrix
+	 * @param input		values
+	 * @param output	results, may be input itself
+	 * @param count		number of values
 	 */
-	static Matrix _relu(const Matrix& matrix);
+	static void _relu(const float* input, float* output, int count);
 
 	/**
-	 * Softmax activation
-	 * @param matrix 	Matrix
-	 * @return 			Matrix
+	 * Stable softmax or log-softmax: the max of each slice is subtracted before exp,
+	 * so no logit overflows
+	 * @param input		rows * cols values, row-major
+	 * @param output	results, may be input itself
+	 * @param rows		rows
+	 * @param cols		cols
+	 * @param axis		SoftmaxAxis
+	 * @param log		log-softmax instead of softmax
 	 */
-	static Matrix _softmax(const Matrix& matrix);
+	static void _softmax(const float* input, float* output, int rows, int cols, SoftmaxAxis axis, bool log);
  public:
 	/**
 	 * Constructor
@@ -47,7 +89,7 @@ class Activation
 	 * Returns this activation’s type
 	 * @return	ActivationType
 	 */
-	ActivationType getActivationType();
+	ActivationType getActivationType() const;
 
 	/**
 	 * Parenthesis operator override,
@@ -57,6 +99,68 @@ class Activation
 	 */
 	Matrix operator()(const Matrix& inputMatrix) const;
 
+	/**
+	 * Applies activation function on matrix in place
+	 * @param matrix	Matrix
+	 * @return	matrix
+	 */
+	Matrix& apply(Matrix& matrix) const;
+
+	/**
+	 * Applies activation function in place on raw values, e.g. a workspace buffer.
+	 * Allocates nothing in steady state.
+	 * @param values	rows * cols values, row-major
+	 * @param rows		rows
+	 * @param cols		cols, one sample each
+	 */
+	void apply(float* values, int rows, int cols) const;
+
+	/**
+	 * Numerically stable softmax of every slice along axis
+	 * @param input		rows * cols values, row-major
+	 * @param output	results, may be input itself
+	 * @param rows		rows
+	 * @param cols		cols
+	 * @param axis		SoftmaxAxis
+	 */
+	static void softmax(const float* input, float* output, int rows, int cols, SoftmaxAxis axis);
+
+	/**
+	 * Numerically stable log-softmax of every slice along axis,
+	 * x - max - log(sum(exp(x - max)))
+	 * @param input		rows * cols values, row-major
+	 * @param output	results, may be input itself
+	 * @param rows		rows
+	 * @param cols		cols
+	 * @param axis		SoftmaxAxis
+	 */
+	static void logSoftmax(const float* input, float* output, int rows, int cols, SoftmaxAxis axis);
+
+	/**
+	 * Numerically stable log-sum-exp of every slice along axis,
+	 * max + log(sum(exp(x - max))), one value per slice and nothing else written:
+	 * the softmax of a single element is exp(x - logSumExp), without normalizing the slice
+	 * @param input		rows * cols values, row-major
+	 * @param output	one value per slice, rows of them for SoftmaxRows, cols for SoftmaxColumns
+	 * @param rows		rows
+	 * @param cols		cols
+	 * @param axis		SoftmaxAxis
+	 */
+	static void logSumExp(const float* input, float* output, int rows, int cols, SoftmaxAxis axis);
+
+	/**
+	 * Selects the exp of every softmax, process wide.
+	 * Defaults to ExpFast unless EXP_MODE_ENV is EXP_MODE_EXACT.
+	 * @param mode	ExpMode
+	 */
+	static void setExpMode(ExpMode mode);
+
+	/**
+	 * Returns the exp of every softmax
+	 * @return	ExpMode
+	 */
+	static ExpMode getExpMode();
+
 };
 
 #endif
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "BulkClassifier.h"
+
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+#define INVALID_RESULT " invalid\n"
+#define PROBABILITY_FORMAT " %u %.6f\n"
+#define RESULT_CHARS 32
+#define PATH_SEPARATOR "/"
+
+/**
+ * Reads one raw image file
+ * @param path	file
+ * @param image	imgDims elements
+ * @return		false if the file is missing or has another size
+ */
+static bool readImage(const std::string& path, Matrix& image)
+{
+	const long bytes = (long) image.getRows() * image.getCols() * (long) sizeof(float);
+	std::ifstream is(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!is.is_open() || is.tellg() != bytes)
+	{
+		return false;
+	}
+	is.seekg(0, std::ios_base::beg);
+	is.read(reinterpret_cast<char*>(image.data()), bytes);
+	return is.good();
+}
+
+/**
+ * Lists the regular files of a directory, sorted by name
+ * @param directory	path
+ * @param paths		receives directory/name per file
+ * @return			false if the directory cannot be opened
+ */
+static bool listDirectory(const std::string& directory, std::vector<std::string>& paths)
+{
+	DIR* handle = opendir(directory.c_str());
+	if (handle == nullptr)
+	{
+		return false;
+	}
+	for (dirent* entry = readdir(handle); entry != nullptr; entry = readdir(handle))
+	{
+		const std::string path = directory + PATH_SEPARATOR + entry->d_name;
+		struct stat status = {};
+		if (stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode))
+		{
+			paths.push_back(path);
+		}
+	}
+	closedir(handle);
+	std::sort(paths.begin(), paths.end());
+	return true;
+}
+
+/**
+ * Reads one path per line, blank lines skipped
+ * @param listPath	file
+ * @param paths		receives the paths
+ * @return			false if the list cannot be opened
+ */
+static bool readList(const std::string& listPath, std::vector<std::string>& paths)
+{
+	std::ifstream is(listPath);
+	if (!is.is_open())
+	{
+		return false;
+	}
+	std::string line;
+	while (std::getline(is, line))
+	{
+		if (!line.empty())
+		{
+			paths.push_back(line);
+		}
+	}
+	return !is.bad();
+}
+
+/**
+ * Constructor
+ * @param network	Network, must outlive the classifier
+ * @param batchSize	Images per step, at least 1
+ * @param output	Results destination, e.g. stdout
+ */
+BulkClassifier::BulkClassifier(const MlpNetwork& network, int batchSize, FILE* output) :
+	_network(network), _batchSize(batchSize), _output(output), _classified(0), _nextPath(0), _streamIndex(0),
+	_prefetcher(1)
+{
+	if (batchSize < 1 || output == nullptr)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	this->_buffer.reserve(BULK_WRITE_BUFFER);
+}
+
+/**
+ * Classifies every image of a source.
+ * Unreadable images or images of another size get an "invalid" line.
+ * @param type		BulkSourceType
+ * @param source	directory, list file or stream file path
+ * @return			false if the source itself cannot be opened or the output fails
+ */
+bool BulkClassifier::run(BulkSourceType type, const std::string& source)
+{
+	this->_paths.clear();
+	this->_nextPath = 0;
+	this->_streamIndex = 0;
+	if (this->_stream.is_open())
+	{
+		this->_stream.close();
+	}
+
+	bool opened = false;
+	switch (type)
+	{
+		case BulkDirectory:
+			opened = listDirectory(source, this->_paths);
+			break;
+		case BulkList:
+			opened = readList(source, this->_paths);
+			break;
+		case BulkStream:
+			this->_stream.open(source, std::ios::in | std::ios::binary);
+			opened = this->_stream.is_open();
+			break;
+	}
+	if (!opened)
+	{
+		return false;
+	}
+
+	// double buffering: the worker fills one batch while the other is classified
+	BulkBatch batches[2];
+	int current = 0;
+	bool good = true;
+	this->_fill(type, batches[current]);
+	while (batches[current].count > 0)
+	{
+		BulkBatch& next = batches[1 - current];
+		this->_prefetcher.submit([this, type, &next](int)
+								 {
+									 this->_fill(type, next);
+								 });
+		good = this->_classify(batches[current]) && good;
+		this->_prefetcher.wait();
+		current = 1 - current;
+	}
+	return this->_flush() && good;
+}
+
+/**
+ * Returns the images classified so far, invalid ones excluded
+ * @return	images
+ */
+long BulkClassifier::classified() const
+{
+	return this->_classified;
+}
+
+/**
+ * Reads the next images of the source into batch.
+ * Runs on the prefetch worker, one call at a time.
+ * @param type	BulkSourceType
+ * @param batch	BulkBatch, storage is reused
+ */
+void BulkClassifier::_fill(BulkSourceType type, BulkBatch& batch)
+{
+	const int imgSize = this->_network.getInputs();
+	const long imgBytes = imgSize * (long) sizeof(float);
+	batch.names.clear();
+	batch.slots.clear();
+	batch.count = 0;
+	while ((int) batch.images.size() < this->_batchSize)
+	{
+		batch.images.emplace_back(imgSize, 1);
+	}
+
+	int valid = 0;
+	while (batch.count < this->_batchSize)
+	{
+		if (type == BulkStream)
+		{
+			this->_stream.read(reinterpret_cast<char*>(batch.images[valid].data()), imgBytes);
+			const long bytes = (long) this->_stream.gcount();
+			if (bytes == 0)
+			{
+				break;
+			}
+			batch.names.push_back(std::to_string(this->_streamIndex++));
+			batch.slots.push_back(bytes == imgBytes ? valid++ : -1);
+		}
+		else
+		{
+			if (this->_nextPath == this->_paths.size())
+			{
+				break;
+			}
+			const std::string& path = this->_paths[this->_nextPath++];
+			batch.names.push_back(path);
+			batch.slots.push_back(readImage(path, batch.images[valid]) ? valid++ : -1);
+		}
+		++batch.count;
+	}
+}
+
+/**
+ * Classifies a batch and buffers its result lines
+ * @param batch	BulkBatch
+ * @return		false on an output error
+ */
+bool BulkClassifier::_classify(const BulkBatch& batch)
+{
+	const int valid = (int) std::count_if(batch.slots.begin(), batch.slots.end(), [](int slot) { return slot >= 0; });
+	std::vector<Digit> digits;
+	if (valid > 0)
+	{
+		digits = this->_network.classifyBatch(batch.images.data(), valid);
+		this->_classified += valid;
+	}
+
+	bool good = true;
+	char result[RESULT_CHARS];
+	for (int i = 0; i < batch.count; ++i)
+	{
+		this->_buffer += batch.names[i];
+		const int slot = batch.slots[i];
+		if (slot < 0)
+		{
+			this->_buffer += INVALID_RESULT;
+		}
+		else
+		{
+			snprintf(result, RESULT_CHARS, PROBABILITY_FORMAT, digits[slot].value, digits[slot].probability);
+			this->_buffer += result;
+		}
+		if (this->_buffer.size() >= BULK_WRITE_BUFFER)
+		{
+			good = this->_flush() && good;
+		}
+	}
+	return good;
+}
+
+/**
+ * Writes the buffered results
+ * @return	false on an output error
+ */
+bool BulkClassifier::_flush()
+{
+	const size_t written = fwrite(this->_buffer.data(), 1, this->_buffer.size(), this->_output);
+	const bool good = written == this->_buffer.size() && fflush(this->_output) == 0;
+	this->_buffer.clear();
+	return good;
+}
@@ -0,0 +1,151 @@
+#ifndef BULK_CLASSIFIER_H
+#define BULK_CLASSIFIER_H
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MlpNetwork.h"
+#include "ThreadPool.h"
+
+/**
+ * Bytes of results buffered before a write
+ */
+#define BULK_WRITE_BUFFER (1 << 16)
+
+/**
+ * Where bulk images come from
+ */
+enum BulkSourceType
+{
+	BulkDirectory,
+	BulkList,
+	BulkStream
+};
+
+/**
+ * @struct BulkBatch
+ * @brief Images read ahead for one classification step
+ * @var names - one per image read, in order
+ * @var slots - index into images, -1 if the image could not be read
+ * @var images - readable images, getInputs() elements each
+ * @var count - images read into this batch
+ */
+typedef struct BulkBatch
+{
+	std::vector<std::string> names;
+	std::vector<int> slots;
+	std::vector<Matrix> images;
+	int count;
+} BulkBatch;
+
+/**
+ * Class BulkClassifier
+ * Non-interactive classification of many images: a directory, a file listing one
+ * path per line, or one stream of concatenated raw images.
+ * A prefetch worker reads the next batch while the current one is classified,
+ * results go out as one "name digit probability" line per image through a buffer.
+ */
+class BulkClassifier
+{
+ public:
+	/**
+	 * Constructor
+	 * @param network	Network, must outlive the classifier
+	 * @param batchSize	Images per step, at least 1
+	 * @param output	Results destination, e.g. stdout
+	 */
+	BulkClassifier(const MlpNetwork& network, int batchSize, FILE* output);
+
+	BulkClassifier(const BulkClassifier&) = delete;
+	BulkClassifier& operator=(const BulkClassifier&) = delete;
+
+	/**
+	 * Classifies every image of a source.
+	 * Unreadable images or images of another size get an "invalid" line.
+	 * @param type		BulkSourceType
+	 * @param source	directory, list file or stream file path
+	 * @return			false if the source itself cannot be opened or the output fails
+	 */
+	bool run(BulkSourceType type, const std::string& source);
+
+	/**
+	 * Returns the images classified so far, invalid ones excluded
+	 * @return	images
+	 */
+	long classified() const;
+
+ private:
+	/**
+	 * Shared network
+	 */
+	const MlpNetwork& _network;
+
+	/**
+	 * Images per step
+	 */
+	int _batchSize;
+
+	/**
+	 * Results destination
+	 */
+	FILE* _output;
+
+	/**
+	 * Pending results
+	 */
+	std::string _buffer;
+
+	/**
+	 * Images classified so far
+	 */
+	long _classified;
+
+	/**
+	 * Paths of a directory or list source
+	 */
+	std::vector<std::string> _paths;
+
+	/**
+	 * Next path to read
+	 */
+	size_t _nextPath;
+
+	/**
+	 * Stream source
+	 */
+	std::ifstream _stream;
+
+	/**
+	 * Images read from the stream so far
+	 */
+	long _streamIndex;
+
+	/**
+	 * The prefetch worker
+	 */
+	ThreadPool _prefetcher;
+
+	/**
+	 * Reads the next images of the source into batch.
+	 * Runs on the prefetch worker, one call at a time.
+	 * @param type	BulkSourceType
+	 * @param batch	BulkBatch, storage is reused
+	 */
+	void _fill(BulkSourceType type, BulkBatch& batch);
+
+	/**
+	 * Classifies a batch and buffers its result lines
+	 * @param batch	BulkBatch
+	 * @return		false on an output error
+	 */
+	bool _classify(const BulkBatch& batch);
+
+	/**
+	 * Writes the buffered results
+	 * @return	false on an output error
+	 */
+	bool _flush();
+};
+
+#endif
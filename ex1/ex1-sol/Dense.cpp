@@ -1,4 +1,12 @@
+#include <algorithm>
+#include <utility>
 #include "Dense.h"
+#include "Gemm.h"
+#include "Kernels.h"
+#include "MatrixAllocator.h"
+#include "Profiler.h"
+
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
 
 /**
  * Inits a new layer with given parameters
@@ -7,10 +15,93 @@
  * @param activationType	ActivationType
  */
 Dense::Dense(const Matrix &weightMat, const Matrix &biasMat, ActivationType activationType):
-	_weightMatrix(weightMat), _biasMatrix(biasMat), _activation(Activation(activationType))
+	_weightMatrix(weightMat), _panels(new DensePanels()), _biasMatrix(biasMat), _activation(Activation(activationType))
+{
+}
+
+/**
+ * Inits a new layer, taking over the given parameters without copying
+ * (borrowed matrices stay borrowed)
+ * @param weightMat			Matrix
+ * @param biasMat			Matrix
+ * @param activationType	ActivationType
+ */
+Dense::Dense(Matrix &&weightMat, Matrix &&biasMat, ActivationType activationType):
+	_weightMatrix(std::move(weightMat)), _panels(new DensePanels()), _biasMatrix(std::move(biasMat)),
+	_activation(Activation(activationType))
+{
+}
+
+/**
+ * Copy constructor, the copy packs its own panels when it needs them
+ * @param otherLayer	Dense
+ */
+Dense::Dense(const Dense &otherLayer):
+	_weightMatrix(otherLayer._weightMatrix), _panels(new DensePanels()), _biasMatrix(otherLayer._biasMatrix),
+	_activation(otherLayer._activation)
 {
 }
 
+/**
+ * Copy assignment, the copy packs its own panels when it needs them
+ * @param otherLayer	Dense
+ * @return				this layer
+ */
+Dense &Dense::operator=(const Dense &otherLayer)
+{
+	if (this != &otherLayer)
+	{
+		this->_weightMatrix = otherLayer._weightMatrix;
+		this->_panels.reset(new DensePanels());
+		this->_biasMatrix = otherLayer._biasMatrix;
+		this->_activation = otherLayer._activation;
+	}
+	return *this;
+}
+
+/**
+ * Constructs unpacked panels
+ */
+DensePanels::DensePanels(): _data(nullptr), _count(0)
+{
+}
+
+/**
+ * Frees the panels
+ */
+DensePanels::~DensePanels()
+{
+	matrixFree(this->_data, this->_count);
+}
+
+/**
+ * Returns the panels, packing weights on the first call
+ * @param weights	row-major weights
+ * @return			packedWeightsSize floats
+ */
+const float* DensePanels::get(const Matrix &weights)
+{
+	std::call_once(this->_once, [this, &weights]()
+	{
+		const int rows = weights.getRows();
+		const int cols = weights.getCols();
+		const int mr = kernels().gemmMr;
+		this->_count = (int) packedWeightsSize(rows, cols, mr);
+		this->_data = matrixAllocate(this->_count);
+		packWeights(rows, cols, weights.data(), cols, mr, this->_data);
+	});
+	return this->_data;
+}
+
+/**
+ * Returns the panels, packing them on the first call
+ * @return	panels, nullptr for borrowed weights
+ */
+const float* Dense::_packed() const
+{
+	return this->_weightMatrix.isOwner() ? this->_panels->get(this->_weightMatrix) : nullptr;
+}
+
 /**
  * Returns the weights of this layer
  * @return Weights matrix
@@ -38,6 +129,25 @@ const Activation &Dense::getActivation() const
 	return this->_activation;
 }
 
+/**
+ * Floating point operations of one pass, a multiply and an add per weight and sample
+ * @param batch	samples
+ * @return		FLOPs
+ */
+double Dense::flops(int batch) const
+{
+	return 2.0 * this->_weightMatrix.getRows() * this->_weightMatrix.getCols() * batch;
+}
+
+/**
+ * Bytes of weights and biases one pass reads
+ * @return	bytes
+ */
+double Dense::weightBytes() const
+{
+	return (double) (this->_weightMatrix.getRows() * (this->_weightMatrix.getCols() + 1)) * sizeof(float);
+}
+
 /**
  * Parenthesis operator override,
  * Applies the layer on inputMatrix and returns output matrix
@@ -46,10 +156,84 @@ const Activation &Dense::getActivation() const
  */
 Matrix Dense::operator()(const Matrix& inputMatrix) const
 {
-	Matrix result = Matrix(inputMatrix);
-    result = (this->_weightMatrix * result) + this->_biasMatrix;
-    result = this->_activation(result);
-    return result;
+	return (*this)(MatrixView(inputMatrix));
 }
 
+/**
+ * Parenthesis operator override,
+ * Applies the layer on a view without copying it.
+ * A single contiguous column goes through the fused dense kernel,
+ * a view with several columns is a batch, one sample per column.
+ * @param inputView		MatrixView
+ * @return					Matrix
+ */
+Matrix Dense::operator()(const MatrixView& inputView) const
+{
+	Matrix result(this->_weightMatrix.getRows(), inputView.getCols());
+	this->forward(inputView, result.data());
+	return result;
+}
 
+/**
+ * Applies the layer on a view into caller provided storage, allocating nothing
+ * for a single column.
+ * @param inputView		MatrixView, getCols() samples
+ * @param output		rows * getCols() floats, row-major, must not alias the input
+ * @param activate		false stops before the activation, e.g. at the logits of a softmax
+ */
+void Dense::forward(const MatrixView& inputView, float* output, bool activate) const
+{
+	const int rows = this->_weightMatrix.getRows();
+	const int batch = inputView.getCols();
+	if (inputView.getRows() != this->_weightMatrix.getCols())
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	PROFILE_SCOPE(this, this->_activation.getActivationType() == Relu ? "dense relu" : "dense softmax", rows,
+				  this->_weightMatrix.getCols(), this->flops(batch), this->weightBytes());
+
+	const float* bias = this->_biasMatrix.data();
+	const int cols = this->_weightMatrix.getCols();
+	if (batch == 1 && inputView.getLd() == 1)
+	{
+		// one sample: product, bias and relu in one pass, softmax only normalizes afterwards
+		const bool relu = activate && this->_activation.getActivationType() == Relu;
+		const bool panels = this->_weightMatrix.isOwner() &&
+							packedWeightsSize(rows, cols, kernels().gemmMr) * sizeof(float) <= DENSE_PANEL_GEMV_BYTES;
+		if (panels)
+		{
+			kernels().densePanels(rows, cols, this->_packed(), inputView.data(), bias, output, relu);
+		}
+		else
+		{
+			kernels().dense(rows, cols, this->_weightMatrix.data(), cols, inputView.data(), bias, output, relu);
+		}
+		if (activate && !relu)
+		{
+			this->_activation.apply(output, rows, 1);
+		}
+		return;
+	}
+
+	// every column starts from the bias, the product accumulates on top of it
+	for (int row = 0; row < rows; ++row)
+	{
+		std::fill(output + row * batch, output + (row + 1) * batch, bias[row]);
+	}
+	const float* packed = batch == 1 ? nullptr : this->_packed();
+	if (packed == nullptr)
+	{
+		// a strided column, gemv reads the row-major weights; borrowed weights are packed per call
+		gemm(rows, batch, cols, this->_weightMatrix.data(), cols, inputView.data(), inputView.getLd(), output,
+			 batch, true);
+	}
+	else
+	{
+		gemmPacked(rows, batch, cols, packed, inputView.data(), inputView.getLd(), output, batch, true);
+	}
+	if (activate)
+	{
+		this->_activation.apply(output, rows, batch);
+	}
+}
@@ -1,9 +1,61 @@
 #ifndef DENSE_H
 #define DENSE_H
 
+#include <memory>
+#include <mutex>
 #include "Matrix.h"
+#include "MatrixView.h"
 #include "Activation.h"
 
+/**
+ * Largest prepacked weights a single sample reads through the panel kernel. Panels need
+ * no horizontal sums, which wins while the weights sit in L1 or near it; larger layers
+ * stream from L2 faster as several row-major rows at once, through the dense kernel.
+ */
+#define DENSE_PANEL_GEMV_BYTES (128 << 10)
+
+/**
+ * Class DensePanels
+ * A layer's weights packed into the dispatched gemmMr-row panels (see packWeights)
+ * on first use, from any thread, in matrixAllocate storage
+ */
+class DensePanels
+{
+ private:
+	/**
+	 * Guards the packing
+	 */
+	std::once_flag _once;
+	/**
+	 * Panels, nullptr until packed
+	 */
+	float* _data;
+	/**
+	 * Floats in _data
+	 */
+	int _count;
+ public:
+	/**
+	 * Constructs unpacked panels
+	 */
+	DensePanels();
+
+	/**
+	 * Frees the panels
+	 */
+	~DensePanels();
+
+	DensePanels(const DensePanels&) = delete;
+	DensePanels& operator=(const DensePanels&) = delete;
+
+	/**
+	 * Returns the panels, packing weights on the first call
+	 * @param weights	row-major weights
+	 * @return			packedWeightsSize floats
+	 */
+	const float* get(const Matrix& weights);
+};
+
 /**
  * Class dense
  */
@@ -14,6 +66,12 @@ class Dense
 	 * Weights matrix
 	 */
 	Matrix _weightMatrix;
+	/**
+	 * The weights packed into panels by the first batch, or single sample up to
+	 * DENSE_PANEL_GEMV_BYTES, that reads them. Borrowed weights are never packed:
+	 * they stay the only resident copy, gemm packs blocks of them per call.
+	 */
+	std::unique_ptr<DensePanels> _panels;
 	/**
 	 * Bias matrix
 	 */
@@ -22,6 +80,12 @@ class Dense
 	 * Activation type
 	 */
 	Activation _activation;
+
+	/**
+	 * Returns the panels, packing them on the first call
+	 * @return	panels, nullptr for borrowed weights
+	 */
+	const float* _packed() const;
  public:
 	/**
 	 * Inits a new layer with given parameters
@@ -31,6 +95,41 @@ class Dense
 	 */
 	Dense(const Matrix &weightMat, const Matrix &biasMat, ActivationType activationType);
 
+	/**
+	 * Inits a new layer, taking over the given parameters without copying
+	 * (borrowed matrices stay borrowed)
+	 * @param weightMat		Matrix
+	 * @param biasMat			Matrix
+	 * @param activationType	ActivationType
+	 */
+	Dense(Matrix &&weightMat, Matrix &&biasMat, ActivationType activationType);
+
+	/**
+	 * Copy constructor, the copy packs its own panels when it needs them
+	 * @param otherLayer	Dense
+	 */
+	Dense(const Dense &otherLayer);
+
+	/**
+	 * Move constructor, takes over the panels
+	 * @param otherLayer	Dense
+	 */
+	Dense(Dense &&otherLayer) noexcept = default;
+
+	/**
+	 * Copy assignment, the copy packs its own panels when it needs them
+	 * @param otherLayer	Dense
+	 * @return				this layer
+	 */
+	Dense &operator=(const Dense &otherLayer);
+
+	/**
+	 * Move assignment, takes over the panels
+	 * @param otherLayer	Dense
+	 * @return				this layer
+	 */
+	Dense &operator=(Dense &&otherLayer) noexcept = default;
+
 	/**
 	 * Returns the weights of this layer
 	 * @return Weights matrix
@@ -49,6 +148,19 @@ class Dense
 	 */
 	const Activation &getActivation() const;
 
+	/**
+	 * Floating point operations of one pass, a multiply and an add per weight and sample
+	 * @param batch	samples
+	 * @return		FLOPs
+	 */
+	double flops(int batch) const;
+
+	/**
+	 * Bytes of weights and biases one pass reads
+	 * @return	bytes
+	 */
+	double weightBytes() const;
+
 	/**
 	 * Parenthesis operator override,
 	 * Applies the layer on inputMatrix and returns output matrix
@@ -56,6 +168,25 @@ class Dense
 	 * @return					Matrix
 	 */
 	Matrix operator()(const Matrix &inputMatrix) const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the layer on a view without copying it.
+	 * A single contiguous column goes through the fused dense kernel,
+	 * a view with several columns is a batch, one sample per column.
+	 * @param inputView		MatrixView
+	 * @return					Matrix
+	 */
+	Matrix operator()(const MatrixView &inputView) const;
+
+	/**
+	 * Applies the layer on a view into caller provided storage, allocating nothing
+	 * for a single column.
+	 * @param inputView		MatrixView, getCols() samples
+	 * @param output		rows * getCols() floats, row-major, must not alias the input
+	 * @param activate		false stops before the activation, e.g. at the logits of a softmax
+	 */
+	void forward(const MatrixView &inputView, float *output, bool activate = true) const;
 };
 
 #endif
@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "Gemm.h"
+#include "Kernels.h"
+
+/**
+ * Packs an mc * kc block of op(a) into mr-row micro-panels.
+ * Inside a micro-panel the mr values of each column are contiguous,
+ * rows past mc are zero padded so the micro-kernel never branches.
+ * A transposed a holds those mr values contiguously already, they are copied as is.
+ * @param op		how a is read
+ * @param mc		rows in block
+ * @param kc		cols in block
+ * @param a			block origin, as stored
+ * @param lda		leading dimension of a
+ * @param mr		micro-panel height
+ * @param packed	destination, ceil(mc / mr) * mr * kc floats
+ */
+static void packA(GemmOperand op, int mc, int kc, const float* a, int lda, int mr, float* packed)
+{
+	const int rowStride = op == GemmNormal ? lda : 1;
+	const int colStride = op == GemmNormal ? 1 : lda;
+	for (int ir = 0; ir < mc; ir += mr)
+	{
+		const int rows = std::min(mr, mc - ir);
+		for (int p = 0; p < kc; ++p)
+		{
+			int i = 0;
+			for (; i < rows; ++i)
+			{
+				packed[i] = a[(ir + i) * rowStride + p * colStride];
+			}
+			for (; i < mr; ++i)
+			{
+				packed[i] = 0;
+			}
+			packed += mr;
+		}
+	}
+}
+
+/**
+ * Packs a kc * nc block of op(b) into nr-col micro-panels.
+ * Inside a micro-panel the nr values of each row are contiguous,
+ * cols past nc are zero padded.
+ * A transposed b is read one stored row, a column of the panel, at a time.
+ * @param op		how b is read
+ * @param kc		rows in block
+ * @param nc		cols in block
+ * @param b			block origin, as stored
+ * @param ldb		leading dimension of b
+ * @param nr		micro-panel width
+ * @param packed	destination, kc * ceil(nc / nr) * nr floats
+ */
+static void packB(GemmOperand op, int kc, int nc, const float* b, int ldb, int nr, float* packed)
+{
+	for (int jr = 0; jr < nc; jr += nr)
+	{
+		const int cols = std::min(nr, nc - jr);
+		if (op == GemmTransposed)
+		{
+			for (int j = 0; j < nr; ++j)
+			{
+				const float* row = b + (jr + j) * ldb;
+				for (int p = 0; p < kc; ++p)
+				{
+					packed[p * nr + j] = j < cols ? row[p] : 0;
+				}
+			}
+			packed += kc * nr;
+			continue;
+		}
+		for (int p = 0; p < kc; ++p)
+		{
+			const float* row = b + p * ldb + jr;
+			int j = 0;
+			for (; j < cols; ++j)
+			{
+				packed[j] = row[j];
+			}
+			for (; j < nr; ++j)
+			{
+				packed[j] = 0;
+			}
+			packed += nr;
+		}
+	}
+}
+
+/**
+ * Blocked product shared by gemm and gemmPacked: c = op(a) * op(b), or c += op(a) * op(b)
+ * @param opA			how a is read, unused when prepacked
+ * @param opB			how b is read
+ * @param m				rows of op(a) and c
+ * @param n				cols of op(b) and c
+ * @param k				cols of op(a), rows of op(b)
+ * @param a				row-major left operand, packed per block, unused when prepacked
+ * @param lda			leading dimension of a
+ * @param prepacked		packWeights output with the dispatched gemmMr, or nullptr
+ * @param b				right operand
+ * @param ldb			leading dimension of b
+ * @param c				result
+ * @param ldc			leading dimension of c
+ * @param accumulate	add to c instead of overwriting it
+ */
+static void gemmBlocked(GemmOperand opA, GemmOperand opB, int m, int n, int k, const float* a, int lda,
+						const float* prepacked, const float* b, int ldb, float* c, int ldc, bool accumulate)
+{
+	const KernelTable& table = kernels();
+	const int mr = table.gemmMr;
+	const int nr = table.gemmNr;
+	static thread_local std::vector<float> packedA;
+	static thread_local std::vector<float> packedB;
+	if (prepacked == nullptr)
+	{
+		packedA.resize(GEMM_MC * GEMM_KC);
+	}
+	packedB.resize(GEMM_KC * GEMM_NC);
+
+	for (int jc = 0; jc < n; jc += GEMM_NC)
+	{
+		const int nc = std::min(GEMM_NC, n - jc);
+		for (int pc = 0; pc < k; pc += GEMM_KC)
+		{
+			const int kc = std::min(GEMM_KC, k - pc);
+			packB(opB, kc, nc, opB == GemmNormal ? b + pc * ldb + jc : b + jc * ldb + pc, ldb, nr, packedB.data());
+
+			for (int ic = 0; ic < m; ic += GEMM_MC)
+			{
+				const int mc = std::min(GEMM_MC, m - ic);
+				if (prepacked == nullptr)
+				{
+					packA(opA, mc, kc, opA == GemmNormal ? a + ic * lda + pc : a + pc * lda + ic, lda, mr,
+						  packedA.data());
+				}
+
+				for (int jr = 0; jr < nc; jr += nr)
+				{
+					for (int ir = 0; ir < mc; ir += mr)
+					{
+						// a prepacked panel holds all k columns, the block starts at its column pc
+						const float* ap = prepacked != nullptr ? prepacked + (size_t) (ic + ir) * k + pc * mr :
+										  packedA.data() + ir * kc;
+						table.gemmKernel(kc, ap, packedB.data() + jr * kc,
+										 c + (ic + ir) * ldc + jc + jr, ldc,
+										 std::min(mr, mc - ir), std::min(nr, nc - jr),
+										 accumulate || pc != 0);
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * General matrix multiplication, c = a * b, or c += a * b when accumulating
+ * The micro-kernel and its register tile come from the dispatched KernelTable.
+ * All operands are row-major, ld* is the distance in floats between rows.
+ * c must not alias a or b.
+ * @param m		rows of a and c
+ * @param n		cols of b and c
+ * @param k		cols of a, rows of b
+ * @param a		left operand
+ * @param lda	leading dimension of a
+ * @param b		right operand
+ * @param ldb	leading dimension of b
+ * @param c		result
+ * @param ldc			leading dimension of c
+ * @param accumulate	add to c instead of overwriting it
+ */
+void gemm(int m, int n, int k, const float* a, int lda, const float* b, int ldb,
+		  float* c, int ldc, bool accumulate)
+{
+	gemm(GemmNormal, GemmNormal, m, n, k, a, lda, b, ldb, c, ldc, accumulate);
+}
+
+/**
+ * Transposed matrix-vector multiplication, y = a^T * x, or y += a^T * x when accumulating,
+ * one scaled row of a added per element of x so a is read in its stored layout
+ * @param m		cols of a, length of y
+ * @param k		rows of a, length of x
+ * @param a		row-major matrix, k x m
+ * @param lda	leading dimension of a
+ * @param x		input vector
+ * @param incx	distance in floats between elements of x
+ * @param y		output vector
+ * @param incy			distance in floats between elements of y
+ * @param accumulate	add to y instead of overwriting it
+ */
+static void gemvTransposed(int m, int k, const float* a, int lda, const float* x, int incx, float* y, int incy,
+						   bool accumulate)
+{
+	if (!accumulate)
+	{
+		for (int i = 0; i < m; ++i)
+		{
+			y[i * incy] = 0;
+		}
+	}
+	int p = 0;
+	if (incy == 1)
+	{
+		// four rows per pass over y, a quarter of the y traffic, vectorized by the compiler
+		for (; p + 4 <= k; p += 4)
+		{
+			const float* row = a + p * lda;
+			const float x0 = x[p * incx];
+			const float x1 = x[(p + 1) * incx];
+			const float x2 = x[(p + 2) * incx];
+			const float x3 = x[(p + 3) * incx];
+			for (int i = 0; i < m; ++i)
+			{
+				y[i] += x0 * row[i] + x1 * row[lda + i] + x2 * row[2 * lda + i] + x3 * row[3 * lda + i];
+			}
+		}
+	}
+	for (; p < k; ++p)
+	{
+		const float* row = a + p * lda;
+		const float scale = x[p * incx];
+		for (int i = 0; i < m; ++i)
+		{
+			y[i * incy] += scale * row[i];
+		}
+	}
+}
+
+/**
+ * General matrix multiplication on transposed operands, c = op(a) * op(b), or
+ * c += op(a) * op(b) when accumulating, where op leaves an operand as stored or reads it
+ * as its transpose. A transposed operand is read in its stored layout while it is packed,
+ * it costs no copy and no extra pass, so a product with a transpose never builds one.
+ * All operands are row-major, ld* is the distance in floats between stored rows.
+ * c must not alias a or b.
+ * @param opA	GemmNormal for a stored m x k, GemmTransposed for a stored k x m
+ * @param opB	GemmNormal for b stored k x n, GemmTransposed for b stored n x k
+ * @param m		rows of op(a) and c
+ * @param n		cols of op(b) and c
+ * @param k		cols of op(a), rows of op(b)
+ * @param a		left operand
+ * @param lda	leading dimension of a as stored
+ * @param b		right operand
+ * @param ldb	leading dimension of b as stored
+ * @param c		result
+ * @param ldc			leading dimension of c
+ * @param accumulate	add to c instead of overwriting it
+ */
+void gemm(GemmOperand opA, GemmOperand opB, int m, int n, int k, const float* a, int lda,
+		  const float* b, int ldb, float* c, int ldc, bool accumulate)
+{
+	if (n == 1)
+	{
+		// a single column of op(b), its elements are a stored column or a stored row
+		const int incx = opB == GemmNormal ? ldb : 1;
+		if (opA == GemmNormal)
+		{
+			gemv(m, k, a, lda, b, incx, c, ldc, accumulate);
+		}
+		else
+		{
+			gemvTransposed(m, k, a, lda, b, incx, c, ldc, accumulate);
+		}
+		return;
+	}
+	if (m == 1 && opB == GemmTransposed)
+	{
+		// a single row of c is b times the row of op(a), dot products over stored rows of b
+		gemv(n, k, b, ldb, a, opA == GemmNormal ? 1 : lda, c, 1, accumulate);
+		return;
+	}
+	gemmBlocked(opA, opB, m, n, k, a, lda, nullptr, b, ldb, c, ldc, accumulate);
+}
+
+/**
+ * Floats of an m * k matrix prepacked by packWeights
+ * @param m		rows
+ * @param k		cols
+ * @param mr	panel height, the gemmMr of the kernels that will read it
+ * @return		ceil(m / mr) * mr * k + PACKED_PADDING
+ */
+size_t packedWeightsSize(int m, int k, int mr)
+{
+	return (size_t) ((m + mr - 1) / mr * mr) * k + PACKED_PADDING;
+}
+
+/**
+ * Prepacks a left operand once for any number of gemmPacked and densePanels calls:
+ * mr-row panels, one after the other, each holding all k columns with the mr values of
+ * a column contiguous and rows past m zero padded. Any GEMM_KC block of a panel is the
+ * micro-panel gemm would pack, and a single sample streams each panel in order.
+ * @param m			rows of a
+ * @param k			cols of a
+ * @param a			row-major matrix
+ * @param lda		leading dimension of a
+ * @param mr		panel height, the gemmMr of the kernels that will read it
+ * @param packed	destination, packedWeightsSize(m, k, mr) floats
+ */
+void packWeights(int m, int k, const float* a, int lda, int mr, float* packed)
+{
+	packA(GemmNormal, m, k, a, lda, mr, packed);
+	std::fill(packed + (size_t) ((m + mr - 1) / mr * mr) * k, packed + packedWeightsSize(m, k, mr), 0.0f);
+}
+
+/**
+ * gemm with the left operand prepacked by packWeights with the dispatched gemmMr,
+ * only the right operand is packed per call
+ * @param m				rows of a and c
+ * @param n				cols of b and c
+ * @param k				cols of a, rows of b
+ * @param packed		packWeights output
+ * @param b				right operand
+ * @param ldb			leading dimension of b
+ * @param c				result
+ * @param ldc			leading dimension of c
+ * @param accumulate	add to c instead of overwriting it
+ */
+void gemmPacked(int m, int n, int k, const float* packed, const float* b, int ldb,
+				float* c, int ldc, bool accumulate)
+{
+	gemmBlocked(GemmNormal, GemmNormal, m, n, k, nullptr, 0, packed, b, ldb, c, ldc, accumulate);
+}
+
+/**
+ * Matrix-vector multiplication, y = a * x, or y += a * x when accumulating
+ * @param m		rows of a, length of y
+ * @param k		cols of a, length of x
+ * @param a		row-major matrix
+ * @param lda	leading dimension of a
+ * @param x		input vector
+ * @param incx	distance in floats between elements of x
+ * @param y		output vector
+ * @param incy			distance in floats between elements of y
+ * @param accumulate	add to y instead of overwriting it
+ */
+void gemv(int m, int k, const float* a, int lda, const float* x, int incx, float* y, int incy,
+		  bool accumulate)
+{
+	if (incx == 1)
+	{
+		const KernelTable& table = kernels();
+		for (int i = 0; i < m; ++i)
+		{
+			const float dot = table.dot(a + i * lda, x, k);
+			y[i * incy] = accumulate ? y[i * incy] + dot : dot;
+		}
+		return;
+	}
+
+	for (int i = 0; i < m; ++i)
+	{
+		const float* row = a + i * lda;
+		float sum = 0;
+		for (int p = 0; p < k; ++p)
+		{
+			sum += row[p] * x[p * incx];
+		}
+		y[i * incy] = accumulate ? y[i * incy] + sum : sum;
+	}
+}
+
+/**
+ * Out-of-place transpose, b = a^T. Cache-oblivious: the larger side is halved until
+ * a block fits TRANSPOSE_TILE, so the blocks copied stay in every cache level they
+ * can without tuning for any. a and b must not overlap.
+ * @param a		rows x cols
+ * @param rows	rows of a
+ * @param cols	cols of a
+ * @param lda	leading dimension of a
+ * @param b		receives cols x rows
+ * @param ldb	leading dimension of b
+ */
+void transpose(const float* a, int rows, int cols, int lda, float* b, int ldb)
+{
+	if (rows <= TRANSPOSE_TILE && cols <= TRANSPOSE_TILE)
+	{
+		for (int row = 0; row < rows; ++row)
+		{
+			for (int col = 0; col < cols; ++col)
+			{
+				b[(size_t) col * ldb + row] = a[(size_t) row * lda + col];
+			}
+		}
+		return;
+	}
+	// halves rounded up to whole tiles, so the leaves are full tiles but for the last ones
+	if (rows >= cols)
+	{
+		const int half = (rows / 2 + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE * TRANSPOSE_TILE;
+		transpose(a, half, cols, lda, b, ldb);
+		transpose(a + (size_t) half * lda, rows - half, cols, lda, b + half, ldb);
+	}
+	else
+	{
+		const int half = (cols / 2 + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE * TRANSPOSE_TILE;
+		transpose(a, rows, half, lda, b, ldb);
+		transpose(a + half, rows, cols - half, lda, b + (size_t) half * ldb, ldb);
+	}
+}
+
+/**
+ * In-place transpose of a contiguous rows x cols matrix into cols x rows.
+ * A square matrix swaps TRANSPOSE_TILE tiles across the diagonal, any other shape
+ * follows the cycles of the permutation, keeping one bit per element.
+ * @param a		rows * cols floats, row-major
+ * @param rows	rows of a
+ * @param cols	cols of a
+ */
+void transposeInPlace(float* a, int rows, int cols)
+{
+	if (rows == cols)
+	{
+		const int n = rows;
+		for (int tileRow = 0; tileRow < n; tileRow += TRANSPOSE_TILE)
+		{
+			const int rowEnd = std::min(tileRow + TRANSPOSE_TILE, n);
+			for (int tileCol = tileRow; tileCol < n; tileCol += TRANSPOSE_TILE)
+			{
+				const int colEnd = std::min(tileCol + TRANSPOSE_TILE, n);
+				for (int row = tileRow; row < rowEnd; ++row)
+				{
+					// a diagonal tile swaps only its upper triangle with its lower one
+					for (int col = tileCol == tileRow ? row + 1 : tileCol; col < colEnd; ++col)
+					{
+						std::swap(a[(size_t) row * n + col], a[(size_t) col * n + row]);
+					}
+				}
+			}
+		}
+		return;
+	}
+	if (rows <= 1 || cols <= 1)
+	{
+		// a vector's layout is its transpose's
+		return;
+	}
+
+	// element i moves to i * rows mod (size - 1), the first and last ones stay
+	const size_t last = (size_t) rows * cols - 1;
+	std::vector<bool> moved(last, false);
+	for (size_t start = 1; start < last; ++start)
+	{
+		if (moved[start])
+		{
+			continue;
+		}
+		float carried = a[start];
+		size_t index = start;
+		do
+		{
+			index = index * rows % last;
+			std::swap(carried, a[index]);
+			moved[index] = true;
+		} while (index != start);
+	}
+}
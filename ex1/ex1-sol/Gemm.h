@@ -0,0 +1,182 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <cstddef>
+
+/**
+ * Rows of A packed per block (L2 resident), multiple of every micro-kernel's mr
+ */
+#define GEMM_MC 144
+
+/**
+ * Depth of a packed block (an A micro-panel plus a B micro-panel stay in L1)
+ */
+#define GEMM_KC 256
+
+/**
+ * Cols of B packed per block (L3 resident), multiple of every micro-kernel's nr
+ */
+#define GEMM_NC 4096
+
+/**
+ * Whether a micro-kernel's register tile divides the packed blocks. Prepacked panels are
+ * addressed as (ic + ir) * k + pc * mr, which is only right when mr divides GEMM_MC; every
+ * kernel asserts it next to its mr and nr.
+ * @param mr	micro-kernel rows
+ * @param nr	micro-kernel cols
+ * @return		true if GEMM_MC % mr == 0 and GEMM_NC % nr == 0
+ */
+constexpr bool gemmTileFits(int mr, int nr)
+{
+	return GEMM_MC % mr == 0 && GEMM_NC % nr == 0;
+}
+#define GEMM_TILE_ERROR "GEMM_MC and GEMM_NC must be multiples of the micro-kernel's mr and nr"
+
+/**
+ * Floats past the end of prepacked weights, zero, so a kernel may load a full vector
+ * from the last column of a panel shorter than the vector
+ */
+#define PACKED_PADDING 16
+
+/**
+ * Side of the tiles transpose copies once the recursion got them small enough. A tile
+ * of the source and one of the destination stay in L1 even when a power of two leading
+ * dimension maps all of their rows to the same cache set.
+ */
+#define TRANSPOSE_TILE 8
+
+/**
+ * How gemm reads an operand
+ */
+enum GemmOperand
+{
+	/**
+	 * As stored
+	 */
+	GemmNormal,
+	/**
+	 * As the transpose of what is stored, read in place, never copied out
+	 */
+	GemmTransposed
+};
+
+/**
+ * General matrix multiplication, c = a * b, or c += a * b when accumulating
+ * The micro-kernel and its register tile come from the dispatched KernelTable.
+ * All operands are row-major, ld* is the distance in floats between rows.
+ * c must not alias a or b.
+ * @param m		rows of a and c
+ * @param n		cols of b and c
+ * @param k		cols of a, rows of b
+ * @param a		left operand
+ * @param lda	leading dimension of a
+ * @param b		right operand
+ * @param ldb	leading dimension of b
+ * @param c		result
+ * @param ldc			leading dimension of c
+ * @param accumulate	add to c instead of overwriting it
+ */
+void gemm(int m, int n, int k, const float* a, int lda, const float* b, int ldb,
+		  float* c, int ldc, bool accumulate = false);
+
+/**
+ * General matrix multiplication on transposed operands, c = op(a) * op(b), or
+ * c += op(a) * op(b) when accumulating, where op leaves an operand as stored or reads it
+ * as its transpose. A transposed operand is read in its stored layout while it is packed,
+ * it costs no copy and no extra pass, so a product with a transpose never builds one.
+ * All operands are row-major, ld* is the distance in floats between stored rows.
+ * c must not alias a or b.
+ * @param opA	GemmNormal for a stored m x k, GemmTransposed for a stored k x m
+ * @param opB	GemmNormal for b stored k x n, GemmTransposed for b stored n x k
+ * @param m		rows of op(a) and c
+ * @param n		cols of op(b) and c
+ * @param k		cols of op(a), rows of op(b)
+ * @param a		left operand
+ * @param lda	leading dimension of a as stored
+ * @param b		right operand
+ * @param ldb	leading dimension of b as stored
+ * @param c		result
+ * @param ldc			leading dimension of c
+ * @param accumulate	add to c instead of overwriting it
+ */
+void gemm(GemmOperand opA, GemmOperand opB, int m, int n, int k, const float* a, int lda,
+		  const float* b, int ldb, float* c, int ldc, bool accumulate = false);
+
+/**
+ * Floats of an m * k matrix prepacked by packWeights
+ * @param m		rows
+ * @param k		cols
+ * @param mr	panel height, the gemmMr of the kernels that will read it
+ * @return		ceil(m / mr) * mr * k + PACKED_PADDING
+ */
+size_t packedWeightsSize(int m, int k, int mr);
+
+/**
+ * Prepacks a left operand once for any number of gemmPacked and densePanels calls:
+ * mr-row panels, one after the other, each holding all k columns with the mr values of
+ * a column contiguous and rows past m zero padded. Any GEMM_KC block of a panel is the
+ * micro-panel gemm would pack, and a single sample streams each panel in order.
+ * @param m			rows of a
+ * @param k			cols of a
+ * @param a			row-major matrix
+ * @param lda		leading dimension of a
+ * @param mr		panel height, the gemmMr of the kernels that will read it
+ * @param packed	destination, packedWeightsSize(m, k, mr) floats
+ */
+void packWeights(int m, int k, const float* a, int lda, int mr, float* packed);
+
+/**
+ * gemm with the left operand prepacked by packWeights with the dispatched gemmMr,
+ * only the right operand is packed per call
+ * @param m				rows of a and c
+ * @param n				cols of b and c
+ * @param k				cols of a, rows of b
+ * @param packed		packWeights output
+ * @param b				right operand
+ * @param ldb			leading dimension of b
+ * @param c				result
+ * @param ldc			leading dimension of c
+ * @param accumulate	add to c instead of overwriting it
+ */
+void gemmPacked(int m, int n, int k, const float* packed, const float* b, int ldb,
+				float* c, int ldc, bool accumulate = false);
+
+/**
+ * Matrix-vector multiplication, y = a * x, or y += a * x when accumulating
+ * @param m		rows of a, length of y
+ * @param k		cols of a, length of x
+ * @param a		row-major matrix
+ * @param lda	leading dimension of a
+ * @param x		input vector
+ * @param incx	distance in floats between elements of x
+ * @param y		output vector
+ * @param incy			distance in floats between elements of y
+ * @param accumulate	add to y instead of overwriting it
+ */
+void gemv(int m, int k, const float* a, int lda, const float* x, int incx, float* y, int incy,
+		  bool accumulate = false);
+
+/**
+ * Out-of-place transpose, b = a^T. Cache-oblivious: the larger side is halved until
+ * a block fits TRANSPOSE_TILE, so the blocks copied stay in every cache level they
+ * can without tuning for any. a and b must not overlap.
+ * @param a		rows x cols
+ * @param rows	rows of a
+ * @param cols	cols of a
+ * @param lda	leading dimension of a
+ * @param b		receives cols x rows
+ * @param ldb	leading dimension of b
+ */
+void transpose(const float* a, int rows, int cols, int lda, float* b, int ldb);
+
+/**
+ * In-place transpose of a contiguous rows x cols matrix into cols x rows.
+ * A square matrix swaps TRANSPOSE_TILE tiles across the diagonal, any other shape
+ * follows the cycles of the permutation, keeping one bit per element.
+ * @param a		rows * cols floats, row-major
+ * @param rows	rows of a
+ * @param cols	cols of a
+ */
+void transposeInPlace(float* a, int rows, int cols);
+
+#endif
@@ -0,0 +1,118 @@
+#include "HalfDense.h"
+#include "Kernels.h"
+
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+
+/**
+ * Rounds the weights of an fp32 layer to format
+ * @param layer		Dense
+ * @param format	HalfFormat
+ */
+HalfDense::HalfDense(const Dense& layer, HalfFormat format) :
+	_rows(layer.getWeights().getRows()), _cols(layer.getWeights().getCols()), _format(format),
+	_weights((size_t) layer.getWeights().getRows() * layer.getWeights().getCols()),
+	_biasMatrix(layer.getBias()), _activation(layer.getActivation())
+{
+	const float* weights = layer.getWeights().data();
+	for (size_t i = 0; i < this->_weights.size(); ++i)
+	{
+		this->_weights[i] = floatToHalf(weights[i], format);
+	}
+}
+
+/**
+ * returns the amount of output rows
+ * @return	rows
+ */
+int HalfDense::getRows() const
+{
+	return this->_rows;
+}
+
+/**
+ * returns the input length
+ * @return	cols
+ */
+int HalfDense::getCols() const
+{
+	return this->_cols;
+}
+
+/**
+ * Returns the storage format
+ * @return	HalfFormat
+ */
+HalfFormat HalfDense::getFormat() const
+{
+	return this->_format;
+}
+
+/**
+ * Weight of one row and col, widened to fp32
+ * @param row	row
+ * @param col	col
+ * @return		weight
+ */
+float HalfDense::getWeight(int row, int col) const
+{
+	return halfToFloat(this->_weights[(size_t) row * this->_cols + col], this->_format);
+}
+
+/**
+ * Returns the bias of this layer
+ * @return 	Bias matrix
+ */
+const Matrix& HalfDense::getBias() const
+{
+	return this->_biasMatrix;
+}
+
+/**
+ * Returns the activation function of this layer
+ * @return	Activation
+ */
+const Activation& HalfDense::getActivation() const
+{
+	return this->_activation;
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the layer on a single sample
+ * @param inputView		Column vector
+ * @return				Matrix
+ */
+Matrix HalfDense::operator()(const MatrixView& inputView) const
+{
+	Matrix result(this->_rows, 1);
+	if (inputView.getLd() != 1)
+	{
+		// strided column: gather it once, the kernel reads x contiguously
+		const Matrix input(inputView);
+		this->forward(MatrixView(input), result.data());
+		return result;
+	}
+	this->forward(inputView, result.data());
+	return result;
+}
+
+/**
+ * Applies the layer on a single sample into caller provided storage, allocating nothing
+ * @param inputView		Column vector, contiguous
+ * @param output		getRows() floats, must not alias the input
+ */
+void HalfDense::forward(const MatrixView& inputView, float* output) const
+{
+	if (inputView.getRows() != this->_cols || inputView.getCols() != 1 || inputView.getLd() != 1)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	const bool relu = this->_activation.getActivationType() == Relu;
+	kernels().denseHalf(this->_rows, this->_cols, this->_weights.data(), inputView.data(), this->_biasMatrix.data(),
+						output, relu, this->_format);
+	if (!relu)
+	{
+		this->_activation.apply(output, this->_rows, 1);
+	}
+}
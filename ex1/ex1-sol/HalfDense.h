@@ -0,0 +1,113 @@
+#ifndef HALF_DENSE_H
+#define HALF_DENSE_H
+
+#include <cstdint>
+#include <vector>
+#include "Matrix.h"
+#include "MatrixView.h"
+#include "Activation.h"
+#include "Dense.h"
+#include "HalfFloat.h"
+
+/**
+ * Class HalfDense
+ * Dense layer whose weights are stored as bfloat16 or IEEE fp16, half the bytes
+ * of fp32. Weights are widened in registers, accumulation, bias and activation
+ * stay in fp32.
+ */
+class HalfDense
+{
+ private:
+	/**
+	 * Output rows
+	 */
+	int _rows;
+
+	/**
+	 * Input length
+	 */
+	int _cols;
+
+	/**
+	 * Storage format of _weights
+	 */
+	HalfFormat _format;
+
+	/**
+	 * Weights, row-major
+	 */
+	std::vector<uint16_t> _weights;
+
+	/**
+	 * Bias matrix
+	 */
+	Matrix _biasMatrix;
+
+	/**
+	 * Activation type
+	 */
+	Activation _activation;
+
+ public:
+	/**
+	 * Rounds the weights of an fp32 layer to format
+	 * @param layer		Dense
+	 * @param format	HalfFormat
+	 */
+	HalfDense(const Dense& layer, HalfFormat format);
+
+	/**
+	 * returns the amount of output rows
+	 * @return	rows
+	 */
+	int getRows() const;
+
+	/**
+	 * returns the input length
+	 * @return	cols
+	 */
+	int getCols() const;
+
+	/**
+	 * Returns the storage format
+	 * @return	HalfFormat
+	 */
+	HalfFormat getFormat() const;
+
+	/**
+	 * Weight of one row and col, widened to fp32
+	 * @param row	row
+	 * @param col	col
+	 * @return		weight
+	 */
+	float getWeight(int row, int col) const;
+
+	/**
+	 * Returns the bias of this layer
+	 * @return 	Bias matrix
+	 */
+	const Matrix& getBias() const;
+
+	/**
+	 * Returns the activation function of this layer
+	 * @return	Activation
+	 */
+	const Activation& getActivation() const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the layer on a single sample
+	 * @param inputView		Column vector
+	 * @return				Matrix
+	 */
+	Matrix operator()(const MatrixView& inputView) const;
+
+	/**
+	 * Applies the layer on a single sample into caller provided storage, allocating nothing
+	 * @param inputView		Column vector, contiguous
+	 * @param output		getRows() floats, must not alias the input
+	 */
+	void forward(const MatrixView& inputView, float* output) const;
+};
+
+#endif
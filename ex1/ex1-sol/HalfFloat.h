@@ -0,0 +1,147 @@
+#ifndef HALF_FLOAT_H
+#define HALF_FLOAT_H
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * 16 bit storage formats of reduced precision weights
+ */
+enum HalfFormat
+{
+	/**
+	 * bfloat16: the upper half of an fp32, 8 exponent bits and 7 mantissa bits
+	 */
+	HalfBf16,
+	/**
+	 * IEEE 754 binary16: 5 exponent bits and 10 mantissa bits, max 65504
+	 */
+	HalfFp16
+};
+
+/**
+ * Rounds an fp32 to bfloat16, nearest even
+ * @param value	fp32
+ * @return		bf16 bits
+ */
+inline uint16_t floatToBf16(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	if ((bits & 0x7FFFFFFFu) > 0x7F800000u)
+	{
+		// NaN stays a quiet NaN instead of rounding into infinity
+		return (uint16_t) ((bits >> 16) | 0x40u);
+	}
+	return (uint16_t) ((bits + 0x7FFFu + ((bits >> 16) & 1u)) >> 16);
+}
+
+/**
+ * Widens a bfloat16 to fp32, exact
+ * @param half	bf16 bits
+ * @return		fp32
+ */
+inline float bf16ToFloat(uint16_t half)
+{
+	const uint32_t bits = (uint32_t) half << 16;
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/**
+ * Rounds an fp32 to IEEE binary16, nearest even, with subnormals,
+ * overflow to infinity and NaN kept
+ * @param value	fp32
+ * @return		fp16 bits
+ */
+inline uint16_t floatToFp16(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = (bits >> 16) & 0x8000u;
+	const uint32_t magnitude = bits & 0x7FFFFFFFu;
+	if (magnitude >= 0x7F800000u)
+	{
+		return (uint16_t) (sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0));
+	}
+	if (magnitude >= 0x477FF000u)
+	{
+		// 65520 and above round past the largest finite half
+		return (uint16_t) (sign | 0x7C00u);
+	}
+	if (magnitude < 0x38800000u)
+	{
+		// below 2^-14: a subnormal half in units of 2^-24, or zero under 2^-25
+		if (magnitude < 0x33000000u)
+		{
+			return (uint16_t) sign;
+		}
+		const uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+		const uint32_t shift = 126 - (magnitude >> 23);
+		const uint32_t remainder = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		uint32_t half = mantissa >> shift;
+		half += remainder > halfway || (remainder == halfway && (half & 1u));
+		return (uint16_t) (sign | half);
+	}
+	// rebias the exponent from 127 to 15, a mantissa carry moves into the exponent
+	uint32_t half = (magnitude - 0x38000000u) >> 13;
+	const uint32_t remainder = magnitude & 0x1FFFu;
+	half += remainder > 0x1000u || (remainder == 0x1000u && (half & 1u));
+	return (uint16_t) (sign | half);
+}
+
+/**
+ * Widens an IEEE binary16 to fp32, exact
+ * @param half	fp16 bits
+ * @return		fp32
+ */
+inline float fp16ToFloat(uint16_t half)
+{
+	const uint32_t sign = (uint32_t) (half & 0x8000u) << 16;
+	const uint32_t exponent = (half >> 10) & 0x1Fu;
+	const uint32_t mantissa = half & 0x3FFu;
+	uint32_t bits = sign;
+	if (exponent == 0x1Fu)
+	{
+		bits |= 0x7F800000u | (mantissa << 13);
+	}
+	else if (exponent != 0)
+	{
+		bits |= ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	else if (mantissa != 0)
+	{
+		// subnormal: mantissa * 2^-24
+		const float value = (float) mantissa * (1.0f / 16777216.0f);
+		return sign != 0 ? -value : value;
+	}
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/**
+ * Widens either format to fp32
+ * @param half		bits
+ * @param format	HalfFormat
+ * @return			fp32
+ */
+inline float halfToFloat(uint16_t half, HalfFormat format)
+{
+	return format == HalfBf16 ? bf16ToFloat(half) : fp16ToFloat(half);
+}
+
+/**
+ * Rounds an fp32 to either format
+ * @param value		fp32
+ * @param format	HalfFormat
+ * @return			bits
+ */
+inline uint16_t floatToHalf(float value, HalfFormat format)
+{
+	return format == HalfBf16 ? floatToBf16(value) : floatToFp16(value);
+}
+
+#endif
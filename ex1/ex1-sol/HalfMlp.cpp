@@ -0,0 +1,75 @@
+#include <algorithm>
+#include "HalfMlp.h"
+
+/**
+ * Converts the weights of an fp32 network, e.g. one loaded from the fp32 files
+ * @param network	MlpNetwork
+ * @param format	HalfFormat
+ */
+HalfMlp::HalfMlp(const MlpNetwork& network, HalfFormat format) : _widest(0)
+{
+	for (const Dense& layer : network.getLayers())
+	{
+		this->_layers.emplace_back(layer, format);
+		this->_widest = std::max(this->_widest, this->_layers.back().getRows());
+	}
+}
+
+/**
+ * Returns the layers
+ * @return	Layers, input first
+ */
+const std::vector<HalfDense>& HalfMlp::getLayers() const
+{
+	return this->_layers;
+}
+
+/**
+ * Returns the bytes held by the weights
+ * @return	bytes
+ */
+long HalfMlp::weightBytes() const
+{
+	long bytes = 0;
+	for (const HalfDense& layer : this->_layers)
+	{
+		bytes += (long) layer.getRows() * layer.getCols() * (long) sizeof(uint16_t);
+	}
+	return bytes;
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the entire network on input
+ * @param img	Image matrix
+ * @return		Digit
+ */
+Digit HalfMlp::operator()(const Matrix& img) const
+{
+	return (*this)(MatrixView(img).vectorize());
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the entire network on a view of the input, allocating nothing
+ * in steady state
+ * @param img	Image view, a contiguous column vector
+ * @return		Digit
+ */
+Digit HalfMlp::operator()(const MatrixView& img) const
+{
+	static thread_local MlpWorkspace workspace;
+	if (workspace.getWidth() < this->_widest)
+	{
+		workspace = MlpWorkspace(this->_widest);
+	}
+
+	MatrixView input = img;
+	for (size_t i = 0; i < this->_layers.size(); ++i)
+	{
+		float* output = workspace.buffer((int) (i % MLP_PING_PONG));
+		this->_layers[i].forward(input, output);
+		input = MatrixView(output, this->_layers[i].getRows(), 1, 1);
+	}
+	return MlpNetwork::mostProbable(input, 0);
+}
@@ -0,0 +1,64 @@
+#ifndef HALF_MLP_H
+#define HALF_MLP_H
+
+#include <vector>
+#include "MlpNetwork.h"
+#include "HalfDense.h"
+
+/**
+ * Class HalfMlp
+ * The layers of an fp32 MlpNetwork with weights stored as bfloat16 or IEEE fp16.
+ * Forward passes run on the same ping-pong workspace plan as MlpNetwork.
+ */
+class HalfMlp
+{
+ private:
+	/**
+	 * Layers, input first
+	 */
+	std::vector<HalfDense> _layers;
+
+	/**
+	 * Buffer plan: the widest layer output, the size of each workspace buffer
+	 */
+	int _widest;
+
+ public:
+	/**
+	 * Converts the weights of an fp32 network, e.g. one loaded from the fp32 files
+	 * @param network	MlpNetwork
+	 * @param format	HalfFormat
+	 */
+	HalfMlp(const MlpNetwork& network, HalfFormat format);
+
+	/**
+	 * Returns the layers
+	 * @return	Layers, input first
+	 */
+	const std::vector<HalfDense>& getLayers() const;
+
+	/**
+	 * Returns the bytes held by the weights
+	 * @return	bytes
+	 */
+	long weightBytes() const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the entire network on input
+	 * @param img	Image matrix
+	 * @return		Digit
+	 */
+	Digit operator()(const Matrix& img) const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the entire network on a view of the input, allocating nothing
+	 * in steady state
+	 * @param img	Image view, a contiguous column vector
+	 * @return		Digit
+	 */
+	Digit operator()(const MatrixView& img) const;
+};
+
+#endif
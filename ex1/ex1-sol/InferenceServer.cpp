@@ -0,0 +1,649 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "InferenceServer.h"
+
+#define PIXEL_SCALE (1.0f / 255.0f)
+#define READ_CHUNK (1 << 16)
+#define MAX_INPUT_BYTES (4 * READ_CHUNK)
+#define WAKE_DRAIN 64
+#define IMAGE_PIXELS (imgDims.rows * imgDims.cols)
+
+/**
+ * Puts a descriptor in non-blocking mode
+ * @param fd	descriptor
+ * @return		false on failure
+ */
+static bool setNonBlocking(int fd)
+{
+	const int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/**
+ * Fills the address of a socket path
+ * @param socketPath	filesystem path
+ * @param address		receives the address
+ * @return				false if the path does not fit
+ */
+static bool socketAddress(const std::string& socketPath, sockaddr_un& address)
+{
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+	return true;
+}
+
+/**
+ * Bytes of a request's image
+ * @param format	SERVER_FORMAT_FLOAT or SERVER_FORMAT_BYTES
+ * @param pixels	network inputs
+ * @return			bytes, 0 for an unknown format
+ */
+static size_t imageBytes(unsigned char format, int pixels)
+{
+	return format == SERVER_FORMAT_FLOAT ? pixels * sizeof(float) :
+		   format == SERVER_FORMAT_BYTES ? (size_t) pixels : 0;
+}
+
+/**
+ * Drops the consumed front of a buffer once it outweighs the rest, so consuming
+ * n bytes in any number of steps moves O(n) bytes
+ * @param buffer	bytes
+ * @param offset	consumed bytes, reset with the buffer
+ */
+static void compact(std::string& buffer, size_t& offset)
+{
+	if (offset == buffer.size())
+	{
+		buffer.clear();
+		offset = 0;
+	}
+	else if (offset > buffer.size() - offset)
+	{
+		buffer.erase(0, offset);
+		offset = 0;
+	}
+}
+
+/**
+ * Constructor
+ * @param network		Network, must outlive the server
+ * @param maxBatch		requests per batch, at least 1
+ * @param maxWaitMicros	longest the oldest request waits for a fuller batch
+ */
+InferenceServer::InferenceServer(const MlpNetwork& network, int maxBatch, int maxWaitMicros) :
+	_network(network), _maxBatch(std::max(1, maxBatch)), _maxWait(std::max(0, maxWaitMicros)), _listenFd(-1),
+	_wakeFds{ -1, -1 }, _stopping(false), _nextConnection(0), _served(0), _batches(0)
+{
+	if (pipe(this->_wakeFds) == 0)
+	{
+		setNonBlocking(this->_wakeFds[0]);
+		setNonBlocking(this->_wakeFds[1]);
+	}
+}
+
+/**
+ * Closes the socket and every connection
+ */
+InferenceServer::~InferenceServer()
+{
+	for (auto& entry : this->_connections)
+	{
+		close(entry.second.fd);
+	}
+	for (int fd : { this->_listenFd, this->_wakeFds[0], this->_wakeFds[1] })
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+}
+
+/**
+ * Reads the batch bounds from SERVER_BATCH_ENV and SERVER_WAIT_ENV
+ * @param maxBatch		receives the batch size, SERVER_DEFAULT_BATCH when unset
+ * @param maxWaitMicros	receives the wait, SERVER_DEFAULT_WAIT_US when unset
+ * @return				false if a variable is set to an invalid value
+ */
+bool InferenceServer::loadOptions(int& maxBatch, int& maxWaitMicros)
+{
+	maxBatch = SERVER_DEFAULT_BATCH;
+	maxWaitMicros = SERVER_DEFAULT_WAIT_US;
+	const char* batch = std::getenv(SERVER_BATCH_ENV);
+	const char* wait = std::getenv(SERVER_WAIT_ENV);
+	char* end = nullptr;
+	if (batch != nullptr)
+	{
+		maxBatch = (int) std::strtol(batch, &end, 10);
+		if (end == batch || *end != '\0' || maxBatch < 1)
+		{
+			return false;
+		}
+	}
+	if (wait != nullptr)
+	{
+		maxWaitMicros = (int) std::strtol(wait, &end, 10);
+		if (end == wait || *end != '\0' || maxWaitMicros < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Binds the socket, replacing a stale one at the same path
+ * @param socketPath	filesystem path of the socket
+ * @return				false if it cannot be created or bound
+ */
+bool InferenceServer::listen(const std::string& socketPath)
+{
+	sockaddr_un address = {};
+	if (this->_listenFd >= 0 || this->_wakeFds[0] < 0 || !socketAddress(socketPath, address))
+	{
+		return false;
+	}
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	unlink(socketPath.c_str());
+	if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+		::listen(fd, SOMAXCONN) != 0 || !setNonBlocking(fd))
+	{
+		close(fd);
+		return false;
+	}
+	this->_listenFd = fd;
+	this->_socketPath = socketPath;
+	return true;
+}
+
+/**
+ * Serves on the calling thread until stop, then removes the socket
+ */
+void InferenceServer::run()
+{
+	std::thread batcher(&InferenceServer::_batchLoop, this);
+	std::vector<pollfd> fds;
+	std::vector<uint64_t> ids;
+	while (!this->_stopping && this->_listenFd >= 0)
+	{
+		// the wake pipe, the listening socket, then every connection
+		fds.clear();
+		ids.clear();
+		fds.push_back({ this->_wakeFds[0], POLLIN, 0 });
+		fds.push_back({ this->_listenFd, POLLIN, 0 });
+		{
+			std::lock_guard<std::mutex> lock(this->_connectionsMutex);
+			for (const auto& entry : this->_connections)
+			{
+				const bool writable = entry.second.outputOffset < entry.second.output.size();
+				fds.push_back({ entry.second.fd, (short) ((_readable(entry.second) ? POLLIN : 0) |
+														  (writable ? POLLOUT : 0)), 0 });
+				ids.push_back(entry.first);
+			}
+		}
+		if (poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		char drain[WAKE_DRAIN];
+		while (read(this->_wakeFds[0], drain, sizeof(drain)) > 0)
+		{
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			this->_accept();
+		}
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			bool open = !(fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) || this->_read(ids[i]);
+			// requests are queued as the bounds allow, a paused connection resumes once
+			// a batch answered it; replies are written eagerly, those the batcher queued
+			// since the poll included
+			std::lock_guard<std::mutex> lock(this->_connectionsMutex);
+			Connection& connection = this->_connections.find(ids[i])->second;
+			open = this->_parse(ids[i], connection) && open;
+			open = open && (connection.outputOffset == connection.output.size() || _write(connection));
+			if (!open)
+			{
+				close(connection.fd);
+				this->_connections.erase(ids[i]);
+			}
+		}
+	}
+
+	this->_stopping = true;
+	{
+		// taken so the batcher either sees _stopping or is already waiting for this notify
+		std::lock_guard<std::mutex> lock(this->_queueMutex);
+	}
+	this->_queueReady.notify_all();
+	batcher.join();
+
+	std::lock_guard<std::mutex> lock(this->_connectionsMutex);
+	for (auto& entry : this->_connections)
+	{
+		close(entry.second.fd);
+	}
+	this->_connections.clear();
+	if (this->_listenFd >= 0)
+	{
+		close(this->_listenFd);
+		this->_listenFd = -1;
+		unlink(this->_socketPath.c_str());
+	}
+}
+
+/**
+ * Makes run return, from any thread or from a signal handler
+ */
+void InferenceServer::stop()
+{
+	this->_stopping = true;
+	this->_wake();
+}
+
+/**
+ * Returns the requests answered so far
+ * @return	requests
+ */
+long InferenceServer::served() const
+{
+	return this->_served;
+}
+
+/**
+ * Returns the batches run so far
+ * @return	batches
+ */
+long InferenceServer::batches() const
+{
+	return this->_batches;
+}
+
+/**
+ * Batches requests and classifies them until stop
+ */
+void InferenceServer::_batchLoop()
+{
+	std::vector<Matrix> images;
+	std::vector<uint64_t> owners;
+	Matrix batch;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->_queueMutex);
+			this->_queueReady.wait(lock, [this] { return this->_stopping || !this->_queue.empty(); });
+			// a full batch goes at once, a partial one once its oldest request waited _maxWait
+			const auto deadline = this->_queue.empty() ? std::chrono::steady_clock::now() :
+								  this->_queue.front().arrival + this->_maxWait;
+			this->_queueReady.wait_until(lock, deadline, [this]
+			{
+				return this->_stopping || (int) this->_queue.size() >= this->_maxBatch;
+			});
+			if (this->_stopping)
+			{
+				return;
+			}
+			// last batch's image buffers go back to the I/O thread that allocated them
+			for (Matrix& image : images)
+			{
+				this->_returnedImages.push_back(std::move(image));
+			}
+			images.clear();
+			owners.clear();
+			const int count = std::min((int) this->_queue.size(), this->_maxBatch);
+			for (int i = 0; i < count; ++i)
+			{
+				images.push_back(std::move(this->_queue.front().image));
+				owners.push_back(this->_queue.front().connection);
+				this->_queue.pop_front();
+			}
+		}
+
+		// the batch storage is reused while batches stay full
+		this->_network.packBatch(images.data(), (int) images.size(), batch);
+		const std::vector<Digit> digits = this->_network.classifyBatch(MatrixView(batch));
+		{
+			std::lock_guard<std::mutex> lock(this->_connectionsMutex);
+			for (size_t i = 0; i < digits.size(); ++i)
+			{
+				// the connection may have closed meanwhile, its replies are dropped
+				auto connection = this->_connections.find(owners[i]);
+				if (connection == this->_connections.end())
+				{
+					continue;
+				}
+				const uint32_t value = digits[i].value;
+				char reply[SERVER_REPLY_BYTES];
+				std::memcpy(reply, &value, sizeof(value));
+				std::memcpy(reply + sizeof(value), &digits[i].probability, sizeof(float));
+				connection->second.output.append(reply, SERVER_REPLY_BYTES);
+				--connection->second.pending;
+			}
+		}
+		this->_served += (long) digits.size();
+		++this->_batches;
+		this->_wake();
+	}
+}
+
+/**
+ * Accepts every pending connection
+ */
+void InferenceServer::_accept()
+{
+	while (true)
+	{
+		const int fd = accept(this->_listenFd, nullptr, nullptr);
+		if (fd < 0)
+		{
+			return;
+		}
+		if (!setNonBlocking(fd))
+		{
+			close(fd);
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(this->_connectionsMutex);
+		this->_connections[this->_nextConnection++] = { fd, std::string(), 0, std::string(), 0, 0 };
+	}
+}
+
+/**
+ * Reads what a connection sent, up to a bounded amount of unqueued input
+ * @param id	connection id
+ * @return		false if the connection closed
+ */
+bool InferenceServer::_read(uint64_t id)
+{
+	// only this thread inserts or erases connections or touches their input
+	Connection& connection = this->_connections.find(id)->second;
+	char chunk[READ_CHUNK];
+	while (connection.input.size() - connection.inputOffset < MAX_INPUT_BYTES)
+	{
+		const ssize_t received = recv(connection.fd, chunk, sizeof(chunk), 0);
+		if (received > 0)
+		{
+			connection.input.append(chunk, (size_t) received);
+			continue;
+		}
+		return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+	}
+	return true;
+}
+
+/**
+ * Queues the whole requests a connection sent, up to SERVER_MAX_PENDING
+ * @param id			connection id
+ * @param connection	Connection, with _connectionsMutex held
+ * @return				false on an unknown format
+ */
+bool InferenceServer::_parse(uint64_t id, Connection& connection)
+{
+	std::vector<Request> requests;
+	const auto now = std::chrono::steady_clock::now();
+	size_t& offset = connection.inputOffset;
+	const int pixels = this->_network.getInputs();
+	bool valid = true;
+	while (offset < connection.input.size() && connection.pending + (int) requests.size() < SERVER_MAX_PENDING)
+	{
+		const unsigned char format = (unsigned char) connection.input[offset];
+		const size_t bytes = imageBytes(format, pixels);
+		if (bytes == 0)
+		{
+			valid = false;
+			break;
+		}
+		if (connection.input.size() - offset < 1 + bytes)
+		{
+			break;
+		}
+		const char* payload = connection.input.data() + offset + 1;
+		Matrix image = this->_imageBuffer(pixels);
+		if (format == SERVER_FORMAT_FLOAT)
+		{
+			std::memcpy(image.data(), payload, bytes);
+		}
+		else
+		{
+			for (int i = 0; i < pixels; ++i)
+			{
+				image[i] = (float) (unsigned char) payload[i] * PIXEL_SCALE;
+			}
+		}
+		requests.push_back({ id, std::move(image), now });
+		offset += 1 + bytes;
+	}
+	compact(connection.input, offset);
+
+	if (!requests.empty())
+	{
+		connection.pending += (int) requests.size();
+		{
+			std::lock_guard<std::mutex> lock(this->_queueMutex);
+			for (Request& request : requests)
+			{
+				this->_queue.push_back(std::move(request));
+			}
+		}
+		this->_queueReady.notify_one();
+	}
+	return valid;
+}
+
+/**
+ * Returns a buffer for a request's image on the I/O thread, a returned one if any
+ * @param pixels	network inputs
+ * @return			Matrix, pixels x 1, uninitialized
+ */
+Matrix InferenceServer::_imageBuffer(int pixels)
+{
+	if (this->_spareImages.empty())
+	{
+		std::lock_guard<std::mutex> lock(this->_queueMutex);
+		std::swap(this->_spareImages, this->_returnedImages);
+	}
+	if (this->_spareImages.empty())
+	{
+		return Matrix::uninitialized(pixels, 1);
+	}
+	Matrix image = std::move(this->_spareImages.back());
+	this->_spareImages.pop_back();
+	return image;
+}
+
+/**
+ * Returns whether a connection may be read: it is under both backpressure bounds
+ * @param connection	Connection, with _connectionsMutex held
+ * @return				false while paused
+ */
+bool InferenceServer::_readable(const Connection& connection)
+{
+	return connection.pending < SERVER_MAX_PENDING &&
+		   connection.output.size() - connection.outputOffset < SERVER_MAX_OUTPUT_BYTES;
+}
+
+/**
+ * Writes as much of a connection's pending replies as the socket takes
+ * @param connection	Connection, with _connectionsMutex held
+ * @return				false on a write error
+ */
+bool InferenceServer::_write(Connection& connection)
+{
+	size_t& written = connection.outputOffset;
+	while (written < connection.output.size())
+	{
+		const ssize_t sent = ::send(connection.fd, connection.output.data() + written,
+									connection.output.size() - written, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				return false;
+			}
+			break;
+		}
+		written += (size_t) sent;
+	}
+	compact(connection.output, written);
+	return true;
+}
+
+/**
+ * Wakes the I/O thread
+ */
+void InferenceServer::_wake()
+{
+	const char byte = 0;
+	const ssize_t written = write(this->_wakeFds[1], &byte, 1);
+	(void) written;
+}
+
+/**
+ * Constructs an unconnected client
+ */
+InferenceClient::InferenceClient() : _fd(-1), _frame(1 + IMAGE_PIXELS * sizeof(float))
+{
+}
+
+/**
+ * Closes the connection
+ */
+InferenceClient::~InferenceClient()
+{
+	if (this->_fd >= 0)
+	{
+		close(this->_fd);
+	}
+}
+
+/**
+ * Connects to a server
+ * @param socketPath	filesystem path of the server socket
+ * @return				false if the server cannot be reached
+ */
+bool InferenceClient::connect(const std::string& socketPath)
+{
+	sockaddr_un address = {};
+	if (this->_fd >= 0 || !socketAddress(socketPath, address))
+	{
+		return false;
+	}
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	this->_fd = fd;
+	return true;
+}
+
+/**
+ * Sends one image as floats
+ * @param image	imgDims floats
+ * @return		false on a write error
+ */
+bool InferenceClient::send(const float* image)
+{
+	this->_frame[0] = SERVER_FORMAT_FLOAT;
+	std::memcpy(this->_frame.data() + 1, image, IMAGE_PIXELS * sizeof(float));
+	return this->_writeAll(this->_frame.data(), 1 + IMAGE_PIXELS * sizeof(float));
+}
+
+/**
+ * Sends one image as unsigned pixels
+ * @param pixels	imgDims bytes, 255 is 1.0
+ * @return			false on a write error
+ */
+bool InferenceClient::send(const uint8_t* pixels)
+{
+	this->_frame[0] = SERVER_FORMAT_BYTES;
+	std::memcpy(this->_frame.data() + 1, pixels, IMAGE_PIXELS);
+	return this->_writeAll(this->_frame.data(), 1 + IMAGE_PIXELS);
+}
+
+/**
+ * Receives the reply to the oldest unanswered request
+ * @param digit	receives the digit and its probability
+ * @return		false if the connection closed
+ */
+bool InferenceClient::receive(Digit& digit)
+{
+	char reply[SERVER_REPLY_BYTES];
+	size_t received = 0;
+	while (received < SERVER_REPLY_BYTES)
+	{
+		const ssize_t bytes = recv(this->_fd, reply + received, SERVER_REPLY_BYTES - received, 0);
+		if (bytes <= 0)
+		{
+			if (bytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		received += (size_t) bytes;
+	}
+	uint32_t value = 0;
+	std::memcpy(&value, reply, sizeof(value));
+	std::memcpy(&digit.probability, reply + sizeof(value), sizeof(float));
+	digit.value = value;
+	return true;
+}
+
+/**
+ * Writes a whole buffer
+ * @param data	bytes
+ * @param size	byte count
+ * @return		false on a write error
+ */
+bool InferenceClient::_writeAll(const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		const ssize_t sent = ::send(this->_fd, data, size, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		data += sent;
+		size -= (size_t) sent;
+	}
+	return true;
+}
@@ -0,0 +1,330 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "MlpNetwork.h"
+
+/**
+ * Request formats, the first byte of every request. The image follows in the host's
+ * byte order: one float per network input (imgDims for the digit models), or one
+ * unsigned pixel per input scaled by 1 / 255.
+ * The reply is the digit as uint32_t, then its probability as a float.
+ */
+#define SERVER_FORMAT_FLOAT 0
+#define SERVER_FORMAT_BYTES 1
+#define SERVER_REPLY_BYTES (sizeof(uint32_t) + sizeof(float))
+
+/**
+ * Environment variables bounding a batch: requests per batch, and microseconds the
+ * oldest request waits for more before a partial batch runs
+ */
+#define SERVER_BATCH_ENV "MLP_SERVE_BATCH"
+#define SERVER_WAIT_ENV "MLP_SERVE_WAIT_US"
+#define SERVER_DEFAULT_BATCH 64
+#define SERVER_DEFAULT_WAIT_US 1000
+
+/**
+ * Backpressure: a connection is not read while it has SERVER_MAX_PENDING requests
+ * queued or in a batch, or SERVER_MAX_OUTPUT_BYTES of replies it has not taken yet,
+ * so a client that pipelines without reading blocks in its own send
+ */
+#define SERVER_MAX_PENDING 256
+#define SERVER_MAX_OUTPUT_BYTES (SERVER_MAX_PENDING * SERVER_REPLY_BYTES)
+
+/**
+ * Class InferenceServer
+ * Classifies images sent over a Unix domain socket, batching requests dynamically:
+ * an I/O thread reads the requests of every connection into one queue, a batcher thread
+ * takes up to maxBatch of them as soon as that many wait or the oldest one waited
+ * maxWait, runs them as one MlpNetwork batch and queues each reply on its connection.
+ * A connection may pipeline requests, its replies come back in order.
+ */
+class InferenceServer
+{
+ public:
+	/**
+	 * Constructor
+	 * @param network		Network, must outlive the server
+	 * @param maxBatch		requests per batch, at least 1
+	 * @param maxWaitMicros	longest the oldest request waits for a fuller batch
+	 */
+	InferenceServer(const MlpNetwork& network, int maxBatch, int maxWaitMicros);
+
+	/**
+	 * Closes the socket and every connection
+	 */
+	~InferenceServer();
+
+	InferenceServer(const InferenceServer&) = delete;
+	InferenceServer& operator=(const InferenceServer&) = delete;
+
+	/**
+	 * Reads the batch bounds from SERVER_BATCH_ENV and SERVER_WAIT_ENV
+	 * @param maxBatch		receives the batch size, SERVER_DEFAULT_BATCH when unset
+	 * @param maxWaitMicros	receives the wait, SERVER_DEFAULT_WAIT_US when unset
+	 * @return				false if a variable is set to an invalid value
+	 */
+	static bool loadOptions(int& maxBatch, int& maxWaitMicros);
+
+	/**
+	 * Binds the socket, replacing a stale one at the same path
+	 * @param socketPath	filesystem path of the socket
+	 * @return				false if it cannot be created or bound
+	 */
+	bool listen(const std::string& socketPath);
+
+	/**
+	 * Serves on the calling thread until stop, then removes the socket
+	 */
+	void run();
+
+	/**
+	 * Makes run return, from any thread or from a signal handler
+	 */
+	void stop();
+
+	/**
+	 * Returns the requests answered so far
+	 * @return	requests
+	 */
+	long served() const;
+
+	/**
+	 * Returns the batches run so far
+	 * @return	batches
+	 */
+	long batches() const;
+
+ private:
+	/**
+	 * @struct Request
+	 * @brief One image waiting for a batch
+	 * @var connection - id of the connection to reply on
+	 * @var image - one float per network input
+	 * @var arrival - when the request was read
+	 */
+	typedef struct Request
+	{
+		uint64_t connection;
+		Matrix image;
+		std::chrono::steady_clock::time_point arrival;
+	} Request;
+
+	/**
+	 * @struct Connection
+	 * @brief A client socket. Buffers are consumed from an offset, compacted once
+	 * the consumed part is the larger one.
+	 * @var fd - socket
+	 * @var input - received bytes, requests from inputOffset on not queued yet
+	 * @var inputOffset - bytes of input already queued
+	 * @var output - replies, guarded by _connectionsMutex
+	 * @var outputOffset - bytes of output already written
+	 * @var pending - requests queued or in a batch, guarded by _connectionsMutex
+	 */
+	typedef struct Connection
+	{
+		int fd;
+		std::string input;
+		size_t inputOffset;
+		std::string output;
+		size_t outputOffset;
+		int pending;
+	} Connection;
+
+	/**
+	 * Shared network
+	 */
+	const MlpNetwork& _network;
+
+	/**
+	 * Requests per batch
+	 */
+	int _maxBatch;
+
+	/**
+	 * Longest wait for a fuller batch
+	 */
+	std::chrono::microseconds _maxWait;
+
+	/**
+	 * Listening socket, -1 before listen
+	 */
+	int _listenFd;
+
+	/**
+	 * Socket path, removed by run on exit
+	 */
+	std::string _socketPath;
+
+	/**
+	 * Self-pipe waking the I/O thread: stop, or replies to write
+	 */
+	int _wakeFds[2];
+
+	/**
+	 * Set by stop
+	 */
+	std::atomic<bool> _stopping;
+
+	/**
+	 * Open connections by id, and their pending replies
+	 */
+	std::map<uint64_t, Connection> _connections;
+	std::mutex _connectionsMutex;
+
+	/**
+	 * Next connection id
+	 */
+	uint64_t _nextConnection;
+
+	/**
+	 * Requests waiting for a batch, oldest first
+	 */
+	std::deque<Request> _queue;
+	std::mutex _queueMutex;
+	std::condition_variable _queueReady;
+
+	/**
+	 * Image buffers of classified requests, handed back by the batcher under _queueMutex,
+	 * and the ones the I/O thread took over. Requests are allocated and freed on the
+	 * I/O thread only, so neither thread's allocator cache drains into the other's.
+	 */
+	std::vector<Matrix> _returnedImages;
+	std::vector<Matrix> _spareImages;
+
+	/**
+	 * Counters
+	 */
+	std::atomic<long> _served;
+	std::atomic<long> _batches;
+
+	/**
+	 * Batches requests and classifies them until stop
+	 */
+	void _batchLoop();
+
+	/**
+	 * Accepts every pending connection
+	 */
+	void _accept();
+
+	/**
+	 * Reads what a connection sent, up to a bounded amount of unqueued input
+	 * @param id	connection id
+	 * @return		false if the connection closed
+	 */
+	bool _read(uint64_t id);
+
+	/**
+	 * Queues the whole requests a connection sent, up to SERVER_MAX_PENDING
+	 * @param id			connection id
+	 * @param connection	Connection, with _connectionsMutex held
+	 * @return				false on an unknown format
+	 */
+	bool _parse(uint64_t id, Connection& connection);
+
+	/**
+	 * Returns a buffer for a request's image on the I/O thread, a returned one if any
+	 * @param pixels	network inputs
+	 * @return			Matrix, pixels x 1, uninitialized
+	 */
+	Matrix _imageBuffer(int pixels);
+
+	/**
+	 * Returns whether a connection may be read: it is under both backpressure bounds
+	 * @param connection	Connection, with _connectionsMutex held
+	 * @return				false while paused
+	 */
+	static bool _readable(const Connection& connection);
+
+	/**
+	 * Writes as much of a connection's pending replies as the socket takes
+	 * @param connection	Connection, with _connectionsMutex held
+	 * @return				false on a write error
+	 */
+	static bool _write(Connection& connection);
+
+	/**
+	 * Wakes the I/O thread
+	 */
+	void _wake();
+};
+
+/**
+ * Class InferenceClient
+ * Blocking client of an InferenceServer. Requests may be pipelined: several sends,
+ * then as many receives, in order.
+ */
+class InferenceClient
+{
+ public:
+	/**
+	 * Constructs an unconnected client
+	 */
+	InferenceClient();
+
+	/**
+	 * Closes the connection
+	 */
+	~InferenceClient();
+
+	InferenceClient(const InferenceClient&) = delete;
+	InferenceClient& operator=(const InferenceClient&) = delete;
+
+	/**
+	 * Connects to a server
+	 * @param socketPath	filesystem path of the server socket
+	 * @return				false if the server cannot be reached
+	 */
+	bool connect(const std::string& socketPath);
+
+	/**
+	 * Sends one image as floats
+	 * @param image	imgDims floats
+	 * @return		false on a write error
+	 */
+	bool send(const float* image);
+
+	/**
+	 * Sends one image as unsigned pixels
+	 * @param pixels	imgDims bytes, 255 is 1.0
+	 * @return			false on a write error
+	 */
+	bool send(const uint8_t* pixels);
+
+	/**
+	 * Receives the reply to the oldest unanswered request
+	 * @param digit	receives the digit and its probability
+	 * @return		false if the connection closed
+	 */
+	bool receive(Digit& digit);
+
+ private:
+	/**
+	 * Socket, -1 when not connected
+	 */
+	int _fd;
+
+	/**
+	 * Request frame, format byte then image
+	 */
+	std::vector<char> _frame;
+
+	/**
+	 * Writes a whole buffer
+	 * @param data	bytes
+	 * @param size	byte count
+	 * @return		false on a write error
+	 */
+	bool _writeAll(const char* data, size_t size);
+};
+
+#endif
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "Gemm.h"
+#include "Kernels.h"
+
+#define ISA_ENV "MLP_ISA"
+#define SCALAR_MR 4
+#define SCALAR_NR 8
+#define SCALAR_LANES 8
+
+static_assert(gemmTileFits(SCALAR_MR, SCALAR_NR), GEMM_TILE_ERROR);
+
+/**
+ * MLP_ISA values, indexed by KernelIsa
+ */
+static const char* const isaNames[] = { "scalar", "sse2", "avx2", "avx512" };
+
+/**
+ * out[i] = a[i] + b[i]
+ */
+static void addScalar(const float* a, const float* b, float* out, int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		out[i] = a[i] + b[i];
+	}
+}
+
+/**
+ * out[i] = a[i] - b[i]
+ */
+static void subScalar(const float* a, const float* b, float* out, int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		out[i] = a[i] - b[i];
+	}
+}
+
+/**
+ * out[i] = a[i] * scalar
+ */
+static void scaleScalar(const float* a, float scalar, float* out, int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		out[i] = a[i] * scalar;
+	}
+}
+
+/**
+ * out[i] = max(a[i], 0)
+ */
+static void reluScalar(const float* a, float* out, int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		out[i] = a[i] < 0 ? 0 : a[i];
+	}
+}
+
+/**
+ * out[i] = exp(a[i]), exact libm version
+ */
+static void expScalar(const float* a, float* out, int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		out[i] = std::exp(a[i]);
+	}
+}
+
+/**
+ * Sum of a[0..n)
+ */
+static float sumScalar(const float* a, int n)
+{
+	float sum = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		sum += a[i];
+	}
+	return sum;
+}
+
+/**
+ * out[i] = exp(a[i] - shift), returns their sum, exact libm version
+ */
+static float expSumScalar(const float* a, float shift, float* out, int n)
+{
+	float sum = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		out[i] = std::exp(a[i] - shift);
+		sum += out[i];
+	}
+	return sum;
+}
+
+/**
+ * Max of a[0..n), n > 0
+ */
+static float maxScalar(const float* a, int n)
+{
+	float max = a[0];
+	for (int i = 1; i < n; ++i)
+	{
+		max = a[i] > max ? a[i] : max;
+	}
+	return max;
+}
+
+/**
+ * Dot product of a[0..n) and b[0..n)
+ */
+static float dotScalar(const float* a, const float* b, int n)
+{
+	// independent partial sums so the loop vectorizes without reassociation
+	float acc[SCALAR_LANES] = {};
+	int i = 0;
+	for (; i + SCALAR_LANES <= n; i += SCALAR_LANES)
+	{
+		for (int l = 0; l < SCALAR_LANES; ++l)
+		{
+			acc[l] += a[i + l] * b[i + l];
+		}
+	}
+	float sum = 0;
+	for (int l = 0; l < SCALAR_LANES; ++l)
+	{
+		sum += acc[l];
+	}
+	for (; i < n; ++i)
+	{
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+/**
+ * Portable 4x8 GEMM micro-kernel, small enough for the compiler
+ * to keep the accumulator tile in the 16 baseline vector registers.
+ */
+static void gemmKernelScalar(int kc, const float* ap, const float* bp, float* c, int ldc,
+							 int mr, int nr, bool accumulate)
+{
+	float acc[SCALAR_MR][SCALAR_NR] = {};
+	for (int p = 0; p < kc; ++p)
+	{
+		for (int i = 0; i < SCALAR_MR; ++i)
+		{
+			const float aip = ap[i];
+			for (int j = 0; j < SCALAR_NR; ++j)
+			{
+				acc[i][j] += aip * bp[j];
+			}
+		}
+		ap += SCALAR_MR;
+		bp += SCALAR_NR;
+	}
+
+	for (int i = 0; i < mr; ++i)
+	{
+		float* row = c + i * ldc;
+		for (int j = 0; j < nr; ++j)
+		{
+			row[j] = accumulate ? row[j] + acc[i][j] : acc[i][j];
+		}
+	}
+}
+
+/**
+ * Fused dense layer on one sample, one row at a time
+ */
+static void denseScalar(int m, int k, const float* a, int lda, const float* x, const float* bias,
+						float* y, bool relu)
+{
+	for (int row = 0; row < m; ++row)
+	{
+		const float value = dotScalar(a + row * lda, x, k) + bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * INT8 dense rows, plain int32 dot products
+ */
+static void denseInt8Scalar(int m, int k, const int8_t* w, const uint8_t* x, int32_t* y)
+{
+	for (int row = 0; row < m; ++row)
+	{
+		const int8_t* weights = w + (long) row * k;
+		int32_t acc = 0;
+		for (int i = 0; i < k; ++i)
+		{
+			acc += (int32_t) weights[i] * (int32_t) x[i];
+		}
+		y[row] = acc;
+	}
+}
+
+/**
+ * Fused dense layer on one sample with 16 bit weights
+ */
+static void denseHalfScalar(int m, int k, const uint16_t* a, const float* x, const float* bias, float* y, bool relu,
+							HalfFormat format)
+{
+	for (int row = 0; row < m; ++row)
+	{
+		const uint16_t* weights = a + (long) row * k;
+		float value = 0;
+		for (int i = 0; i < k; ++i)
+		{
+			value += halfToFloat(weights[i], format) * x[i];
+		}
+		value += bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * Block-sparse dense layer on one sample
+ */
+static void denseBlocksScalar(int m, const int* rowStart, const int* blockCols, const float* values, const float* x,
+							  const float* bias, float* y, bool relu)
+{
+	for (int row = 0; row < m; ++row)
+	{
+		float value = 0;
+		for (int block = rowStart[row]; block < rowStart[row + 1]; ++block)
+		{
+			const float* weights = values + (long) block * SPARSE_BLOCK;
+			const float* input = x + blockCols[block];
+			for (int i = 0; i < SPARSE_BLOCK; ++i)
+			{
+				value += weights[i] * input[i];
+			}
+		}
+		value += bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * Fused dense layer on one sample with prepacked weights, one panel at a time
+ */
+static void densePanelsScalar(int m, int k, const float* packed, const float* x, const float* bias, float* y,
+							  bool relu)
+{
+	for (int panel = 0; panel < m; panel += SCALAR_MR)
+	{
+		const float* weights = packed + (long) panel * k;
+		float acc[SCALAR_MR] = {};
+		for (int p = 0; p < k; ++p)
+		{
+			for (int i = 0; i < SCALAR_MR; ++i)
+			{
+				acc[i] += weights[p * SCALAR_MR + i] * x[p];
+			}
+		}
+		for (int i = 0; i < std::min(SCALAR_MR, m - panel); ++i)
+		{
+			const float value = acc[i] + bias[panel + i];
+			y[panel + i] = relu && value < 0 ? 0 : value;
+		}
+	}
+}
+
+/**
+ * Scalar kernels, always available
+ * @return	KernelTable
+ */
+const KernelTable* scalarKernels()
+{
+	static const KernelTable table = { isaNames[IsaScalar], addScalar, subScalar, scaleScalar,
+									   reluScalar, expScalar, expSumScalar, sumScalar, maxScalar, dotScalar,
+									   SCALAR_MR, SCALAR_NR, gemmKernelScalar, denseScalar,
+									   denseInt8Scalar, denseHalfScalar, denseBlocksScalar, densePanelsScalar };
+	return &table;
+}
+
+/**
+ * Returns the kernels of a specific instruction set
+ * @param isa	KernelIsa
+ * @return		KernelTable, nullptr if the CPU or the build does not support isa
+ */
+const KernelTable* kernelTable(KernelIsa isa)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	switch (isa)
+	{
+		case IsaAvx512:
+			return __builtin_cpu_supports("avx512f") ? avx512Kernels() : nullptr;
+		case IsaAvx2:
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ?
+				   avx2Kernels() : nullptr;
+		case IsaSse2:
+			return __builtin_cpu_supports("sse2") ? sse2Kernels() : nullptr;
+		default:
+			break;
+	}
+#endif
+	return isa == IsaScalar ? scalarKernels() : nullptr;
+}
+
+/**
+ * Picks the newest supported instruction set, capped by MLP_ISA
+ * @return	KernelTable
+ */
+static const KernelTable& selectKernels()
+{
+	int cap = IsaAvx512;
+	const char* requested = std::getenv(ISA_ENV);
+	if (requested != nullptr)
+	{
+		for (int isa = IsaScalar; isa <= IsaAvx512; ++isa)
+		{
+			if (std::strcmp(requested, isaNames[isa]) == 0)
+			{
+				cap = isa;
+			}
+		}
+	}
+
+	for (int isa = cap; isa > IsaScalar; --isa)
+	{
+		const KernelTable* table = kernelTable((KernelIsa) isa);
+		if (table != nullptr)
+		{
+			return *table;
+		}
+	}
+	return *scalarKernels();
+}
+
+/**
+ * Returns the kernels of the best instruction set this CPU supports.
+ * Selected once, on first call, from CPUID. Setting the environment variable
+ * MLP_ISA to scalar, sse2, avx2 or avx512 caps the selection.
+ * @return	KernelTable
+ */
+const KernelTable& kernels()
+{
+	static const KernelTable& table = selectKernels();
+	return table;
+}
@@ -0,0 +1,166 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstdint>
+#include "HalfFloat.h"
+
+/**
+ * INT8 rows are zero padded to a multiple of this many elements, one AVX-512 register of bytes
+ */
+#define QUANT_PADDING 64
+
+/**
+ * Width of the blocks of a block-sparse row, one AVX2 register of floats
+ */
+#define SPARSE_BLOCK 8
+
+/**
+ * Instruction sets with a kernel implementation, ordered from oldest to newest
+ */
+enum KernelIsa
+{
+	IsaScalar,
+	IsaSse2,
+	IsaAvx2,
+	IsaAvx512
+};
+
+/**
+ * @struct KernelTable
+ * @brief Element-wise, reduction and GEMM micro-kernels of one instruction set.
+ *        All arrays are unaligned, out may alias an input of an element-wise kernel.
+ */
+typedef struct KernelTable
+{
+	/**
+	 * Instruction set name, as accepted by MLP_ISA
+	 */
+	const char* name;
+
+	/**
+	 * out[i] = a[i] + b[i]
+	 */
+	void (* add)(const float* a, const float* b, float* out, int n);
+
+	/**
+	 * out[i] = a[i] - b[i]
+	 */
+	void (* sub)(const float* a, const float* b, float* out, int n);
+
+	/**
+	 * out[i] = a[i] * scalar
+	 */
+	void (* scale)(const float* a, float scalar, float* out, int n);
+
+	/**
+	 * out[i] = max(a[i], 0)
+	 */
+	void (* relu)(const float* a, float* out, int n);
+
+	/**
+	 * out[i] = exp(a[i])
+	 */
+	void (* exp)(const float* a, float* out, int n);
+
+	/**
+	 * out[i] = exp(a[i] - shift), returns their sum. With shift the max of a,
+	 * as in a stable softmax, no term overflows. out may alias a.
+	 */
+	float (* expSum)(const float* a, float shift, float* out, int n);
+
+	/**
+	 * Sum of a[0..n)
+	 */
+	float (* sum)(const float* a, int n);
+
+	/**
+	 * Max of a[0..n), n > 0
+	 */
+	float (* max)(const float* a, int n);
+
+	/**
+	 * Dot product of a[0..n) and b[0..n)
+	 */
+	float (* dot)(const float* a, const float* b, int n);
+
+	/**
+	 * GEMM micro-kernel tile rows
+	 */
+	int gemmMr;
+
+	/**
+	 * GEMM micro-kernel tile cols
+	 */
+	int gemmNr;
+
+	/**
+	 * GEMM micro-kernel, see Gemm.cpp for the packed panel layout
+	 */
+	void (* gemmKernel)(int kc, const float* ap, const float* bp, float* c, int ldc,
+						int mr, int nr, bool accumulate);
+
+	/**
+	 * Fused dense layer on one sample, y[i] = dot(a row i, x[0..k)) + bias[i], clamped at 0 when relu.
+	 * Several rows share each load of x, the bias and the clamp are applied in registers
+	 * and y is written once. y must not alias x.
+	 */
+	void (* dense)(int m, int k, const float* a, int lda, const float* x, const float* bias,
+				   float* y, bool relu);
+
+	/**
+	 * INT8 dense rows, y[i] = dot(w row i, x[0..k)) accumulated in int32.
+	 * w is row-major with ld k, x holds activations in [0, 127] so a pair of
+	 * u8 * s8 products never saturates int16. k is a multiple of QUANT_PADDING.
+	 */
+	void (* denseInt8)(int m, int k, const int8_t* w, const uint8_t* x, int32_t* y);
+
+	/**
+	 * Fused dense layer on one sample with 16 bit weights, as dense with lda k:
+	 * each weight is widened to fp32 in registers and accumulated in fp32.
+	 */
+	void (* denseHalf)(int m, int k, const uint16_t* a, const float* x, const float* bias, float* y, bool relu,
+					   HalfFormat format);
+
+	/**
+	 * Block-sparse dense layer on one sample. Row i holds the blocks rowStart[i] to
+	 * rowStart[i + 1] - 1, block b covers x[blockCols[b]..blockCols[b] + SPARSE_BLOCK) with
+	 * the weights values[b * SPARSE_BLOCK..]. y[i] = bias[i] + the dot products of its blocks,
+	 * clamped at 0 when relu. y must not alias x.
+	 */
+	void (* denseBlocks)(int m, const int* rowStart, const int* blockCols, const float* values, const float* x,
+						 const float* bias, float* y, bool relu);
+
+	/**
+	 * Fused dense layer on one sample with weights prepacked by packWeights with gemmMr.
+	 * Each panel accumulates its gemmMr rows in registers, one column (gemmMr contiguous
+	 * weights) times one broadcast x value at a time, so the weights stream in order and
+	 * no horizontal sums are needed.
+	 * y must not alias x.
+	 */
+	void (* densePanels)(int m, int k, const float* packed, const float* x, const float* bias, float* y, bool relu);
+} KernelTable;
+
+/**
+ * Returns the kernels of the best instruction set this CPU supports.
+ * Selected once, on first call, from CPUID. Setting the environment variable
+ * MLP_ISA to scalar, sse2, avx2 or avx512 caps the selection.
+ * @return	KernelTable
+ */
+const KernelTable& kernels();
+
+/**
+ * Returns the kernels of a specific instruction set
+ * @param isa	KernelIsa
+ * @return		KernelTable, nullptr if the CPU or the build does not support isa
+ */
+const KernelTable* kernelTable(KernelIsa isa);
+
+/**
+ * Per instruction set tables, nullptr when not compiled for this architecture
+ */
+const KernelTable* scalarKernels();
+const KernelTable* sse2Kernels();
+const KernelTable* avx2Kernels();
+const KernelTable* avx512Kernels();
+
+#endif
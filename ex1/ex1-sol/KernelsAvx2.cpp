@@ -0,0 +1,586 @@
+#include "Gemm.h"
+#include "Kernels.h"
+#include "KernelsSimd.h"
+
+#ifdef KERNELS_X86
+
+#define LANES 8
+#define AVX2_MR 6
+#define AVX2_NR 16
+
+static_assert(gemmTileFits(AVX2_MR, AVX2_NR), GEMM_TILE_ERROR);
+
+/**
+ * out[i] = a[i] + b[i]
+ */
+TARGET_AVX2 static void addAvx2(const float* a, const float* b, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+	}
+	for (; i < n; ++i)
+	{
+		out[i] = a[i] + b[i];
+	}
+}
+
+/**
+ * out[i] = a[i] - b[i]
+ */
+TARGET_AVX2 static void subAvx2(const float* a, const float* b, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+	}
+	for (; i < n; ++i)
+	{
+		out[i] = a[i] - b[i];
+	}
+}
+
+/**
+ * out[i] = a[i] * scalar
+ */
+TARGET_AVX2 static void scaleAvx2(const float* a, float scalar, float* out, int n)
+{
+	const __m256 s = _mm256_set1_ps(scalar);
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), s));
+	}
+	for (; i < n; ++i)
+	{
+		out[i] = a[i] * scalar;
+	}
+}
+
+/**
+ * out[i] = max(a[i], 0)
+ */
+TARGET_AVX2 static void reluAvx2(const float* a, float* out, int n)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm256_storeu_ps(out + i, _mm256_max_ps(_mm256_loadu_ps(a + i), zero));
+	}
+	for (; i < n; ++i)
+	{
+		out[i] = a[i] < 0 ? 0 : a[i];
+	}
+}
+
+/**
+ * Polynomial exp of 8 lanes, see KernelsSimd.h
+ */
+TARGET_AVX2 static __m256 exp8(__m256 x)
+{
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+	__m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(EXP_LOG2E), _mm256_set1_ps(0.5f)));
+
+	x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C1), x);
+	x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C2), x);
+
+	__m256 y = _mm256_set1_ps(EXP_P0);
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+	y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+	__m256i exponent = _mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(EXP_BIAS));
+	return _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(exponent, EXP_MANTISSA_BITS)));
+}
+
+/**
+ * out[i] = exp(a[i])
+ */
+TARGET_AVX2 static void expAvx2(const float* a, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm256_storeu_ps(out + i, exp8(_mm256_loadu_ps(a + i)));
+	}
+	if (i < n)
+	{
+		float tail[LANES] = {};
+		for (int j = i; j < n; ++j)
+		{
+			tail[j - i] = a[j];
+		}
+		_mm256_storeu_ps(tail, exp8(_mm256_loadu_ps(tail)));
+		for (int j = i; j < n; ++j)
+		{
+			out[j] = tail[j - i];
+		}
+	}
+}
+
+/**
+ * Sum of the 8 lanes
+ */
+TARGET_AVX2 static float horizontalSum(__m256 v)
+{
+	__m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+	x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+	return _mm_cvtss_f32(x);
+}
+
+/**
+ * Sum of a[0..n)
+ */
+TARGET_AVX2 static float sumAvx2(const float* a, int n)
+{
+	__m256 acc = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		acc = _mm256_add_ps(acc, _mm256_loadu_ps(a + i));
+	}
+	float sum = horizontalSum(acc);
+	for (; i < n; ++i)
+	{
+		sum += a[i];
+	}
+	return sum;
+}
+
+/**
+ * out[i] = exp(a[i] - shift), returns their sum
+ */
+TARGET_AVX2 static float expSumAvx2(const float* a, float shift, float* out, int n)
+{
+	const __m256 shifts = _mm256_set1_ps(shift);
+	__m256 acc = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		const __m256 values = exp8(_mm256_sub_ps(_mm256_loadu_ps(a + i), shifts));
+		_mm256_storeu_ps(out + i, values);
+		acc = _mm256_add_ps(acc, values);
+	}
+	float sum = horizontalSum(acc);
+	if (i < n)
+	{
+		float tail[LANES] = {};
+		for (int j = i; j < n; ++j)
+		{
+			tail[j - i] = a[j] - shift;
+		}
+		_mm256_storeu_ps(tail, exp8(_mm256_loadu_ps(tail)));
+		for (int j = i; j < n; ++j)
+		{
+			out[j] = tail[j - i];
+			sum += out[j];
+		}
+	}
+	return sum;
+}
+
+/**
+ * Max of a[0..n), n > 0
+ */
+TARGET_AVX2 static float maxAvx2(const float* a, int n)
+{
+	float max = a[0];
+	int i = 0;
+	if (n >= LANES)
+	{
+		__m256 acc = _mm256_loadu_ps(a);
+		for (i = LANES; i + LANES <= n; i += LANES)
+		{
+			acc = _mm256_max_ps(acc, _mm256_loadu_ps(a + i));
+		}
+		__m128 x = _mm_max_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+		x = _mm_max_ps(x, _mm_movehl_ps(x, x));
+		x = _mm_max_ss(x, _mm_shuffle_ps(x, x, 1));
+		max = _mm_cvtss_f32(x);
+	}
+	for (; i < n; ++i)
+	{
+		max = a[i] > max ? a[i] : max;
+	}
+	return max;
+}
+
+/**
+ * Dot product of a[0..n) and b[0..n)
+ */
+TARGET_AVX2 static float dotAvx2(const float* a, const float* b, int n)
+{
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 2 * LANES <= n; i += 2 * LANES)
+	{
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + LANES), _mm256_loadu_ps(b + i + LANES), acc1);
+	}
+	float sum = horizontalSum(_mm256_add_ps(acc0, acc1));
+	for (; i < n; ++i)
+	{
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+/**
+ * 6x16 GEMM micro-kernel, 12 accumulator registers fed by fused multiply-add
+ */
+TARGET_AVX2 static void gemmKernelAvx2(int kc, const float* ap, const float* bp, float* c, int ldc,
+									   int mr, int nr, bool accumulate)
+{
+	__m256 acc[AVX2_MR][2];
+	for (int i = 0; i < AVX2_MR; ++i)
+	{
+		acc[i][0] = _mm256_setzero_ps();
+		acc[i][1] = _mm256_setzero_ps();
+	}
+	for (int p = 0; p < kc; ++p)
+	{
+		const __m256 b0 = _mm256_loadu_ps(bp);
+		const __m256 b1 = _mm256_loadu_ps(bp + LANES);
+		for (int i = 0; i < AVX2_MR; ++i)
+		{
+			const __m256 a = _mm256_broadcast_ss(ap + i);
+			acc[i][0] = _mm256_fmadd_ps(a, b0, acc[i][0]);
+			acc[i][1] = _mm256_fmadd_ps(a, b1, acc[i][1]);
+		}
+		ap += AVX2_MR;
+		bp += AVX2_NR;
+	}
+
+	if (mr == AVX2_MR && nr == AVX2_NR)
+	{
+		for (int i = 0; i < AVX2_MR; ++i)
+		{
+			float* row = c + i * ldc;
+			if (accumulate)
+			{
+				acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_loadu_ps(row));
+				acc[i][1] = _mm256_add_ps(acc[i][1], _mm256_loadu_ps(row + LANES));
+			}
+			_mm256_storeu_ps(row, acc[i][0]);
+			_mm256_storeu_ps(row + LANES, acc[i][1]);
+		}
+		return;
+	}
+
+	float tile[AVX2_MR][AVX2_NR];
+	for (int i = 0; i < AVX2_MR; ++i)
+	{
+		_mm256_storeu_ps(tile[i], acc[i][0]);
+		_mm256_storeu_ps(tile[i] + LANES, acc[i][1]);
+	}
+	for (int i = 0; i < mr; ++i)
+	{
+		float* row = c + i * ldc;
+		for (int j = 0; j < nr; ++j)
+		{
+			row[j] = accumulate ? row[j] + tile[i][j] : tile[i][j];
+		}
+	}
+}
+
+/**
+ * Fused dense layer on one sample, DENSE_ROWS rows per pass over x.
+ * The row sums are folded to 128 bits and transposed into one register
+ * so bias and clamp are a single add and max.
+ */
+TARGET_AVX2 static void denseAvx2(int m, int k, const float* a, int lda, const float* x, const float* bias,
+								  float* y, bool relu)
+{
+	const __m128 zero = _mm_setzero_ps();
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const float* a0 = a + row * lda;
+		const float* a1 = a0 + lda;
+		const float* a2 = a1 + lda;
+		const float* a3 = a2 + lda;
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		__m256 acc2 = _mm256_setzero_ps();
+		__m256 acc3 = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + LANES <= k; i += LANES)
+		{
+			const __m256 xi = _mm256_loadu_ps(x + i);
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + i), xi, acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + i), xi, acc1);
+			acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + i), xi, acc2);
+			acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a3 + i), xi, acc3);
+		}
+		__m128 s0 = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+		__m128 s1 = _mm_add_ps(_mm256_castps256_ps128(acc1), _mm256_extractf128_ps(acc1, 1));
+		__m128 s2 = _mm_add_ps(_mm256_castps256_ps128(acc2), _mm256_extractf128_ps(acc2, 1));
+		__m128 s3 = _mm_add_ps(_mm256_castps256_ps128(acc3), _mm256_extractf128_ps(acc3, 1));
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+		__m128 sums = _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3));
+		for (; i < k; ++i)
+		{
+			sums = _mm_fmadd_ps(_mm_setr_ps(a0[i], a1[i], a2[i], a3[i]), _mm_set1_ps(x[i]), sums);
+		}
+		sums = _mm_add_ps(sums, _mm_loadu_ps(bias + row));
+		_mm_storeu_ps(y + row, relu ? _mm_max_ps(sums, zero) : sums);
+	}
+	for (; row < m; ++row)
+	{
+		const float value = dotAvx2(a + row * lda, x, k) + bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * 8 16 bit weights widened to fp32: F16C for fp16, a shift into the upper half for bf16
+ */
+template<HalfFormat Format>
+TARGET_AVX2_F16C static __m256 loadHalf(const uint16_t* a)
+{
+	const __m128i half = _mm_loadu_si128((const __m128i*) a);
+	if (Format == HalfFp16)
+	{
+		return _mm256_cvtph_ps(half);
+	}
+	return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(half), 16));
+}
+
+/**
+ * Fused dense layer on one sample with 16 bit weights of one format, as denseAvx2
+ */
+template<HalfFormat Format>
+TARGET_AVX2_F16C static void denseHalfRows(int m, int k, const uint16_t* a, const float* x, const float* bias,
+										   float* y, bool relu)
+{
+	const __m128 zero = _mm_setzero_ps();
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const uint16_t* a0 = a + (long) row * k;
+		const uint16_t* a1 = a0 + k;
+		const uint16_t* a2 = a1 + k;
+		const uint16_t* a3 = a2 + k;
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		__m256 acc2 = _mm256_setzero_ps();
+		__m256 acc3 = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + LANES <= k; i += LANES)
+		{
+			const __m256 xi = _mm256_loadu_ps(x + i);
+			acc0 = _mm256_fmadd_ps(loadHalf<Format>(a0 + i), xi, acc0);
+			acc1 = _mm256_fmadd_ps(loadHalf<Format>(a1 + i), xi, acc1);
+			acc2 = _mm256_fmadd_ps(loadHalf<Format>(a2 + i), xi, acc2);
+			acc3 = _mm256_fmadd_ps(loadHalf<Format>(a3 + i), xi, acc3);
+		}
+		__m128 s0 = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+		__m128 s1 = _mm_add_ps(_mm256_castps256_ps128(acc1), _mm256_extractf128_ps(acc1, 1));
+		__m128 s2 = _mm_add_ps(_mm256_castps256_ps128(acc2), _mm256_extractf128_ps(acc2, 1));
+		__m128 s3 = _mm_add_ps(_mm256_castps256_ps128(acc3), _mm256_extractf128_ps(acc3, 1));
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+		__m128 sums = _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3));
+		for (; i < k; ++i)
+		{
+			const __m128 weights = _mm_setr_ps(halfToFloat(a0[i], Format), halfToFloat(a1[i], Format),
+											   halfToFloat(a2[i], Format), halfToFloat(a3[i], Format));
+			sums = _mm_fmadd_ps(weights, _mm_set1_ps(x[i]), sums);
+		}
+		sums = _mm_add_ps(sums, _mm_loadu_ps(bias + row));
+		_mm_storeu_ps(y + row, relu ? _mm_max_ps(sums, zero) : sums);
+	}
+	for (; row < m; ++row)
+	{
+		const uint16_t* weights = a + (long) row * k;
+		__m256 acc = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + LANES <= k; i += LANES)
+		{
+			acc = _mm256_fmadd_ps(loadHalf<Format>(weights + i), _mm256_loadu_ps(x + i), acc);
+		}
+		float value = horizontalSum(acc);
+		for (; i < k; ++i)
+		{
+			value += halfToFloat(weights[i], Format) * x[i];
+		}
+		value += bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * Fused dense layer on one sample with 16 bit weights.
+ * fp16 needs F16C, which AVX2 does not imply: without it fp16 goes to the scalar kernel.
+ */
+static void denseHalfAvx2(int m, int k, const uint16_t* a, const float* x, const float* bias, float* y, bool relu,
+						  HalfFormat format)
+{
+	static const bool f16c = __builtin_cpu_supports("f16c") != 0;
+	if (format == HalfBf16)
+	{
+		denseHalfRows<HalfBf16>(m, k, a, x, bias, y, relu);
+	}
+	else if (f16c)
+	{
+		denseHalfRows<HalfFp16>(m, k, a, x, bias, y, relu);
+	}
+	else
+	{
+		scalarKernels()->denseHalf(m, k, a, x, bias, y, relu, format);
+	}
+}
+
+/**
+ * Sum of the 8 int32 lanes
+ */
+TARGET_AVX2 static int32_t horizontalSumInt(__m256i v)
+{
+	__m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(x);
+}
+
+/**
+ * 32 u8 * s8 products summed into 8 int32 lanes of acc:
+ * pmaddubsw gives int16 pair sums, pmaddwd by ones widens them
+ */
+TARGET_AVX2 static __m256i maddInt8(__m256i acc, __m256i x, const int8_t* w, __m256i ones)
+{
+	const __m256i pairs = _mm256_maddubs_epi16(x, _mm256_loadu_si256((const __m256i*) w));
+	return _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, ones));
+}
+
+/**
+ * INT8 dense rows, DENSE_ROWS rows per pass over x, 32 bytes per step
+ */
+TARGET_AVX2 static void denseInt8Avx2(int m, int k, const int8_t* w, const uint8_t* x, int32_t* y)
+{
+	const __m256i ones = _mm256_set1_epi16(1);
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const int8_t* w0 = w + (long) row * k;
+		__m256i acc0 = _mm256_setzero_si256();
+		__m256i acc1 = _mm256_setzero_si256();
+		__m256i acc2 = _mm256_setzero_si256();
+		__m256i acc3 = _mm256_setzero_si256();
+		for (int i = 0; i < k; i += 4 * LANES)
+		{
+			const __m256i xi = _mm256_loadu_si256((const __m256i*) (x + i));
+			acc0 = maddInt8(acc0, xi, w0 + i, ones);
+			acc1 = maddInt8(acc1, xi, w0 + k + i, ones);
+			acc2 = maddInt8(acc2, xi, w0 + 2L * k + i, ones);
+			acc3 = maddInt8(acc3, xi, w0 + 3L * k + i, ones);
+		}
+		y[row] = horizontalSumInt(acc0);
+		y[row + 1] = horizontalSumInt(acc1);
+		y[row + 2] = horizontalSumInt(acc2);
+		y[row + 3] = horizontalSumInt(acc3);
+	}
+	for (; row < m; ++row)
+	{
+		__m256i acc = _mm256_setzero_si256();
+		for (int i = 0; i < k; i += 4 * LANES)
+		{
+			acc = maddInt8(acc, _mm256_loadu_si256((const __m256i*) (x + i)), w + (long) row * k + i, ones);
+		}
+		y[row] = horizontalSumInt(acc);
+	}
+}
+
+/**
+ * Block-sparse dense layer on one sample, one register per block, two blocks per step
+ */
+TARGET_AVX2 static void denseBlocksAvx2(int m, const int* rowStart, const int* blockCols, const float* values,
+										const float* x, const float* bias, float* y, bool relu)
+{
+	for (int row = 0; row < m; ++row)
+	{
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		int block = rowStart[row];
+		const int end = rowStart[row + 1];
+		for (; block + 2 <= end; block += 2)
+		{
+			const float* weights = values + (long) block * SPARSE_BLOCK;
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(weights), _mm256_loadu_ps(x + blockCols[block]), acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(weights + SPARSE_BLOCK), _mm256_loadu_ps(x + blockCols[block + 1]),
+								   acc1);
+		}
+		if (block < end)
+		{
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(values + (long) block * SPARSE_BLOCK),
+								   _mm256_loadu_ps(x + blockCols[block]), acc0);
+		}
+		const float value = horizontalSum(_mm256_add_ps(acc0, acc1)) + bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * Fused dense layer on one sample with prepacked weights. A panel column is 6 floats:
+ * each column loads a full register, whose two top lanes belong to the next column
+ * (or to PACKED_PADDING) and are never read back.
+ */
+TARGET_AVX2 static void densePanelsAvx2(int m, int k, const float* packed, const float* x, const float* bias,
+										float* y, bool relu)
+{
+	for (int panel = 0; panel < m; panel += AVX2_MR)
+	{
+		const float* weights = packed + (long) panel * k;
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		__m256 acc2 = _mm256_setzero_ps();
+		__m256 acc3 = _mm256_setzero_ps();
+		int p = 0;
+		for (; p + 4 <= k; p += 4)
+		{
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(weights + p * AVX2_MR), _mm256_broadcast_ss(x + p), acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(weights + (p + 1) * AVX2_MR), _mm256_broadcast_ss(x + p + 1), acc1);
+			acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(weights + (p + 2) * AVX2_MR), _mm256_broadcast_ss(x + p + 2), acc2);
+			acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(weights + (p + 3) * AVX2_MR), _mm256_broadcast_ss(x + p + 3), acc3);
+		}
+		for (; p < k; ++p)
+		{
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(weights + p * AVX2_MR), _mm256_broadcast_ss(x + p), acc0);
+		}
+		float values[LANES];
+		_mm256_storeu_ps(values, _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+		for (int i = 0; i < AVX2_MR && panel + i < m; ++i)
+		{
+			const float value = values[i] + bias[panel + i];
+			y[panel + i] = relu && value < 0 ? 0 : value;
+		}
+	}
+}
+
+/**
+ * AVX2 + FMA kernels
+ * @return	KernelTable
+ */
+const KernelTable* avx2Kernels()
+{
+	static const KernelTable table = { "avx2", addAvx2, subAvx2, scaleAvx2, reluAvx2, expAvx2,
+									   expSumAvx2, sumAvx2, maxAvx2, dotAvx2, AVX2_MR, AVX2_NR,
+									   gemmKernelAvx2, denseAvx2, denseInt8Avx2,
+									   denseHalfAvx2, denseBlocksAvx2, densePanelsAvx2 };
+	return &table;
+}
+
+#else
+
+const KernelTable* avx2Kernels()
+{
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,614 @@
+#include "Gemm.h"
+#include "Kernels.h"
+#include "KernelsSimd.h"
+
+#ifdef KERNELS_X86
+
+#define LANES 16
+#define AVX512_MR 8
+#define AVX512_NR 32
+
+static_assert(gemmTileFits(AVX512_MR, AVX512_NR), GEMM_TILE_ERROR);
+#define PANELS_AVX512 4
+
+/**
+ * Mask of the first n lanes, n < LANES
+ */
+TARGET_AVX512 static __mmask16 tailMask(int n)
+{
+	return (__mmask16) ((1u << n) - 1);
+}
+
+/**
+ * out[i] = a[i] + b[i]
+ */
+TARGET_AVX512 static void addAvx512(const float* a, const float* b, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm512_storeu_ps(out + i, _mm512_add_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+	}
+	if (i < n)
+	{
+		const __mmask16 mask = tailMask(n - i);
+		_mm512_mask_storeu_ps(out + i, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, a + i),
+														   _mm512_maskz_loadu_ps(mask, b + i)));
+	}
+}
+
+/**
+ * out[i] = a[i] - b[i]
+ */
+TARGET_AVX512 static void subAvx512(const float* a, const float* b, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm512_storeu_ps(out + i, _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+	}
+	if (i < n)
+	{
+		const __mmask16 mask = tailMask(n - i);
+		_mm512_mask_storeu_ps(out + i, mask, _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i),
+														   _mm512_maskz_loadu_ps(mask, b + i)));
+	}
+}
+
+/**
+ * out[i] = a[i] * scalar
+ */
+TARGET_AVX512 static void scaleAvx512(const float* a, float scalar, float* out, int n)
+{
+	const __m512 s = _mm512_set1_ps(scalar);
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(a + i), s));
+	}
+	if (i < n)
+	{
+		const __mmask16 mask = tailMask(n - i);
+		_mm512_mask_storeu_ps(out + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, a + i), s));
+	}
+}
+
+/**
+ * out[i] = max(a[i], 0)
+ */
+TARGET_AVX512 static void reluAvx512(const float* a, float* out, int n)
+{
+	const __m512 zero = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm512_storeu_ps(out + i, _mm512_max_ps(_mm512_loadu_ps(a + i), zero));
+	}
+	if (i < n)
+	{
+		const __mmask16 mask = tailMask(n - i);
+		_mm512_mask_storeu_ps(out + i, mask, _mm512_max_ps(_mm512_maskz_loadu_ps(mask, a + i), zero));
+	}
+}
+
+/**
+ * Polynomial exp of 16 lanes, see KernelsSimd.h
+ */
+TARGET_AVX512 static __m512 exp16(__m512 x)
+{
+	x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+	__m512 fx = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(EXP_LOG2E), _mm512_set1_ps(0.5f)),
+									 _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+
+	x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C1), x);
+	x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C2), x);
+
+	__m512 y = _mm512_set1_ps(EXP_P0);
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+	y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+
+	__m512i exponent = _mm512_add_epi32(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(EXP_BIAS));
+	return _mm512_mul_ps(y, _mm512_castsi512_ps(_mm512_slli_epi32(exponent, EXP_MANTISSA_BITS)));
+}
+
+/**
+ * out[i] = exp(a[i])
+ */
+TARGET_AVX512 static void expAvx512(const float* a, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm512_storeu_ps(out + i, exp16(_mm512_loadu_ps(a + i)));
+	}
+	if (i < n)
+	{
+		const __mmask16 mask = tailMask(n - i);
+		_mm512_mask_storeu_ps(out + i, mask, exp16(_mm512_maskz_loadu_ps(mask, a + i)));
+	}
+}
+
+/**
+ * Sum of a[0..n)
+ */
+TARGET_AVX512 static float sumAvx512(const float* a, int n)
+{
+	__m512 acc = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		acc = _mm512_add_ps(acc, _mm512_loadu_ps(a + i));
+	}
+	if (i < n)
+	{
+		acc = _mm512_add_ps(acc, _mm512_maskz_loadu_ps(tailMask(n - i), a + i));
+	}
+	return _mm512_reduce_add_ps(acc);
+}
+
+/**
+ * out[i] = exp(a[i] - shift), returns their sum
+ */
+TARGET_AVX512 static float expSumAvx512(const float* a, float shift, float* out, int n)
+{
+	const __m512 shifts = _mm512_set1_ps(shift);
+	__m512 acc = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		const __m512 values = exp16(_mm512_sub_ps(_mm512_loadu_ps(a + i), shifts));
+		_mm512_storeu_ps(out + i, values);
+		acc = _mm512_add_ps(acc, values);
+	}
+	if (i < n)
+	{
+		const __mmask16 mask = tailMask(n - i);
+		const __m512 values = exp16(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), shifts));
+		_mm512_mask_storeu_ps(out + i, mask, values);
+		acc = _mm512_mask_add_ps(acc, mask, acc, values);
+	}
+	return _mm512_reduce_add_ps(acc);
+}
+
+/**
+ * Max of a[0..n), n > 0
+ */
+TARGET_AVX512 static float maxAvx512(const float* a, int n)
+{
+	__m512 acc = _mm512_set1_ps(a[0]);
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		acc = _mm512_max_ps(acc, _mm512_loadu_ps(a + i));
+	}
+	if (i < n)
+	{
+		const __mmask16 mask = tailMask(n - i);
+		acc = _mm512_mask_max_ps(acc, mask, acc, _mm512_maskz_loadu_ps(mask, a + i));
+	}
+	return _mm512_reduce_max_ps(acc);
+}
+
+/**
+ * Dot product of a[0..n) and b[0..n)
+ */
+TARGET_AVX512 static float dotAvx512(const float* a, const float* b, int n)
+{
+	__m512 acc0 = _mm512_setzero_ps();
+	__m512 acc1 = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 2 * LANES <= n; i += 2 * LANES)
+	{
+		acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+		acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + LANES), _mm512_loadu_ps(b + i + LANES), acc1);
+	}
+	for (; i < n; i += LANES)
+	{
+		const __mmask16 mask = n - i >= LANES ? (__mmask16) 0xFFFF : tailMask(n - i);
+		acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc0);
+	}
+	return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+/**
+ * 8x32 GEMM micro-kernel, 16 of the 32 vector registers hold accumulators
+ */
+TARGET_AVX512 static void gemmKernelAvx512(int kc, const float* ap, const float* bp, float* c, int ldc,
+										   int mr, int nr, bool accumulate)
+{
+	__m512 acc[AVX512_MR][2];
+	for (int i = 0; i < AVX512_MR; ++i)
+	{
+		acc[i][0] = _mm512_setzero_ps();
+		acc[i][1] = _mm512_setzero_ps();
+	}
+	for (int p = 0; p < kc; ++p)
+	{
+		const __m512 b0 = _mm512_loadu_ps(bp);
+		const __m512 b1 = _mm512_loadu_ps(bp + LANES);
+		for (int i = 0; i < AVX512_MR; ++i)
+		{
+			const __m512 a = _mm512_set1_ps(ap[i]);
+			acc[i][0] = _mm512_fmadd_ps(a, b0, acc[i][0]);
+			acc[i][1] = _mm512_fmadd_ps(a, b1, acc[i][1]);
+		}
+		ap += AVX512_MR;
+		bp += AVX512_NR;
+	}
+
+	const __mmask16 mask0 = nr >= LANES ? (__mmask16) 0xFFFF : tailMask(nr);
+	const __mmask16 mask1 = nr >= AVX512_NR ? (__mmask16) 0xFFFF :
+							nr > LANES ? tailMask(nr - LANES) : (__mmask16) 0;
+	// constant trip count keeps acc in registers, rows past mr are skipped
+	for (int i = 0; i < AVX512_MR; ++i)
+	{
+		if (i >= mr)
+		{
+			break;
+		}
+		float* row = c + i * ldc;
+		if (accumulate)
+		{
+			acc[i][0] = _mm512_add_ps(acc[i][0], _mm512_maskz_loadu_ps(mask0, row));
+			acc[i][1] = _mm512_add_ps(acc[i][1], _mm512_maskz_loadu_ps(mask1, row + LANES));
+		}
+		_mm512_mask_storeu_ps(row, mask0, acc[i][0]);
+		_mm512_mask_storeu_ps(row + LANES, mask1, acc[i][1]);
+	}
+}
+
+/**
+ * Fused dense layer on one sample, DENSE_ROWS rows per pass over x, masked tail.
+ * The row sums are gathered into one register so bias and clamp are a single add and max.
+ */
+TARGET_AVX512 static void denseAvx512(int m, int k, const float* a, int lda, const float* x,
+									  const float* bias, float* y, bool relu)
+{
+	const __m128 zero = _mm_setzero_ps();
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const float* a0 = a + row * lda;
+		const float* a1 = a0 + lda;
+		const float* a2 = a1 + lda;
+		const float* a3 = a2 + lda;
+		__m512 acc0 = _mm512_setzero_ps();
+		__m512 acc1 = _mm512_setzero_ps();
+		__m512 acc2 = _mm512_setzero_ps();
+		__m512 acc3 = _mm512_setzero_ps();
+		for (int i = 0; i < k; i += LANES)
+		{
+			const __mmask16 mask = k - i >= LANES ? (__mmask16) 0xFFFF : tailMask(k - i);
+			const __m512 xi = _mm512_maskz_loadu_ps(mask, x + i);
+			acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a0 + i), xi, acc0);
+			acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a1 + i), xi, acc1);
+			acc2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a2 + i), xi, acc2);
+			acc3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a3 + i), xi, acc3);
+		}
+		__m128 sums = _mm_setr_ps(_mm512_reduce_add_ps(acc0), _mm512_reduce_add_ps(acc1),
+								  _mm512_reduce_add_ps(acc2), _mm512_reduce_add_ps(acc3));
+		sums = _mm_add_ps(sums, _mm_loadu_ps(bias + row));
+		_mm_storeu_ps(y + row, relu ? _mm_max_ps(sums, zero) : sums);
+	}
+	for (; row < m; ++row)
+	{
+		const float value = dotAvx512(a + row * lda, x, k) + bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * 16 16 bit weights widened to fp32: vcvtph2ps for fp16, a shift into the upper half for bf16
+ */
+template<HalfFormat Format>
+TARGET_AVX512 static __m512 loadHalf(const uint16_t* a)
+{
+	const __m256i half = _mm256_loadu_si256((const __m256i*) a);
+	if (Format == HalfFp16)
+	{
+		return _mm512_cvtph_ps(half);
+	}
+	return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(half), 16));
+}
+
+/**
+ * Fused dense layer on one sample with 16 bit weights of one format, as denseAvx512
+ * with the tail of each row in scalar code
+ */
+template<HalfFormat Format>
+TARGET_AVX512 static void denseHalfRows(int m, int k, const uint16_t* a, const float* x, const float* bias,
+										float* y, bool relu)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const int blocked = k / LANES * LANES;
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const uint16_t* a0 = a + (long) row * k;
+		const uint16_t* a1 = a0 + k;
+		const uint16_t* a2 = a1 + k;
+		const uint16_t* a3 = a2 + k;
+		__m512 acc0 = _mm512_setzero_ps();
+		__m512 acc1 = _mm512_setzero_ps();
+		__m512 acc2 = _mm512_setzero_ps();
+		__m512 acc3 = _mm512_setzero_ps();
+		for (int i = 0; i < blocked; i += LANES)
+		{
+			const __m512 xi = _mm512_loadu_ps(x + i);
+			acc0 = _mm512_fmadd_ps(loadHalf<Format>(a0 + i), xi, acc0);
+			acc1 = _mm512_fmadd_ps(loadHalf<Format>(a1 + i), xi, acc1);
+			acc2 = _mm512_fmadd_ps(loadHalf<Format>(a2 + i), xi, acc2);
+			acc3 = _mm512_fmadd_ps(loadHalf<Format>(a3 + i), xi, acc3);
+		}
+		__m128 sums = _mm_setr_ps(_mm512_reduce_add_ps(acc0), _mm512_reduce_add_ps(acc1),
+								  _mm512_reduce_add_ps(acc2), _mm512_reduce_add_ps(acc3));
+		for (int i = blocked; i < k; ++i)
+		{
+			const __m128 weights = _mm_setr_ps(halfToFloat(a0[i], Format), halfToFloat(a1[i], Format),
+											   halfToFloat(a2[i], Format), halfToFloat(a3[i], Format));
+			sums = _mm_fmadd_ps(weights, _mm_set1_ps(x[i]), sums);
+		}
+		sums = _mm_add_ps(sums, _mm_loadu_ps(bias + row));
+		_mm_storeu_ps(y + row, relu ? _mm_max_ps(sums, zero) : sums);
+	}
+	for (; row < m; ++row)
+	{
+		const uint16_t* weights = a + (long) row * k;
+		__m512 acc = _mm512_setzero_ps();
+		for (int i = 0; i < blocked; i += LANES)
+		{
+			acc = _mm512_fmadd_ps(loadHalf<Format>(weights + i), _mm512_loadu_ps(x + i), acc);
+		}
+		float value = _mm512_reduce_add_ps(acc);
+		for (int i = blocked; i < k; ++i)
+		{
+			value += halfToFloat(weights[i], Format) * x[i];
+		}
+		value += bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * Fused dense layer on one sample with 16 bit weights
+ */
+static void denseHalfAvx512(int m, int k, const uint16_t* a, const float* x, const float* bias, float* y, bool relu,
+							HalfFormat format)
+{
+	if (format == HalfBf16)
+	{
+		denseHalfRows<HalfBf16>(m, k, a, x, bias, y, relu);
+	}
+	else
+	{
+		denseHalfRows<HalfFp16>(m, k, a, x, bias, y, relu);
+	}
+}
+
+/**
+ * INT8 dense rows with VNNI, DENSE_ROWS rows per pass over x, 64 bytes per step.
+ * vpdpbusd multiplies u8 by s8 and adds groups of four straight into int32.
+ */
+TARGET_AVX512_VNNI static void denseInt8Vnni(int m, int k, const int8_t* w, const uint8_t* x, int32_t* y)
+{
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const int8_t* w0 = w + (long) row * k;
+		__m512i acc0 = _mm512_setzero_si512();
+		__m512i acc1 = _mm512_setzero_si512();
+		__m512i acc2 = _mm512_setzero_si512();
+		__m512i acc3 = _mm512_setzero_si512();
+		for (int i = 0; i < k; i += QUANT_PADDING)
+		{
+			const __m512i xi = _mm512_loadu_si512(x + i);
+			acc0 = _mm512_dpbusd_epi32(acc0, xi, _mm512_loadu_si512(w0 + i));
+			acc1 = _mm512_dpbusd_epi32(acc1, xi, _mm512_loadu_si512(w0 + k + i));
+			acc2 = _mm512_dpbusd_epi32(acc2, xi, _mm512_loadu_si512(w0 + 2L * k + i));
+			acc3 = _mm512_dpbusd_epi32(acc3, xi, _mm512_loadu_si512(w0 + 3L * k + i));
+		}
+		y[row] = _mm512_reduce_add_epi32(acc0);
+		y[row + 1] = _mm512_reduce_add_epi32(acc1);
+		y[row + 2] = _mm512_reduce_add_epi32(acc2);
+		y[row + 3] = _mm512_reduce_add_epi32(acc3);
+	}
+	for (; row < m; ++row)
+	{
+		__m512i acc = _mm512_setzero_si512();
+		for (int i = 0; i < k; i += QUANT_PADDING)
+		{
+			acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(x + i), _mm512_loadu_si512(w + (long) row * k + i));
+		}
+		y[row] = _mm512_reduce_add_epi32(acc);
+	}
+}
+
+/**
+ * Two blocks in one register: their weights are adjacent, the input slices fill the halves
+ */
+TARGET_AVX512 static __m512 loadBlockPair(const float* x, const int* blockCols)
+{
+	const __m512d lo = _mm512_castpd256_pd512(_mm256_castps_pd(_mm256_loadu_ps(x + blockCols[0])));
+	const __m256d hi = _mm256_castps_pd(_mm256_loadu_ps(x + blockCols[1]));
+	return _mm512_castpd_ps(_mm512_insertf64x4(lo, hi, 1));
+}
+
+/**
+ * Block-sparse dense layer on one sample, two blocks per register and two registers
+ * per step
+ */
+TARGET_AVX512 static void denseBlocksAvx512(int m, const int* rowStart, const int* blockCols, const float* values,
+											const float* x, const float* bias, float* y, bool relu)
+{
+	const __mmask16 half = (__mmask16) ((1 << SPARSE_BLOCK) - 1);
+	for (int row = 0; row < m; ++row)
+	{
+		__m512 acc0 = _mm512_setzero_ps();
+		__m512 acc1 = _mm512_setzero_ps();
+		int block = rowStart[row];
+		const int end = rowStart[row + 1];
+		for (; block + 4 <= end; block += 4)
+		{
+			const float* weights = values + (long) block * SPARSE_BLOCK;
+			acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(weights), loadBlockPair(x, blockCols + block), acc0);
+			acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(weights + 2 * SPARSE_BLOCK),
+								   loadBlockPair(x, blockCols + block + 2), acc1);
+		}
+		for (; block + 2 <= end; block += 2)
+		{
+			acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(values + (long) block * SPARSE_BLOCK),
+								   loadBlockPair(x, blockCols + block), acc0);
+		}
+		if (block < end)
+		{
+			acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(half, values + (long) block * SPARSE_BLOCK),
+								   _mm512_maskz_loadu_ps(half, x + blockCols[block]), acc1);
+		}
+		const float value = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1)) + bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * INT8 kernel for this CPU, VNNI when present, else the AVX2 one
+ * @return	kernel
+ */
+static void (* denseInt8Avx512())(int, int, const int8_t*, const uint8_t*, int32_t*)
+{
+	if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512bw"))
+	{
+		return denseInt8Vnni;
+	}
+	return avx2Kernels()->denseInt8;
+}
+
+/**
+ * Accumulates the first kc columns of PANELS consecutive prepacked panels. A panel
+ * column is 8 floats, so a register holds two columns: one load of 8 inputs is permuted
+ * into the four column pairs of 8 columns, shared by every panel, and each pair of each
+ * panel has its own accumulator.
+ * @param kc			columns
+ * @param weights		first panel
+ * @param panelStride	floats between panels, AVX512_MR * kc
+ * @param input			kc inputs
+ * @param acc			accumulators, lane halves hold the even and the odd columns
+ */
+template<int PANELS>
+TARGET_AVX512 static inline void accumulatePanelsAvx512(int kc, const float* weights, int panelStride,
+														const float* input, __m512 (&acc)[PANELS][4])
+{
+	const __m512i pairs[4] = { _mm512_set_epi32(1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0),
+							   _mm512_set_epi32(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2),
+							   _mm512_set_epi32(5, 5, 5, 5, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4),
+							   _mm512_set_epi32(7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6) };
+	int p = 0;
+	for (; p + 8 <= kc; p += 8)
+	{
+		// only lanes 0..7 are permuted in, the undefined upper half is never read
+		const __m512 inputs = _mm512_castps256_ps512(_mm256_loadu_ps(input + p));
+		for (int pair = 0; pair < 4; ++pair)
+		{
+			const __m512 broadcast = _mm512_permutexvar_ps(pairs[pair], inputs);
+			for (int panel = 0; panel < PANELS; ++panel)
+			{
+				const float* columns = weights + panel * panelStride + p * AVX512_MR + pair * LANES;
+				acc[panel][pair] = _mm512_fmadd_ps(_mm512_loadu_ps(columns), broadcast, acc[panel][pair]);
+			}
+		}
+	}
+	if (p < kc)
+	{
+		// the last 1 to 7 columns, masked lanes load zeros
+		const int floats = (kc - p) * AVX512_MR;
+		const __m512 inputs = _mm512_maskz_loadu_ps(tailMask(kc - p), input + p);
+		for (int pair = 0; pair * LANES < floats; ++pair)
+		{
+			const __m512 broadcast = _mm512_permutexvar_ps(pairs[pair], inputs);
+			const int rest = floats - pair * LANES;
+			const __mmask16 mask = rest >= LANES ? (__mmask16) 0xFFFF : tailMask(rest);
+			for (int panel = 0; panel < PANELS; ++panel)
+			{
+				const float* columns = weights + panel * panelStride + p * AVX512_MR + pair * LANES;
+				acc[panel][pair] = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, columns), broadcast, acc[panel][pair]);
+			}
+		}
+	}
+}
+
+/**
+ * Runs PANELS consecutive panels, then folds, biases and clamps their rows
+ * @param panel		first row, a multiple of AVX512_MR
+ */
+template<int PANELS>
+TARGET_AVX512 static inline void densePanelGroupAvx512(int panel, int m, int k, const float* packed, const float* x,
+													   const float* bias, float* y, bool relu)
+{
+	__m512 acc[PANELS][4];
+	for (int i = 0; i < PANELS; ++i)
+	{
+		for (int pair = 0; pair < 4; ++pair)
+		{
+			acc[i][pair] = _mm512_setzero_ps();
+		}
+	}
+	accumulatePanelsAvx512<PANELS>(k, packed + (long) panel * k, AVX512_MR * k, x, acc);
+	for (int i = 0; i < PANELS; ++i)
+	{
+		const __m512 sum = _mm512_add_ps(_mm512_add_ps(acc[i][0], acc[i][1]), _mm512_add_ps(acc[i][2], acc[i][3]));
+		const __m256 rows = _mm256_add_ps(_mm512_castps512_ps256(sum),
+										  _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(sum), 1)));
+		float values[AVX512_MR];
+		_mm256_storeu_ps(values, rows);
+		const int first = panel + i * AVX512_MR;
+		for (int row = 0; row < AVX512_MR && first + row < m; ++row)
+		{
+			const float value = values[row] + bias[first + row];
+			y[first + row] = relu && value < 0 ? 0 : value;
+		}
+	}
+}
+
+/**
+ * Fused dense layer on one sample with prepacked weights, PANELS_AVX512 panels at a
+ * time so every permuted input feeds several loads and independent accumulators
+ */
+TARGET_AVX512 static void densePanelsAvx512(int m, int k, const float* packed, const float* x, const float* bias,
+											float* y, bool relu)
+{
+	int panel = 0;
+	for (; panel + PANELS_AVX512 * AVX512_MR <= m; panel += PANELS_AVX512 * AVX512_MR)
+	{
+		densePanelGroupAvx512<PANELS_AVX512>(panel, m, k, packed, x, bias, y, relu);
+	}
+	for (; panel < m; panel += AVX512_MR)
+	{
+		densePanelGroupAvx512<1>(panel, m, k, packed, x, bias, y, relu);
+	}
+}
+
+/**
+ * AVX-512F kernels
+ * @return	KernelTable
+ */
+const KernelTable* avx512Kernels()
+{
+	static const KernelTable table = { "avx512", addAvx512, subAvx512, scaleAvx512, reluAvx512,
+									   expAvx512, expSumAvx512, sumAvx512, maxAvx512, dotAvx512,
+									   AVX512_MR, AVX512_NR, gemmKernelAvx512, denseAvx512,
+									   denseInt8Avx512(), denseHalfAvx512, denseBlocksAvx512,
+									   densePanelsAvx512 };
+	return &table;
+}
+
+#else
+
+const KernelTable* avx512Kernels()
+{
+	return nullptr;
+}
+
+#endif
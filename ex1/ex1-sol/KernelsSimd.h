@@ -0,0 +1,49 @@
+#ifndef KERNELS_SIMD_H
+#define KERNELS_SIMD_H
+
+/**
+ * Shared by the per instruction set kernel translation units.
+ * Each kernel carries a target attribute, so the build itself needs no -m flags
+ * and the binary still starts on CPUs without the instruction set.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX2_F16C __attribute__((target("avx2,fma,f16c")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#define TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512bw,avx512vnni,avx2,fma")))
+/**
+ * For header templates that cannot live in a per instruction set translation unit:
+ * the compiler emits one copy per instruction set and picks one at load time
+ */
+#define TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define TARGET_CLONES
+#endif
+
+/**
+ * Rows of the weights computed together by the fused dense kernels
+ */
+#define DENSE_ROWS 4
+
+/**
+ * Cephes expf: exp(x) = 2^n * exp(r), n = round(x / ln2), |r| <= ln2 / 2,
+ * exp(r) by a degree 7 polynomial. Relative error below 2 ulp on the clamped range.
+ */
+#define EXP_HI 88.3762626647949f
+#define EXP_LO (-88.3762626647949f)
+#define EXP_LOG2E 1.44269504088896341f
+#define EXP_C1 0.693359375f
+#define EXP_C2 (-2.12194440e-4f)
+#define EXP_P0 1.9875691500E-4f
+#define EXP_P1 1.3981999507E-3f
+#define EXP_P2 8.3334519073E-3f
+#define EXP_P3 4.1665795894E-2f
+#define EXP_P4 1.6666665459E-1f
+#define EXP_P5 5.0000001201E-1f
+#define EXP_BIAS 127
+#define EXP_MANTISSA_BITS 23
+
+#endif
@@ -0,0 +1,537 @@
+#include "Gemm.h"
+#include "Kernels.h"
+#include "KernelsSimd.h"
+
+#ifdef KERNELS_X86
+
+#define LANES 4
+#define SSE2_MR 4
+#define SSE2_NR 8
+
+static_assert(gemmTileFits(SSE2_MR, SSE2_NR), GEMM_TILE_ERROR);
+
+/**
+ * out[i] = a[i] + b[i]
+ */
+TARGET_SSE2 static void addSse2(const float* a, const float* b, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	}
+	for (; i < n; ++i)
+	{
+		out[i] = a[i] + b[i];
+	}
+}
+
+/**
+ * out[i] = a[i] - b[i]
+ */
+TARGET_SSE2 static void subSse2(const float* a, const float* b, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm_storeu_ps(out + i, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	}
+	for (; i < n; ++i)
+	{
+		out[i] = a[i] - b[i];
+	}
+}
+
+/**
+ * out[i] = a[i] * scalar
+ */
+TARGET_SSE2 static void scaleSse2(const float* a, float scalar, float* out, int n)
+{
+	const __m128 s = _mm_set1_ps(scalar);
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), s));
+	}
+	for (; i < n; ++i)
+	{
+		out[i] = a[i] * scalar;
+	}
+}
+
+/**
+ * out[i] = max(a[i], 0)
+ */
+TARGET_SSE2 static void reluSse2(const float* a, float* out, int n)
+{
+	const __m128 zero = _mm_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm_storeu_ps(out + i, _mm_max_ps(_mm_loadu_ps(a + i), zero));
+	}
+	for (; i < n; ++i)
+	{
+		out[i] = a[i] < 0 ? 0 : a[i];
+	}
+}
+
+/**
+ * Polynomial exp of 4 lanes, see KernelsSimd.h
+ */
+TARGET_SSE2 static __m128 exp4(__m128 x)
+{
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+
+	// n = floor(x * log2e + 0.5), SSE2 has no floor instruction
+	__m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(EXP_LOG2E)), _mm_set1_ps(0.5f));
+	__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+	__m128 fix = _mm_and_ps(_mm_cmpgt_ps(truncated, fx), _mm_set1_ps(1.0f));
+	fx = _mm_sub_ps(truncated, fix);
+
+	x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C1)));
+	x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C2)));
+
+	__m128 y = _mm_set1_ps(EXP_P0);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+	y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+
+	__m128i exponent = _mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(EXP_BIAS));
+	return _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(exponent, EXP_MANTISSA_BITS)));
+}
+
+/**
+ * out[i] = exp(a[i])
+ */
+TARGET_SSE2 static void expSse2(const float* a, float* out, int n)
+{
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		_mm_storeu_ps(out + i, exp4(_mm_loadu_ps(a + i)));
+	}
+	if (i < n)
+	{
+		float tail[LANES] = {};
+		for (int j = i; j < n; ++j)
+		{
+			tail[j - i] = a[j];
+		}
+		_mm_storeu_ps(tail, exp4(_mm_loadu_ps(tail)));
+		for (int j = i; j < n; ++j)
+		{
+			out[j] = tail[j - i];
+		}
+	}
+}
+
+/**
+ * Sum of the 4 lanes
+ */
+TARGET_SSE2 static float horizontalSum(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+/**
+ * Sum of a[0..n)
+ */
+TARGET_SSE2 static float sumSse2(const float* a, int n)
+{
+	__m128 acc = _mm_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		acc = _mm_add_ps(acc, _mm_loadu_ps(a + i));
+	}
+	float sum = horizontalSum(acc);
+	for (; i < n; ++i)
+	{
+		sum += a[i];
+	}
+	return sum;
+}
+
+/**
+ * out[i] = exp(a[i] - shift), returns their sum
+ */
+TARGET_SSE2 static float expSumSse2(const float* a, float shift, float* out, int n)
+{
+	const __m128 shifts = _mm_set1_ps(shift);
+	__m128 acc = _mm_setzero_ps();
+	int i = 0;
+	for (; i + LANES <= n; i += LANES)
+	{
+		const __m128 values = exp4(_mm_sub_ps(_mm_loadu_ps(a + i), shifts));
+		_mm_storeu_ps(out + i, values);
+		acc = _mm_add_ps(acc, values);
+	}
+	float sum = horizontalSum(acc);
+	if (i < n)
+	{
+		float tail[LANES] = {};
+		for (int j = i; j < n; ++j)
+		{
+			tail[j - i] = a[j] - shift;
+		}
+		_mm_storeu_ps(tail, exp4(_mm_loadu_ps(tail)));
+		for (int j = i; j < n; ++j)
+		{
+			out[j] = tail[j - i];
+			sum += out[j];
+		}
+	}
+	return sum;
+}
+
+/**
+ * Max of a[0..n), n > 0
+ */
+TARGET_SSE2 static float maxSse2(const float* a, int n)
+{
+	float max = a[0];
+	int i = 0;
+	if (n >= LANES)
+	{
+		__m128 acc = _mm_loadu_ps(a);
+		for (i = LANES; i + LANES <= n; i += LANES)
+		{
+			acc = _mm_max_ps(acc, _mm_loadu_ps(a + i));
+		}
+		acc = _mm_max_ps(acc, _mm_movehl_ps(acc, acc));
+		acc = _mm_max_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+		max = _mm_cvtss_f32(acc);
+	}
+	for (; i < n; ++i)
+	{
+		max = a[i] > max ? a[i] : max;
+	}
+	return max;
+}
+
+/**
+ * Dot product of a[0..n) and b[0..n)
+ */
+TARGET_SSE2 static float dotSse2(const float* a, const float* b, int n)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	int i = 0;
+	for (; i + 2 * LANES <= n; i += 2 * LANES)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + LANES), _mm_loadu_ps(b + i + LANES)));
+	}
+	float sum = horizontalSum(_mm_add_ps(acc0, acc1));
+	for (; i < n; ++i)
+	{
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+/**
+ * 4x8 GEMM micro-kernel, 8 accumulator registers
+ */
+TARGET_SSE2 static void gemmKernelSse2(int kc, const float* ap, const float* bp, float* c, int ldc,
+									   int mr, int nr, bool accumulate)
+{
+	__m128 acc[SSE2_MR][2];
+	for (int i = 0; i < SSE2_MR; ++i)
+	{
+		acc[i][0] = _mm_setzero_ps();
+		acc[i][1] = _mm_setzero_ps();
+	}
+	for (int p = 0; p < kc; ++p)
+	{
+		const __m128 b0 = _mm_loadu_ps(bp);
+		const __m128 b1 = _mm_loadu_ps(bp + LANES);
+		for (int i = 0; i < SSE2_MR; ++i)
+		{
+			const __m128 a = _mm_set1_ps(ap[i]);
+			acc[i][0] = _mm_add_ps(acc[i][0], _mm_mul_ps(a, b0));
+			acc[i][1] = _mm_add_ps(acc[i][1], _mm_mul_ps(a, b1));
+		}
+		ap += SSE2_MR;
+		bp += SSE2_NR;
+	}
+
+	float tile[SSE2_MR][SSE2_NR];
+	for (int i = 0; i < SSE2_MR; ++i)
+	{
+		_mm_storeu_ps(tile[i], acc[i][0]);
+		_mm_storeu_ps(tile[i] + LANES, acc[i][1]);
+	}
+	for (int i = 0; i < mr; ++i)
+	{
+		float* row = c + i * ldc;
+		for (int j = 0; j < nr; ++j)
+		{
+			row[j] = accumulate ? row[j] + tile[i][j] : tile[i][j];
+		}
+	}
+}
+
+/**
+ * Fused dense layer on one sample, DENSE_ROWS rows per pass over x.
+ * The row sums are transposed into one register so bias and clamp are a single add and max.
+ */
+TARGET_SSE2 static void denseSse2(int m, int k, const float* a, int lda, const float* x, const float* bias,
+								  float* y, bool relu)
+{
+	const __m128 zero = _mm_setzero_ps();
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const float* a0 = a + row * lda;
+		const float* a1 = a0 + lda;
+		const float* a2 = a1 + lda;
+		const float* a3 = a2 + lda;
+		__m128 acc0 = zero;
+		__m128 acc1 = zero;
+		__m128 acc2 = zero;
+		__m128 acc3 = zero;
+		int i = 0;
+		for (; i + LANES <= k; i += LANES)
+		{
+			const __m128 xi = _mm_loadu_ps(x + i);
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a0 + i), xi));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a1 + i), xi));
+			acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a2 + i), xi));
+			acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a3 + i), xi));
+		}
+		_MM_TRANSPOSE4_PS(acc0, acc1, acc2, acc3);
+		__m128 sums = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+		for (; i < k; ++i)
+		{
+			sums = _mm_add_ps(sums, _mm_mul_ps(_mm_setr_ps(a0[i], a1[i], a2[i], a3[i]), _mm_set1_ps(x[i])));
+		}
+		sums = _mm_add_ps(sums, _mm_loadu_ps(bias + row));
+		_mm_storeu_ps(y + row, relu ? _mm_max_ps(sums, zero) : sums);
+	}
+	for (; row < m; ++row)
+	{
+		const float value = dotSse2(a + row * lda, x, k) + bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * 4 bf16 weights widened to fp32, each becomes the upper half of a lane
+ */
+TARGET_SSE2 static __m128 loadBf16(const uint16_t* a)
+{
+	return _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), _mm_loadl_epi64((const __m128i*) a)));
+}
+
+/**
+ * Fused dense layer on one sample with 16 bit weights, DENSE_ROWS rows per pass over x.
+ * SSE2 has no fp16 conversion, fp16 weights go to the scalar kernel.
+ */
+TARGET_SSE2 static void denseHalfSse2(int m, int k, const uint16_t* a, const float* x, const float* bias, float* y,
+									  bool relu, HalfFormat format)
+{
+	if (format != HalfBf16)
+	{
+		scalarKernels()->denseHalf(m, k, a, x, bias, y, relu, format);
+		return;
+	}
+	const __m128 zero = _mm_setzero_ps();
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const uint16_t* a0 = a + (long) row * k;
+		const uint16_t* a1 = a0 + k;
+		const uint16_t* a2 = a1 + k;
+		const uint16_t* a3 = a2 + k;
+		__m128 acc0 = zero;
+		__m128 acc1 = zero;
+		__m128 acc2 = zero;
+		__m128 acc3 = zero;
+		int i = 0;
+		for (; i + LANES <= k; i += LANES)
+		{
+			const __m128 xi = _mm_loadu_ps(x + i);
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(loadBf16(a0 + i), xi));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(loadBf16(a1 + i), xi));
+			acc2 = _mm_add_ps(acc2, _mm_mul_ps(loadBf16(a2 + i), xi));
+			acc3 = _mm_add_ps(acc3, _mm_mul_ps(loadBf16(a3 + i), xi));
+		}
+		_MM_TRANSPOSE4_PS(acc0, acc1, acc2, acc3);
+		__m128 sums = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+		for (; i < k; ++i)
+		{
+			const __m128 weights = _mm_setr_ps(bf16ToFloat(a0[i]), bf16ToFloat(a1[i]), bf16ToFloat(a2[i]),
+											   bf16ToFloat(a3[i]));
+			sums = _mm_add_ps(sums, _mm_mul_ps(weights, _mm_set1_ps(x[i])));
+		}
+		sums = _mm_add_ps(sums, _mm_loadu_ps(bias + row));
+		_mm_storeu_ps(y + row, relu ? _mm_max_ps(sums, zero) : sums);
+	}
+	for (; row < m; ++row)
+	{
+		const uint16_t* weights = a + (long) row * k;
+		__m128 acc = zero;
+		int i = 0;
+		for (; i + LANES <= k; i += LANES)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(loadBf16(weights + i), _mm_loadu_ps(x + i)));
+		}
+		float value = horizontalSum(acc);
+		for (; i < k; ++i)
+		{
+			value += bf16ToFloat(weights[i]) * x[i];
+		}
+		value += bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * Sum of the 4 int32 lanes
+ */
+TARGET_SSE2 static int32_t horizontalSumInt(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(v);
+}
+
+/**
+ * 16 products of one weight row with x widened to int16, summed pairwise into acc
+ */
+TARGET_SSE2 static __m128i maddInt8(__m128i acc, const int8_t* w, __m128i xLo, __m128i xHi)
+{
+	const __m128i bytes = _mm_loadu_si128((const __m128i*) w);
+	// sign extend by placing each byte in the high half, then shifting back down
+	const __m128i wLo = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+	const __m128i wHi = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+	acc = _mm_add_epi32(acc, _mm_madd_epi16(wLo, xLo));
+	return _mm_add_epi32(acc, _mm_madd_epi16(wHi, xHi));
+}
+
+/**
+ * INT8 dense rows, DENSE_ROWS rows per pass over x, 16 bytes per step.
+ * SSE2 has no u8 * s8 multiply, both operands are widened to int16 for pmaddwd.
+ */
+TARGET_SSE2 static void denseInt8Sse2(int m, int k, const int8_t* w, const uint8_t* x, int32_t* y)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int row = 0;
+	for (; row + DENSE_ROWS <= m; row += DENSE_ROWS)
+	{
+		const int8_t* w0 = w + (long) row * k;
+		__m128i acc[DENSE_ROWS] = { zero, zero, zero, zero };
+		for (int i = 0; i < k; i += 4 * LANES)
+		{
+			const __m128i bytes = _mm_loadu_si128((const __m128i*) (x + i));
+			const __m128i xLo = _mm_unpacklo_epi8(bytes, zero);
+			const __m128i xHi = _mm_unpackhi_epi8(bytes, zero);
+			for (int r = 0; r < DENSE_ROWS; ++r)
+			{
+				acc[r] = maddInt8(acc[r], w0 + (long) r * k + i, xLo, xHi);
+			}
+		}
+		for (int r = 0; r < DENSE_ROWS; ++r)
+		{
+			y[row + r] = horizontalSumInt(acc[r]);
+		}
+	}
+	for (; row < m; ++row)
+	{
+		__m128i acc = zero;
+		for (int i = 0; i < k; i += 4 * LANES)
+		{
+			const __m128i bytes = _mm_loadu_si128((const __m128i*) (x + i));
+			acc = maddInt8(acc, w + (long) row * k + i, _mm_unpacklo_epi8(bytes, zero),
+						   _mm_unpackhi_epi8(bytes, zero));
+		}
+		y[row] = horizontalSumInt(acc);
+	}
+}
+
+/**
+ * Block-sparse dense layer on one sample, each block in two registers
+ */
+TARGET_SSE2 static void denseBlocksSse2(int m, const int* rowStart, const int* blockCols, const float* values,
+										const float* x, const float* bias, float* y, bool relu)
+{
+	for (int row = 0; row < m; ++row)
+	{
+		__m128 accLo = _mm_setzero_ps();
+		__m128 accHi = _mm_setzero_ps();
+		for (int block = rowStart[row]; block < rowStart[row + 1]; ++block)
+		{
+			const float* weights = values + (long) block * SPARSE_BLOCK;
+			const float* input = x + blockCols[block];
+			accLo = _mm_add_ps(accLo, _mm_mul_ps(_mm_loadu_ps(weights), _mm_loadu_ps(input)));
+			accHi = _mm_add_ps(accHi, _mm_mul_ps(_mm_loadu_ps(weights + LANES), _mm_loadu_ps(input + LANES)));
+		}
+		const float value = horizontalSum(_mm_add_ps(accLo, accHi)) + bias[row];
+		y[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * Fused dense layer on one sample with prepacked weights: a panel column is one
+ * register, four columns in flight on separate accumulators
+ */
+TARGET_SSE2 static void densePanelsSse2(int m, int k, const float* packed, const float* x, const float* bias,
+										float* y, bool relu)
+{
+	for (int panel = 0; panel < m; panel += SSE2_MR)
+	{
+		const float* weights = packed + (long) panel * k;
+		__m128 acc0 = _mm_setzero_ps();
+		__m128 acc1 = _mm_setzero_ps();
+		__m128 acc2 = _mm_setzero_ps();
+		__m128 acc3 = _mm_setzero_ps();
+		int p = 0;
+		for (; p + 4 <= k; p += 4)
+		{
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(weights + p * SSE2_MR), _mm_set1_ps(x[p])));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(weights + (p + 1) * SSE2_MR), _mm_set1_ps(x[p + 1])));
+			acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(weights + (p + 2) * SSE2_MR), _mm_set1_ps(x[p + 2])));
+			acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(weights + (p + 3) * SSE2_MR), _mm_set1_ps(x[p + 3])));
+		}
+		for (; p < k; ++p)
+		{
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(weights + p * SSE2_MR), _mm_set1_ps(x[p])));
+		}
+		float values[SSE2_MR];
+		_mm_storeu_ps(values, _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3)));
+		for (int i = 0; i < SSE2_MR && panel + i < m; ++i)
+		{
+			const float value = values[i] + bias[panel + i];
+			y[panel + i] = relu && value < 0 ? 0 : value;
+		}
+	}
+}
+
+/**
+ * SSE2 kernels
+ * @return	KernelTable
+ */
+const KernelTable* sse2Kernels()
+{
+	static const KernelTable table = { "sse2", addSse2, subSse2, scaleSse2, reluSse2, expSse2,
+									   expSumSse2, sumSse2, maxSse2, dotSse2, SSE2_MR, SSE2_NR,
+									   gemmKernelSse2, denseSse2, denseInt8Sse2,
+									   denseHalfSse2, denseBlocksSse2, densePanelsSse2 };
+	return &table;
+}
+
+#else
+
+const KernelTable* sse2Kernels()
+{
+	return nullptr;
+}
+
+#endif
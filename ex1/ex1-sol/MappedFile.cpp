@@ -0,0 +1,131 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include "MappedFile.h"
+
+#define SIZE_ERROR "ERROR: mapped file size does not match the matrix"
+
+/**
+ * Constructs a closed mapping
+ */
+MappedFile::MappedFile() : _address(nullptr), _size(0)
+{
+}
+
+/**
+ * Unmaps the file
+ */
+MappedFile::~MappedFile()
+{
+	this->close();
+}
+
+/**
+ * Move constructor, takes over the mapping
+ * @param otherFile	MappedFile
+ */
+MappedFile::MappedFile(MappedFile&& otherFile) noexcept :
+	_address(otherFile._address), _size(otherFile._size)
+{
+	otherFile._address = nullptr;
+	otherFile._size = 0;
+}
+
+/**
+ * Move assignment, swaps mappings
+ * @param otherFile	MappedFile
+ * @return			this
+ */
+MappedFile& MappedFile::operator=(MappedFile&& otherFile) noexcept
+{
+	std::swap(this->_address, otherFile._address);
+	std::swap(this->_size, otherFile._size);
+	return *this;
+}
+
+/**
+ * Maps a file, replacing any previous mapping
+ * @param filePath	path
+ * @return			true on success, false if it cannot be opened, is empty or cannot be mapped
+ */
+bool MappedFile::open(const std::string& filePath)
+{
+	this->close();
+	const int fd = ::open(filePath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* address = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	if (address == MAP_FAILED)
+	{
+		return false;
+	}
+
+	// start readahead now so the first inference rarely waits on a page fault
+	madvise(address, (size_t) info.st_size, MADV_WILLNEED);
+	this->_address = address;
+	this->_size = (size_t) info.st_size;
+	return true;
+}
+
+/**
+ * Unmaps the file, no-op when closed
+ */
+void MappedFile::close()
+{
+	if (this->_address != nullptr)
+	{
+		munmap(this->_address, this->_size);
+		this->_address = nullptr;
+		this->_size = 0;
+	}
+}
+
+/**
+ * Returns the mapped bytes
+ * @return	mapping start, nullptr when closed
+ */
+const void* MappedFile::data() const
+{
+	return this->_address;
+}
+
+/**
+ * Returns the mapping length
+ * @return	bytes
+ */
+size_t MappedFile::size() const
+{
+	return this->_size;
+}
+
+/**
+ * Views the whole file as a rows * cols float matrix
+ * Exits (code == 1) if the file size does not match.
+ * @param rows	rows
+ * @param cols	cols
+ * @return		MatrixView on the mapped pages
+ */
+MatrixView MappedFile::view(int rows, int cols) const
+{
+	if (this->_address == nullptr || rows <= 0 || cols <= 0 ||
+		this->_size != (size_t) rows * cols * sizeof(float))
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return MatrixView(static_cast<const float*>(this->_address), rows, cols, cols);
+}
@@ -0,0 +1,87 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include "MatrixView.h"
+
+/**
+ * Class MappedFile
+ * Read-only, shared memory mapping of a whole file.
+ * Pages come straight from the page cache: nothing is read until first touched,
+ * and every process mapping the same file shares the same physical pages.
+ */
+class MappedFile
+{
+ private:
+	/**
+	 * Mapping start, nullptr when closed
+	 */
+	void* _address;
+
+	/**
+	 * Mapping length in bytes
+	 */
+	size_t _size;
+ public:
+	/**
+	 * Constructs a closed mapping
+	 */
+	MappedFile();
+
+	/**
+	 * Unmaps the file
+	 */
+	~MappedFile();
+
+	/**
+	 * Move constructor, takes over the mapping
+	 * @param otherFile	MappedFile
+	 */
+	MappedFile(MappedFile&& otherFile) noexcept;
+
+	/**
+	 * Move assignment, swaps mappings
+	 * @param otherFile	MappedFile
+	 * @return			this
+	 */
+	MappedFile& operator=(MappedFile&& otherFile) noexcept;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+	 * Maps a file, replacing any previous mapping
+	 * @param filePath	path
+	 * @return			true on success, false if it cannot be opened, is empty or cannot be mapped
+	 */
+	bool open(const std::string& filePath);
+
+	/**
+	 * Unmaps the file, no-op when closed
+	 */
+	void close();
+
+	/**
+	 * Returns the mapped bytes
+	 * @return	mapping start, nullptr when closed
+	 */
+	const void* data() const;
+
+	/**
+	 * Returns the mapping length
+	 * @return	bytes
+	 */
+	size_t size() const;
+
+	/**
+	 * Views the whole file as a rows * cols float matrix
+	 * Exits (code == 1) if the file size does not match.
+	 * @param rows	rows
+	 * @param cols	cols
+	 * @return		MatrixView on the mapped pages
+	 */
+	MatrixView view(int rows, int cols) const;
+};
+
+#endif
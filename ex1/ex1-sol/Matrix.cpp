@@ -1,32 +1,55 @@
+#include <algorithm>
 #include "Matrix.h"
+#include "MatrixView.h"
+#include "Gemm.h"
+#include "Kernels.h"
+#include "MatrixAllocator.h"
+#include "MatrixTrace.h"
 
 #define INVALID_MATRIX_ERROR "ERROR: invalid matrix"
 #define INVALID_INPUT_ERROR "ERROR: invalid input"
 #define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
 #define INVALID_READ_ERROR "ERROR: unable to read your file"
+#define BORROW_ERROR "ERROR: only contiguous views can be borrowed"
 #define DEFAULT_ROWS 1
 #define DEFAULT_COLS 1
 #define DEFAULT_VALUE 0
 
 /**
- * Constructs Matrix rows * cols
- * Inits all elements to 0
+ * Constructs an owning Matrix on fresh, uninitialized storage
+ * @param dims		dimensions, both > 0
+ * @param copy		whether the caller fills it with a deep copy, for MatrixCounters
  */
-Matrix::Matrix(int rows, int cols)
+Matrix::Matrix(MatrixDims dims, bool copy)
 {
-	if (rows <= 0 || cols <= 0)
+	if (dims.rows <= 0 || dims.cols <= 0)
 	{
 		std::cerr << INVALID_MATRIX_ERROR << std::endl;
 		exit(EXIT_FAILURE);
 	}
-	this->_dims = new MatrixDims();
-	this->_dims->rows = rows;
-	this->_dims->cols = cols;
-	this->_mat = new float[rows * cols];
-	for (int i = 0; i < rows * cols; ++i)
-	{
-		this->_mat[i] = DEFAULT_VALUE;
-	}
+	this->_dims = dims;
+	this->_owner = true;
+	this->_mat = matrixAllocate(dims.rows * dims.cols);
+	matrixTraceAllocate((long) dims.rows * dims.cols * (long) sizeof(float), copy);
+}
+
+/**
+ * Constructs Matrix rows * cols
+ * Inits all elements to 0
+ */
+Matrix::Matrix(int rows, int cols) : Matrix(MatrixDims { rows, cols }, false)
+{
+	std::fill(this->_mat, this->_mat + rows * cols, DEFAULT_VALUE);
+}
+
+/**
+ * Constructs a Matrix on existing storage
+ * @param data		elements
+ * @param dims		dimensions
+ * @param owner		whether the matrix frees data
+ */
+Matrix::Matrix(float* data, MatrixDims dims, bool owner) : _mat(data), _dims(dims), _owner(owner)
+{
 }
 
 /**
@@ -42,23 +65,98 @@ Matrix::Matrix() : Matrix(DEFAULT_ROWS, DEFAULT_COLS)
  * Copy constructor
  * @param otherMatrix	Matrix
  */
-Matrix::Matrix(const Matrix& otherMatrix) : Matrix(otherMatrix.getRows(), otherMatrix.getCols())
+Matrix::Matrix(const Matrix& otherMatrix) : Matrix(otherMatrix._dims, true)
+{
+	std::copy(otherMatrix._mat, otherMatrix._mat + this->_dims.cols * this->_dims.rows, this->_mat);
+}
+
+/**
+ * Copies the elements of a view into a new contiguous Matrix
+ * @param view	MatrixView
+ */
+Matrix::Matrix(const MatrixView& view) : Matrix(MatrixDims { view.getRows(), view.getCols() }, true)
+{
+	for (int row = 0; row < view.getRows(); ++row)
+	{
+		const float* source = view.data() + row * view.getLd();
+		std::copy(source, source + view.getCols(), this->_mat + row * view.getCols());
+	}
+}
+
+/**
+ * Constructs Matrix rows * cols without initializing its elements,
+ * for results a kernel overwrites completely
+ * @param rows	rows, > 0
+ * @param cols	cols, > 0
+ * @return		owning Matrix
+ */
+Matrix Matrix::uninitialized(int rows, int cols)
+{
+	return Matrix(MatrixDims { rows, cols }, false);
+}
+
+/**
+ * Wraps existing contiguous storage without copying it, e.g. mmapped parameters.
+ * The storage may be write protected, so it is never written: the first non-const
+ * access copies the elements into owned storage, as copies of it do.
+ * view's storage must outlive it.
+ * @param view	contiguous MatrixView
+ * @return		non-owning Matrix
+ */
+Matrix Matrix::borrow(const MatrixView& view)
+{
+	if (!view.isContiguous())
+	{
+		std::cerr << BORROW_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return Matrix(const_cast<float*>(view.data()), { view.getRows(), view.getCols() }, false);
+}
+
+/**
+ * Before a write: copies borrowed elements into owned storage, nothing when owning
+ */
+void Matrix::_own()
 {
-	for (int i = 0; i < this->_dims->cols * this->_dims->rows; ++i)
+	if (!this->_owner)
 	{
-		this->_mat[i] = otherMatrix._mat[i];
+		*this = Matrix(*this);
 	}
 }
 
+/**
+ * Returns whether this matrix owns its elements
+ * @return	false for a borrowed matrix
+ */
+bool Matrix::isOwner() const
+{
+	return this->_owner;
+}
+
+/**
+ * Move constructor, takes over the buffer of otherMatrix.
+ * otherMatrix is left empty (0 * 0) and may only be assigned to or destroyed.
+ * @param otherMatrix	Matrix
+ */
+Matrix::Matrix(Matrix&& otherMatrix) noexcept :
+	_mat(otherMatrix._mat), _dims(otherMatrix._dims), _owner(otherMatrix._owner)
+{
+	otherMatrix._mat = nullptr;
+	otherMatrix._dims = { 0, 0 };
+	matrixTraceMove();
+}
+
 /**
  * Matrix destructor
  */
 Matrix::~Matrix()
 {
-	delete[] this->_mat;
+	if (this->_owner)
+	{
+		matrixFree(this->_mat, this->_dims.rows * this->_dims.cols);
+		matrixTraceFree((long) this->_dims.rows * this->_dims.cols * (long) sizeof(float));
+	}
 	this->_mat = nullptr;
-	delete this->_dims;
-	this->_dims = nullptr;
 }
 
 /**
@@ -67,7 +165,7 @@ Matrix::~Matrix()
  */
 int Matrix::getRows() const
 {
-	return this->_dims->rows;
+	return this->_dims.rows;
 }
 
 /**
@@ -76,7 +174,26 @@ int Matrix::getRows() const
  */
 int Matrix::getCols() const
 {
-	return this->_dims->cols;
+	return this->_dims.cols;
+}
+
+/**
+ * Returns the row-major element array, owned first if borrowed
+ * @return	float array of rows * cols elements
+ */
+float* Matrix::data()
+{
+	this->_own();
+	return this->_mat;
+}
+
+/**
+ * Returns the row-major element array, const
+ * @return	float array of rows * cols elements
+ */
+const float* Matrix::data() const
+{
+	return this->_mat;
 }
 
 /**
@@ -85,8 +202,25 @@ int Matrix::getCols() const
  */
 Matrix& Matrix::vectorize()
 {
-	this->_dims->rows *= this->_dims->cols;
-	this->_dims->cols = 1;
+	this->_dims.rows *= this->_dims.cols;
+	this->_dims.cols = 1;
+	return *this;
+}
+
+/**
+ * Transposes the matrix, in place when it owns its storage, into a fresh
+ * owned copy when it borrows it
+ * @return	Matrix
+ */
+Matrix& Matrix::transpose()
+{
+	if (this->_owner)
+	{
+		transposeInPlace(this->_mat, this->_dims.rows, this->_dims.cols);
+		std::swap(this->_dims.rows, this->_dims.cols);
+		return *this;
+	}
+	*this = MatrixView(*this).transposed();
 	return *this;
 }
 
@@ -95,9 +229,9 @@ Matrix& Matrix::vectorize()
  */
 void Matrix::plainPrint() const
 {
-	for (int row = 0; row < this->_dims->rows; ++row)
+	for (int row = 0; row < this->_dims.rows; ++row)
 	{
-		for (int col = 0; col < this->_dims->cols; ++col)
+		for (int col = 0; col < this->_dims.cols; ++col)
 		{
 			std::cout << (*this)(row, col) << " ";
 		}
@@ -114,19 +248,44 @@ Matrix& Matrix::operator=(const Matrix& otherMatrix)
 {
 	if (this != &otherMatrix)
 	{
-		this->_dims->rows = otherMatrix.getRows();
-		this->_dims->cols = otherMatrix.getCols();
-		delete[] (this->_mat);
-		this->_mat = new float[otherMatrix.getRows() * otherMatrix.getCols()];
-		for (int i = 0; i < otherMatrix.getCols() * otherMatrix.getRows(); ++i)
+		const int size = otherMatrix.getRows() * otherMatrix.getCols();
+		// same element count reuses the buffer, borrowed storage is never written
+		if (!this->_owner || this->_dims.rows * this->_dims.cols != size)
+		{
+			if (this->_owner)
+			{
+				matrixFree(this->_mat, this->_dims.rows * this->_dims.cols);
+				matrixTraceFree((long) this->_dims.rows * this->_dims.cols * (long) sizeof(float));
+			}
+			this->_mat = matrixAllocate(size);
+			this->_owner = true;
+			matrixTraceAllocate((long) size * (long) sizeof(float), true);
+		}
+		else
 		{
-			this->_mat[i] = otherMatrix._mat[i];
+			matrixTraceCopy();
 		}
+		this->_dims = otherMatrix._dims;
+		std::copy(otherMatrix._mat, otherMatrix._mat + size, this->_mat);
 	}
 
 	return *this;
 }
 
+/**
+ * Move assignment, swaps buffers with otherMatrix
+ * @param otherMatrix	Matrix
+ * @return				this
+ */
+Matrix& Matrix::operator=(Matrix&& otherMatrix) noexcept
+{
+	std::swap(this->_mat, otherMatrix._mat);
+	std::swap(this->_dims, otherMatrix._dims);
+	std::swap(this->_owner, otherMatrix._owner);
+	matrixTraceMove();
+	return *this;
+}
+
 /**
  * Matrix multiplication
  * @param otherMatrix	Matrix
@@ -134,24 +293,7 @@ Matrix& Matrix::operator=(const Matrix& otherMatrix)
  */
 Matrix Matrix::operator*(const Matrix& otherMatrix) const
 {
-	if (this->_dims->cols != otherMatrix.getRows())
-	{
-		std::cerr << SIZE_ERROR << std::endl;
-		exit(EXIT_FAILURE);
-	}
-
-	Matrix newMatrix(this->_dims->rows, otherMatrix.getCols());
-	for (int row = 0; row < newMatrix.getRows(); ++row)
-	{
-		for (int col = 0; col < newMatrix.getCols(); ++col)
-		{
-			for (int i = 0; i < this->getCols(); ++i)
-			{
-				newMatrix(row, col) += ((*this)(row, i) * otherMatrix(i, col));
-			}
-		}
-	}
-	return newMatrix;
+	return MatrixView(*this) * MatrixView(otherMatrix);
 }
 
 /**
@@ -161,11 +303,8 @@ Matrix Matrix::operator*(const Matrix& otherMatrix) const
  */
 Matrix Matrix::operator*(const float scalar) const
 {
-	Matrix newMatrix(*this);
-	for (int i = 0; i < (newMatrix.getRows() * newMatrix.getCols()); ++i)
-	{
-		newMatrix[i] *= scalar;
-	}
+	Matrix newMatrix(this->_dims.rows, this->_dims.cols);
+	kernels().scale(this->_mat, scalar, newMatrix._mat, this->_dims.rows * this->_dims.cols);
 	return newMatrix;
 }
 
@@ -177,8 +316,7 @@ Matrix Matrix::operator*(const float scalar) const
  */
 Matrix operator*(float scalar, const Matrix& otherMatrix)
 {
-	const Matrix& newMatrix(otherMatrix);
-	return newMatrix * scalar;
+	return otherMatrix * scalar;
 }
 
 /**
@@ -188,46 +326,73 @@ Matrix operator*(float scalar, const Matrix& otherMatrix)
  */
 Matrix Matrix::operator+(const Matrix& otherMatrix) const
 {
-	if (this->_dims->cols != otherMatrix.getCols() ||
-		this->_dims->rows != otherMatrix.getRows())
+	return MatrixView(*this) + MatrixView(otherMatrix);
+}
+
+/**
+ * Matrix addition accumulation, in place
+ * @param otherMatrix	Matrix
+ * @return				this
+ */
+Matrix& Matrix::operator+=(const Matrix& otherMatrix)
+{
+	this->_own();
+	if (this->_dims.cols != otherMatrix.getCols() ||
+		this->_dims.rows != otherMatrix.getRows())
 	{
 		std::cerr << SIZE_ERROR << std::endl;
 		exit(EXIT_FAILURE);
 	}
-	Matrix newMatrix(this->_dims->rows, this->_dims->cols);
-	for (int i = 0; i < this->getRows() * this->getCols(); ++i)
+	kernels().add(this->_mat, otherMatrix._mat, this->_mat, this->_dims.rows * this->_dims.cols);
+	return *this;
+}
+
+/**
+ * Matrix subtraction accumulation, in place
+ * @param otherMatrix	Matrix
+ * @return				this
+ */
+Matrix& Matrix::operator-=(const Matrix& otherMatrix)
+{
+	this->_own();
+	if (this->_dims.cols != otherMatrix.getCols() ||
+		this->_dims.rows != otherMatrix.getRows())
 	{
-		newMatrix[i] = this->_mat[i] + otherMatrix._mat[i];
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
 	}
-	return newMatrix;
+	kernels().sub(this->_mat, otherMatrix._mat, this->_mat, this->_dims.rows * this->_dims.cols);
+	return *this;
 }
 
 /**
- * Matrix addition accumulation
- * @param otherMatrix	Matrix
- * @return				Matrix
+ * Scalar multiplication, in place
+ * @param scalar	scalar
+ * @return			this
  */
-Matrix& Matrix::operator+=(const Matrix& otherMatrix)
+Matrix& Matrix::operator*=(float scalar)
 {
-	*this = *this + otherMatrix;
+	this->_own();
+	kernels().scale(this->_mat, scalar, this->_mat, this->_dims.rows * this->_dims.cols);
 	return *this;
 }
 
 /**
- * Parenthesis indexing
+ * Parenthesis indexing, owned first if borrowed
  * @param row	row
  * @param col	column
  * @return		this(row, col)
  */
 float& Matrix::operator()(int row, int col)
 {
-	if (row < 0 || row >= this->_dims->rows ||
-		col < 0 || col >= this->_dims->cols)
+	this->_own();
+	if (row < 0 || row >= this->_dims.rows ||
+		col < 0 || col >= this->_dims.cols)
 	{
 		std::cerr << INVALID_INPUT_ERROR << std::endl;
 		exit(EXIT_FAILURE);
 	}
-	return this->_mat[row * _dims->cols + col];
+	return this->_mat[row * _dims.cols + col];
 
 }
 
@@ -239,8 +404,8 @@ float& Matrix::operator()(int row, int col)
  */
 const float& Matrix::operator()(int row, int col) const
 {
-	if (row < 0 || row >= this->_dims->rows ||
-		col < 0 || col >= this->_dims->cols)
+	if (row < 0 || row >= this->_dims.rows ||
+		col < 0 || col >= this->_dims.cols)
 	{
 		std::cerr << INVALID_INPUT_ERROR << std::endl;
 		exit(EXIT_FAILURE);
@@ -249,13 +414,14 @@ const float& Matrix::operator()(int row, int col) const
 }
 
 /**
- * Brackets indexing
+ * Brackets indexing, owned first if borrowed
  * @param index		Index
  * @return		this[i]
  */
 float& Matrix::operator[](int index)
 {
-	if ((index >= this->_dims->rows * this->_dims->cols) || (index < 0))
+	this->_own();
+	if ((index >= this->_dims.rows * this->_dims.cols) || (index < 0))
 	{
 		std::cerr << INVALID_INPUT_ERROR << std::endl;
 		exit(EXIT_FAILURE);
@@ -270,7 +436,7 @@ float& Matrix::operator[](int index)
  */
 const float& Matrix::operator[](int index) const
 {
-	if ((index >= this->_dims->rows * this->_dims->cols) || (index < 0))
+	if ((index >= this->_dims.rows * this->_dims.cols) || (index < 0))
 	{
 		std::cerr << INVALID_INPUT_ERROR << std::endl;
 		exit(EXIT_FAILURE);
@@ -287,16 +453,17 @@ const float& Matrix::operator[](int index) const
 	 */
 std::istream& operator>>(std::istream& in, Matrix& matrix)
 {
-	for (int i = 0; i < matrix._dims->rows; ++i)
+	matrix._own();
+	for (int i = 0; i < matrix._dims.rows; ++i)
 	{
-		for (int j = 0; j < matrix._dims->cols; ++j)
+		for (int j = 0; j < matrix._dims.cols; ++j)
 		{
 			if (!in.good())
 			{
 				std::cerr << INVALID_READ_ERROR << std::endl;
 				exit(EXIT_FAILURE);
 			}
-			in.read((char*)(&(matrix._mat[i * matrix._dims->cols + j])), 4);
+			in.read((char*)(&(matrix._mat[i * matrix._dims.cols + j])), 4);
 		}
 	}
 	return in;
@@ -311,11 +478,11 @@ std::istream& operator>>(std::istream& in, Matrix& matrix)
 	 */
 std::ostream& operator<<(std::ostream& os, const Matrix& matrix)
 {
-	for (int row = 0; row < matrix._dims->rows; ++row)
+	for (int row = 0; row < matrix._dims.rows; ++row)
 	{
-		for (int col = 0; col < matrix._dims->cols; ++col)
+		for (int col = 0; col < matrix._dims.cols; ++col)
 		{
-			if (matrix[row * matrix._dims->cols + col] <= 0.1f)
+			if (matrix[row * matrix._dims.cols + col] <= 0.1f)
 			{
 				os << "  ";
 			}
@@ -11,6 +11,8 @@ typedef struct MatrixDims
 	int rows, cols;
 } MatrixDims;
 
+class MatrixView;
+
 /**
  * Class matrix
  */
@@ -25,7 +27,32 @@ class Matrix
 	/**
 	 * Matrix dimensions
 	 */
-	MatrixDims * _dims;
+	MatrixDims _dims;
+
+	/**
+	 * False when _mat is borrowed (see borrow) and must not be freed or written
+	 */
+	bool _owner;
+
+	/**
+	 * Constructs a Matrix on existing storage
+	 * @param data		elements
+	 * @param dims		dimensions
+	 * @param owner		whether the matrix frees data
+	 */
+	Matrix(float* data, MatrixDims dims, bool owner);
+
+	/**
+	 * Constructs an owning Matrix on fresh, uninitialized storage
+	 * @param dims		dimensions, both > 0
+	 * @param copy		whether the caller fills it with a deep copy, for MatrixCounters
+	 */
+	Matrix(MatrixDims dims, bool copy);
+
+	/**
+	 * Before a write: copies borrowed elements into owned storage, nothing when owning
+	 */
+	void _own();
  public:
 	/**
 	 * Constructs 1*1 Matrix
@@ -45,6 +72,44 @@ class Matrix
 	 */
 	Matrix(const Matrix& otherMatrix);
 
+	/**
+	 * Copies the elements of a view into a new contiguous Matrix
+	 * @param view	MatrixView
+	 */
+	explicit Matrix(const MatrixView& view);
+
+	/**
+	 * Constructs Matrix rows * cols without initializing its elements,
+	 * for results a kernel overwrites completely
+	 * @param rows	rows, > 0
+	 * @param cols	cols, > 0
+	 * @return		owning Matrix
+	 */
+	static Matrix uninitialized(int rows, int cols);
+
+	/**
+	 * Wraps existing contiguous storage without copying it, e.g. mmapped parameters.
+	 * The storage may be write protected, so it is never written: the first non-const
+	 * access copies the elements into owned storage, as copies of it do.
+	 * view's storage must outlive it.
+	 * @param view	contiguous MatrixView
+	 * @return		non-owning Matrix
+	 */
+	static Matrix borrow(const MatrixView& view);
+
+	/**
+	 * Returns whether this matrix owns its elements
+	 * @return	false for a borrowed matrix
+	 */
+	bool isOwner() const;
+
+	/**
+	 * Move constructor, takes over the buffer of otherMatrix.
+	 * otherMatrix is left empty (0 * 0) and may only be assigned to or destroyed.
+	 * @param otherMatrix	Matrix
+	 */
+	Matrix(Matrix&& otherMatrix) noexcept;
+
 	/**
 	 * Matrix destructor
 	 */
@@ -62,12 +127,31 @@ class Matrix
 	 */
 	int getCols() const;
 
+	/**
+	 * Returns the row-major element array, owned first if borrowed
+	 * @return	float array of rows * cols elements
+	 */
+	float* data();
+
+	/**
+	 * Returns the row-major element array, const
+	 * @return	float array of rows * cols elements
+	 */
+	const float* data() const;
+
 	/**
 	 * Transforms a matrix into a column vector
 	 * @return	Matrix
 	 */
 	Matrix& vectorize();
 
+	/**
+	 * Transposes the matrix, in place when it owns its storage, into a fresh
+	 * owned copy when it borrows it
+	 * @return	Matrix
+	 */
+	Matrix& transpose();
+
 	/**
 	 * Prints matrix elements, no return value.
 	 */
@@ -80,6 +164,13 @@ class Matrix
 	 */
 	Matrix& operator=(const Matrix& otherMatrix);
 
+	/**
+	 * Move assignment, swaps buffers with otherMatrix
+	 * @param otherMatrix	Matrix
+	 * @return				this
+	 */
+	Matrix& operator=(Matrix&& otherMatrix) noexcept;
+
 	/**
 	 * Matrix multiplication
 	 * @param otherMatrix	Matrix
@@ -110,14 +201,28 @@ class Matrix
 	Matrix operator+(const Matrix& otherMatrix) const;
 
 	/**
-	 * Matrix addition accumulation
+	 * Matrix addition accumulation, in place
 	 * @param otherMatrix	Matrix
-	 * @return				Matrix
+	 * @return				this
 	 */
 	Matrix& operator+=(const Matrix& otherMatrix);
 
 	/**
-	 * Parenthesis indexing
+	 * Matrix subtraction accumulation, in place
+	 * @param otherMatrix	Matrix
+	 * @return				this
+	 */
+	Matrix& operator-=(const Matrix& otherMatrix);
+
+	/**
+	 * Scalar multiplication, in place
+	 * @param scalar	scalar
+	 * @return			this
+	 */
+	Matrix& operator*=(float scalar);
+
+	/**
+	 * Parenthesis indexing, owned first if borrowed
 	 * @param row	row
 	 * @param col	column
 	 * @return		this(row, col)
@@ -133,7 +238,7 @@ class Matrix
 	const float& operator()(int row, int col) const;
 
 	/**
-	 * Brackets indexing
+	 * Brackets indexing, owned first if borrowed
 	 * @param index		Index
 	 * @return		this[i]
 	 */
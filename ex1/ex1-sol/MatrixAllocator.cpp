@@ -0,0 +1,352 @@
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include "MatrixAllocator.h"
+
+#define SIZE_CLASSES (MATRIX_POOL_MAX_SHIFT - MATRIX_POOL_MIN_SHIFT + 1)
+#define DIRECT_CLASS (-1)
+#define ALLOCATION_ERROR "ERROR: unable to allocate matrix storage"
+#define CACHE_UNUSED 0
+#define CACHE_ALIVE 1
+#define CACHE_DESTROYED 2
+
+/**
+ * @struct FreeBlock
+ * @brief Free list link, stored inside the free block itself
+ */
+typedef struct FreeBlock
+{
+	FreeBlock* next;
+} FreeBlock;
+
+/**
+ * @struct ThreadCounters
+ * @brief Counters of one thread, written by that thread only
+ */
+typedef struct ThreadCounters
+{
+	std::atomic<long> allocations{ 0 };
+	std::atomic<long> frees{ 0 };
+	std::atomic<long> poolHits{ 0 };
+	std::atomic<long> systemAllocations{ 0 };
+	std::atomic<long> systemFrees{ 0 };
+	std::atomic<long> bytesCached{ 0 };
+	std::atomic<long> bytesInUse{ 0 };
+} ThreadCounters;
+
+/**
+ * @struct Registry
+ * @brief Counters of live threads plus the totals of exited ones. The shared atomics
+ * change only off the pool hit path: on system reservations and releases, and for
+ * buffers a thread handles after its cache is gone.
+ */
+typedef struct Registry
+{
+	std::mutex mutex;
+	std::vector<const ThreadCounters*> threads;
+	AllocatorStats retired = {};
+	std::atomic<long> uncachedBytesInUse{ 0 };
+	std::atomic<long> bytesReserved{ 0 };
+	std::atomic<long> peakBytesReserved{ 0 };
+} Registry;
+
+/**
+ * Process wide registry, constructed before the first thread cache and destroyed after the last
+ * @return	Registry
+ */
+static Registry& registry()
+{
+	static Registry instance;
+	return instance;
+}
+
+/**
+ * Tracks bytes held from the system and their high-water mark
+ * @param delta	bytes, positive when reserved
+ */
+static void trackReserved(long delta)
+{
+	Registry& global = registry();
+	const long reserved = global.bytesReserved.fetch_add(delta, std::memory_order_relaxed) + delta;
+	long peak = global.peakBytesReserved.load(std::memory_order_relaxed);
+	while (reserved > peak &&
+		   !global.peakBytesReserved.compare_exchange_weak(peak, reserved, std::memory_order_relaxed))
+	{
+	}
+}
+
+/**
+ * Lifecycle of the calling thread's cache, trivially destructible so it is still
+ * readable while thread_local destructors run
+ */
+static thread_local int cacheState = CACHE_UNUSED;
+
+/**
+ * Class ThreadCache
+ * Per thread free lists, one per power of two size class
+ */
+class ThreadCache
+{
+ public:
+	/**
+	 * Free list heads
+	 */
+	FreeBlock* lists[SIZE_CLASSES];
+
+	/**
+	 * Counters
+	 */
+	ThreadCounters counters;
+
+	/**
+	 * Registers the counters
+	 */
+	ThreadCache() : lists()
+	{
+		Registry& global = registry();
+		std::lock_guard<std::mutex> lock(global.mutex);
+		global.threads.push_back(&this->counters);
+		cacheState = CACHE_ALIVE;
+	}
+
+	/**
+	 * Releases cached blocks, folds the counters into the retired totals
+	 */
+	~ThreadCache()
+	{
+		this->trim();
+		Registry& global = registry();
+		std::lock_guard<std::mutex> lock(global.mutex);
+		for (size_t i = 0; i < global.threads.size(); ++i)
+		{
+			if (global.threads[i] == &this->counters)
+			{
+				global.threads.erase(global.threads.begin() + i);
+				break;
+			}
+		}
+		global.retired.allocations += this->counters.allocations;
+		global.retired.frees += this->counters.frees;
+		global.retired.poolHits += this->counters.poolHits;
+		global.retired.systemAllocations += this->counters.systemAllocations;
+		global.retired.systemFrees += this->counters.systemFrees;
+		global.retired.bytesInUse += this->counters.bytesInUse;
+		cacheState = CACHE_DESTROYED;
+	}
+
+	/**
+	 * Returns every cached block to the system
+	 */
+	void trim()
+	{
+		for (int sizeClass = 0; sizeClass < SIZE_CLASSES; ++sizeClass)
+		{
+			while (this->lists[sizeClass] != nullptr)
+			{
+				FreeBlock* block = this->lists[sizeClass];
+				this->lists[sizeClass] = block->next;
+				std::free(block);
+				trackReserved(-(1L << (sizeClass + MATRIX_POOL_MIN_SHIFT)));
+				bump(this->counters.systemFrees, 1);
+				bump(this->counters.bytesCached, -(1L << (sizeClass + MATRIX_POOL_MIN_SHIFT)));
+			}
+		}
+	}
+
+	/**
+	 * Adds to a counter owned by this thread, no read-modify-write contention
+	 * @param counter	counter
+	 * @param delta		amount
+	 */
+	static void bump(std::atomic<long>& counter, long delta)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+	}
+};
+
+/**
+ * Calling thread's cache
+ * @return	ThreadCache, nullptr once it has been destroyed at thread exit
+ */
+static ThreadCache* threadCache()
+{
+	if (cacheState == CACHE_DESTROYED)
+	{
+		return nullptr;
+	}
+	static thread_local ThreadCache cache;
+	return &cache;
+}
+
+/**
+ * Size class of a buffer
+ * @param count	floats
+ * @return		class index, DIRECT_CLASS if too large to pool
+ */
+static int sizeClassOf(int count)
+{
+	const size_t bytes = (size_t) count * sizeof(float);
+	int shift = MATRIX_POOL_MIN_SHIFT;
+	while (((size_t) 1 << shift) < bytes)
+	{
+		++shift;
+	}
+	return shift > MATRIX_POOL_MAX_SHIFT ? DIRECT_CLASS : shift - MATRIX_POOL_MIN_SHIFT;
+}
+
+/**
+ * Bytes reserved for a buffer
+ * @param count		floats
+ * @param sizeClass	its size class
+ * @return			bytes
+ */
+static long blockBytes(int count, int sizeClass)
+{
+	if (sizeClass == DIRECT_CLASS)
+	{
+		return ((long) count * (long) sizeof(float) + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+	}
+	return 1L << (sizeClass + MATRIX_POOL_MIN_SHIFT);
+}
+
+/**
+ * Returns a 64-byte aligned buffer of count floats.
+ * Sizes are rounded up to a power of two and served from a per-thread free list,
+ * so steady-state allocation never reaches malloc.
+ * @param count		floats, > 0
+ * @return			buffer, uninitialized
+ */
+float* matrixAllocate(int count)
+{
+	const int sizeClass = sizeClassOf(count);
+	const long bytes = blockBytes(count, sizeClass);
+	ThreadCache* cache = threadCache();
+	if (cache == nullptr)
+	{
+		registry().uncachedBytesInUse.fetch_add(bytes, std::memory_order_relaxed);
+	}
+	else
+	{
+		ThreadCache::bump(cache->counters.allocations, 1);
+		ThreadCache::bump(cache->counters.bytesInUse, bytes);
+		if (sizeClass != DIRECT_CLASS && cache->lists[sizeClass] != nullptr)
+		{
+			FreeBlock* block = cache->lists[sizeClass];
+			cache->lists[sizeClass] = block->next;
+			ThreadCache::bump(cache->counters.poolHits, 1);
+			ThreadCache::bump(cache->counters.bytesCached, -bytes);
+			return reinterpret_cast<float*>(block);
+		}
+		ThreadCache::bump(cache->counters.systemAllocations, 1);
+	}
+
+	void* memory = nullptr;
+	if (posix_memalign(&memory, MATRIX_ALIGNMENT, (size_t) bytes) != 0)
+	{
+		std::cerr << ALLOCATION_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	trackReserved(bytes);
+	return static_cast<float*>(memory);
+}
+
+/**
+ * Returns a buffer to the calling thread's free list
+ * @param data		buffer from matrixAllocate, nullptr is ignored
+ * @param count		the count it was allocated with
+ */
+void matrixFree(float* data, int count)
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+	const int sizeClass = sizeClassOf(count);
+	const long bytes = blockBytes(count, sizeClass);
+	ThreadCache* cache = threadCache();
+	if (cache == nullptr)
+	{
+		registry().uncachedBytesInUse.fetch_add(-bytes, std::memory_order_relaxed);
+	}
+	else
+	{
+		ThreadCache::bump(cache->counters.frees, 1);
+		ThreadCache::bump(cache->counters.bytesInUse, -bytes);
+		if (sizeClass != DIRECT_CLASS &&
+			cache->counters.bytesCached.load(std::memory_order_relaxed) + bytes <= MATRIX_POOL_CACHE_LIMIT)
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(data);
+			block->next = cache->lists[sizeClass];
+			cache->lists[sizeClass] = block;
+			ThreadCache::bump(cache->counters.bytesCached, bytes);
+			return;
+		}
+		ThreadCache::bump(cache->counters.systemFrees, 1);
+	}
+	trackReserved(-bytes);
+	std::free(data);
+}
+
+/**
+ * Returns the cached blocks of the calling thread to the system
+ */
+void matrixAllocatorTrim()
+{
+	ThreadCache* cache = threadCache();
+	if (cache != nullptr)
+	{
+		cache->trim();
+	}
+}
+
+/**
+ * matrixAllocate calls made by the calling thread so far, without the
+ * registry lock of matrixAllocatorStats
+ * @return	allocations
+ */
+long matrixThreadAllocations()
+{
+	const ThreadCache* cache = threadCache();
+	return cache == nullptr ? 0 : cache->counters.allocations.load(std::memory_order_relaxed);
+}
+
+/**
+ * Snapshot of the allocator counters
+ * @return	AllocatorStats
+ */
+AllocatorStats matrixAllocatorStats()
+{
+	Registry& global = registry();
+	std::lock_guard<std::mutex> lock(global.mutex);
+	AllocatorStats stats = global.retired;
+	for (const ThreadCounters* counters : global.threads)
+	{
+		stats.allocations += counters->allocations.load(std::memory_order_relaxed);
+		stats.frees += counters->frees.load(std::memory_order_relaxed);
+		stats.poolHits += counters->poolHits.load(std::memory_order_relaxed);
+		stats.systemAllocations += counters->systemAllocations.load(std::memory_order_relaxed);
+		stats.systemFrees += counters->systemFrees.load(std::memory_order_relaxed);
+		stats.bytesCached += counters->bytesCached.load(std::memory_order_relaxed);
+		stats.bytesInUse += counters->bytesInUse.load(std::memory_order_relaxed);
+	}
+	stats.bytesInUse += global.uncachedBytesInUse.load(std::memory_order_relaxed);
+	stats.peakBytesReserved = global.peakBytesReserved.load(std::memory_order_relaxed);
+	return stats;
+}
+
+/**
+ * Output stream
+ * One line summary of the counters
+ * @param os		Ostream
+ * @param stats		AllocatorStats
+ * @return			Ostream
+ */
+std::ostream& operator<<(std::ostream& os, const AllocatorStats& stats)
+{
+	os << "allocations=" << stats.allocations << " frees=" << stats.frees
+	   << " poolHits=" << stats.poolHits << " systemAllocations=" << stats.systemAllocations
+	   << " systemFrees=" << stats.systemFrees << " bytesInUse=" << stats.bytesInUse
+	   << " peakBytesReserved=" << stats.peakBytesReserved << " bytesCached=" << stats.bytesCached;
+	return os;
+}
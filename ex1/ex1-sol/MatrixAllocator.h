@@ -0,0 +1,118 @@
+#ifndef MATRIX_ALLOCATOR_H
+#define MATRIX_ALLOCATOR_H
+
+#include <iostream>
+
+/**
+ * Alignment in bytes of every Matrix buffer, one cache line / one AVX-512 register
+ */
+#define MATRIX_ALIGNMENT 64
+
+/**
+ * Smallest size class is 2^MATRIX_POOL_MIN_SHIFT bytes
+ */
+#define MATRIX_POOL_MIN_SHIFT 6
+
+/**
+ * Largest pooled size class is 2^MATRIX_POOL_MAX_SHIFT bytes, larger buffers bypass the pools
+ */
+#define MATRIX_POOL_MAX_SHIFT 26
+
+/**
+ * Bytes a thread may keep cached in its free lists before returning blocks to the system
+ */
+#define MATRIX_POOL_CACHE_LIMIT (64L << 20)
+
+/**
+ * @struct AllocatorStats
+ * @brief Matrix storage allocator counters, summed over all threads
+ */
+typedef struct AllocatorStats
+{
+	/**
+	 * matrixAllocate calls
+	 */
+	long allocations;
+
+	/**
+	 * matrixFree calls
+	 */
+	long frees;
+
+	/**
+	 * Allocations served from a free list
+	 */
+	long poolHits;
+
+	/**
+	 * Blocks requested from the system (posix_memalign)
+	 */
+	long systemAllocations;
+
+	/**
+	 * Blocks returned to the system
+	 */
+	long systemFrees;
+
+	/**
+	 * Bytes currently handed out, rounded up to the size class
+	 */
+	long bytesInUse;
+
+	/**
+	 * Highest bytes held from the system, handed out plus cached. Tracked only when a
+	 * block is reserved or released, so pool hits never touch a shared counter;
+	 * bounds the highest bytesInUse from above.
+	 */
+	long peakBytesReserved;
+
+	/**
+	 * Bytes sitting in free lists
+	 */
+	long bytesCached;
+} AllocatorStats;
+
+/**
+ * Returns a 64-byte aligned buffer of count floats.
+ * Sizes are rounded up to a power of two and served from a per-thread free list,
+ * so steady-state allocation never reaches malloc.
+ * @param count		floats, > 0
+ * @return			buffer, uninitialized
+ */
+float* matrixAllocate(int count);
+
+/**
+ * Returns a buffer to the calling thread's free list
+ * @param data		buffer from matrixAllocate, nullptr is ignored
+ * @param count		the count it was allocated with
+ */
+void matrixFree(float* data, int count);
+
+/**
+ * Returns the cached blocks of the calling thread to the system
+ */
+void matrixAllocatorTrim();
+
+/**
+ * matrixAllocate calls made by the calling thread so far, without the
+ * registry lock of matrixAllocatorStats
+ * @return	allocations
+ */
+long matrixThreadAllocations();
+
+/**
+ * Snapshot of the allocator counters
+ * @return	AllocatorStats
+ */
+AllocatorStats matrixAllocatorStats();
+
+/**
+ * Output stream
+ * One line summary of the counters
+ * @param os		Ostream
+ * @param stats		AllocatorStats
+ * @return			Ostream
+ */
+std::ostream& operator<<(std::ostream& os, const AllocatorStats& stats);
+
+#endif
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include "MatrixTrace.h"
+
+#ifdef __GLIBC__
+#include <execinfo.h>
+#endif
+
+/**
+ * @struct ThreadTrace
+ * @brief Counters and copy sampling state of one thread. Trivially destructible, so
+ *        matrices freed by other thread_local destructors at thread exit still count.
+ */
+typedef struct ThreadTrace
+{
+	MatrixCounters counters;
+	int sampleEvery;
+	long untilSample;
+} ThreadTrace;
+
+/**
+ * Calling thread's trace
+ */
+static thread_local ThreadTrace threadTrace;
+
+/**
+ * Calling thread's sampled copy stacks and their counts
+ * @return	sites
+ */
+static std::map<std::string, long>& threadSites()
+{
+	static thread_local std::map<std::string, long> sites;
+	return sites;
+}
+
+/**
+ * Records the stack of a copy when its sample is due
+ * @param trace	ThreadTrace
+ */
+static void sampleCopy(ThreadTrace& trace)
+{
+	if (trace.sampleEvery == 0 || --trace.untilSample > 0)
+	{
+		return;
+	}
+	trace.untilSample = trace.sampleEvery;
+#ifdef __GLIBC__
+	void* frames[MATRIX_TRACE_FRAMES];
+	const int depth = backtrace(frames, MATRIX_TRACE_FRAMES);
+	char** symbols = backtrace_symbols(frames, depth);
+	if (symbols == nullptr)
+	{
+		return;
+	}
+	std::string stack;
+	for (int i = 0; i < depth; ++i)
+	{
+		stack += symbols[i];
+		stack += '\n';
+	}
+	std::free(symbols);
+	++threadSites()[stack];
+#endif
+}
+
+/**
+ * Returns the calling thread's counters
+ * @return	MatrixCounters
+ */
+MatrixCounters matrixCounters()
+{
+	return threadTrace.counters;
+}
+
+/**
+ * Zeroes the calling thread's counters, e.g. right before the code a test budgets
+ */
+void matrixCountersReset()
+{
+	threadTrace.counters = {};
+}
+
+/**
+ * Samples the stack of every sampleEvery-th deep copy on the calling thread,
+ * 0 stops sampling. The sampled stacks are kept until the next call.
+ * Stacks are only available with glibc, elsewhere nothing is sampled.
+ * @param sampleEvery	copies per sample
+ */
+void matrixTraceCopies(int sampleEvery)
+{
+	ThreadTrace& trace = threadTrace;
+	trace.sampleEvery = std::max(0, sampleEvery);
+	trace.untilSample = trace.sampleEvery;
+	threadSites().clear();
+}
+
+/**
+ * Returns the sampled copy stacks of the calling thread, most frequent first
+ * @return	(stack, samples) pairs, one frame per line
+ */
+std::vector<std::pair<std::string, long>> matrixCopySites()
+{
+	const std::map<std::string, long>& sites = threadSites();
+	std::vector<std::pair<std::string, long>> sorted(sites.begin(), sites.end());
+	std::stable_sort(sorted.begin(), sorted.end(),
+					 [](const std::pair<std::string, long>& a, const std::pair<std::string, long>& b)
+					 {
+						 return a.second > b.second;
+					 });
+	return sorted;
+}
+
+/**
+ * Called by Matrix when it allocates a buffer
+ * @param bytes	element bytes
+ * @param copy	whether the buffer receives a deep copy
+ */
+void matrixTraceAllocate(long bytes, bool copy)
+{
+	ThreadTrace& trace = threadTrace;
+	MatrixCounters& counters = trace.counters;
+	++(copy ? counters.copies : counters.constructions);
+	counters.bytesAllocated += bytes;
+	counters.liveBytes += bytes;
+	counters.peakLiveBytes = std::max(counters.peakLiveBytes, counters.liveBytes);
+	if (copy)
+	{
+		sampleCopy(trace);
+	}
+}
+
+/**
+ * Called by Matrix when it deep copies into a buffer it already owns
+ */
+void matrixTraceCopy()
+{
+	ThreadTrace& trace = threadTrace;
+	++trace.counters.copies;
+	sampleCopy(trace);
+}
+
+/**
+ * Called by Matrix on a move construction or move assignment
+ */
+void matrixTraceMove()
+{
+	++threadTrace.counters.moves;
+}
+
+/**
+ * Called by Matrix when it frees a buffer
+ * @param bytes	element bytes
+ */
+void matrixTraceFree(long bytes)
+{
+	threadTrace.counters.liveBytes -= bytes;
+}
+
+/**
+ * Output stream
+ * One line summary of the counters
+ * @param os		Ostream
+ * @param counters	MatrixCounters
+ * @return			Ostream
+ */
+std::ostream& operator<<(std::ostream& os, const MatrixCounters& counters)
+{
+	os << "constructions=" << counters.constructions << " copies=" << counters.copies
+	   << " moves=" << counters.moves << " bytesAllocated=" << counters.bytesAllocated
+	   << " liveBytes=" << counters.liveBytes << " peakLiveBytes=" << counters.peakLiveBytes;
+	return os;
+}
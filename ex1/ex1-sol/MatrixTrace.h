@@ -0,0 +1,105 @@
+#ifndef MATRIX_TRACE_H
+#define MATRIX_TRACE_H
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Frames kept per sampled copy stack, the hook frames themselves included
+ */
+#define MATRIX_TRACE_FRAMES 16
+
+/**
+ * @struct MatrixCounters
+ * @brief Matrix lifecycle counters of the calling thread since its last reset.
+ *        Bytes are element bytes, before the allocator rounds them to a size class.
+ */
+typedef struct MatrixCounters
+{
+	/**
+	 * Matrices given fresh zeroed storage: the sized and default constructors
+	 */
+	long constructions;
+	/**
+	 * Deep copies: the copy constructor, copy assignment and copies of a MatrixView
+	 */
+	long copies;
+	/**
+	 * Move constructions and move assignments, no element is copied
+	 */
+	long moves;
+	/**
+	 * Element bytes of every buffer allocated
+	 */
+	long bytesAllocated;
+	/**
+	 * Bytes allocated minus bytes freed by this thread, may go negative when
+	 * matrices allocated before the reset or on another thread are freed here
+	 */
+	long liveBytes;
+	/**
+	 * Highest liveBytes seen
+	 */
+	long peakLiveBytes;
+} MatrixCounters;
+
+/**
+ * Returns the calling thread's counters
+ * @return	MatrixCounters
+ */
+MatrixCounters matrixCounters();
+
+/**
+ * Zeroes the calling thread's counters, e.g. right before the code a test budgets
+ */
+void matrixCountersReset();
+
+/**
+ * Samples the stack of every sampleEvery-th deep copy on the calling thread,
+ * 0 stops sampling. The sampled stacks are kept until the next call.
+ * Stacks are only available with glibc, elsewhere nothing is sampled.
+ * @param sampleEvery	copies per sample
+ */
+void matrixTraceCopies(int sampleEvery);
+
+/**
+ * Returns the sampled copy stacks of the calling thread, most frequent first
+ * @return	(stack, samples) pairs, one frame per line
+ */
+std::vector<std::pair<std::string, long>> matrixCopySites();
+
+/**
+ * Called by Matrix when it allocates a buffer
+ * @param bytes	element bytes
+ * @param copy	whether the buffer receives a deep copy
+ */
+void matrixTraceAllocate(long bytes, bool copy);
+
+/**
+ * Called by Matrix when it deep copies into a buffer it already owns
+ */
+void matrixTraceCopy();
+
+/**
+ * Called by Matrix on a move construction or move assignment
+ */
+void matrixTraceMove();
+
+/**
+ * Called by Matrix when it frees a buffer
+ * @param bytes	element bytes
+ */
+void matrixTraceFree(long bytes);
+
+/**
+ * Output stream
+ * One line summary of the counters
+ * @param os		Ostream
+ * @param counters	MatrixCounters
+ * @return			Ostream
+ */
+std::ostream& operator<<(std::ostream& os, const MatrixCounters& counters);
+
+#endif
@@ -0,0 +1,252 @@
+#include "MatrixView.h"
+#include "Gemm.h"
+#include "Kernels.h"
+
+#define INVALID_VIEW_ERROR "ERROR: invalid matrix view"
+#define INVALID_INPUT_ERROR "ERROR: invalid input"
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+
+/**
+ * Constructs a view on raw data
+ * @param data	first element
+ * @param rows	rows
+ * @param cols	cols
+ * @param ld	distance in floats between rows, at least cols
+ */
+MatrixView::MatrixView(const float* data, int rows, int cols, int ld) :
+	_data(data), _dims({ rows, cols }), _ld(ld)
+{
+	if (data == nullptr || rows <= 0 || cols <= 0 || ld < cols)
+	{
+		std::cerr << INVALID_VIEW_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Constructs a view on a whole matrix
+ * @param matrix	Matrix
+ */
+MatrixView::MatrixView(const Matrix& matrix) :
+	_data(matrix.data()), _dims({ matrix.getRows(), matrix.getCols() }), _ld(matrix.getCols())
+{
+}
+
+/**
+ * returns the amount of rows as int
+ * @return	amount of rows as int
+ */
+int MatrixView::getRows() const
+{
+	return this->_dims.rows;
+}
+
+/**
+ * returns the amount of cols as int
+ * @return	amount of cols as int
+ */
+int MatrixView::getCols() const
+{
+	return this->_dims.cols;
+}
+
+/**
+ * returns the leading dimension
+ * @return	distance in floats between rows
+ */
+int MatrixView::getLd() const
+{
+	return this->_ld;
+}
+
+/**
+ * Returns the first element
+ * @return	float array
+ */
+const float* MatrixView::data() const
+{
+	return this->_data;
+}
+
+/**
+ * Returns whether the rows are stored back to back
+ * @return	true if the view covers rows * cols consecutive floats
+ */
+bool MatrixView::isContiguous() const
+{
+	return this->_ld == this->_dims.cols || this->_dims.rows == 1;
+}
+
+/**
+ * Reinterprets a contiguous view with other dims of the same size
+ * @param rows	rows
+ * @param cols	cols
+ * @return		MatrixView
+ */
+MatrixView MatrixView::reshape(int rows, int cols) const
+{
+	if (!this->isContiguous() || rows * cols != this->_dims.rows * this->_dims.cols)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return MatrixView(this->_data, rows, cols, cols);
+}
+
+/**
+ * Reinterprets a contiguous view as a column vector
+ * @return	MatrixView
+ */
+MatrixView MatrixView::vectorize() const
+{
+	return this->reshape(this->_dims.rows * this->_dims.cols, 1);
+}
+
+/**
+ * Sub-block of the view
+ * @param row	first row
+ * @param col	first col
+ * @param rows	rows
+ * @param cols	cols
+ * @return		MatrixView
+ */
+MatrixView MatrixView::block(int row, int col, int rows, int cols) const
+{
+	if (row < 0 || col < 0 || rows <= 0 || cols <= 0 ||
+		row + rows > this->_dims.rows || col + cols > this->_dims.cols)
+	{
+		std::cerr << INVALID_INPUT_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return MatrixView(this->_data + row * this->_ld + col, rows, cols, this->_ld);
+}
+
+/**
+ * Consecutive rows
+ * @param first	first row
+ * @param count	rows
+ * @return		MatrixView
+ */
+MatrixView MatrixView::rowRange(int first, int count) const
+{
+	return this->block(first, 0, count, this->_dims.cols);
+}
+
+/**
+ * Consecutive cols, e.g. a sub-batch of a batch with one sample per column
+ * @param first	first col
+ * @param count	cols
+ * @return		MatrixView
+ */
+MatrixView MatrixView::colRange(int first, int count) const
+{
+	return this->block(0, first, this->_dims.rows, count);
+}
+
+/**
+ * A single column, as a strided column vector
+ * @param col	col
+ * @return		MatrixView
+ */
+MatrixView MatrixView::column(int col) const
+{
+	return this->block(0, col, this->_dims.rows, 1);
+}
+
+/**
+ * Copies the transpose of the view
+ * @return	Matrix, cols x rows
+ */
+Matrix MatrixView::transposed() const
+{
+	Matrix result = Matrix::uninitialized(this->_dims.cols, this->_dims.rows);
+	transpose(this->_data, this->_dims.rows, this->_dims.cols, this->_ld, result.data(), this->_dims.rows);
+	return result;
+}
+
+/**
+ * Parenthesis indexing
+ * @param row	row
+ * @param col	column
+ * @return		this(row, col)
+ */
+const float& MatrixView::operator()(int row, int col) const
+{
+	if (row < 0 || row >= this->_dims.rows || col < 0 || col >= this->_dims.cols)
+	{
+		std::cerr << INVALID_INPUT_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return this->_data[row * this->_ld + col];
+}
+
+/**
+ * Matrix multiplication
+ * @param lhs	MatrixView
+ * @param rhs	MatrixView
+ * @return		Matrix
+ */
+Matrix operator*(const MatrixView& lhs, const MatrixView& rhs)
+{
+	if (lhs._dims.cols != rhs._dims.rows)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	Matrix result = Matrix::uninitialized(lhs._dims.rows, rhs._dims.cols);
+	gemm(lhs._dims.rows, rhs._dims.cols, lhs._dims.cols, lhs._data, lhs._ld, rhs._data, rhs._ld,
+		 result.data(), result.getCols());
+	return result;
+}
+
+/**
+ * Matrix multiplication on transposed operands, op(lhs) * op(rhs), reading a
+ * transposed operand in place instead of copying its transpose first
+ * @param lhs	MatrixView
+ * @param lhsOp	how lhs is read
+ * @param rhs	MatrixView
+ * @param rhsOp	how rhs is read
+ * @return		Matrix
+ */
+Matrix multiply(const MatrixView& lhs, GemmOperand lhsOp, const MatrixView& rhs, GemmOperand rhsOp)
+{
+	const int rows = lhsOp == GemmNormal ? lhs._dims.rows : lhs._dims.cols;
+	const int depth = lhsOp == GemmNormal ? lhs._dims.cols : lhs._dims.rows;
+	const int cols = rhsOp == GemmNormal ? rhs._dims.cols : rhs._dims.rows;
+	if (depth != (rhsOp == GemmNormal ? rhs._dims.rows : rhs._dims.cols))
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	Matrix result = Matrix::uninitialized(rows, cols);
+	gemm(lhsOp, rhsOp, rows, cols, depth, lhs._data, lhs._ld, rhs._data, rhs._ld, result.data(), result.getCols());
+	return result;
+}
+
+/**
+ * Matrix addition
+ * @param lhs	MatrixView
+ * @param rhs	MatrixView
+ * @return		Matrix
+ */
+Matrix operator+(const MatrixView& lhs, const MatrixView& rhs)
+{
+	if (lhs._dims.rows != rhs._dims.rows || lhs._dims.cols != rhs._dims.cols)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	Matrix result = Matrix::uninitialized(lhs._dims.rows, lhs._dims.cols);
+	const KernelTable& table = kernels();
+	if (lhs.isContiguous() && rhs.isContiguous())
+	{
+		table.add(lhs._data, rhs._data, result.data(), lhs._dims.rows * lhs._dims.cols);
+		return result;
+	}
+	for (int row = 0; row < lhs._dims.rows; ++row)
+	{
+		table.add(lhs._data + row * lhs._ld, rhs._data + row * rhs._ld,
+				  result.data() + row * lhs._dims.cols, lhs._dims.cols);
+	}
+	return result;
+}
@@ -0,0 +1,176 @@
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+#include "Matrix.h"
+#include "Gemm.h"
+
+/**
+ * Class MatrixView
+ * Non-owning, read-only window on row-major float data.
+ * Rows are ld floats apart, so a view can be a whole Matrix, a reshape of it,
+ * a block of rows, a single column or a range of batch columns, all without copying.
+ * The viewed buffer must outlive the view.
+ */
+class MatrixView
+{
+ private:
+	/**
+	 * First element
+	 */
+	const float* _data;
+
+	/**
+	 * View dimensions
+	 */
+	MatrixDims _dims;
+
+	/**
+	 * Leading dimension, distance in floats between rows
+	 */
+	int _ld;
+ public:
+	/**
+	 * Constructs a view on raw data
+	 * @param data	first element
+	 * @param rows	rows
+	 * @param cols	cols
+	 * @param ld	distance in floats between rows, at least cols
+	 */
+	MatrixView(const float* data, int rows, int cols, int ld);
+
+	/**
+	 * Constructs a view on a whole matrix
+	 * @param matrix	Matrix
+	 */
+	MatrixView(const Matrix& matrix);
+
+	/**
+	 * returns the amount of rows as int
+	 * @return	amount of rows as int
+	 */
+	int getRows() const;
+
+	/**
+	 * returns the amount of cols as int
+	 * @return	amount of cols as int
+	 */
+	int getCols() const;
+
+	/**
+	 * returns the leading dimension
+	 * @return	distance in floats between rows
+	 */
+	int getLd() const;
+
+	/**
+	 * Returns the first element
+	 * @return	float array
+	 */
+	const float* data() const;
+
+	/**
+	 * Returns whether the rows are stored back to back
+	 * @return	true if the view covers rows * cols consecutive floats
+	 */
+	bool isContiguous() const;
+
+	/**
+	 * Reinterprets a contiguous view with other dims of the same size
+	 * @param rows	rows
+	 * @param cols	cols
+	 * @return		MatrixView
+	 */
+	MatrixView reshape(int rows, int cols) const;
+
+	/**
+	 * Reinterprets a contiguous view as a column vector
+	 * @return	MatrixView
+	 */
+	MatrixView vectorize() const;
+
+	/**
+	 * Sub-block of the view
+	 * @param row	first row
+	 * @param col	first col
+	 * @param rows	rows
+	 * @param cols	cols
+	 * @return		MatrixView
+	 */
+	MatrixView block(int row, int col, int rows, int cols) const;
+
+	/**
+	 * Consecutive rows
+	 * @param first	first row
+	 * @param count	rows
+	 * @return		MatrixView
+	 */
+	MatrixView rowRange(int first, int count) const;
+
+	/**
+	 * Consecutive cols, e.g. a sub-batch of a batch with one sample per column
+	 * @param first	first col
+	 * @param count	cols
+	 * @return		MatrixView
+	 */
+	MatrixView colRange(int first, int count) const;
+
+	/**
+	 * A single column, as a strided column vector
+	 * @param col	col
+	 * @return		MatrixView
+	 */
+	MatrixView column(int col) const;
+
+	/**
+	 * Copies the transpose of the view
+	 * @return	Matrix, cols x rows
+	 */
+	Matrix transposed() const;
+
+	/**
+	 * Parenthesis indexing
+	 * @param row	row
+	 * @param col	column
+	 * @return		this(row, col)
+	 */
+	const float& operator()(int row, int col) const;
+
+	/**
+	 * Matrix multiplication
+	 * @param lhs	MatrixView
+	 * @param rhs	MatrixView
+	 * @return		Matrix
+	 */
+	friend Matrix operator*(const MatrixView& lhs, const MatrixView& rhs);
+
+	/**
+	 * Matrix multiplication on transposed operands, op(lhs) * op(rhs), reading a
+	 * transposed operand in place instead of copying its transpose first
+	 * @param lhs	MatrixView
+	 * @param lhsOp	how lhs is read
+	 * @param rhs	MatrixView
+	 * @param rhsOp	how rhs is read
+	 * @return		Matrix
+	 */
+	friend Matrix multiply(const MatrixView& lhs, GemmOperand lhsOp, const MatrixView& rhs, GemmOperand rhsOp);
+
+	/**
+	 * Matrix addition
+	 * @param lhs	MatrixView
+	 * @param rhs	MatrixView
+	 * @return		Matrix
+	 */
+	friend Matrix operator+(const MatrixView& lhs, const MatrixView& rhs);
+};
+
+/**
+ * Matrix multiplication on transposed operands, see MatrixView
+ * @param lhs	MatrixView
+ * @param lhsOp	how lhs is read
+ * @param rhs	MatrixView
+ * @param rhsOp	how rhs is read
+ * @return		Matrix
+ */
+Matrix multiply(const MatrixView& lhs, GemmOperand lhsOp, const MatrixView& rhs, GemmOperand rhsOp);
+
+#endif
@@ -1,7 +1,75 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
 #include "MlpNetwork.h"
+#include "Profiler.h"
 
 #define DEFAULT_VALUE 0
-#define RESULT_VECTOR_SIZE 10
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+#define PACK_BAND_ROWS 16
+
+/**
+ * Constructs buffers of width floats each
+ * @param width	Widest layer output of the networks to run
+ */
+MlpWorkspace::MlpWorkspace(int width) : _buffers{ Matrix(width, 1), Matrix(width, 1) }
+{
+}
+
+/**
+ * Returns the floats per buffer
+ * @return	width
+ */
+int MlpWorkspace::getWidth() const
+{
+	return this->_buffers[0].getRows();
+}
+
+/**
+ * Returns one buffer
+ * @param index	0 .. MLP_PING_PONG - 1
+ * @return		getWidth() floats
+ */
+float* MlpWorkspace::buffer(int index)
+{
+	return this->_buffers[index].data();
+}
+
+/**
+ * Builds the MLP_SIZE layers of the fixed architecture, relu then a softmax output,
+ * emplaced into reserved storage so each parameter is copied once
+ * @param weights	Weights array
+ * @param biases	Biases array
+ * @return			Layers, input first
+ */
+static std::vector<Dense> makeLayers(const Matrix* weights, const Matrix* biases)
+{
+	std::vector<Dense> layers;
+	layers.reserve(MLP_SIZE);
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		layers.emplace_back(weights[i], biases[i], i + 1 < MLP_SIZE ? Relu : Softmax);
+	}
+	return layers;
+}
+
+/**
+ * Builds the MLP_SIZE layers over borrowed views of the parameters. Emplaced into
+ * reserved storage: a layer copied out of an initializer list would deep-copy them.
+ * @param weights	Weights views array, contiguous
+ * @param biases	Biases views array, contiguous
+ * @return			Layers, input first
+ */
+static std::vector<Dense> borrowLayers(const MatrixView* weights, const MatrixView* biases)
+{
+	std::vector<Dense> layers;
+	layers.reserve(MLP_SIZE);
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		layers.emplace_back(Matrix::borrow(weights[i]), Matrix::borrow(biases[i]), i + 1 < MLP_SIZE ? Relu : Softmax);
+	}
+	return layers;
+}
 
 /**
  * Constructor
@@ -9,14 +77,105 @@
  * @param weights	Weights array
  * @param biases	Biases array
  */
-MlpNetwork::MlpNetwork(const Matrix* weights, const Matrix* biases) :
-	_l1(Dense(weights[0], biases[0], Relu)),
-	_l2(Dense(weights[1], biases[1], Relu)),
-	_l3(Dense(weights[2], biases[2], Relu)),
-	_l4(Dense(weights[3], biases[3], Softmax))
+MlpNetwork::MlpNetwork(const Matrix* weights, const Matrix* biases) : MlpNetwork(makeLayers(weights, biases))
 {
 }
 
+/**
+ * Constructor
+ * Borrows the parameters without copying them, e.g. from mmapped files.
+ * The viewed storage must outlive the network.
+ * @param weights	Weights views array, contiguous
+ * @param biases	Biases views array, contiguous
+ */
+MlpNetwork::MlpNetwork(const MatrixView* weights, const MatrixView* biases) :
+	MlpNetwork(borrowLayers(weights, biases))
+{
+}
+
+/**
+ * Constructor
+ * Takes over layers of any depth, e.g. from loadModel, and plans the buffers.
+ * Exits (code == 1) if there is no layer or a layer's input does not match
+ * the previous layer's output.
+ * @param layers	Layers, input first
+ */
+MlpNetwork::MlpNetwork(std::vector<Dense>&& layers) : _layers(std::move(layers)), _widest(0), _softmaxOutput(false)
+{
+	if (this->_layers.empty())
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < this->_layers.size(); ++i)
+	{
+		const Matrix& weights = this->_layers[i].getWeights();
+		if (i > 0 && weights.getCols() != this->_layers[i - 1].getWeights().getRows())
+		{
+			std::cerr << SIZE_ERROR << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		this->_widest = std::max(this->_widest, weights.getRows());
+	}
+	this->_softmaxOutput = this->_layers.back().getActivation().getActivationType() == Softmax;
+}
+
+/**
+ * Returns the layers
+ * @return	Layers, input first
+ */
+const std::vector<Dense>& MlpNetwork::getLayers() const
+{
+	return this->_layers;
+}
+
+/**
+ * Returns the input length
+ * @return	inputs
+ */
+int MlpNetwork::getInputs() const
+{
+	return this->_layers.front().getWeights().getCols();
+}
+
+/**
+ * Floating point operations of one pass over every layer
+ * @param batch	samples
+ * @return		FLOPs
+ */
+double MlpNetwork::flops(int batch) const
+{
+	double flops = 0;
+	for (const Dense& layer : this->_layers)
+	{
+		flops += layer.flops(batch);
+	}
+	return flops;
+}
+
+/**
+ * Bytes of weights and biases one pass reads
+ * @return	bytes
+ */
+double MlpNetwork::weightBytes() const
+{
+	double bytes = 0;
+	for (const Dense& layer : this->_layers)
+	{
+		bytes += layer.weightBytes();
+	}
+	return bytes;
+}
+
+/**
+ * Returns a workspace this network fits in
+ * @return	MlpWorkspace
+ */
+MlpWorkspace MlpNetwork::makeWorkspace() const
+{
+	return MlpWorkspace(this->_widest);
+}
+
 /**
  * Parenthesis operator override,
  * Applies the entire network on input
@@ -24,24 +183,290 @@ MlpNetwork::MlpNetwork(const Matrix* weights, const Matrix* biases) :
  * @return		Digit
  */
 Digit MlpNetwork::operator()(const Matrix& img) const
+{
+	return (*this)(MatrixView(img).vectorize());
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the entire network on a view of the input
+ * @param img	Image view, a column vector
+ * @return		Digit
+ */
+Digit MlpNetwork::operator()(const MatrixView& img) const
+{
+	return (*this)(img, this->_threadWorkspace());
+}
+
+/**
+ * The calling thread's workspace, grown to fit this network
+ * @return	MlpWorkspace
+ */
+MlpWorkspace& MlpNetwork::_threadWorkspace() const
+{
+	// one workspace per thread, only grows: steady state passes allocate nothing
+	static thread_local MlpWorkspace workspace;
+	if (workspace.getWidth() < this->_widest)
+	{
+		workspace = this->makeWorkspace();
+	}
+	return workspace;
+}
+
+/**
+ * Runs every layer on one sample through the workspace buffers, the output layer
+ * stopping at its logits when it is a softmax.
+ * Exits (code == 1) if the workspace is narrower than the widest layer.
+ * @param img		Image view, a column vector
+ * @param workspace	MlpWorkspace
+ * @return			output layer values, in a workspace buffer
+ */
+const float* MlpNetwork::_forward(const MatrixView& img, MlpWorkspace& workspace) const
+{
+	if (workspace.getWidth() < this->_widest || img.getCols() != 1)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	PROFILE_SCOPE(this, "network", this->_layers.back().getWeights().getRows(), this->getInputs(), this->flops(1),
+				  this->weightBytes());
+
+	MatrixView input = img;
+	for (size_t i = 0; i < this->_layers.size(); ++i)
+	{
+		float* output = workspace.buffer((int) (i % MLP_PING_PONG));
+		const int rows = this->_layers[i].getWeights().getRows();
+		this->_layers[i].forward(input, output, i + 1 < this->_layers.size() || !this->_softmaxOutput);
+		input = MatrixView(output, rows, 1, 1);
+	}
+	return input.data();
+}
+
+/**
+ * Applies the entire network on a view of the input, alternating between the
+ * workspace buffers: allocates nothing.
+ * A softmax output layer is never normalized: the digit is the argmax of its logits
+ * and only the winner's probability is computed, from their log-sum-exp.
+ * Exits (code == 1) if the workspace is narrower than the widest layer.
+ * @param img		Image view, a column vector
+ * @param workspace	MlpWorkspace, e.g. from makeWorkspace
+ * @return			Digit
+ */
+Digit MlpNetwork::operator()(const MatrixView& img, MlpWorkspace& workspace) const
+{
+	const int classes = this->_layers.back().getWeights().getRows();
+	const MatrixView output(this->_forward(img, workspace), classes, 1, 1);
+	if (!this->_softmaxOutput)
+	{
+		return mostProbable(output, 0);
+	}
+	float logSumExp = 0;
+	Activation::logSumExp(output.data(), &logSumExp, classes, 1, SoftmaxColumns);
+	return mostProbableLogit(output, 0, logSumExp);
+}
+
+/**
+ * Ranks the k most probable classes of one image
+ * @param img	Image matrix
+ * @param k		classes to return, at most the output width
+ * @return		ClassScore per class, most probable first
+ */
+std::vector<ClassScore> MlpNetwork::topK(const Matrix& img, int k) const
+{
+	return this->topK(MatrixView(img).vectorize(), k);
+}
+
+/**
+ * Ranks the k most probable classes of one image, from the output layer logits.
+ * Without a softmax output layer the probabilities are the output values themselves.
+ * @param img	Image view, a column vector
+ * @param k		classes to return, at most the output width
+ * @return		ClassScore per class, most probable first
+ */
+std::vector<ClassScore> MlpNetwork::topK(const MatrixView& img, int k) const
+{
+	const int classes = this->_layers.back().getWeights().getRows();
+	const float* output = this->_forward(img, this->_threadWorkspace());
+	float logSumExp = 0;
+	if (this->_softmaxOutput)
+	{
+		Activation::logSumExp(output, &logSumExp, classes, 1, SoftmaxColumns);
+	}
+
+	std::vector<ClassScore> scores(classes);
+	for (int i = 0; i < classes; ++i)
+	{
+		scores[i].value = i;
+		scores[i].logit = output[i];
+		scores[i].probability = this->_softmaxOutput ? std::exp(output[i] - logSumExp) : output[i];
+	}
+	k = std::max(0, std::min(k, classes));
+	std::partial_sort(scores.begin(), scores.begin() + k, scores.end(),
+					  [](const ClassScore& lhs, const ClassScore& rhs)
+					  {
+						  return lhs.logit > rhs.logit || (lhs.logit == rhs.logit && lhs.value < rhs.value);
+					  });
+	scores.resize(k);
+	return scores;
+}
+
+/**
+ * Classifies n images at once.
+ * Packs them as the columns of one matrix so every layer is a single GEMM
+ * and each weight is loaded once for the whole batch.
+ * @param images	Images array, getInputs() elements each (any shape)
+ * @param n			Number of images, > 0
+ * @return			Digit per image, in order
+ */
+std::vector<Digit> MlpNetwork::classifyBatch(const Matrix images[], int n) const
+{
+	Matrix batch = Matrix::uninitialized(this->getInputs(), n);
+	this->packBatch(images, n, batch);
+	return this->classifyBatch(MatrixView(batch));
+}
+
+/**
+ * Packs n images as the columns of batch, reusing its storage when it already
+ * has n columns, e.g. a worker's scratch buffer
+ * Exits (code == 1) if an image does not have getInputs() elements.
+ * @param images	Images array, getInputs() elements each (any shape)
+ * @param n			Number of images, > 0
+ * @param batch		Receives the packed images, getInputs() elements x n
+ */
+void MlpNetwork::packBatch(const Matrix images[], int n, Matrix& batch) const
+{
+	const int imgSize = this->getInputs();
+	if (batch.getRows() != imgSize || batch.getCols() != n)
+	{
+		batch = Matrix::uninitialized(imgSize, n);
+	}
+	this->packBatch(images, n, batch.data(), n);
+}
+
+/**
+ * Packs n images as the first n columns of caller storage, e.g. a narrower view of
+ * a scratch buffer sized for full batches
+ * Exits (code == 1) if an image does not have getInputs() elements.
+ * @param images	Images array, getInputs() elements each (any shape)
+ * @param n			Number of images, > 0
+ * @param batch		getInputs() rows of ld floats, row-major
+ * @param ld		Floats per row of batch, >= n
+ */
+void MlpNetwork::packBatch(const Matrix images[], int n, float* batch, int ld) const
+{
+	const int imgSize = this->getInputs();
+	if (n <= 0 || ld < n)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	for (int col = 0; col < n; ++col)
+	{
+		if (images[col].getRows() * images[col].getCols() != imgSize)
+		{
+			std::cerr << SIZE_ERROR << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// transpose in bands of rows so the written lines stay in L1 across images
+	for (int first = 0; first < imgSize; first += PACK_BAND_ROWS)
+	{
+		const int last = std::min(first + PACK_BAND_ROWS, imgSize);
+		for (int col = 0; col < n; ++col)
+		{
+			const float* pixels = images[col].data();
+			for (int row = first; row < last; ++row)
+			{
+				batch[row * ld + col] = pixels[row];
+			}
+		}
+	}
+}
+
+/**
+ * Classifies an already packed batch
+ * @param batch		View with one image per column
+ * @return			Digit per column, in order
+ */
+std::vector<Digit> MlpNetwork::classifyBatch(const MatrixView& batch) const
+{
+	// the output layer stops at its logits when it is a softmax, as a single image does
+	const size_t last = this->_layers.size() - 1;
+	Matrix matrix(this->_layers[0].getWeights().getRows(), batch.getCols());
+	this->_layers[0].forward(batch, matrix.data(), last > 0 || !this->_softmaxOutput);
+	for (size_t i = 1; i <= last; ++i)
+	{
+		Matrix output(this->_layers[i].getWeights().getRows(), batch.getCols());
+		this->_layers[i].forward(MatrixView(matrix), output.data(), i < last || !this->_softmaxOutput);
+		matrix = std::move(output);
+	}
+
+	std::vector<float> logSumExps(this->_softmaxOutput ? matrix.getCols() : 0);
+	if (this->_softmaxOutput)
+	{
+		Activation::logSumExp(matrix.data(), logSumExps.data(), matrix.getRows(), matrix.getCols(), SoftmaxColumns);
+	}
+	std::vector<Digit> digits;
+	digits.reserve(matrix.getCols());
+	for (int col = 0; col < matrix.getCols(); ++col)
+	{
+		digits.push_back(this->_softmaxOutput ? mostProbableLogit(matrix, col, logSumExps[col]) :
+						 mostProbable(matrix, col));
+	}
+	return digits;
+}
+
+/**
+ * Picks the most probable class of one sample
+ * @param probabilities	Output layer result, one sample per column
+ * @param col			Sample
+ * @return				Digit
+ */
+Digit MlpNetwork::mostProbable(const MatrixView& probabilities, int col)
 {
 	Digit digit;
 	digit.probability = DEFAULT_VALUE;
 	digit.value = DEFAULT_VALUE;
 
-	Matrix matrix = Matrix(img);
-	matrix = this->_l1(matrix);
-	matrix = this->_l2(matrix);
-	matrix = this->_l3(matrix);
-	matrix = this->_l4(matrix);
+	const int ld = probabilities.getLd();
+	const float* values = probabilities.data() + col;
+	for (int i = 0; i < probabilities.getRows(); ++i)
+	{
+		if (values[i * ld] > digit.probability)
+		{
+			digit.probability = values[i * ld];
+			digit.value = i;
+		}
+	}
+	return digit;
+}
 
-	for (int i = 0; i < RESULT_VECTOR_SIZE; ++i)
+/**
+ * Picks the most probable class of one sample from softmax logits,
+ * its probability exp(logit - logSumExp)
+ * @param logits		Output layer logits, one sample per column
+ * @param col			Sample
+ * @param logSumExp		log-sum-exp of the sample's logits, see Activation::logSumExp
+ * @return				Digit
+ */
+Digit MlpNetwork::mostProbableLogit(const MatrixView& logits, int col, float logSumExp)
+{
+	// logits may all be negative, the scan starts from the first one
+	const int ld = logits.getLd();
+	const float* values = logits.data() + col;
+	Digit digit;
+	digit.value = 0;
+	float max = values[0];
+	for (int i = 1; i < logits.getRows(); ++i)
 	{
-		if (matrix[i] > digit.probability)
+		if (values[i * ld] > max)
 		{
-			digit.probability = matrix[i];
+			max = values[i * ld];
 			digit.value = i;
 		}
 	}
+	digit.probability = std::exp(max - logSumExp);
 	return digit;
 }
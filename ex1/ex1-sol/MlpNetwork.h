@@ -1,7 +1,9 @@
 #ifndef MLPNETWORK_H
 #define MLPNETWORK_H
 
+#include <vector>
 #include "Matrix.h"
+#include "MatrixView.h"
 #include "Digit.h"
 #include "Dense.h"
 
@@ -11,28 +13,101 @@ const MatrixDims imgDims = { 28, 28 };
 const MatrixDims weightsDims[] = {{ 128, 784 }, { 64, 128 }, { 20, 64 }, { 10, 20 }};
 const MatrixDims biasDims[] = {{ 128, 1 }, { 64, 1 }, { 20, 1 }, { 10, 1 }};
 
+/**
+ * @struct ClassScore
+ * @brief One class of a top-k ranking
+ * @var value - class index
+ * @var logit - output layer value before its softmax
+ * @var probability - softmax probability of the class
+ */
+typedef struct ClassScore
+{
+	unsigned int value;
+	float logit;
+	float probability;
+} ClassScore;
+
+/**
+ * Activation buffers a forward pass alternates between
+ */
+#define MLP_PING_PONG 2
+
+/**
+ * Class MlpWorkspace
+ * The ping-pong activation buffers of forward passes: layer i writes buffer i % 2
+ * and reads the other one. Not shared between threads.
+ */
+class MlpWorkspace
+{
+ private:
+	/**
+	 * Buffers, width x 1 each
+	 */
+	Matrix _buffers[MLP_PING_PONG];
+
+ public:
+	/**
+	 * Constructs an empty workspace, fits no network
+	 */
+	MlpWorkspace() = default;
+
+	/**
+	 * Constructs buffers of width floats each
+	 * @param width	Widest layer output of the networks to run
+	 */
+	explicit MlpWorkspace(int width);
+
+	/**
+	 * Returns the floats per buffer
+	 * @return	width
+	 */
+	int getWidth() const;
+
+	/**
+	 * Returns one buffer
+	 * @param index	0 .. MLP_PING_PONG - 1
+	 * @return		getWidth() floats
+	 */
+	float* buffer(int index);
+};
+
 /**
  * MlpNetwork class
+ * A sequence of dense layers of any length, input first
  */
 class MlpNetwork
 {
  private:
 	/**
-	 * First layer
+	 * Layers, input first
+	 */
+	std::vector<Dense> _layers;
+
+	/**
+	 * Buffer plan: the widest layer output, the size of each workspace buffer
 	 */
-	Dense _l1;
+	int _widest;
+
 	/**
-	 * Second layer
+	 * Whether the output layer is a softmax, classified from its logits
 	 */
-	Dense _l2;
+	bool _softmaxOutput;
+
 	/**
-	 * Third layer
+	 * Runs every layer on one sample through the workspace buffers, the output layer
+	 * stopping at its logits when it is a softmax.
+	 * Exits (code == 1) if the workspace is narrower than the widest layer.
+	 * @param img		Image view, a column vector
+	 * @param workspace	MlpWorkspace
+	 * @return			output layer values, in a workspace buffer
 	 */
-	Dense _l3;
+	const float* _forward(const MatrixView& img, MlpWorkspace& workspace) const;
+
 	/**
-	 * Forth layer
+	 * The calling thread's workspace, grown to fit this network
+	 * @return	MlpWorkspace
 	 */
-	Dense _l4;
+	MlpWorkspace& _threadWorkspace() const;
 
  public:
 	/**
@@ -42,6 +117,56 @@ class MlpNetwork
 	 * @param biases	Biases array
 	 */
 	MlpNetwork(const Matrix weights[MLP_SIZE], const Matrix biases[MLP_SIZE]);
+
+	/**
+	 * Constructor
+	 * Borrows the parameters without copying them, e.g. from mmapped files.
+	 * The viewed storage must outlive the network.
+	 * @param weights	Weights views array, contiguous
+	 * @param biases	Biases views array, contiguous
+	 */
+	MlpNetwork(const MatrixView weights[MLP_SIZE], const MatrixView biases[MLP_SIZE]);
+
+	/**
+	 * Constructor
+	 * Takes over layers of any depth, e.g. from loadModel, and plans the buffers.
+	 * Exits (code == 1) if there is no layer or a layer's input does not match
+	 * the previous layer's output.
+	 * @param layers	Layers, input first
+	 */
+	explicit MlpNetwork(std::vector<Dense>&& layers);
+
+	/**
+	 * Returns the layers
+	 * @return	Layers, input first
+	 */
+	const std::vector<Dense>& getLayers() const;
+
+	/**
+	 * Returns the input length
+	 * @return	inputs
+	 */
+	int getInputs() const;
+
+	/**
+	 * Floating point operations of one pass over every layer
+	 * @param batch	samples
+	 * @return		FLOPs
+	 */
+	double flops(int batch) const;
+
+	/**
+	 * Bytes of weights and biases one pass reads
+	 * @return	bytes
+	 */
+	double weightBytes() const;
+
+	/**
+	 * Returns a workspace this network fits in
+	 * @return	MlpWorkspace
+	 */
+	MlpWorkspace makeWorkspace() const;
+
 	/**
 	 * Parenthesis operator override,
 	 * Applies the entire network on input
@@ -49,6 +174,99 @@ class MlpNetwork
 	 * @return		Digit
 	 */
 	Digit operator()(const Matrix& img) const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the entire network on a view of the input
+	 * @param img	Image view, a column vector
+	 * @return		Digit
+	 */
+	Digit operator()(const MatrixView& img) const;
+
+	/**
+	 * Applies the entire network on a view of the input, alternating between the
+	 * workspace buffers: allocates nothing.
+	 * A softmax output layer is never normalized: the digit is the argmax of its logits
+	 * and only the winner's probability is computed, from their log-sum-exp.
+	 * Exits (code == 1) if the workspace is narrower than the widest layer.
+	 * @param img		Image view, a column vector
+	 * @param workspace	MlpWorkspace, e.g. from makeWorkspace
+	 * @return			Digit
+	 */
+	Digit operator()(const MatrixView& img, MlpWorkspace& workspace) const;
+
+	/**
+	 * Ranks the k most probable classes of one image
+	 * @param img	Image matrix
+	 * @param k		classes to return, at most the output width
+	 * @return		ClassScore per class, most probable first
+	 */
+	std::vector<ClassScore> topK(const Matrix& img, int k) const;
+
+	/**
+	 * Ranks the k most probable classes of one image, from the output layer logits.
+	 * Without a softmax output layer the probabilities are the output values themselves.
+	 * @param img	Image view, a column vector
+	 * @param k		classes to return, at most the output width
+	 * @return		ClassScore per class, most probable first
+	 */
+	std::vector<ClassScore> topK(const MatrixView& img, int k) const;
+
+	/**
+	 * Classifies n images at once.
+	 * Packs them as the columns of one matrix so every layer is a single GEMM
+	 * and each weight is loaded once for the whole batch.
+	 * @param images	Images array, getInputs() elements each (any shape)
+	 * @param n			Number of images, > 0
+	 * @return			Digit per image, in order
+	 */
+	std::vector<Digit> classifyBatch(const Matrix images[], int n) const;
+
+	/**
+	 * Classifies an already packed batch
+	 * @param batch		View with one image per column
+	 * @return			Digit per column, in order
+	 */
+	std::vector<Digit> classifyBatch(const MatrixView& batch) const;
+
+	/**
+	 * Packs n images as the columns of batch, reusing its storage when it already
+	 * has n columns, e.g. a worker's scratch buffer
+	 * Exits (code == 1) if an image does not have getInputs() elements.
+	 * @param images	Images array, getInputs() elements each (any shape)
+	 * @param n			Number of images, > 0
+	 * @param batch		Receives the packed images, getInputs() elements x n
+	 */
+	void packBatch(const Matrix images[], int n, Matrix& batch) const;
+
+	/**
+	 * Packs n images as the first n columns of caller storage, e.g. a narrower view of
+	 * a scratch buffer sized for full batches
+	 * Exits (code == 1) if an image does not have getInputs() elements.
+	 * @param images	Images array, getInputs() elements each (any shape)
+	 * @param n			Number of images, > 0
+	 * @param batch		getInputs() rows of ld floats, row-major
+	 * @param ld		Floats per row of batch, >= n
+	 */
+	void packBatch(const Matrix images[], int n, float* batch, int ld) const;
+
+	/**
+	 * Picks the most probable class of one sample
+	 * @param probabilities	Output layer result, one sample per column
+	 * @param col			Sample
+	 * @return				Digit
+	 */
+	static Digit mostProbable(const MatrixView& probabilities, int col);
+
+	/**
+	 * Picks the most probable class of one sample from softmax logits,
+	 * its probability exp(logit - logSumExp)
+	 * @param logits		Output layer logits, one sample per column
+	 * @param col			Sample
+	 * @param logSumExp		log-sum-exp of the sample's logits, see Activation::logSumExp
+	 * @return				Digit
+	 */
+	static Digit mostProbableLogit(const MatrixView& logits, int col, float logSumExp);
 };
 
 #endif
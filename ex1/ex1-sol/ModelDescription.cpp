@@ -0,0 +1,136 @@
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include "ModelDescription.h"
+
+#define PATH_SEPARATOR '/'
+
+/**
+ * Resolves a parameter path against the description's directory
+ * @param descriptionPath	description path
+ * @param path				path as written in the description
+ * @return					path usable from the working directory
+ */
+static std::string resolvePath(const std::string& descriptionPath, const std::string& path)
+{
+	const size_t separator = descriptionPath.rfind(PATH_SEPARATOR);
+	if (path.empty() || path[0] == PATH_SEPARATOR || separator == std::string::npos)
+	{
+		return path;
+	}
+	return descriptionPath.substr(0, separator + 1) + path;
+}
+
+/**
+ * Reads a raw float file into a matrix of matching size
+ * @param filePath	path
+ * @param matrix	Matrix, its dims give the expected size
+ * @return			false if the file is missing or has another size
+ */
+static bool readParameters(const std::string& filePath, Matrix& matrix)
+{
+	std::ifstream is(filePath, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!is.is_open() || is.tellg() != (long) matrix.getRows() * matrix.getCols() * (long) sizeof(float))
+	{
+		return false;
+	}
+	is.seekg(0, std::ios_base::beg);
+	is.read(reinterpret_cast<char*>(matrix.data()), (long) matrix.getRows() * matrix.getCols() * (long) sizeof(float));
+	return is.good();
+}
+
+/**
+ * Parses a model description: a text file with one layer per line, input first,
+ *     weights-file bias-file rows cols relu|softmax
+ * Blank lines and lines starting with MODEL_COMMENT are skipped, relative
+ * parameter paths are relative to the description's directory.
+ * @param filePath	description path
+ * @param layers	receives the layers, input first
+ * @return			false if the file is missing, malformed or describes no layer
+ */
+bool readModelDescription(const std::string& filePath, std::vector<LayerDescription>& layers)
+{
+	std::ifstream is(filePath);
+	if (!is.is_open())
+	{
+		return false;
+	}
+
+	std::vector<LayerDescription> parsed;
+	std::string line;
+	while (std::getline(is, line))
+	{
+		std::istringstream fields(line);
+		std::string first;
+		if (!(fields >> first) || first[0] == MODEL_COMMENT)
+		{
+			continue;
+		}
+
+		LayerDescription layer;
+		std::string activation;
+		std::string extra;
+		layer.weightsPath = resolvePath(filePath, first);
+		if (!(fields >> layer.biasPath >> layer.dims.rows >> layer.dims.cols >> activation) || (fields >> extra) ||
+			layer.dims.rows <= 0 || layer.dims.cols <= 0)
+		{
+			return false;
+		}
+		layer.biasPath = resolvePath(filePath, layer.biasPath);
+		if (activation == MODEL_RELU)
+		{
+			layer.activation = Relu;
+		}
+		else if (activation == MODEL_SOFTMAX)
+		{
+			layer.activation = Softmax;
+		}
+		else
+		{
+			return false;
+		}
+
+		// every layer consumes the previous one's outputs
+		if (!parsed.empty() && parsed.back().dims.rows != layer.dims.cols)
+		{
+			return false;
+		}
+		parsed.push_back(layer);
+	}
+	if (parsed.empty() || is.bad())
+	{
+		return false;
+	}
+	layers = std::move(parsed);
+	return true;
+}
+
+/**
+ * Reads a model description and the parameter files it names
+ * @param filePath	description path
+ * @param layers	receives the layers, input first
+ * @return			false if the description or a parameter file is invalid
+ */
+bool loadModel(const std::string& filePath, std::vector<Dense>& layers)
+{
+	std::vector<LayerDescription> descriptions;
+	if (!readModelDescription(filePath, descriptions))
+	{
+		return false;
+	}
+
+	std::vector<Dense> loaded;
+	loaded.reserve(descriptions.size());
+	for (const LayerDescription& description : descriptions)
+	{
+		Matrix weights(description.dims.rows, description.dims.cols);
+		Matrix bias(description.dims.rows, 1);
+		if (!(readParameters(description.weightsPath, weights) && readParameters(description.biasPath, bias)))
+		{
+			return false;
+		}
+		loaded.emplace_back(std::move(weights), std::move(bias), description.activation);
+	}
+	layers = std::move(loaded);
+	return true;
+}
@@ -0,0 +1,56 @@
+#ifndef MODEL_DESCRIPTION_H
+#define MODEL_DESCRIPTION_H
+
+#include <string>
+#include <vector>
+#include "Matrix.h"
+#include "Activation.h"
+#include "Dense.h"
+
+/**
+ * Starts a comment line in a model description
+ */
+#define MODEL_COMMENT '#'
+
+/**
+ * Activation names in a model description
+ */
+#define MODEL_RELU "relu"
+#define MODEL_SOFTMAX "softmax"
+
+/**
+ * @struct LayerDescription
+ * @brief One line of a model description
+ * @var weightsPath - raw float weights, rows * cols, row-major
+ * @var biasPath - raw float biases, rows
+ * @var dims - weights dims: outputs x inputs
+ * @var activation - activation applied to the outputs
+ */
+typedef struct LayerDescription
+{
+	std::string weightsPath;
+	std::string biasPath;
+	MatrixDims dims;
+	ActivationType activation;
+} LayerDescription;
+
+/**
+ * Parses a model description: a text file with one layer per line, input first,
+ *     weights-file bias-file rows cols relu|softmax
+ * Blank lines and lines starting with MODEL_COMMENT are skipped, relative
+ * parameter paths are relative to the description's directory.
+ * @param filePath	description path
+ * @param layers	receives the layers, input first
+ * @return			false if the file is missing, malformed or describes no layer
+ */
+bool readModelDescription(const std::string& filePath, std::vector<LayerDescription>& layers);
+
+/**
+ * Reads a model description and the parameter files it names
+ * @param filePath	description path
+ * @param layers	receives the layers, input first
+ * @return			false if the description or a parameter file is invalid
+ */
+bool loadModel(const std::string& filePath, std::vector<Dense>& layers);
+
+#endif
@@ -0,0 +1,254 @@
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include "PackedModel.h"
+
+#define CRC_POLYNOMIAL 0xEDB88320u
+#define CRC_TABLE_SIZE 256
+#define CRC_BITS 8
+#define MAGIC_BYTES 8
+
+/**
+ * Rounds an offset up to PACKED_ALIGNMENT
+ * @param offset	bytes
+ * @return			aligned offset
+ */
+static uint64_t aligned(uint64_t offset)
+{
+	return (offset + PACKED_ALIGNMENT - 1) / PACKED_ALIGNMENT * PACKED_ALIGNMENT;
+}
+
+/**
+ * Byte-wise CRC-32 lookup table
+ * @return	CRC_TABLE_SIZE entries
+ */
+static const uint32_t* crcTable()
+{
+	static const struct CrcTable
+	{
+		uint32_t entries[CRC_TABLE_SIZE];
+
+		CrcTable() : entries()
+		{
+			for (uint32_t i = 0; i < CRC_TABLE_SIZE; ++i)
+			{
+				uint32_t crc = i;
+				for (int bit = 0; bit < CRC_BITS; ++bit)
+				{
+					crc = crc & 1 ? (crc >> 1) ^ CRC_POLYNOMIAL : crc >> 1;
+				}
+				this->entries[i] = crc;
+			}
+		}
+	} table;
+	return table.entries;
+}
+
+/**
+ * CRC-32 (IEEE 802.3, as zlib) of a buffer
+ * @param data	bytes
+ * @param size	length
+ * @return		checksum
+ */
+uint32_t crc32(const void* data, size_t size)
+{
+	const uint32_t* table = crcTable();
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = table[(crc ^ bytes[i]) & 0xFFu] ^ (crc >> CRC_BITS);
+	}
+	return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * Tells whether a file starts like a packed model
+ * @param filePath	path
+ * @return			true if it starts with PACKED_FILE_MAGIC
+ */
+bool isPackedModel(const std::string& filePath)
+{
+	std::ifstream is(filePath, std::ios::in | std::ios::binary);
+	char magic[MAGIC_BYTES] = {};
+	is.read(magic, MAGIC_BYTES);
+	return is.good() && std::strncmp(magic, PACKED_FILE_MAGIC, MAGIC_BYTES) == 0;
+}
+
+/**
+ * Writes zero bytes up to an offset
+ * @param os		stream, at most at offset
+ * @param offset	bytes from the start
+ */
+static void padTo(std::ofstream& os, uint64_t offset)
+{
+	static const char zeros[PACKED_ALIGNMENT] = {};
+	const uint64_t position = (uint64_t) os.tellp();
+	if (position < offset)
+	{
+		os.write(zeros, (long) (offset - position));
+	}
+}
+
+/**
+ * Writes layers as one packed model file
+ * @param filePath	path
+ * @param layers	Layers, input first
+ * @return			false on a write error
+ */
+bool writePackedModel(const std::string& filePath, const std::vector<Dense>& layers)
+{
+	// plan the payloads first, the headers carry their offsets
+	std::vector<PackedLayerHeader> headers;
+	uint64_t offset = aligned(sizeof(PackedFileHeader) + layers.size() * sizeof(PackedLayerHeader));
+	for (const Dense& layer : layers)
+	{
+		const Matrix& weights = layer.getWeights();
+		const Matrix& bias = layer.getBias();
+		const size_t weightsBytes = (size_t) weights.getRows() * weights.getCols() * sizeof(float);
+		const size_t biasBytes = (size_t) bias.getRows() * sizeof(float);
+		PackedLayerHeader header = {};
+		header.rows = weights.getRows();
+		header.cols = weights.getCols();
+		header.activation = layer.getActivation().getActivationType();
+		header.dtype = PackedFloat32;
+		header.weightsOffset = offset;
+		header.biasOffset = aligned(offset + weightsBytes);
+		header.weightsCrc = crc32(weights.data(), weightsBytes);
+		header.biasCrc = crc32(bias.data(), biasBytes);
+		offset = aligned(header.biasOffset + biasBytes);
+		headers.push_back(header);
+	}
+
+	PackedFileHeader fileHeader = {};
+	std::strncpy(fileHeader.magic, PACKED_FILE_MAGIC, MAGIC_BYTES);
+	fileHeader.version = PACKED_FILE_VERSION;
+	fileHeader.layerCount = (uint32_t) layers.size();
+	fileHeader.fileSize = headers.empty() ? offset : headers.back().biasOffset +
+													  (uint64_t) headers.back().rows * sizeof(float);
+
+	std::ofstream os(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	os.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+	os.write(reinterpret_cast<const char*>(headers.data()), (long) (headers.size() * sizeof(PackedLayerHeader)));
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		const PackedLayerHeader& header = headers[i];
+		padTo(os, header.weightsOffset);
+		os.write(reinterpret_cast<const char*>(layers[i].getWeights().data()),
+				 (long) ((size_t) header.rows * header.cols * sizeof(float)));
+		padTo(os, header.biasOffset);
+		os.write(reinterpret_cast<const char*>(layers[i].getBias().data()), (long) (header.rows * sizeof(float)));
+	}
+	return os.good();
+}
+
+/**
+ * Verifies one tensor of a mapped packed model
+ * @param file		mapping
+ * @param offset	payload offset
+ * @param bytes		payload length
+ * @param crc		expected CRC-32
+ * @param name		tensor name for the error, e.g. "layer 2 weights"
+ * @param error		receives what is wrong
+ * @return			false if misplaced or corrupt
+ */
+static bool verifyTensor(const MappedFile& file, uint64_t offset, uint64_t bytes, uint32_t crc,
+						 const std::string& name, std::string& error)
+{
+	if (offset % PACKED_ALIGNMENT != 0 || offset > file.size() || bytes > file.size() - offset)
+	{
+		error = name + ": payload outside the file or misaligned";
+		return false;
+	}
+	if (crc32(static_cast<const char*>(file.data()) + offset, bytes) != crc)
+	{
+		error = name + ": checksum mismatch";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Maps a packed model and verifies it, then views its tensors as layers without
+ * copying them
+ * @param filePath	path
+ * @param file		receives the mapping, must outlive the layers
+ * @param layers	receives the layers, input first, borrowing the mapped pages
+ * @param error		receives what is wrong on failure, e.g. a truncated file or
+ * 					the tensor whose checksum does not match
+ * @return			false if the file is missing, invalid or corrupt
+ */
+bool mapPackedModel(const std::string& filePath, MappedFile& file, std::vector<Dense>& layers, std::string& error)
+{
+	if (!file.open(filePath))
+	{
+		error = "unable to map the file";
+		return false;
+	}
+
+	PackedFileHeader fileHeader = {};
+	if (file.size() < sizeof(fileHeader))
+	{
+		error = "truncated header";
+		return false;
+	}
+	std::memcpy(&fileHeader, file.data(), sizeof(fileHeader));
+	if (std::strncmp(fileHeader.magic, PACKED_FILE_MAGIC, MAGIC_BYTES) != 0)
+	{
+		error = "not a packed model";
+		return false;
+	}
+	if (fileHeader.version != PACKED_FILE_VERSION)
+	{
+		error = "unsupported version " + std::to_string(fileHeader.version);
+		return false;
+	}
+	if (fileHeader.fileSize != file.size())
+	{
+		error = "truncated or extended: expected " + std::to_string(fileHeader.fileSize) + " bytes, found " +
+				std::to_string(file.size());
+		return false;
+	}
+	if (fileHeader.layerCount == 0 ||
+		fileHeader.layerCount > (file.size() - sizeof(fileHeader)) / sizeof(PackedLayerHeader))
+	{
+		error = "invalid layer count " + std::to_string(fileHeader.layerCount);
+		return false;
+	}
+
+	const char* bytes = static_cast<const char*>(file.data());
+	std::vector<Dense> mapped;
+	mapped.reserve(fileHeader.layerCount);
+	for (uint32_t i = 0; i < fileHeader.layerCount; ++i)
+	{
+		PackedLayerHeader header = {};
+		std::memcpy(&header, bytes + sizeof(fileHeader) + i * sizeof(PackedLayerHeader), sizeof(header));
+		const std::string name = "layer " + std::to_string(i + 1);
+		if (header.rows <= 0 || header.cols <= 0 || (header.activation != Relu && header.activation != Softmax) ||
+			header.dtype != PackedFloat32)
+		{
+			error = name + ": invalid shape, activation or dtype";
+			return false;
+		}
+		if (!mapped.empty() && mapped.back().getWeights().getRows() != header.cols)
+		{
+			error = name + ": input does not match the previous layer";
+			return false;
+		}
+		if (!verifyTensor(file, header.weightsOffset, (uint64_t) header.rows * header.cols * sizeof(float),
+						  header.weightsCrc, name + " weights", error) ||
+			!verifyTensor(file, header.biasOffset, (uint64_t) header.rows * sizeof(float), header.biasCrc,
+						  name + " bias", error))
+		{
+			return false;
+		}
+
+		const float* weights = reinterpret_cast<const float*>(bytes + header.weightsOffset);
+		const float* bias = reinterpret_cast<const float*>(bytes + header.biasOffset);
+		mapped.emplace_back(Matrix::borrow(MatrixView(weights, header.rows, header.cols, header.cols)),
+							Matrix::borrow(MatrixView(bias, header.rows, 1, 1)),
+							(ActivationType) header.activation);
+	}
+	layers = std::move(mapped);
+	return true;
+}
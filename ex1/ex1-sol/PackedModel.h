@@ -0,0 +1,109 @@
+#ifndef PACKED_MODEL_H
+#define PACKED_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Dense.h"
+#include "MappedFile.h"
+
+/**
+ * First bytes of a packed model file
+ */
+#define PACKED_FILE_MAGIC "MLPPACK"
+
+/**
+ * Format version written by writePackedModel
+ */
+#define PACKED_FILE_VERSION 1
+
+/**
+ * Alignment of every tensor payload from the start of the file
+ */
+#define PACKED_ALIGNMENT 64
+
+/**
+ * Element types of packed tensors
+ */
+enum PackedDtype
+{
+	PackedFloat32
+};
+
+/**
+ * @struct PackedFileHeader
+ * @brief Start of a packed model file
+ * @var magic - PACKED_FILE_MAGIC, zero padded
+ * @var version - PACKED_FILE_VERSION
+ * @var layerCount - PackedLayerHeader records that follow
+ * @var fileSize - bytes of the whole file, tells a truncated file apart
+ */
+typedef struct PackedFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t layerCount;
+	uint64_t fileSize;
+} PackedFileHeader;
+
+/**
+ * @struct PackedLayerHeader
+ * @brief One layer of a packed model file, right after the previous record
+ * @var rows - outputs
+ * @var cols - inputs
+ * @var activation - ActivationType
+ * @var dtype - PackedDtype of both tensors
+ * @var weightsOffset - rows * cols weights, row-major, PACKED_ALIGNMENT aligned
+ * @var biasOffset - rows biases, PACKED_ALIGNMENT aligned
+ * @var weightsCrc - CRC-32 of the weights payload
+ * @var biasCrc - CRC-32 of the bias payload
+ */
+typedef struct PackedLayerHeader
+{
+	int32_t rows;
+	int32_t cols;
+	int32_t activation;
+	int32_t dtype;
+	uint64_t weightsOffset;
+	uint64_t biasOffset;
+	uint32_t weightsCrc;
+	uint32_t biasCrc;
+} PackedLayerHeader;
+
+/**
+ * CRC-32 (IEEE 802.3, as zlib) of a buffer
+ * @param data	bytes
+ * @param size	length
+ * @return		checksum
+ */
+uint32_t crc32(const void* data, size_t size);
+
+/**
+ * Tells whether a file starts like a packed model
+ * @param filePath	path
+ * @return			true if it starts with PACKED_FILE_MAGIC
+ */
+bool isPackedModel(const std::string& filePath);
+
+/**
+ * Writes layers as one packed model file
+ * @param filePath	path
+ * @param layers	Layers, input first
+ * @return			false on a write error
+ */
+bool writePackedModel(const std::string& filePath, const std::vector<Dense>& layers);
+
+/**
+ * Maps a packed model and verifies it, then views its tensors as layers without
+ * copying them
+ * @param filePath	path
+ * @param file		receives the mapping, must outlive the layers
+ * @param layers	receives the layers, input first, borrowing the mapped pages
+ * @param error		receives what is wrong on failure, e.g. a truncated file or
+ * 					the tensor whose checksum does not match
+ * @return			false if the file is missing, invalid or corrupt
+ */
+bool mapPackedModel(const std::string& filePath, MappedFile& file, std::vector<Dense>& layers, std::string& error);
+
+#endif
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <chrono>
+#include "ParallelClassifier.h"
+
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+
+/**
+ * Constructor
+ * @param network	Network, must outlive the classifier
+ * @param threads	Workers, at least 1
+ * @param batchSize	Images per task, at least 1
+ */
+ParallelClassifier::ParallelClassifier(const MlpNetwork& network, int threads, int batchSize) :
+	_network(network), _batchSize(std::max(batchSize, 1)), _pool(threads)
+{
+	for (int i = 0; i < this->_pool.size(); ++i)
+	{
+		this->_scratch.emplace_back(network.getInputs(), this->_batchSize);
+	}
+}
+
+/**
+ * Returns the number of workers
+ * @return	workers
+ */
+int ParallelClassifier::threads() const
+{
+	return this->_pool.size();
+}
+
+/**
+ * Classifies n images, one task per batch of batchSize images
+ * @param images	Images array, imgDims elements each
+ * @param n			Number of images, > 0
+ * @param latencies	If not nullptr, receives per batch the seconds from queueing to done
+ * @return			Digit per image, in order
+ */
+std::vector<Digit> ParallelClassifier::classify(const Matrix images[], int n, std::vector<double>* latencies)
+{
+	typedef std::chrono::steady_clock Clock;
+	if (n <= 0)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	const int batches = (n + this->_batchSize - 1) / this->_batchSize;
+	std::vector<Digit> digits(n);
+	if (latencies != nullptr)
+	{
+		latencies->assign(batches, 0);
+	}
+
+	for (int batch = 0; batch < batches; ++batch)
+	{
+		const int first = batch * this->_batchSize;
+		const int count = std::min(this->_batchSize, n - first);
+		const Clock::time_point queued = Clock::now();
+		this->_pool.submit([this, images, first, count, batch, queued, latencies, &digits](int worker)
+						   {
+							   // a partial last batch reads a narrower view of the scratch, never resizes it
+							   Matrix& scratch = this->_scratch[worker];
+							   this->_network.packBatch(images + first, count, scratch.data(), scratch.getCols());
+							   const std::vector<Digit> result = this->_network.classifyBatch(
+								   MatrixView(scratch).block(0, 0, scratch.getRows(), count));
+							   std::copy(result.begin(), result.end(), digits.begin() + first);
+							   if (latencies != nullptr)
+							   {
+								   (*latencies)[batch] = std::chrono::duration<double>(Clock::now() - queued).count();
+							   }
+						   });
+	}
+	this->_pool.wait();
+	return digits;
+}
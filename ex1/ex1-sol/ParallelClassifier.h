@@ -0,0 +1,62 @@
+#ifndef PARALLEL_CLASSIFIER_H
+#define PARALLEL_CLASSIFIER_H
+
+#include <vector>
+#include "MlpNetwork.h"
+#include "ThreadPool.h"
+
+/**
+ * Class ParallelClassifier
+ * Shards a stream of images into batches and classifies them on a work-stealing pool.
+ * The network's weights are shared read-only by every worker, each worker packs
+ * its batches into its own scratch matrix.
+ */
+class ParallelClassifier
+{
+ public:
+	/**
+	 * Constructor
+	 * @param network	Network, must outlive the classifier
+	 * @param threads	Workers, at least 1
+	 * @param batchSize	Images per task, at least 1
+	 */
+	ParallelClassifier(const MlpNetwork& network, int threads, int batchSize);
+
+	/**
+	 * Returns the number of workers
+	 * @return	workers
+	 */
+	int threads() const;
+
+	/**
+	 * Classifies n images, one task per batch of batchSize images
+	 * @param images	Images array, getInputs() elements each
+	 * @param n			Number of images, > 0
+	 * @param latencies	If not nullptr, receives per batch the seconds from queueing to done
+	 * @return			Digit per image, in order
+	 */
+	std::vector<Digit> classify(const Matrix images[], int n, std::vector<double>* latencies = nullptr);
+
+ private:
+	/**
+	 * Shared network
+	 */
+	const MlpNetwork& _network;
+
+	/**
+	 * Images per task
+	 */
+	int _batchSize;
+
+	/**
+	 * Workers
+	 */
+	ThreadPool _pool;
+
+	/**
+	 * Packed batch of each worker
+	 */
+	std::vector<Matrix> _scratch;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include "Profiler.h"
+#include "MatrixAllocator.h"
+
+#define GIGA 1e9
+#define MICRO 1e6
+
+/**
+ * Reads PROFILE_SUMMARY_ENV
+ */
+Profiler::Profiler() : _summarySeconds(0), _lastSummary(std::chrono::steady_clock::now())
+{
+	const char* seconds = std::getenv(PROFILE_SUMMARY_ENV);
+	if (seconds != nullptr)
+	{
+		this->_summarySeconds = std::max(0.0, std::atof(seconds));
+	}
+}
+
+/**
+ * Writes the JSON dump to PROFILE_JSON_ENV, if set and anything was recorded
+ */
+Profiler::~Profiler()
+{
+	const char* path = std::getenv(PROFILE_JSON_ENV);
+	if (path != nullptr && !this->_entries.empty())
+	{
+		std::ofstream os(path);
+		this->writeJson(os);
+	}
+}
+
+/**
+ * Returns the process wide profiler
+ * @return	Profiler
+ */
+Profiler& Profiler::instance()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+/**
+ * Adds one call of a profiled object
+ * @param key			object, one entry each
+ * @param kind			name prefix, e.g. "network"
+ * @param rows			output length, part of the name
+ * @param cols			input length, part of the name
+ * @param seconds		wall time
+ * @param flops			floating point operations
+ * @param bytes			weight and bias bytes touched
+ * @param allocations	Matrix allocations
+ */
+void Profiler::record(const void* key, const char* kind, int rows, int cols, double seconds, double flops,
+					  double bytes, long allocations)
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	auto found = this->_index.find(key);
+	if (found == this->_index.end())
+	{
+		const std::string name = std::string(kind) + " " + std::to_string(rows) + "x" + std::to_string(cols);
+		found = this->_index.emplace(key, this->_entries.size()).first;
+		this->_entries.push_back({ name, 0, 0, 0, 0, 0 });
+	}
+	ProfileEntry& entry = this->_entries[found->second];
+	++entry.calls;
+	entry.seconds += seconds;
+	entry.flops += flops;
+	entry.bytes += bytes;
+	entry.allocations += allocations;
+
+	if (this->_summarySeconds > 0)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(now - this->_lastSummary).count() >= this->_summarySeconds)
+		{
+			this->_lastSummary = now;
+			this->_summary(std::cerr);
+		}
+	}
+}
+
+/**
+ * Returns a copy of the entries, in order of their first call
+ * @return	entries
+ */
+std::vector<ProfileEntry> Profiler::entries()
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	return this->_entries;
+}
+
+/**
+ * Drops every entry
+ */
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	this->_entries.clear();
+	this->_index.clear();
+}
+
+/**
+ * Writes every entry as JSON, with time per call, GFLOP/s and GB/s
+ * @param os	Ostream
+ */
+void Profiler::writeJson(std::ostream& os)
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	os << "{" << std::endl << "  \"layers\": [" << std::endl;
+	for (size_t i = 0; i < this->_entries.size(); ++i)
+	{
+		const ProfileEntry& entry = this->_entries[i];
+		const double seconds = entry.seconds > 0 ? entry.seconds : 1;
+		os << "    {\"name\": \"" << entry.name << "\", \"calls\": " << entry.calls
+		   << std::fixed << std::setprecision(6) << ", \"seconds\": " << entry.seconds
+		   << std::setprecision(3) << ", \"us_per_call\": " << entry.seconds * MICRO / (double) entry.calls
+		   << ", \"flops\": " << std::setprecision(0) << entry.flops
+		   << ", \"weight_bytes\": " << entry.bytes << ", \"allocations\": " << entry.allocations
+		   << std::setprecision(3) << ", \"gflops\": " << entry.flops / seconds / GIGA
+		   << ", \"gbytes_per_s\": " << entry.bytes / seconds / GIGA << "}"
+		   << (i + 1 == this->_entries.size() ? "" : ",") << std::endl;
+		os.unsetf(std::ios::floatfield);
+	}
+	os << "  ]" << std::endl << "}" << std::endl;
+}
+
+/**
+ * Writes one line: time per call, GFLOP/s and allocations of every entry
+ * @param os	Ostream
+ */
+void Profiler::writeSummary(std::ostream& os)
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	this->_summary(os);
+}
+
+/**
+ * Writes the summary line, _mutex held
+ * @param os	Ostream
+ */
+void Profiler::_summary(std::ostream& os) const
+{
+	os << "profile:";
+	for (const ProfileEntry& entry : this->_entries)
+	{
+		const double seconds = entry.seconds > 0 ? entry.seconds : 1;
+		os << (&entry == &this->_entries.front() ? " " : " | ") << entry.name << " " << entry.calls << " calls "
+		   << std::fixed << std::setprecision(2) << entry.seconds * MICRO / (double) entry.calls << " us "
+		   << entry.flops / seconds / GIGA << " GFLOP/s " << entry.allocations << " allocs";
+		os.unsetf(std::ios::floatfield);
+	}
+	os << std::endl;
+}
+
+/**
+ * Starts timing one call
+ * @param key	profiled object
+ * @param kind	name prefix
+ * @param rows	output length
+ * @param cols	input length
+ * @param flops	floating point operations of the call
+ * @param bytes	weight and bias bytes the call touches
+ */
+ProfileScope::ProfileScope(const void* key, const char* kind, int rows, int cols, double flops, double bytes) :
+	_key(key), _kind(kind), _rows(rows), _cols(cols), _flops(flops), _bytes(bytes),
+	_allocations(matrixThreadAllocations()), _start(std::chrono::steady_clock::now())
+{
+}
+
+/**
+ * Records the call
+ */
+ProfileScope::~ProfileScope()
+{
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->_start).count();
+	Profiler::instance().record(this->_key, this->_kind, this->_rows, this->_cols, seconds, this->_flops,
+								this->_bytes, matrixThreadAllocations() - this->_allocations);
+}
@@ -0,0 +1,183 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Environment variable naming a file the JSON dump is written to at exit
+ */
+#define PROFILE_JSON_ENV "MLP_PROFILE_JSON"
+
+/**
+ * Environment variable with the seconds between summary lines on stderr
+ */
+#define PROFILE_SUMMARY_ENV "MLP_PROFILE_SUMMARY"
+
+/**
+ * @struct ProfileEntry
+ * @brief Totals of one profiled layer or network
+ * @var name - kind and shape, e.g. "dense relu 128x784"
+ * @var calls - recorded calls
+ * @var seconds - wall time of all calls
+ * @var flops - floating point operations of all calls
+ * @var bytes - weight and bias bytes touched by all calls
+ * @var allocations - Matrix allocations made inside the calls
+ */
+typedef struct ProfileEntry
+{
+	std::string name;
+	long calls;
+	double seconds;
+	double flops;
+	double bytes;
+	long allocations;
+} ProfileEntry;
+
+/**
+ * Class Profiler
+ * Process wide per layer counters. The hooks in Dense and MlpNetwork are compiled
+ * in only with MLP_PROFILE defined (cmake -DMLP_PROFILE=ON, make PROFILE=1), without
+ * it nothing is recorded and the hot paths carry no code at all.
+ */
+class Profiler
+{
+ private:
+	/**
+	 * Guards everything below, recording is serialized
+	 */
+	std::mutex _mutex;
+
+	/**
+	 * Entries in order of their first call
+	 */
+	std::vector<ProfileEntry> _entries;
+
+	/**
+	 * Entry of each profiled object
+	 */
+	std::unordered_map<const void*, size_t> _index;
+
+	/**
+	 * Seconds between summary lines, 0 for none
+	 */
+	double _summarySeconds;
+
+	/**
+	 * When the last summary line was written
+	 */
+	std::chrono::steady_clock::time_point _lastSummary;
+
+	/**
+	 * Writes the summary line, _mutex held
+	 * @param os	Ostream
+	 */
+	void _summary(std::ostream& os) const;
+
+	/**
+	 * Reads PROFILE_SUMMARY_ENV
+	 */
+	Profiler();
+
+ public:
+	/**
+	 * Writes the JSON dump to PROFILE_JSON_ENV, if set and anything was recorded
+	 */
+	~Profiler();
+
+	/**
+	 * Returns the process wide profiler
+	 * @return	Profiler
+	 */
+	static Profiler& instance();
+
+	/**
+	 * Adds one call of a profiled object
+	 * @param key			object, one entry each
+	 * @param kind			name prefix, e.g. "network"
+	 * @param rows			output length, part of the name
+	 * @param cols			input length, part of the name
+	 * @param seconds		wall time
+	 * @param flops			floating point operations
+	 * @param bytes			weight and bias bytes touched
+	 * @param allocations	Matrix allocations
+	 */
+	void record(const void* key, const char* kind, int rows, int cols, double seconds, double flops, double bytes,
+				long allocations);
+
+	/**
+	 * Returns a copy of the entries, in order of their first call
+	 * @return	entries
+	 */
+	std::vector<ProfileEntry> entries();
+
+	/**
+	 * Drops every entry
+	 */
+	void reset();
+
+	/**
+	 * Writes every entry as JSON, with time per call, GFLOP/s and GB/s
+	 * @param os	Ostream
+	 */
+	void writeJson(std::ostream& os);
+
+	/**
+	 * Writes one line: time per call, GFLOP/s and allocations of every entry
+	 * @param os	Ostream
+	 */
+	void writeSummary(std::ostream& os);
+};
+
+/**
+ * Class ProfileScope
+ * Times its own lifetime and records it with the Profiler on destruction
+ */
+class ProfileScope
+{
+ private:
+	const void* _key;
+	const char* _kind;
+	int _rows;
+	int _cols;
+	double _flops;
+	double _bytes;
+	long _allocations;
+	std::chrono::steady_clock::time_point _start;
+
+ public:
+	/**
+	 * Starts timing one call
+	 * @param key	profiled object
+	 * @param kind	name prefix
+	 * @param rows	output length
+	 * @param cols	input length
+	 * @param flops	floating point operations of the call
+	 * @param bytes	weight and bias bytes the call touches
+	 */
+	ProfileScope(const void* key, const char* kind, int rows, int cols, double flops, double bytes);
+
+	/**
+	 * Records the call
+	 */
+	~ProfileScope();
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+/**
+ * Profiles the rest of the enclosing block, compiled out without MLP_PROFILE
+ */
+#ifdef MLP_PROFILE
+#define PROFILE_SCOPE(key, kind, rows, cols, flops, bytes) \
+	const ProfileScope profileScope(key, kind, rows, cols, flops, bytes)
+#else
+#define PROFILE_SCOPE(key, kind, rows, cols, flops, bytes)
+#endif
+
+#endif
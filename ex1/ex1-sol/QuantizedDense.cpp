@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "QuantizedDense.h"
+#include "Kernels.h"
+
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+
+/**
+ * Rounds a length up to QUANT_PADDING
+ * @param cols	length
+ * @return		padded length
+ */
+static int padded(int cols)
+{
+	return (cols + QUANT_PADDING - 1) / QUANT_PADDING * QUANT_PADDING;
+}
+
+/**
+ * Quantizes an fp32 layer
+ * @param weightMat			Matrix
+ * @param biasMat			Matrix
+ * @param activationType	ActivationType
+ * @param inputMax			Largest input seen during calibration
+ */
+QuantizedDense::QuantizedDense(const MatrixView& weightMat, const MatrixView& biasMat,
+							   ActivationType activationType, float inputMax) :
+	_rows(weightMat.getRows()), _cols(weightMat.getCols()), _paddedCols(padded(weightMat.getCols())),
+	_weights((size_t) weightMat.getRows() * padded(weightMat.getCols()), 0), _rowScales(weightMat.getRows()),
+	_biasMatrix(biasMat), _inputScale(inputMax > 0 ? inputMax / QUANT_ACTIVATION_MAX : 1),
+	_activation(activationType)
+{
+	if (biasMat.getRows() != this->_rows || biasMat.getCols() != 1)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	for (int row = 0; row < this->_rows; ++row)
+	{
+		float max = 0;
+		for (int col = 0; col < this->_cols; ++col)
+		{
+			max = std::max(max, std::fabs(weightMat(row, col)));
+		}
+		const float scale = max > 0 ? max / QUANT_WEIGHT_MAX : 1;
+		this->_rowScales[row] = scale;
+
+		int8_t* weights = this->_weights.data() + (size_t) row * this->_paddedCols;
+		for (int col = 0; col < this->_cols; ++col)
+		{
+			weights[col] = (int8_t) std::lround(weightMat(row, col) / scale);
+		}
+	}
+}
+
+/**
+ * Inits a layer from already quantized parameters
+ * @param cols				Input length
+ * @param weights			rows * cols weights, row-major, unpadded
+ * @param rowScales			Per row weight scale
+ * @param biasMat			Matrix
+ * @param activationType	ActivationType
+ * @param inputScale		Input scale
+ */
+QuantizedDense::QuantizedDense(int cols, const std::vector<int8_t>& weights, std::vector<float>&& rowScales,
+							   Matrix&& biasMat, ActivationType activationType, float inputScale) :
+	_rows((int) rowScales.size()), _cols(cols), _paddedCols(padded(cols)),
+	_weights(rowScales.size() * padded(cols), 0), _rowScales(std::move(rowScales)),
+	_biasMatrix(std::move(biasMat)), _inputScale(inputScale), _activation(activationType)
+{
+	if (cols <= 0 || weights.size() != (size_t) this->_rows * cols ||
+		this->_biasMatrix.getRows() != this->_rows || this->_biasMatrix.getCols() != 1)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	for (int row = 0; row < this->_rows; ++row)
+	{
+		std::copy(weights.begin() + (long) row * cols, weights.begin() + (long) (row + 1) * cols,
+				  this->_weights.begin() + (long) row * this->_paddedCols);
+	}
+}
+
+/**
+ * returns the amount of output rows
+ * @return	rows
+ */
+int QuantizedDense::getRows() const
+{
+	return this->_rows;
+}
+
+/**
+ * returns the input length
+ * @return	cols
+ */
+int QuantizedDense::getCols() const
+{
+	return this->_cols;
+}
+
+/**
+ * Weight of one row and col
+ * @param row	row
+ * @param col	col
+ * @return		quantized weight
+ */
+int8_t QuantizedDense::getWeight(int row, int col) const
+{
+	return this->_weights[(size_t) row * this->_paddedCols + col];
+}
+
+/**
+ * Returns the per row weight scales
+ * @return	rows scales
+ */
+const std::vector<float>& QuantizedDense::getRowScales() const
+{
+	return this->_rowScales;
+}
+
+/**
+ * Returns the bias of this layer
+ * @return 	Bias matrix
+ */
+const Matrix& QuantizedDense::getBias() const
+{
+	return this->_biasMatrix;
+}
+
+/**
+ * Returns the input scale
+ * @return	scale
+ */
+float QuantizedDense::getInputScale() const
+{
+	return this->_inputScale;
+}
+
+/**
+ * Returns the activation function of this layer
+ * @return	Activation
+ */
+const Activation& QuantizedDense::getActivation() const
+{
+	return this->_activation;
+}
+
+/**
+ * Parenthesis operator override,
+ * Quantizes a single sample, applies the INT8 layer and returns the fp32 output
+ * @param inputView		Column vector
+ * @return				Matrix
+ */
+Matrix QuantizedDense::operator()(const MatrixView& inputView) const
+{
+	if (inputView.getRows() != this->_cols || inputView.getCols() != 1)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// per thread scratch, the padding tail stays zero
+	static thread_local std::vector<uint8_t> quantized;
+	static thread_local std::vector<int32_t> sums;
+	quantized.resize(this->_paddedCols);
+	sums.resize(this->_rows);
+	std::fill(quantized.begin() + this->_cols, quantized.end(), 0);
+
+	const float* input = inputView.data();
+	const int ld = inputView.getLd();
+	const float inverseScale = 1 / this->_inputScale;
+	uint8_t* bytes = quantized.data();
+	if (ld == 1)
+	{
+		// unit stride, branch free so the compiler vectorizes it
+		for (int col = 0; col < this->_cols; ++col)
+		{
+			const float value = std::min(std::max(input[col] * inverseScale, 0.f), (float) QUANT_ACTIVATION_MAX);
+			bytes[col] = (uint8_t) (int) (value + 0.5f);
+		}
+	}
+	else
+	{
+		for (int col = 0; col < this->_cols; ++col)
+		{
+			const float value = std::min(std::max(input[col * ld] * inverseScale, 0.f),
+										 (float) QUANT_ACTIVATION_MAX);
+			bytes[col] = (uint8_t) (int) (value + 0.5f);
+		}
+	}
+
+	kernels().denseInt8(this->_rows, this->_paddedCols, this->_weights.data(), quantized.data(), sums.data());
+
+	Matrix result(this->_rows, 1);
+	const bool relu = this->_activation.getActivationType() == Relu;
+	for (int row = 0; row < this->_rows; ++row)
+	{
+		const float value = (float) sums[row] * this->_rowScales[row] * this->_inputScale + this->_biasMatrix[row];
+		result[row] = relu && value < 0 ? 0 : value;
+	}
+	if (!relu)
+	{
+		this->_activation.apply(result);
+	}
+	return result;
+}
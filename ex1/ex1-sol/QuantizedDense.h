@@ -0,0 +1,146 @@
+#ifndef QUANTIZED_DENSE_H
+#define QUANTIZED_DENSE_H
+
+#include <cstdint>
+#include <vector>
+#include "Matrix.h"
+#include "MatrixView.h"
+#include "Activation.h"
+
+/**
+ * Largest quantized activation. Inputs are non-negative (pixels and ReLU outputs)
+ * and kept to 7 bits so the AVX2 u8 * s8 pair sums fit int16.
+ */
+#define QUANT_ACTIVATION_MAX 127
+
+/**
+ * Largest quantized weight magnitude, symmetric around 0
+ */
+#define QUANT_WEIGHT_MAX 127
+
+/**
+ * Class QuantizedDense
+ * Dense layer with INT8 weights, one scale per output row, and INT8 inputs
+ * quantized with a scale calibrated ahead of time. Bias, accumulation
+ * rescaling and activation stay in fp32.
+ */
+class QuantizedDense
+{
+ private:
+	/**
+	 * Output rows
+	 */
+	int _rows;
+
+	/**
+	 * Input length
+	 */
+	int _cols;
+
+	/**
+	 * Input length rounded up to QUANT_PADDING, the leading dimension of _weights
+	 */
+	int _paddedCols;
+
+	/**
+	 * Weights, row-major, zero padded
+	 */
+	std::vector<int8_t> _weights;
+
+	/**
+	 * Per row weight scale, weight = _weights * scale
+	 */
+	std::vector<float> _rowScales;
+
+	/**
+	 * Bias matrix
+	 */
+	Matrix _biasMatrix;
+
+	/**
+	 * Input scale, input = quantized input * scale
+	 */
+	float _inputScale;
+
+	/**
+	 * Activation type
+	 */
+	Activation _activation;
+
+ public:
+	/**
+	 * Quantizes an fp32 layer
+	 * @param weightMat			Matrix
+	 * @param biasMat			Matrix
+	 * @param activationType	ActivationType
+	 * @param inputMax			Largest input seen during calibration
+	 */
+	QuantizedDense(const MatrixView& weightMat, const MatrixView& biasMat, ActivationType activationType,
+				   float inputMax);
+
+	/**
+	 * Inits a layer from already quantized parameters
+	 * @param cols				Input length
+	 * @param weights			rows * cols weights, row-major, unpadded
+	 * @param rowScales			Per row weight scale
+	 * @param biasMat			Matrix
+	 * @param activationType	ActivationType
+	 * @param inputScale		Input scale
+	 */
+	QuantizedDense(int cols, const std::vector<int8_t>& weights, std::vector<float>&& rowScales,
+				   Matrix&& biasMat, ActivationType activationType, float inputScale);
+
+	/**
+	 * returns the amount of output rows
+	 * @return	rows
+	 */
+	int getRows() const;
+
+	/**
+	 * returns the input length
+	 * @return	cols
+	 */
+	int getCols() const;
+
+	/**
+	 * Weight of one row and col
+	 * @param row	row
+	 * @param col	col
+	 * @return		quantized weight
+	 */
+	int8_t getWeight(int row, int col) const;
+
+	/**
+	 * Returns the per row weight scales
+	 * @return	rows scales
+	 */
+	const std::vector<float>& getRowScales() const;
+
+	/**
+	 * Returns the bias of this layer
+	 * @return 	Bias matrix
+	 */
+	const Matrix& getBias() const;
+
+	/**
+	 * Returns the input scale
+	 * @return	scale
+	 */
+	float getInputScale() const;
+
+	/**
+	 * Returns the activation function of this layer
+	 * @return	Activation
+	 */
+	const Activation& getActivation() const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Quantizes a single sample, applies the INT8 layer and returns the fp32 output
+	 * @param inputView		Column vector
+	 * @return				Matrix
+	 */
+	Matrix operator()(const MatrixView& inputView) const;
+};
+
+#endif
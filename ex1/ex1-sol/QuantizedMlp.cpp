@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include "QuantizedMlp.h"
+
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+#define MAGIC_BYTES 8
+
+/**
+ * @struct LayerHeader
+ * @brief Fixed size part of one layer in a pre-quantized file
+ */
+typedef struct LayerHeader
+{
+	int32_t rows;
+	int32_t cols;
+	int32_t activation;
+	float inputScale;
+} LayerHeader;
+
+/**
+ * Activation of each layer, as in MlpNetwork
+ * @param layer	layer index
+ * @return		ActivationType
+ */
+static ActivationType layerActivation(int layer)
+{
+	return layer == MLP_SIZE - 1 ? Softmax : Relu;
+}
+
+/**
+ * Largest value of a matrix
+ * @param matrix	Matrix
+ * @return			max
+ */
+static float maxValue(const Matrix& matrix)
+{
+	const float* values = matrix.data();
+	return *std::max_element(values, values + matrix.getRows() * matrix.getCols());
+}
+
+/**
+ * Quantizes fp32 parameters
+ * Accepts 2 arrays, size 4 each, and calibration images
+ * @param weights	Weights array
+ * @param biases	Biases array
+ * @param images	Calibration images, imgDims elements each
+ * @param n			Number of calibration images, > 0
+ */
+QuantizedMlp::QuantizedMlp(const Matrix* weights, const Matrix* biases, const Matrix* images, int n)
+{
+	const int imgSize = imgDims.rows * imgDims.cols;
+	if (n <= 0)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// fp32 layers borrowing the parameters, to record the range of every layer's input
+	std::vector<Dense> layers;
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		layers.emplace_back(Matrix::borrow(MatrixView(weights[i])), Matrix::borrow(MatrixView(biases[i])),
+							layerActivation(i));
+	}
+	float inputMax[MLP_SIZE] = {};
+	for (int image = 0; image < n; ++image)
+	{
+		if (images[image].getRows() * images[image].getCols() != imgSize)
+		{
+			std::cerr << SIZE_ERROR << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		Matrix matrix = Matrix(MatrixView(images[image]).vectorize());
+		for (int i = 0; i < MLP_SIZE; ++i)
+		{
+			inputMax[i] = std::max(inputMax[i], maxValue(matrix));
+			matrix = layers[i](matrix);
+		}
+	}
+
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		this->_layers.emplace_back(MatrixView(weights[i]), MatrixView(biases[i]), layerActivation(i), inputMax[i]);
+	}
+}
+
+/**
+ * Reads a file written by save
+ * @param filePath	path
+ * @return			false if the file is missing, not pre-quantized or has other shapes
+ */
+bool QuantizedMlp::load(const std::string& filePath)
+{
+	std::ifstream is(filePath, std::ios::in | std::ios::binary);
+	char magic[MAGIC_BYTES] = {};
+	uint32_t version = 0;
+	uint32_t count = 0;
+	is.read(magic, MAGIC_BYTES);
+	is.read(reinterpret_cast<char*>(&version), sizeof(version));
+	is.read(reinterpret_cast<char*>(&count), sizeof(count));
+	if (!is.good() || std::strncmp(magic, QUANT_FILE_MAGIC, MAGIC_BYTES) != 0 ||
+		version != QUANT_FILE_VERSION || count != MLP_SIZE)
+	{
+		return false;
+	}
+
+	std::vector<QuantizedDense> layers;
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		LayerHeader header = {};
+		is.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!is.good() || header.rows != weightsDims[i].rows || header.cols != weightsDims[i].cols ||
+			header.activation != layerActivation(i) || !(header.inputScale > 0))
+		{
+			return false;
+		}
+
+		std::vector<float> rowScales(header.rows);
+		Matrix bias(header.rows, 1);
+		std::vector<int8_t> quantized((size_t) header.rows * header.cols);
+		is.read(reinterpret_cast<char*>(rowScales.data()), (long) (rowScales.size() * sizeof(float)));
+		is.read(reinterpret_cast<char*>(bias.data()), (long) (header.rows * sizeof(float)));
+		is.read(reinterpret_cast<char*>(quantized.data()), (long) quantized.size());
+		if (!is.good())
+		{
+			return false;
+		}
+		layers.emplace_back(header.cols, quantized, std::move(rowScales), std::move(bias),
+							(ActivationType) header.activation, header.inputScale);
+	}
+	if (is.peek() != std::ifstream::traits_type::eof())
+	{
+		return false;
+	}
+	this->_layers = std::move(layers);
+	return true;
+}
+
+/**
+ * Writes the quantized parameters:
+ * magic, version, layer count, then per layer rows, cols, activation, input scale,
+ * rows row scales, rows biases (fp32) and rows * cols weights (int8)
+ * @param filePath	path
+ * @return			false on a write error
+ */
+bool QuantizedMlp::save(const std::string& filePath) const
+{
+	std::ofstream os(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	char magic[MAGIC_BYTES] = {};
+	std::strncpy(magic, QUANT_FILE_MAGIC, MAGIC_BYTES);
+	const uint32_t version = QUANT_FILE_VERSION;
+	const uint32_t count = (uint32_t) this->_layers.size();
+	os.write(magic, MAGIC_BYTES);
+	os.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	os.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+	for (const QuantizedDense& layer : this->_layers)
+	{
+		const LayerHeader header = { layer.getRows(), layer.getCols(),
+									 layer.getActivation().getActivationType(), layer.getInputScale() };
+		os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		os.write(reinterpret_cast<const char*>(layer.getRowScales().data()),
+				 (long) (layer.getRows() * sizeof(float)));
+		os.write(reinterpret_cast<const char*>(layer.getBias().data()), (long) (layer.getRows() * sizeof(float)));
+		std::vector<int8_t> row(layer.getCols());
+		for (int r = 0; r < layer.getRows(); ++r)
+		{
+			for (int c = 0; c < layer.getCols(); ++c)
+			{
+				row[c] = layer.getWeight(r, c);
+			}
+			os.write(reinterpret_cast<const char*>(row.data()), (long) row.size());
+		}
+	}
+	return os.good();
+}
+
+/**
+ * Returns the bytes held by the quantized weights
+ * @return	bytes
+ */
+long QuantizedMlp::weightBytes() const
+{
+	long bytes = 0;
+	for (const QuantizedDense& layer : this->_layers)
+	{
+		bytes += (long) layer.getRows() * layer.getCols();
+	}
+	return bytes;
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the entire network on input
+ * @param img	Image matrix
+ * @return		Digit
+ */
+Digit QuantizedMlp::operator()(const Matrix& img) const
+{
+	return (*this)(MatrixView(img).vectorize());
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the entire network on a view of the input
+ * @param img	Image view, a column vector
+ * @return		Digit
+ */
+Digit QuantizedMlp::operator()(const MatrixView& img) const
+{
+	if (this->_layers.empty())
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	Matrix matrix = this->_layers[0](img);
+	for (size_t i = 1; i < this->_layers.size(); ++i)
+	{
+		matrix = this->_layers[i](matrix);
+	}
+	return MlpNetwork::mostProbable(matrix, 0);
+}
@@ -0,0 +1,88 @@
+#ifndef QUANTIZED_MLP_H
+#define QUANTIZED_MLP_H
+
+#include <string>
+#include <vector>
+#include "MlpNetwork.h"
+#include "QuantizedDense.h"
+
+/**
+ * First bytes of a pre-quantized parameters file
+ */
+#define QUANT_FILE_MAGIC "MLPQ8"
+
+/**
+ * Format version written by save
+ */
+#define QUANT_FILE_VERSION 1
+
+/**
+ * Class QuantizedMlp
+ * The MlpNetwork layers with INT8 weights and activations (post-training quantization).
+ * Weights get one symmetric scale per row, each layer's input gets one scale
+ * from the largest value it saw while running the fp32 network on calibration images.
+ */
+class QuantizedMlp
+{
+ private:
+	/**
+	 * Layers, input first
+	 */
+	std::vector<QuantizedDense> _layers;
+
+ public:
+	/**
+	 * Inits an empty network, to be loaded
+	 */
+	QuantizedMlp() = default;
+
+	/**
+	 * Quantizes fp32 parameters
+	 * Accepts 2 arrays, size 4 each, and calibration images
+	 * @param weights	Weights array
+	 * @param biases	Biases array
+	 * @param images	Calibration images, imgDims elements each
+	 * @param n			Number of calibration images, > 0
+	 */
+	QuantizedMlp(const Matrix weights[MLP_SIZE], const Matrix biases[MLP_SIZE], const Matrix images[], int n);
+
+	/**
+	 * Reads a file written by save
+	 * @param filePath	path
+	 * @return			false if the file is missing, not pre-quantized or has other shapes
+	 */
+	bool load(const std::string& filePath);
+
+	/**
+	 * Writes the quantized parameters:
+	 * magic, version, layer count, then per layer rows, cols, activation, input scale,
+	 * rows row scales, rows biases (fp32) and rows * cols weights (int8)
+	 * @param filePath	path
+	 * @return			false on a write error
+	 */
+	bool save(const std::string& filePath) const;
+
+	/**
+	 * Returns the bytes held by the quantized weights
+	 * @return	bytes
+	 */
+	long weightBytes() const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the entire network on input
+	 * @param img	Image matrix
+	 * @return		Digit
+	 */
+	Digit operator()(const Matrix& img) const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the entire network on a view of the input
+	 * @param img	Image view, a column vector
+	 * @return		Digit
+	 */
+	Digit operator()(const MatrixView& img) const;
+};
+
+#endif
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include "SparseDense.h"
+#include "Kernels.h"
+
+#define SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+#define CSR_SUMS 4
+
+/**
+ * Keeps the non-zero weights of a layer. Blocks need at least SPARSE_BLOCK inputs,
+ * a narrower layer is stored as CSR.
+ * @param layer		Dense
+ * @param format	SparseFormat
+ */
+SparseDense::SparseDense(const Dense& layer, SparseFormat format) :
+	_rows(layer.getWeights().getRows()), _cols(layer.getWeights().getCols()),
+	_format(layer.getWeights().getCols() < SPARSE_BLOCK ? SparseCsr : format), _rowStart(1, 0),
+	_biasMatrix(layer.getBias()), _activation(layer.getActivation())
+{
+	const float* weights = layer.getWeights().data();
+	for (int row = 0; row < this->_rows; ++row)
+	{
+		const float* line = weights + (long) row * this->_cols;
+		if (this->_format == SparseCsr)
+		{
+			for (int col = 0; col < this->_cols; ++col)
+			{
+				if (line[col] != 0)
+				{
+					this->_columns.push_back(col);
+					this->_values.push_back(line[col]);
+				}
+			}
+		}
+		else
+		{
+			for (int first = 0; first < this->_cols; first += SPARSE_BLOCK)
+			{
+				const int last = std::min(first + SPARSE_BLOCK, this->_cols);
+				if (std::all_of(line + first, line + last, [](float weight) { return weight == 0; }))
+				{
+					continue;
+				}
+				// a partial last block shifts left to stay inside x, the overlap holds zeros
+				const int start = last - SPARSE_BLOCK;
+				this->_columns.push_back(start);
+				for (int col = start; col < start + SPARSE_BLOCK; ++col)
+				{
+					this->_values.push_back(col < first ? 0 : line[col]);
+				}
+			}
+		}
+		this->_rowStart.push_back((int) this->_columns.size());
+	}
+}
+
+/**
+ * Fraction of the weights of a layer that are non-zero
+ * @param layer	Dense
+ * @return		density in [0, 1]
+ */
+float SparseDense::density(const Dense& layer)
+{
+	const Matrix& weights = layer.getWeights();
+	const long count = (long) weights.getRows() * weights.getCols();
+	const long nonZeros = count - std::count(weights.data(), weights.data() + count, 0.0f);
+	return count == 0 ? 0 : (float) nonZeros / (float) count;
+}
+
+/**
+ * returns the amount of output rows
+ * @return	rows
+ */
+int SparseDense::getRows() const
+{
+	return this->_rows;
+}
+
+/**
+ * returns the input length
+ * @return	cols
+ */
+int SparseDense::getCols() const
+{
+	return this->_cols;
+}
+
+/**
+ * Returns the storage format
+ * @return	SparseFormat
+ */
+SparseFormat SparseDense::getFormat() const
+{
+	return this->_format;
+}
+
+/**
+ * Returns the stored weights, explicit zeros inside blocks included
+ * @return	count
+ */
+long SparseDense::storedValues() const
+{
+	return (long) this->_values.size();
+}
+
+/**
+ * Returns the bytes held by the weights and their indices
+ * @return	bytes
+ */
+long SparseDense::weightBytes() const
+{
+	return (long) (this->_values.size() * sizeof(float) +
+				   (this->_columns.size() + this->_rowStart.size()) * sizeof(int));
+}
+
+/**
+ * Returns the bias of this layer
+ * @return 	Bias matrix
+ */
+const Matrix& SparseDense::getBias() const
+{
+	return this->_biasMatrix;
+}
+
+/**
+ * Returns the activation function of this layer
+ * @return	Activation
+ */
+const Activation& SparseDense::getActivation() const
+{
+	return this->_activation;
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the layer on a view, a batch when it has several columns
+ * @param inputView		MatrixView, one sample per column
+ * @return				Matrix
+ */
+Matrix SparseDense::operator()(const MatrixView& inputView) const
+{
+	Matrix result(this->_rows, inputView.getCols());
+	this->forward(inputView, result.data());
+	return result;
+}
+
+/**
+ * Applies the layer on a view into caller provided storage, allocating nothing
+ * @param inputView		MatrixView, getCols() samples
+ * @param output		rows * getCols() floats, row-major, must not alias the input
+ */
+void SparseDense::forward(const MatrixView& inputView, float* output) const
+{
+	const int batch = inputView.getCols();
+	if (inputView.getRows() != this->_cols)
+	{
+		std::cerr << SIZE_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (batch == 1 && inputView.getLd() == 1)
+	{
+		// one sample: bias and relu fused into the row sums, softmax only normalizes afterwards
+		const bool relu = this->_activation.getActivationType() == Relu;
+		this->_spmv(inputView.data(), output, relu);
+		if (!relu)
+		{
+			this->_activation.apply(output, this->_rows, 1);
+		}
+		return;
+	}
+	this->_spmm(inputView.data(), batch, inputView.getLd(), output);
+	this->_activation.apply(output, this->_rows, batch);
+}
+
+/**
+ * SpMV: one contiguous sample
+ * @param x			getCols() floats
+ * @param output	getRows() floats
+ * @param relu		clamp at 0
+ */
+void SparseDense::_spmv(const float* x, float* output, bool relu) const
+{
+	const float* bias = this->_biasMatrix.data();
+	if (this->_format == SparseBlocks)
+	{
+		kernels().denseBlocks(this->_rows, this->_rowStart.data(), this->_columns.data(), this->_values.data(), x,
+							  bias, output, relu);
+		return;
+	}
+	// CSR reads x through an index per weight, four independent sums hide the add latency
+	const float* values = this->_values.data();
+	const int* columns = this->_columns.data();
+	for (int row = 0; row < this->_rows; ++row)
+	{
+		float sums[CSR_SUMS] = {};
+		int entry = this->_rowStart[row];
+		const int end = this->_rowStart[row + 1];
+		for (; entry + CSR_SUMS <= end; entry += CSR_SUMS)
+		{
+			for (int i = 0; i < CSR_SUMS; ++i)
+			{
+				sums[i] += values[entry + i] * x[columns[entry + i]];
+			}
+		}
+		for (; entry < end; ++entry)
+		{
+			sums[0] += values[entry] * x[columns[entry]];
+		}
+		const float value = (sums[0] + sums[1]) + (sums[2] + sums[3]) + bias[row];
+		output[row] = relu && value < 0 ? 0 : value;
+	}
+}
+
+/**
+ * SpMM: a batch, one sample per column
+ * @param input		getCols() rows, batch cols, row stride ld
+ * @param batch		samples
+ * @param ld		input row stride
+ * @param output	getRows() * batch floats, row-major
+ */
+void SparseDense::_spmm(const float* input, int batch, int ld, float* output) const
+{
+	const float* bias = this->_biasMatrix.data();
+	const int width = this->_format == SparseBlocks ? SPARSE_BLOCK : 1;
+	for (int row = 0; row < this->_rows; ++row)
+	{
+		// every weight scales one contiguous input row into the output row, batch wide
+		float* out = output + (long) row * batch;
+		std::fill(out, out + batch, bias[row]);
+		for (int entry = this->_rowStart[row]; entry < this->_rowStart[row + 1]; ++entry)
+		{
+			const float* weights = this->_values.data() + (long) entry * width;
+			for (int i = 0; i < width; ++i)
+			{
+				const float weight = weights[i];
+				const float* in = input + (long) (this->_columns[entry] + i) * ld;
+				for (int sample = 0; sample < batch; ++sample)
+				{
+					out[sample] += weight * in[sample];
+				}
+			}
+		}
+	}
+}
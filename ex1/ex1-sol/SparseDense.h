@@ -0,0 +1,165 @@
+#ifndef SPARSE_DENSE_H
+#define SPARSE_DENSE_H
+
+#include <vector>
+#include "Matrix.h"
+#include "MatrixView.h"
+#include "Activation.h"
+#include "Dense.h"
+
+/**
+ * Storage formats of pruned weights
+ */
+enum SparseFormat
+{
+	/**
+	 * Compressed sparse rows: one column index per non-zero weight
+	 */
+	SparseCsr,
+	/**
+	 * 1 x SPARSE_BLOCK blocks of a row: one column index per block holding a non-zero
+	 * weight, the zeros inside a block are stored. Each block is one SIMD load.
+	 */
+	SparseBlocks
+};
+
+/**
+ * Class SparseDense
+ * Dense layer over pruned weights, stored in CSR or block-sparse form so only the
+ * non-zero weights are read and multiplied. Bias and activation are as in Dense.
+ */
+class SparseDense
+{
+ private:
+	/**
+	 * Output rows
+	 */
+	int _rows;
+
+	/**
+	 * Input length
+	 */
+	int _cols;
+
+	/**
+	 * Storage format
+	 */
+	SparseFormat _format;
+
+	/**
+	 * Row i holds the entries _rowStart[i] to _rowStart[i + 1] - 1, rows + 1 entries
+	 */
+	std::vector<int> _rowStart;
+
+	/**
+	 * Column of each entry: of the weight for CSR, of the first weight for blocks
+	 */
+	std::vector<int> _columns;
+
+	/**
+	 * Weights, one per CSR entry or SPARSE_BLOCK per block
+	 */
+	std::vector<float> _values;
+
+	/**
+	 * Bias matrix
+	 */
+	Matrix _biasMatrix;
+
+	/**
+	 * Activation type
+	 */
+	Activation _activation;
+
+	/**
+	 * SpMV: one contiguous sample
+	 * @param x			getCols() floats
+	 * @param output	getRows() floats
+	 * @param relu		clamp at 0
+	 */
+	void _spmv(const float* x, float* output, bool relu) const;
+
+	/**
+	 * SpMM: a batch, one sample per column
+	 * @param input		getCols() rows, batch cols, row stride ld
+	 * @param batch		samples
+	 * @param ld		input row stride
+	 * @param output	getRows() * batch floats, row-major
+	 */
+	void _spmm(const float* input, int batch, int ld, float* output) const;
+
+ public:
+	/**
+	 * Keeps the non-zero weights of a layer. Blocks need at least SPARSE_BLOCK inputs,
+	 * a narrower layer is stored as CSR.
+	 * @param layer		Dense
+	 * @param format	SparseFormat
+	 */
+	SparseDense(const Dense& layer, SparseFormat format);
+
+	/**
+	 * Fraction of the weights of a layer that are non-zero
+	 * @param layer	Dense
+	 * @return		density in [0, 1]
+	 */
+	static float density(const Dense& layer);
+
+	/**
+	 * returns the amount of output rows
+	 * @return	rows
+	 */
+	int getRows() const;
+
+	/**
+	 * returns the input length
+	 * @return	cols
+	 */
+	int getCols() const;
+
+	/**
+	 * Returns the storage format
+	 * @return	SparseFormat
+	 */
+	SparseFormat getFormat() const;
+
+	/**
+	 * Returns the stored weights, explicit zeros inside blocks included
+	 * @return	count
+	 */
+	long storedValues() const;
+
+	/**
+	 * Returns the bytes held by the weights and their indices
+	 * @return	bytes
+	 */
+	long weightBytes() const;
+
+	/**
+	 * Returns the bias of this layer
+	 * @return 	Bias matrix
+	 */
+	const Matrix& getBias() const;
+
+	/**
+	 * Returns the activation function of this layer
+	 * @return	Activation
+	 */
+	const Activation& getActivation() const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the layer on a view, a batch when it has several columns
+	 * @param inputView		MatrixView, one sample per column
+	 * @return				Matrix
+	 */
+	Matrix operator()(const MatrixView& inputView) const;
+
+	/**
+	 * Applies the layer on a view into caller provided storage, allocating nothing
+	 * @param inputView		MatrixView, getCols() samples
+	 * @param output		rows * getCols() floats, row-major, must not alias the input
+	 */
+	void forward(const MatrixView& inputView, float* output) const;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "SparseMlp.h"
+
+/**
+ * Converts the layers of network whose density is at most maxDensity
+ * @param network		MlpNetwork, must outlive this
+ * @param maxDensity	threshold in [0, 1], 1 converts every layer
+ * @param format		SparseFormat
+ */
+SparseMlp::SparseMlp(const MlpNetwork& network, float maxDensity, SparseFormat format) :
+	_network(network), _widest(0)
+{
+	for (const Dense& layer : network.getLayers())
+	{
+		if (SparseDense::density(layer) <= maxDensity)
+		{
+			this->_sparseIndex.push_back((int) this->_sparse.size());
+			this->_sparse.emplace_back(layer, format);
+		}
+		else
+		{
+			this->_sparseIndex.push_back(-1);
+		}
+		this->_widest = std::max(this->_widest, layer.getWeights().getRows());
+	}
+}
+
+/**
+ * Reads the load time options from SPARSE_DENSITY_ENV and SPARSE_FORMAT_ENV
+ * @param maxDensity	receives the threshold
+ * @param format		receives the SparseFormat
+ * @return				false if the conversion is not requested or the threshold is invalid
+ */
+bool SparseMlp::loadOptions(float& maxDensity, SparseFormat& format)
+{
+	const char* density = std::getenv(SPARSE_DENSITY_ENV);
+	if (density == nullptr)
+	{
+		return false;
+	}
+	char* end = nullptr;
+	maxDensity = std::strtof(density, &end);
+	const char* name = std::getenv(SPARSE_FORMAT_ENV);
+	format = name != nullptr && std::strcmp(name, SPARSE_FORMAT_CSR) == 0 ? SparseCsr : SparseBlocks;
+	return end != density && *end == '\0' && maxDensity >= 0 && maxDensity <= 1;
+}
+
+/**
+ * Returns the amount of converted layers
+ * @return	layers
+ */
+int SparseMlp::sparseLayers() const
+{
+	return (int) this->_sparse.size();
+}
+
+/**
+ * Returns the bytes held by the weights, sparse indices included
+ * @return	bytes
+ */
+long SparseMlp::weightBytes() const
+{
+	long bytes = 0;
+	const std::vector<Dense>& layers = this->_network.getLayers();
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		const Matrix& weights = layers[i].getWeights();
+		bytes += this->_sparseIndex[i] < 0 ? (long) weights.getRows() * weights.getCols() * (long) sizeof(float)
+										   : this->_sparse[this->_sparseIndex[i]].weightBytes();
+	}
+	return bytes;
+}
+
+/**
+ * Applies one layer, sparse or dense
+ * @param layer		index in the network
+ * @param input		MatrixView, one sample per column
+ * @param output	rows * input cols floats
+ */
+void SparseMlp::_forward(int layer, const MatrixView& input, float* output) const
+{
+	const int index = this->_sparseIndex[layer];
+	if (index < 0)
+	{
+		this->_network.getLayers()[layer].forward(input, output);
+	}
+	else
+	{
+		this->_sparse[index].forward(input, output);
+	}
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the entire network on input
+ * @param img	Image matrix
+ * @return		Digit
+ */
+Digit SparseMlp::operator()(const Matrix& img) const
+{
+	return (*this)(MatrixView(img).vectorize());
+}
+
+/**
+ * Parenthesis operator override,
+ * Applies the entire network on a view of the input, allocating nothing
+ * in steady state
+ * @param img	Image view, a column vector
+ * @return		Digit
+ */
+Digit SparseMlp::operator()(const MatrixView& img) const
+{
+	static thread_local MlpWorkspace workspace;
+	if (workspace.getWidth() < this->_widest)
+	{
+		workspace = MlpWorkspace(this->_widest);
+	}
+
+	const std::vector<Dense>& layers = this->_network.getLayers();
+	MatrixView input = img;
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		float* output = workspace.buffer((int) (i % MLP_PING_PONG));
+		this->_forward((int) i, input, output);
+		input = MatrixView(output, layers[i].getWeights().getRows(), 1, 1);
+	}
+	return MlpNetwork::mostProbable(input, 0);
+}
+
+/**
+ * Classifies a batch, one image per column, the sparse layers through SpMM
+ * @param batch	MatrixView, getInputs() rows
+ * @return		Digit per column
+ */
+std::vector<Digit> SparseMlp::classifyBatch(const MatrixView& batch) const
+{
+	const std::vector<Dense>& layers = this->_network.getLayers();
+	const int n = batch.getCols();
+	Matrix buffers[MLP_PING_PONG] = { Matrix(this->_widest, n), Matrix(this->_widest, n) };
+	MatrixView input = batch;
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		float* output = buffers[i % MLP_PING_PONG].data();
+		this->_forward((int) i, input, output);
+		input = MatrixView(output, layers[i].getWeights().getRows(), n, n);
+	}
+
+	std::vector<Digit> digits;
+	digits.reserve(n);
+	for (int col = 0; col < n; ++col)
+	{
+		digits.push_back(MlpNetwork::mostProbable(input, col));
+	}
+	return digits;
+}
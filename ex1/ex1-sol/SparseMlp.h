@@ -0,0 +1,110 @@
+#ifndef SPARSE_MLP_H
+#define SPARSE_MLP_H
+
+#include <vector>
+#include "MlpNetwork.h"
+#include "SparseDense.h"
+
+/**
+ * Environment variable enabling the sparse conversion at load time: layers whose
+ * weight density is at most its value, e.g. 0.3, become SparseDense
+ */
+#define SPARSE_DENSITY_ENV "MLP_SPARSE"
+
+/**
+ * Environment variable selecting the SparseFormat, SPARSE_FORMAT_CSR or blocks (the default)
+ */
+#define SPARSE_FORMAT_ENV "MLP_SPARSE_FORMAT"
+#define SPARSE_FORMAT_CSR "csr"
+
+/**
+ * Class SparseMlp
+ * An fp32 MlpNetwork whose pruned layers run on sparse weights. Layers denser than
+ * the threshold keep running on the network's Dense layers.
+ */
+class SparseMlp
+{
+ private:
+	/**
+	 * Network, dense layers and shapes
+	 */
+	const MlpNetwork& _network;
+
+	/**
+	 * Converted layers
+	 */
+	std::vector<SparseDense> _sparse;
+
+	/**
+	 * Per layer of the network: its index in _sparse, -1 for a dense layer
+	 */
+	std::vector<int> _sparseIndex;
+
+	/**
+	 * Buffer plan: the widest layer output, the size of each workspace buffer
+	 */
+	int _widest;
+
+	/**
+	 * Applies one layer, sparse or dense
+	 * @param layer		index in the network
+	 * @param input		MatrixView, one sample per column
+	 * @param output	rows * input cols floats
+	 */
+	void _forward(int layer, const MatrixView& input, float* output) const;
+
+ public:
+	/**
+	 * Converts the layers of network whose density is at most maxDensity
+	 * @param network		MlpNetwork, must outlive this
+	 * @param maxDensity	threshold in [0, 1], 1 converts every layer
+	 * @param format		SparseFormat
+	 */
+	SparseMlp(const MlpNetwork& network, float maxDensity, SparseFormat format);
+
+	/**
+	 * Reads the load time options from SPARSE_DENSITY_ENV and SPARSE_FORMAT_ENV
+	 * @param maxDensity	receives the threshold
+	 * @param format		receives the SparseFormat
+	 * @return				false if the conversion is not requested or the threshold is invalid
+	 */
+	static bool loadOptions(float& maxDensity, SparseFormat& format);
+
+	/**
+	 * Returns the amount of converted layers
+	 * @return	layers
+	 */
+	int sparseLayers() const;
+
+	/**
+	 * Returns the bytes held by the weights, sparse indices included
+	 * @return	bytes
+	 */
+	long weightBytes() const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the entire network on input
+	 * @param img	Image matrix
+	 * @return		Digit
+	 */
+	Digit operator()(const Matrix& img) const;
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the entire network on a view of the input, allocating nothing
+	 * in steady state
+	 * @param img	Image view, a column vector
+	 * @return		Digit
+	 */
+	Digit operator()(const MatrixView& img) const;
+
+	/**
+	 * Classifies a batch, one image per column, the sparse layers through SpMM
+	 * @param batch	MatrixView, getInputs() rows
+	 * @return		Digit per column
+	 */
+	std::vector<Digit> classifyBatch(const MatrixView& batch) const;
+};
+
+#endif
@@ -0,0 +1,442 @@
+#ifndef STATIC_MLP_HPP
+#define STATIC_MLP_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "Matrix.h"
+#include "MatrixView.h"
+#include "MatrixAllocator.h"
+#include "Digit.h"
+#include "KernelsSimd.h"
+
+#define STATIC_SIZE_ERROR "ERROR: matrix size is invalid for this operation"
+
+/**
+ * Independent partial sums per row in the static dense loops, one AVX-512 register.
+ * The reduction in staticDense is written for exactly 16.
+ */
+#define STATIC_LANES 16
+
+/**
+ * Rows sharing each load of the input in the static dense loops
+ */
+#define STATIC_ROWS 4
+
+/**
+ * Class StaticMatrix
+ * R * C floats stored inline, dims are template parameters so loops over them
+ * have constant trip counts and element access is unchecked.
+ * Small instances are meant for the stack.
+ */
+template<int R, int C>
+class StaticMatrix
+{
+	static_assert(R > 0 && C > 0, "StaticMatrix dims must be positive");
+
+ private:
+	/**
+	 * Elements, row-major
+	 */
+	alignas(MATRIX_ALIGNMENT) float _data[R * C];
+
+ public:
+	/**
+	 * Rows
+	 */
+	static constexpr int rows = R;
+
+	/**
+	 * Cols
+	 */
+	static constexpr int cols = C;
+
+	/**
+	 * Constructs an uninitialized matrix
+	 */
+	StaticMatrix() = default;
+
+	/**
+	 * Copies a view of the same dims
+	 * Exits (code == 1) on other dims.
+	 * @param view	MatrixView
+	 */
+	explicit StaticMatrix(const MatrixView& view)
+	{
+		if (view.getRows() != R || view.getCols() != C)
+		{
+			std::cerr << STATIC_SIZE_ERROR << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		for (int row = 0; row < R; ++row)
+		{
+			for (int col = 0; col < C; ++col)
+			{
+				this->_data[row * C + col] = view.data()[row * view.getLd() + col];
+			}
+		}
+	}
+
+	/**
+	 * Returns the elements
+	 * @return	float array
+	 */
+	float* data()
+	{
+		return this->_data;
+	}
+
+	/**
+	 * Returns the elements
+	 * @return	float array
+	 */
+	const float* data() const
+	{
+		return this->_data;
+	}
+
+	/**
+	 * Parenthesis indexing, unchecked
+	 * @param row	row
+	 * @param col	column
+	 * @return		this(row, col)
+	 */
+	float& operator()(int row, int col)
+	{
+		return this->_data[row * C + col];
+	}
+
+	/**
+	 * Parenthesis indexing, unchecked
+	 * @param row	row
+	 * @param col	column
+	 * @return		this(row, col)
+	 */
+	const float& operator()(int row, int col) const
+	{
+		return this->_data[row * C + col];
+	}
+
+	/**
+	 * Brackets indexing, unchecked
+	 * @param index	index
+	 * @return		this[index]
+	 */
+	float& operator[](int index)
+	{
+		return this->_data[index];
+	}
+
+	/**
+	 * Brackets indexing, unchecked
+	 * @param index	index
+	 * @return		this[index]
+	 */
+	const float& operator[](int index) const
+	{
+		return this->_data[index];
+	}
+
+	/**
+	 * Views the matrix
+	 * @return	MatrixView
+	 */
+	MatrixView view() const
+	{
+		return MatrixView(this->_data, R, C, C);
+	}
+};
+
+/**
+ * STATIC_LANES floats as one GCC vector: a zmm register in the avx512f clone,
+ * two ymm in the avx2 clone, four xmm otherwise
+ */
+typedef float StaticLanes __attribute__((vector_size(STATIC_LANES * sizeof(float))));
+
+/**
+ * Lane indices for __builtin_shuffle on StaticLanes
+ */
+typedef int StaticMask __attribute__((vector_size(STATIC_LANES * sizeof(int))));
+
+/**
+ * Dense layer with constant dims, y = w * x + bias, clamped at 0 when Relu.
+ * STATIC_ROWS rows share each load of x, each row accumulates in one StaticLanes
+ * and with the trip counts known the compiler fully unrolls the tails.
+ * @param w		Out * In weights, row-major
+ * @param bias	Out biases
+ * @param x		In inputs
+ * @param y		Out outputs, must not alias x
+ */
+template<int Out, int In, bool Relu>
+TARGET_CLONES void staticDense(const float* w, const float* bias, const float* x, float* y)
+{
+	static_assert(STATIC_LANES == 16, "the reduction below folds exactly 16 lanes");
+	constexpr int blocked = In / STATIC_LANES * STATIC_LANES;
+	constexpr int fullRows = Out / STATIC_ROWS * STATIC_ROWS;
+	for (int row = 0; row < Out; row += STATIC_ROWS)
+	{
+		const int count = row < fullRows ? STATIC_ROWS : Out - fullRows;
+		StaticLanes acc[STATIC_ROWS] = {};
+		StaticLanes xi;
+		StaticLanes wi;
+		if (count == STATIC_ROWS)
+		{
+			for (int i = 0; i < blocked; i += STATIC_LANES)
+			{
+				std::memcpy(&xi, x + i, sizeof(xi));
+				for (int r = 0; r < STATIC_ROWS; ++r)
+				{
+					std::memcpy(&wi, w + (row + r) * In + i, sizeof(wi));
+					acc[r] += wi * xi;
+				}
+			}
+		}
+		else
+		{
+			for (int i = 0; i < blocked; i += STATIC_LANES)
+			{
+				std::memcpy(&xi, x + i, sizeof(xi));
+				for (int r = 0; r < count; ++r)
+				{
+					std::memcpy(&wi, w + (row + r) * In + i, sizeof(wi));
+					acc[r] += wi * xi;
+				}
+			}
+		}
+
+		for (int r = 0; r < count; ++r)
+		{
+			// fold halves onto each other, 4 vector adds instead of 15 dependent scalar ones
+			StaticLanes folded = acc[r];
+			folded += __builtin_shuffle(folded, StaticMask{ 8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7 });
+			folded += __builtin_shuffle(folded, StaticMask{ 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3 });
+			folded += __builtin_shuffle(folded, StaticMask{ 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1 });
+			folded += __builtin_shuffle(folded, StaticMask{ 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0 });
+			float sum = folded[0];
+			for (int i = blocked; i < In; ++i)
+			{
+				sum += w[(row + r) * In + i] * x[i];
+			}
+			sum += bias[row + r];
+			y[row + r] = Relu && sum < 0 ? 0 : sum;
+		}
+	}
+}
+
+/**
+ * Class StaticLayers
+ * The layer chain of a StaticMlp: Sizes are the layer widths, input first.
+ * Hidden layers use ReLU, the last one softmax.
+ */
+template<int... Sizes>
+class StaticLayers;
+
+/**
+ * Output layer
+ */
+template<int In, int Out>
+class StaticLayers<In, Out>
+{
+ private:
+	/**
+	 * Weights matrix
+	 */
+	StaticMatrix<Out, In> _weights;
+
+	/**
+	 * Bias matrix
+	 */
+	StaticMatrix<Out, 1> _bias;
+
+ public:
+	/**
+	 * Copies the parameters of this layer
+	 * @param weights	Weights views array, this layer first
+	 * @param biases	Biases views array, this layer first
+	 */
+	StaticLayers(const MatrixView weights[], const MatrixView biases[]) : _weights(weights[0]), _bias(biases[0])
+	{
+	}
+
+	/**
+	 * Applies this layer and softmax
+	 * @param x				In inputs
+	 * @param probabilities	Out outputs
+	 */
+	void forward(const float* x, float* probabilities) const
+	{
+		staticDense<Out, In, false>(this->_weights.data(), this->_bias.data(), x, probabilities);
+		float sum = 0;
+		for (int i = 0; i < Out; ++i)
+		{
+			probabilities[i] = std::exp(probabilities[i]);
+			sum += probabilities[i];
+		}
+		for (int i = 0; i < Out; ++i)
+		{
+			probabilities[i] /= sum;
+		}
+	}
+};
+
+/**
+ * Hidden layer followed by the rest of the chain
+ */
+template<int In, int Out, int Next, int... Rest>
+class StaticLayers<In, Out, Next, Rest...>
+{
+ private:
+	/**
+	 * Weights matrix
+	 */
+	StaticMatrix<Out, In> _weights;
+
+	/**
+	 * Bias matrix
+	 */
+	StaticMatrix<Out, 1> _bias;
+
+	/**
+	 * Following layers
+	 */
+	StaticLayers<Out, Next, Rest...> _next;
+
+ public:
+	/**
+	 * Copies the parameters of this layer and the following ones
+	 * @param weights	Weights views array, this layer first
+	 * @param biases	Biases views array, this layer first
+	 */
+	StaticLayers(const MatrixView weights[], const MatrixView biases[]) :
+		_weights(weights[0]), _bias(biases[0]), _next(weights + 1, biases + 1)
+	{
+	}
+
+	/**
+	 * Applies this layer with ReLU, then the following ones.
+	 * The intermediate lives on the stack.
+	 * @param x				In inputs
+	 * @param probabilities	outputs of the last layer
+	 */
+	void forward(const float* x, float* probabilities) const
+	{
+		alignas(MATRIX_ALIGNMENT) float hidden[Out];
+		staticDense<Out, In, true>(this->_weights.data(), this->_bias.data(), x, hidden);
+		this->_next.forward(hidden, probabilities);
+	}
+};
+
+/**
+ * Class StaticMlp
+ * Network whose layer widths are template parameters, input first, e.g.
+ * StaticMlp<784, 128, 64, 20, 10>. Parameters are copied into inline storage,
+ * forward passes allocate nothing and run on constant trip counts.
+ * The runtime-shaped MlpNetwork remains the path for other models.
+ * Parameters of a real model do not fit the stack: create it with new,
+ * which returns MATRIX_ALIGNMENT aligned storage.
+ */
+template<int... Sizes>
+class StaticMlp
+{
+	static_assert(sizeof...(Sizes) >= 2, "StaticMlp needs an input and an output width");
+
+ private:
+	/**
+	 * Widths, input first
+	 */
+	static constexpr int _sizes[] = { Sizes... };
+
+	/**
+	 * Layers
+	 */
+	StaticLayers<Sizes...> _layers;
+
+ public:
+	/**
+	 * Number of layers
+	 */
+	static constexpr int layers = sizeof...(Sizes) - 1;
+
+	/**
+	 * Input width
+	 */
+	static constexpr int inputs = _sizes[0];
+
+	/**
+	 * Output width
+	 */
+	static constexpr int outputs = _sizes[sizeof...(Sizes) - 1];
+
+	/**
+	 * Constructor
+	 * Copies the parameters, exits (code == 1) if a shape does not match.
+	 * @param weights	Weights views array, size layers
+	 * @param biases	Biases views array, size layers
+	 */
+	StaticMlp(const MatrixView weights[], const MatrixView biases[]) : _layers(weights, biases)
+	{
+	}
+
+	/**
+	 * Parenthesis operator override,
+	 * Applies the entire network on input
+	 * @param img	Image view, inputs elements, contiguous
+	 * @return		Digit
+	 */
+	Digit operator()(const MatrixView& img) const
+	{
+		if (img.getRows() * img.getCols() != inputs || !img.isContiguous())
+		{
+			std::cerr << STATIC_SIZE_ERROR << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		alignas(MATRIX_ALIGNMENT) float probabilities[outputs];
+		this->_layers.forward(img.data(), probabilities);
+
+		Digit digit = { 0, probabilities[0] };
+		for (int i = 1; i < outputs; ++i)
+		{
+			if (probabilities[i] > digit.probability)
+			{
+				digit.probability = probabilities[i];
+				digit.value = i;
+			}
+		}
+		return digit;
+	}
+
+	/**
+	 * Aligned allocation, plain new only guarantees 16 bytes before C++17
+	 * @param size	bytes
+	 * @return		storage
+	 */
+	static void* operator new(size_t size)
+	{
+		void* memory = nullptr;
+		if (posix_memalign(&memory, MATRIX_ALIGNMENT, size) != 0)
+		{
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	/**
+	 * Releases storage from operator new
+	 * @param memory	storage
+	 */
+	static void operator delete(void* memory)
+	{
+		std::free(memory);
+	}
+};
+
+template<int... Sizes>
+constexpr int StaticMlp<Sizes...>::_sizes[];
+
+/**
+ * The shipped digits network, 784 -> 128 -> 64 -> 20 -> 10
+ */
+typedef StaticMlp<784, 128, 64, 20, 10> StaticDigitsMlp;
+
+#endif
@@ -0,0 +1,162 @@
+#include "ThreadPool.h"
+
+#define NO_WORKER (-1)
+
+/**
+ * Worker index of the current thread
+ */
+static thread_local int currentWorker = NO_WORKER;
+
+/**
+ * Starts the workers
+ * @param threads	number of workers, at least 1
+ */
+ThreadPool::ThreadPool(int threads) : _pending(0), _queued(0), _nextQueue(0), _stopping(false)
+{
+	const int count = threads < 1 ? 1 : threads;
+	for (int i = 0; i < count; ++i)
+	{
+		this->_queues.emplace_back(new WorkerQueue());
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		this->_threads.emplace_back(&ThreadPool::_run, this, i);
+	}
+}
+
+/**
+ * Runs the remaining tasks, then joins the workers
+ */
+ThreadPool::~ThreadPool()
+{
+	this->wait();
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_stopping = true;
+	}
+	this->_workAvailable.notify_all();
+	for (std::thread& thread : this->_threads)
+	{
+		thread.join();
+	}
+}
+
+/**
+ * Returns the number of workers
+ * @return	workers
+ */
+int ThreadPool::size() const
+{
+	return (int) this->_queues.size();
+}
+
+/**
+ * Queues a task. From a worker it goes to that worker's deque,
+ * otherwise the deques are filled round robin.
+ * @param task	Task
+ */
+void ThreadPool::submit(Task task)
+{
+	const int size = this->size();
+	const int target = currentWorker >= 0 && currentWorker < size ?
+					   currentWorker : (int) (this->_nextQueue++ % (unsigned) size);
+	this->_pending++;
+	{
+		WorkerQueue& queue = *this->_queues[target];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	{
+		// publish under the sleep mutex so a worker about to sleep cannot miss it
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_queued++;
+	}
+	this->_workAvailable.notify_one();
+}
+
+/**
+ * Blocks until every submitted task has finished
+ */
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(this->_mutex);
+	this->_allDone.wait(lock, [this]() { return this->_pending == 0; });
+}
+
+/**
+ * Index of the calling worker
+ * @return	worker index, -1 when not called from a worker of any pool
+ */
+int ThreadPool::workerIndex()
+{
+	return currentWorker;
+}
+
+/**
+ * Takes a task, own deque first, then steals
+ * @param index	worker index
+ * @param task	receives the task
+ * @return		false if every deque is empty
+ */
+bool ThreadPool::_take(int index, Task& task)
+{
+	{
+		WorkerQueue& own = *this->_queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	const int size = this->size();
+	for (int offset = 1; offset < size; ++offset)
+	{
+		WorkerQueue& victim = *this->_queues[(index + offset) % size];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Worker loop
+ * @param index	worker index
+ */
+void ThreadPool::_run(int index)
+{
+	currentWorker = index;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			this->_workAvailable.wait(lock, [this]() { return this->_queued > 0 || this->_stopping; });
+			if (this->_queued == 0 && this->_stopping)
+			{
+				return;
+			}
+		}
+
+		Task task;
+		if (!this->_take(index, task))
+		{
+			// another worker got there first
+			continue;
+		}
+		this->_queued--;
+		task(index);
+
+		if (--this->_pending == 0)
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_allDone.notify_all();
+		}
+	}
+}
@@ -0,0 +1,137 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Class ThreadPool
+ * Fixed set of workers, each with its own task deque.
+ * A worker runs its own deque newest first and, when it runs dry, steals the
+ * oldest task of another worker, so uneven shards still keep every core busy.
+ * Tasks receive the index of the worker running them, for per-worker scratch state.
+ */
+class ThreadPool
+{
+ public:
+	/**
+	 * Task signature, the argument is the worker index in [0, size())
+	 */
+	typedef std::function<void(int)> Task;
+
+	/**
+	 * Starts the workers
+	 * @param threads	number of workers, at least 1
+	 */
+	explicit ThreadPool(int threads);
+
+	/**
+	 * Runs the remaining tasks, then joins the workers
+	 */
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * Returns the number of workers
+	 * @return	workers
+	 */
+	int size() const;
+
+	/**
+	 * Queues a task. From a worker it goes to that worker's deque,
+	 * otherwise the deques are filled round robin.
+	 * @param task	Task
+	 */
+	void submit(Task task);
+
+	/**
+	 * Blocks until every submitted task has finished
+	 */
+	void wait();
+
+	/**
+	 * Index of the calling worker
+	 * @return	worker index, -1 when not called from a worker of any pool
+	 */
+	static int workerIndex();
+
+ private:
+	/**
+	 * @struct WorkerQueue
+	 * @brief One worker's deque, owner pops the back, thieves pop the front
+	 */
+	typedef struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	} WorkerQueue;
+
+	/**
+	 * Per worker deques
+	 */
+	std::vector<std::unique_ptr<WorkerQueue>> _queues;
+
+	/**
+	 * Worker threads
+	 */
+	std::vector<std::thread> _threads;
+
+	/**
+	 * Guards sleeping and waking
+	 */
+	std::mutex _mutex;
+
+	/**
+	 * Signalled when a task is queued or the pool stops
+	 */
+	std::condition_variable _workAvailable;
+
+	/**
+	 * Signalled when the last pending task finishes
+	 */
+	std::condition_variable _allDone;
+
+	/**
+	 * Tasks queued or running
+	 */
+	std::atomic<long> _pending;
+
+	/**
+	 * Tasks queued, not yet taken
+	 */
+	std::atomic<long> _queued;
+
+	/**
+	 * Round robin cursor for external submissions
+	 */
+	std::atomic<unsigned> _nextQueue;
+
+	/**
+	 * Set by the destructor
+	 */
+	bool _stopping;
+
+	/**
+	 * Worker loop
+	 * @param index	worker index
+	 */
+	void _run(int index);
+
+	/**
+	 * Takes a task, own deque first, then steals
+	 * @param index	worker index
+	 * @param task	receives the task
+	 * @return		false if every deque is empty
+	 */
+	bool _take(int index, Task& task);
+};
+
+#endif
@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <utility>
+#include "Trainer.h"
+#include "Activation.h"
+#include "Gemm.h"
+#include "Kernels.h"
+#include "ModelDescription.h"
+
+#define UPDATE_CHUNK 16384
+#define PIXEL_SCALE (1.0f / 255.0f)
+#define IDX_WORD_BYTES 4
+#define MODEL_FILE "/model.txt"
+#define WEIGHTS_FILE "/w"
+#define BIAS_FILE "/b"
+#define MODEL_HEADER "# Trained parameters, one layer per line, input first:\n" \
+                     "# weights-file bias-file rows cols activation\n"
+#define INVALID_WIDTHS_ERROR "ERROR: training needs at least an input and an output width"
+#define INVALID_LAYERS_ERROR "ERROR: training needs ReLU layers and a softmax output layer"
+#define INVALID_SET_ERROR "ERROR: samples do not match the input width or the labels"
+#define INVALID_LABEL_ERROR "ERROR: label outside the output layer: "
+#define INVALID_BATCH_ERROR "ERROR: minibatch of invalid size: "
+
+/**
+ * Reads a big-endian 32 bit word of an IDX header
+ * @param is	stream
+ * @param word	receives the word
+ * @return		false past the end
+ */
+static bool readWord(std::istream& is, uint32_t& word)
+{
+	unsigned char bytes[IDX_WORD_BYTES] = {};
+	is.read(reinterpret_cast<char*>(bytes), IDX_WORD_BYTES);
+	word = (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 | (uint32_t) bytes[2] << 8 | bytes[3];
+	return is.good();
+}
+
+/**
+ * Reads an MNIST IDX pair: images (magic IDX_IMAGES_MAGIC, count, rows, cols, then
+ * unsigned pixels) and labels (magic IDX_LABELS_MAGIC, count, then unsigned labels),
+ * big-endian. Pixels are scaled to [0, 1] like the shipped images.
+ * @param imagesPath	images file
+ * @param labelsPath	labels file
+ * @param set			receives the samples, one image per row
+ * @return				false if a file is missing, malformed or the counts differ
+ */
+bool readIdx(const std::string& imagesPath, const std::string& labelsPath, TrainingSet& set)
+{
+	std::ifstream images(imagesPath, std::ios::in | std::ios::binary);
+	std::ifstream labels(labelsPath, std::ios::in | std::ios::binary);
+	uint32_t imagesMagic = 0, count = 0, rows = 0, cols = 0, labelsMagic = 0, labelsCount = 0;
+	if (!readWord(images, imagesMagic) || !readWord(images, count) || !readWord(images, rows) ||
+		!readWord(images, cols) || !readWord(labels, labelsMagic) || !readWord(labels, labelsCount))
+	{
+		return false;
+	}
+	const uint64_t pixelCount = (uint64_t) count * rows * cols;
+	if (imagesMagic != IDX_IMAGES_MAGIC || labelsMagic != IDX_LABELS_MAGIC || count != labelsCount ||
+		count == 0 || rows * cols == 0 || pixelCount > (uint64_t) INT32_MAX)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> pixels(pixelCount);
+	std::vector<unsigned char> classes(count);
+	images.read(reinterpret_cast<char*>(pixels.data()), (long) pixelCount);
+	labels.read(reinterpret_cast<char*>(classes.data()), count);
+	if (!images.good() || !labels.good())
+	{
+		return false;
+	}
+	set.images = Matrix((int) count, (int) (rows * cols));
+	float* values = set.images.data();
+	for (uint64_t i = 0; i < pixelCount; ++i)
+	{
+		values[i] = pixels[i] * PIXEL_SCALE;
+	}
+	set.labels.assign(classes.begin(), classes.end());
+	return true;
+}
+
+/**
+ * Starts from He initialized ReLU layers and a softmax output layer
+ * @param widths	layer sizes, input first, e.g. 784 128 64 20 10
+ * @param options	TrainingOptions
+ */
+Trainer::Trainer(const std::vector<int>& widths, const TrainingOptions& options) :
+		_options(options), _step(0), _random(options.seed)
+{
+	if (widths.size() < 2 || *std::min_element(widths.begin(), widths.end()) <= 0)
+	{
+		std::cerr << INVALID_WIDTHS_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	for (size_t i = 1; i < widths.size(); ++i)
+	{
+		// He uniform, variance 2 / fan-in, keeps the ReLU activations from fading layer by layer
+		const float limit = std::sqrt(6.0f / (float) widths[i - 1]);
+		std::uniform_real_distribution<float> uniform(-limit, limit);
+		Matrix weights(widths[i], widths[i - 1]);
+		for (int j = 0; j < widths[i] * widths[i - 1]; ++j)
+		{
+			weights[j] = uniform(this->_random);
+		}
+		this->_parameters.push_back(std::move(weights));
+		this->_parameters.emplace_back(widths[i], 1);
+	}
+	this->_allocate();
+}
+
+/**
+ * Continues from existing layers, copying their parameters
+ * @param layers	ReLU layers and a softmax output layer, input first
+ * @param options	TrainingOptions
+ */
+Trainer::Trainer(const std::vector<Dense>& layers, const TrainingOptions& options) :
+		_options(options), _step(0), _random(options.seed)
+{
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		const ActivationType expected = i + 1 == layers.size() ? Softmax : Relu;
+		if (layers[i].getActivation().getActivationType() != expected ||
+			(i > 0 && layers[i].getWeights().getCols() != layers[i - 1].getWeights().getRows()))
+		{
+			std::cerr << INVALID_LAYERS_ERROR << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		this->_parameters.push_back(layers[i].getWeights());
+		this->_parameters.emplace_back(layers[i].getBias().getRows(), 1);
+		std::copy(layers[i].getBias().data(), layers[i].getBias().data() + layers[i].getBias().getRows(),
+				  this->_parameters.back().data());
+	}
+	if (layers.empty())
+	{
+		std::cerr << INVALID_LAYERS_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	this->_allocate();
+}
+
+/**
+ * Allocates the optimizer and shard state once the parameters are known
+ */
+void Trainer::_allocate()
+{
+	this->_options.threads = std::max(1, this->_options.threads);
+	this->_options.batchSize = std::max(1, this->_options.batchSize);
+	const int shardRows = (this->_options.batchSize + this->_options.threads - 1) / this->_options.threads;
+	int widest = 0;
+	for (int layer = 0; layer < this->_layers(); ++layer)
+	{
+		const Matrix& weights = this->_parameters[2 * layer];
+		widest = std::max(widest, weights.getRows());
+	}
+	for (const Matrix& parameter : this->_parameters)
+	{
+		this->_moments.emplace_back(parameter.getRows(), parameter.getCols());
+		if (this->_options.optimizer == OptimizerAdam)
+		{
+			this->_squares.emplace_back(parameter.getRows(), parameter.getCols());
+		}
+	}
+
+	this->_shards.resize(this->_options.threads);
+	for (Shard& shard : this->_shards)
+	{
+		for (int layer = 0; layer < this->_layers(); ++layer)
+		{
+			shard.activations.emplace_back(shardRows, this->_parameters[2 * layer].getRows());
+		}
+		shard.deltas[0] = Matrix(shardRows, widest);
+		shard.deltas[1] = Matrix(shardRows, widest);
+		for (const Matrix& parameter : this->_parameters)
+		{
+			shard.gradients.emplace_back(parameter.getRows(), parameter.getCols());
+		}
+		shard.loss = 0;
+		shard.correct = 0;
+	}
+	this->_pool.reset(new ThreadPool(this->_options.threads));
+	this->_batch = Matrix(this->_options.batchSize, this->_parameters[0].getCols());
+	this->_batchLabels.resize(this->_options.batchSize);
+}
+
+/**
+ * Returns the amount of layers
+ * @return	layers
+ */
+int Trainer::_layers() const
+{
+	return (int) this->_parameters.size() / 2;
+}
+
+/**
+ * Forward pass of a shard, caches every layer's output and counts the loss
+ * @param shard		Shard
+ * @param images	rows x inputs, one sample per row
+ * @param labels	rows labels
+ * @param rows		samples
+ */
+void Trainer::_forward(Shard& shard, const float* images, const int* labels, int rows) const
+{
+	const KernelTable& table = kernels();
+	const float* input = images;
+	int inputs = this->_parameters[0].getCols();
+	for (int layer = 0; layer < this->_layers(); ++layer)
+	{
+		const Matrix& bias = this->_parameters[2 * layer + 1];
+		const int outputs = bias.getRows();
+		float* output = shard.activations[layer].data();
+		const Matrix& weights = this->_parameters[2 * layer];
+		gemm(GemmNormal, GemmTransposed, rows, outputs, inputs, input, inputs, weights.data(), inputs,
+			 output, outputs);
+		for (int row = 0; row < rows; ++row)
+		{
+			table.add(output + row * outputs, bias.data(), output + row * outputs, outputs);
+		}
+		if (layer + 1 < this->_layers())
+		{
+			table.relu(output, output, rows * outputs);
+		}
+		else
+		{
+			Activation::softmax(output, output, rows, outputs, SoftmaxRows);
+		}
+		input = output;
+		inputs = outputs;
+	}
+
+	shard.loss = 0;
+	shard.correct = 0;
+	for (int row = 0; row < rows; ++row)
+	{
+		const float* probabilities = input + row * inputs;
+		shard.loss -= std::log(std::max(probabilities[labels[row]], FLT_MIN));
+		shard.correct += std::max_element(probabilities, probabilities + inputs) - probabilities == labels[row];
+	}
+}
+
+/**
+ * Backward pass of a shard after its forward pass, writes its gradients
+ * @param shard		Shard
+ * @param images	rows x inputs, one sample per row
+ * @param labels	rows labels
+ * @param rows		samples
+ * @param scale		loss weight of every sample, 1 / minibatch size
+ */
+void Trainer::_backward(Shard& shard, const float* images, const int* labels, int rows, float scale) const
+{
+	const KernelTable& table = kernels();
+	int current = 0;
+	// softmax followed by cross-entropy: the logits gradient is probabilities - one-hot label
+	const int classes = this->_parameters.back().getRows();
+	float* delta = shard.deltas[current].data();
+	table.scale(shard.activations.back().data(), scale, delta, rows * classes);
+	for (int row = 0; row < rows; ++row)
+	{
+		delta[row * classes + labels[row]] -= scale;
+	}
+
+	for (int layer = this->_layers() - 1; layer >= 0; --layer)
+	{
+		const Matrix& weights = this->_parameters[2 * layer];
+		const int outputs = weights.getRows();
+		const int inputs = weights.getCols();
+		const float* input = layer == 0 ? images : shard.activations[layer - 1].data();
+		delta = shard.deltas[current].data();
+
+		// dW = delta^T * input, db = column sums of delta
+		gemm(GemmTransposed, GemmNormal, outputs, inputs, rows, delta, outputs, input, inputs,
+			 shard.gradients[2 * layer].data(), inputs);
+		float* biasGradient = shard.gradients[2 * layer + 1].data();
+		std::copy(delta, delta + outputs, biasGradient);
+		for (int row = 1; row < rows; ++row)
+		{
+			table.add(biasGradient, delta + row * outputs, biasGradient, outputs);
+		}
+
+		if (layer > 0)
+		{
+			// d input = delta * W, then ReLU passes it only where its output was positive
+			float* below = shard.deltas[1 - current].data();
+			gemm(rows, inputs, outputs, delta, outputs, weights.data(), inputs, below, inputs);
+			const float* activation = shard.activations[layer - 1].data();
+			for (int i = 0; i < rows * inputs; ++i)
+			{
+				below[i] = activation[i] > 0 ? below[i] : 0;
+			}
+			current = 1 - current;
+		}
+	}
+}
+
+/**
+ * Runs the forward pass, and the backward pass when scale is non-zero, of samples
+ * split into shards
+ * @param images	n x inputs, one sample per row
+ * @param labels	n labels
+ * @param n			samples, at most batchSize
+ * @param scale		loss weight of every sample, 0 for the forward pass only
+ * @return			shards that ran
+ */
+int Trainer::_runShards(const float* images, const int* labels, int n, float scale)
+{
+	if (n <= 0 || n > this->_options.batchSize)
+	{
+		std::cerr << INVALID_BATCH_ERROR << n << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	const int classes = this->_parameters.back().getRows();
+	for (int i = 0; i < n; ++i)
+	{
+		if (labels[i] < 0 || labels[i] >= classes)
+		{
+			std::cerr << INVALID_LABEL_ERROR << labels[i] << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	const int inputs = this->_parameters[0].getCols();
+	const int shardRows = (n + (int) this->_shards.size() - 1) / (int) this->_shards.size();
+	int used = 0;
+	for (int begin = 0; begin < n; begin += shardRows, ++used)
+	{
+		Shard* shard = &this->_shards[used];
+		const float* shardImages = images + (size_t) begin * inputs;
+		const int* shardLabels = labels + begin;
+		const int rows = std::min(shardRows, n - begin);
+		this->_pool->submit([this, shard, shardImages, shardLabels, rows, scale](int)
+							{
+								this->_forward(*shard, shardImages, shardLabels, rows);
+								if (scale != 0)
+								{
+									this->_backward(*shard, shardImages, shardLabels, rows, scale);
+								}
+							});
+	}
+	this->_pool->wait();
+	return used;
+}
+
+/**
+ * Sums the gradients of the used shards into the first one and updates a range of
+ * one parameter tensor
+ * @param tensor	index in _parameters
+ * @param begin		first element
+ * @param end		past the last element
+ * @param shards	shards that ran
+ */
+void Trainer::_update(int tensor, int begin, int end, int shards)
+{
+	const KernelTable& table = kernels();
+	float* gradient = this->_shards[0].gradients[tensor].data() + begin;
+	for (int shard = 1; shard < shards; ++shard)
+	{
+		table.add(gradient, this->_shards[shard].gradients[tensor].data() + begin, gradient, end - begin);
+	}
+
+	float* parameter = this->_parameters[tensor].data() + begin;
+	float* moment = this->_moments[tensor].data() + begin;
+	const float rate = this->_options.learningRate;
+	if (this->_options.optimizer == OptimizerAdam)
+	{
+		const float beta1 = this->_options.beta1;
+		const float beta2 = this->_options.beta2;
+		// the moments start at zero, the correction removes their bias towards it early on
+		const float correctedRate = rate * std::sqrt(1 - std::pow(beta2, (float) this->_step)) /
+									(1 - std::pow(beta1, (float) this->_step));
+		float* square = this->_squares[tensor].data() + begin;
+		for (int i = 0; i < end - begin; ++i)
+		{
+			moment[i] = beta1 * moment[i] + (1 - beta1) * gradient[i];
+			square[i] = beta2 * square[i] + (1 - beta2) * gradient[i] * gradient[i];
+			parameter[i] -= correctedRate * moment[i] / (std::sqrt(square[i]) + this->_options.epsilon);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < end - begin; ++i)
+		{
+			moment[i] = this->_options.momentum * moment[i] + gradient[i];
+			parameter[i] -= rate * moment[i];
+		}
+	}
+}
+
+/**
+ * One parameter update on a minibatch
+ * @param images	n x inputs, one sample per row
+ * @param labels	n labels
+ * @param n			samples, at most batchSize
+ * @return			mean cross-entropy before the update
+ */
+float Trainer::trainBatch(const float* images, const int* labels, int n)
+{
+	const int shards = this->_runShards(images, labels, n, 1.0f / (float) n);
+	double loss = 0;
+	for (int shard = 0; shard < shards; ++shard)
+	{
+		loss += this->_shards[shard].loss;
+	}
+
+	++this->_step;
+	for (int tensor = 0; tensor < (int) this->_parameters.size(); ++tensor)
+	{
+		const int size = this->_parameters[tensor].getRows() * this->_parameters[tensor].getCols();
+		for (int begin = 0; begin < size; begin += UPDATE_CHUNK)
+		{
+			const int end = std::min(begin + UPDATE_CHUNK, size);
+			this->_pool->submit([this, tensor, begin, end, shards](int)
+								{
+									this->_update(tensor, begin, end, shards);
+								});
+		}
+	}
+	this->_pool->wait();
+	return (float) (loss / n);
+}
+
+/**
+ * One pass over a shuffled set, the last minibatch may be smaller
+ * @param set	TrainingSet
+ * @return		mean cross-entropy of the minibatches before their updates
+ */
+float Trainer::trainEpoch(const TrainingSet& set)
+{
+	const int count = set.images.getRows();
+	const int inputs = set.images.getCols();
+	if (inputs != this->_parameters[0].getCols() || (int) set.labels.size() != count || count == 0)
+	{
+		std::cerr << INVALID_SET_ERROR << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::vector<int> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), this->_random);
+
+	double loss = 0;
+	for (int begin = 0; begin < count; begin += this->_options.batchSize)
+	{
+		const int n = std::min(this->_options.batchSize, count - begin);
+		for (int i = 0; i < n; ++i)
+		{
+			const float* image = set.images.data() + (size_t) order[begin + i] * inputs;
+			std::copy(image, image + inputs, this->_batch.data() + (size_t) i * inputs);
+			this->_batchLabels[i] = set.labels[order[begin + i]];
+		}
+		loss += (double) this->trainBatch(this->_batch.data(), this->_batchLabels.data(), n) * n;
+	}
+	return (float) (loss / count);
+}
+
+/**
+ * Evaluates without updating
+ * @param images	n x inputs, one sample per row
+ * @param labels	n labels
+ * @param n			samples
+ * @param accuracy	receives the fraction classified right, may be nullptr
+ * @return			mean cross-entropy
+ */
+float Trainer::loss(const float* images, const int* labels, int n, float* accuracy)
+{
+	const int inputs = this->_parameters[0].getCols();
+	double loss = 0;
+	long correct = 0;
+	for (int begin = 0; begin < n; begin += this->_options.batchSize)
+	{
+		const int chunk = std::min(this->_options.batchSize, n - begin);
+		const int shards = this->_runShards(images + (size_t) begin * inputs, labels + begin, chunk, 0);
+		for (int shard = 0; shard < shards; ++shard)
+		{
+			loss += this->_shards[shard].loss;
+			correct += this->_shards[shard].correct;
+		}
+	}
+	if (accuracy != nullptr)
+	{
+		*accuracy = (float) correct / (float) n;
+	}
+	return (float) (loss / n);
+}
+
+/**
+ * Copies the parameters out as layers, e.g. for an MlpNetwork
+ * @return	Dense layers, input first
+ */
+std::vector<Dense> Trainer::layers() const
+{
+	std::vector<Dense> layers;
+	for (int layer = 0; layer < this->_layers(); ++layer)
+	{
+		layers.emplace_back(this->_parameters[2 * layer], this->_parameters[2 * layer + 1],
+							layer + 1 < this->_layers() ? Relu : Softmax);
+	}
+	return layers;
+}
+
+/**
+ * Writes w1..wN and b1..bN as raw floats, the format loadParameters reads, and a
+ * model.txt describing them for loadModel
+ * @param directory		existing directory
+ * @return				false on a write error
+ */
+bool Trainer::save(const std::string& directory) const
+{
+	std::ofstream model(directory + MODEL_FILE, std::ios::out | std::ios::trunc);
+	model << MODEL_HEADER;
+	for (int layer = 0; layer < this->_layers(); ++layer)
+	{
+		const std::string index = std::to_string(layer + 1);
+		const Matrix& weights = this->_parameters[2 * layer];
+		const Matrix& bias = this->_parameters[2 * layer + 1];
+		std::ofstream weightsFile(directory + WEIGHTS_FILE + index, std::ios::out | std::ios::binary | std::ios::trunc);
+		weightsFile.write(reinterpret_cast<const char*>(weights.data()),
+						  (long) ((size_t) weights.getRows() * weights.getCols() * sizeof(float)));
+		std::ofstream biasFile(directory + BIAS_FILE + index, std::ios::out | std::ios::binary | std::ios::trunc);
+		biasFile.write(reinterpret_cast<const char*>(bias.data()), (long) (bias.getRows() * sizeof(float)));
+		if (!weightsFile.good() || !biasFile.good())
+		{
+			return false;
+		}
+		model << "w" << index << " b" << index << " " << weights.getRows() << " " << weights.getCols() << " "
+			  << (layer + 1 < this->_layers() ? MODEL_RELU : MODEL_SOFTMAX) << "\n";
+	}
+	return model.good();
+}
@@ -0,0 +1,270 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "Matrix.h"
+#include "Dense.h"
+#include "ThreadPool.h"
+
+/**
+ * Magic numbers of MNIST IDX files: unsigned bytes in 3 or 1 dimensions
+ */
+#define IDX_IMAGES_MAGIC 0x00000803u
+#define IDX_LABELS_MAGIC 0x00000801u
+
+/**
+ * Parameter update rules
+ */
+enum Optimizer
+{
+	/**
+	 * Minibatch SGD, with momentum when TrainingOptions::momentum is non-zero
+	 */
+	OptimizerSgd,
+	/**
+	 * Adam, bias corrected first and second moments
+	 */
+	OptimizerAdam
+};
+
+/**
+ * @struct TrainingOptions
+ * @brief Hyperparameters of a Trainer
+ * @var batchSize - samples per parameter update
+ * @var learningRate - step size
+ * @var optimizer - Optimizer
+ * @var momentum - SGD momentum, 0 for plain SGD
+ * @var beta1 - Adam decay of the first moment
+ * @var beta2 - Adam decay of the second moment
+ * @var epsilon - Adam denominator guard
+ * @var threads - shards of each minibatch, one worker each
+ * @var seed - initialization and shuffling seed
+ */
+typedef struct TrainingOptions
+{
+	int batchSize = 64;
+	float learningRate = 1e-3f;
+	Optimizer optimizer = OptimizerAdam;
+	float momentum = 0;
+	float beta1 = 0.9f;
+	float beta2 = 0.999f;
+	float epsilon = 1e-8f;
+	int threads = 1;
+	unsigned seed = 1;
+} TrainingOptions;
+
+/**
+ * @struct TrainingSet
+ * @brief Labeled samples
+ * @var images - one sample per row, count x features
+ * @var labels - class of every row
+ */
+typedef struct TrainingSet
+{
+	Matrix images;
+	std::vector<int> labels;
+} TrainingSet;
+
+/**
+ * Reads an MNIST IDX pair: images (magic IDX_IMAGES_MAGIC, count, rows, cols, then
+ * unsigned pixels) and labels (magic IDX_LABELS_MAGIC, count, then unsigned labels),
+ * big-endian. Pixels are scaled to [0, 1] like the shipped images.
+ * @param imagesPath	images file
+ * @param labelsPath	labels file
+ * @param set			receives the samples, one image per row
+ * @return				false if a file is missing, malformed or the counts differ
+ */
+bool readIdx(const std::string& imagesPath, const std::string& labelsPath, TrainingSet& set);
+
+/**
+ * Class Trainer
+ * Trains a ReLU MLP with a softmax output on the cross-entropy loss.
+ * Every minibatch is split into TrainingOptions::threads shards, each worker runs the
+ * forward pass with cached activations and the backward pass of its shard into its
+ * own gradients, and the shard gradients are then summed and applied in parallel
+ * over parameter ranges. Samples are rows throughout, so a shard is a contiguous
+ * block of the minibatch.
+ */
+class Trainer
+{
+ private:
+	/**
+	 * @struct Shard
+	 * @brief Scratch state of one minibatch shard
+	 * @var activations - output of every layer, shard rows x layer rows
+	 * @var deltas - loss gradient w.r.t. the pre-activations of the current layer and
+	 * 				 of the one below, ping-pong, shard rows x widest
+	 * @var gradients - per parameter tensor, shaped like it
+	 * @var loss - summed cross-entropy of the shard
+	 * @var correct - samples whose most probable class is the label
+	 */
+	typedef struct Shard
+	{
+		std::vector<Matrix> activations;
+		Matrix deltas[2];
+		std::vector<Matrix> gradients;
+		double loss;
+		int correct;
+	} Shard;
+
+	/**
+	 * Weights and biases interleaved, w1 b1 w2 b2 ..., input first
+	 */
+	std::vector<Matrix> _parameters;
+
+	/**
+	 * Adam first moments or SGD velocities, like _parameters
+	 */
+	std::vector<Matrix> _moments;
+
+	/**
+	 * Adam second moments, like _parameters
+	 */
+	std::vector<Matrix> _squares;
+
+	/**
+	 * Hyperparameters
+	 */
+	TrainingOptions _options;
+
+	/**
+	 * Parameter updates so far, for the Adam bias correction
+	 */
+	long _step;
+
+	/**
+	 * Shard scratch state, one per thread
+	 */
+	std::vector<Shard> _shards;
+
+	/**
+	 * Runs the shards and the update
+	 */
+	std::unique_ptr<ThreadPool> _pool;
+
+	/**
+	 * Shuffling
+	 */
+	std::mt19937 _random;
+
+	/**
+	 * Gathered minibatch of an epoch, batchSize x inputs
+	 */
+	Matrix _batch;
+
+	/**
+	 * Labels of _batch
+	 */
+	std::vector<int> _batchLabels;
+
+	/**
+	 * Allocates the optimizer and shard state once the parameters are known
+	 */
+	void _allocate();
+
+	/**
+	 * Returns the amount of layers
+	 * @return	layers
+	 */
+	int _layers() const;
+
+	/**
+	 * Forward pass of a shard, caches every layer's output and counts the loss
+	 * @param shard		Shard
+	 * @param images	rows x inputs, one sample per row
+	 * @param labels	rows labels
+	 * @param rows		samples
+	 */
+	void _forward(Shard& shard, const float* images, const int* labels, int rows) const;
+
+	/**
+	 * Backward pass of a shard after its forward pass, writes its gradients
+	 * @param shard		Shard
+	 * @param images	rows x inputs, one sample per row
+	 * @param labels	rows labels
+	 * @param rows		samples
+	 * @param scale		loss weight of every sample, 1 / minibatch size
+	 */
+	void _backward(Shard& shard, const float* images, const int* labels, int rows, float scale) const;
+
+	/**
+	 * Sums the gradients of the used shards into the first one and updates a range of
+	 * one parameter tensor
+	 * @param tensor	index in _parameters
+	 * @param begin		first element
+	 * @param end		past the last element
+	 * @param shards	shards that ran
+	 */
+	void _update(int tensor, int begin, int end, int shards);
+
+	/**
+	 * Runs the forward pass, and the backward pass when scale is non-zero, of samples
+	 * split into shards
+	 * @param images	n x inputs, one sample per row
+	 * @param labels	n labels
+	 * @param n			samples, at most batchSize
+	 * @param scale		loss weight of every sample, 0 for the forward pass only
+	 * @return			shards that ran
+	 */
+	int _runShards(const float* images, const int* labels, int n, float scale);
+
+ public:
+	/**
+	 * Starts from He initialized ReLU layers and a softmax output layer
+	 * @param widths	layer sizes, input first, e.g. 784 128 64 20 10
+	 * @param options	TrainingOptions
+	 */
+	Trainer(const std::vector<int>& widths, const TrainingOptions& options);
+
+	/**
+	 * Continues from existing layers, copying their parameters
+	 * @param layers	ReLU layers and a softmax output layer, input first
+	 * @param options	TrainingOptions
+	 */
+	Trainer(const std::vector<Dense>& layers, const TrainingOptions& options);
+
+	/**
+	 * One parameter update on a minibatch
+	 * @param images	n x inputs, one sample per row
+	 * @param labels	n labels
+	 * @param n			samples, at most batchSize
+	 * @return			mean cross-entropy before the update
+	 */
+	float trainBatch(const float* images, const int* labels, int n);
+
+	/**
+	 * One pass over a shuffled set, the last minibatch may be smaller
+	 * @param set	TrainingSet
+	 * @return		mean cross-entropy of the minibatches before their updates
+	 */
+	float trainEpoch(const TrainingSet& set);
+
+	/**
+	 * Evaluates without updating
+	 * @param images	n x inputs, one sample per row
+	 * @param labels	n labels
+	 * @param n			samples
+	 * @param accuracy	receives the fraction classified right, may be nullptr
+	 * @return			mean cross-entropy
+	 */
+	float loss(const float* images, const int* labels, int n, float* accuracy = nullptr);
+
+	/**
+	 * Copies the parameters out as layers, e.g. for an MlpNetwork
+	 * @return	Dense layers, input first
+	 */
+	std::vector<Dense> layers() const;
+
+	/**
+	 * Writes w1..wN and b1..bN as raw floats, the format loadParameters reads, and a
+	 * model.txt describing them for loadModel
+	 * @param directory		existing directory
+	 * @return				false on a write error
+	 */
+	bool save(const std::string& directory) const;
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../Matrix.h"
+#include "../MatrixView.h"
+#include "../Kernels.h"
+#include "../Gemm.h"
+
+#define MIN_SECONDS 0.2
+#define GFLOP 1e9
+#define GBYTE 1e9
+
+/**
+ * A benchmarked product shape, (m * k) times (k * n)
+ */
+typedef struct GemmShape
+{
+	const char* name;
+	int m, k, n;
+} GemmShape;
+
+const GemmShape shapes[] = {
+		{ "square", 64, 64, 64 },
+		{ "square", 128, 128, 128 },
+		{ "square", 256, 256, 256 },
+		{ "square", 512, 512, 512 },
+		{ "square", 768, 768, 768 },
+		{ "tall-skinny", 4096, 64, 64 },
+		{ "tall-skinny", 8192, 32, 16 },
+		{ "skinny-k", 512, 16, 512 },
+		{ "layer1-batch", 128, 784, 256 },
+		{ "layer1-gemv", 128, 784, 1 },
+};
+
+/**
+ * The former Matrix::operator*, kept as the reference implementation
+ * @param a	left operand
+ * @param b	right operand
+ * @return	a * b
+ */
+static Matrix naiveMultiply(const Matrix& a, const Matrix& b)
+{
+	Matrix c(a.getRows(), b.getCols());
+	for (int row = 0; row < c.getRows(); ++row)
+	{
+		for (int col = 0; col < c.getCols(); ++col)
+		{
+			for (int i = 0; i < a.getCols(); ++i)
+			{
+				c(row, col) += a(row, i) * b(i, col);
+			}
+		}
+	}
+	return c;
+}
+
+/**
+ * Row by row transpose, the loop the cache-oblivious one replaces
+ * @param a		rows x cols, contiguous
+ * @param rows	rows of a
+ * @param cols	cols of a
+ * @param b		receives cols x rows
+ */
+static void naiveTranspose(const float* a, int rows, int cols, float* b)
+{
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			b[(size_t) col * rows + row] = a[(size_t) row * cols + col];
+		}
+	}
+}
+
+/**
+ * Largest difference between two equally sized matrices
+ * @param a	Matrix
+ * @param b	Matrix
+ * @return	max |a - b|
+ */
+static float maxDifference(const Matrix& a, const Matrix& b)
+{
+	float maxError = 0;
+	for (int i = 0; i < a.getRows() * a.getCols(); ++i)
+	{
+		maxError = std::max(maxError, std::fabs(a[i] - b[i]));
+	}
+	return maxError;
+}
+
+/**
+ * Fills a matrix with uniform values in [-1, 1]
+ * @param matrix	Matrix
+ */
+static void fillRandom(Matrix& matrix)
+{
+	for (int i = 0; i < matrix.getRows() * matrix.getCols(); ++i)
+	{
+		matrix[i] = (float) rand() / RAND_MAX * 2 - 1;
+	}
+}
+
+/**
+ * Repeats multiply until MIN_SECONDS elapsed
+ * @param multiply	product to time
+ * @return			seconds per call
+ */
+template<typename Function>
+static double timeIt(Function multiply)
+{
+	int iterations = 0;
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		multiply();
+		++iterations;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+	return elapsed / iterations;
+}
+
+/**
+ * Prints GFLOP/s of the reference loop, of the blocked GEMM and of the blocked GEMM on
+ * prepacked weights for every shape, then of products with a transposed operand read in
+ * place against the transpose copied first, then the bandwidth of both transposes
+ * @return	exit status, failure if the products disagree
+ */
+int main()
+{
+	std::cout << "kernels: " << kernels().name << std::endl;
+	std::cout << std::left << std::setw(14) << "shape" << std::setw(18) << "m x k x n"
+			  << std::setw(14) << "naive GF/s" << std::setw(14) << "gemm GF/s"
+			  << std::setw(10) << "speedup" << std::setw(16) << "prepacked GF/s" << "max err" << std::endl;
+
+	int status = EXIT_SUCCESS;
+	for (const GemmShape& shape : shapes)
+	{
+		Matrix a(shape.m, shape.k);
+		Matrix b(shape.k, shape.n);
+		fillRandom(a);
+		fillRandom(b);
+
+		Matrix expected = naiveMultiply(a, b);
+		Matrix actual = a * b;
+		float maxError = 0;
+		for (int i = 0; i < shape.m * shape.n; ++i)
+		{
+			maxError = std::max(maxError, std::fabs(expected[i] - actual[i]));
+		}
+		const double flops = 2.0 * shape.m * shape.n * shape.k;
+		const double naiveSeconds = timeIt([&]() { naiveMultiply(a, b); });
+		const double gemmSeconds = timeIt([&]() { a * b; });
+
+		// the left operand packed once, as Dense does at load: a single column goes through
+		// the densePanels kernel, wider products through gemmPacked
+		std::vector<float> packed(packedWeightsSize(shape.m, shape.k, kernels().gemmMr));
+		packWeights(shape.m, shape.k, a.data(), shape.k, kernels().gemmMr, packed.data());
+		const std::vector<float> zeros(shape.m, 0);
+		Matrix prepacked(shape.m, shape.n);
+		const double prepackedSeconds = timeIt([&]()
+		{
+			if (shape.n == 1)
+			{
+				kernels().densePanels(shape.m, shape.k, packed.data(), b.data(), zeros.data(), prepacked.data(), false);
+			}
+			else
+			{
+				gemmPacked(shape.m, shape.n, shape.k, packed.data(), b.data(), shape.n, prepacked.data(), shape.n);
+			}
+		});
+		for (int i = 0; i < shape.m * shape.n; ++i)
+		{
+			maxError = std::max(maxError, std::fabs(expected[i] - prepacked[i]));
+		}
+		if (maxError > 1e-3f * shape.k)
+		{
+			status = EXIT_FAILURE;
+		}
+
+		std::cout << std::left << std::setw(14) << shape.name
+				  << std::setw(18) << (std::to_string(shape.m) + "x" + std::to_string(shape.k) +
+									   "x" + std::to_string(shape.n))
+				  << std::setw(14) << std::fixed << std::setprecision(2) << flops / naiveSeconds / GFLOP
+				  << std::setw(14) << flops / gemmSeconds / GFLOP
+				  << std::setw(10) << naiveSeconds / gemmSeconds
+				  << std::setw(16) << flops / prepackedSeconds / GFLOP
+				  << std::scientific << std::setprecision(1) << maxError << std::endl;
+	}
+
+	// op(a) * op(b) with one operand stored transposed: the gemm flag packs it as stored,
+	// the alternative materializes the transpose and multiplies as usual
+	std::cout << std::endl << std::left << std::setw(14) << "shape" << std::setw(18) << "m x k x n"
+			  << std::setw(14) << "A^T flag" << std::setw(14) << "A^T copied"
+			  << std::setw(14) << "B^T flag" << std::setw(14) << "B^T copied" << "max err" << std::endl;
+	for (const GemmShape& shape : shapes)
+	{
+		Matrix a(shape.m, shape.k);
+		Matrix b(shape.k, shape.n);
+		fillRandom(a);
+		fillRandom(b);
+		const Matrix expected = a * b;
+		const Matrix storedA = MatrixView(a).transposed();
+		const Matrix storedB = MatrixView(b).transposed();
+		Matrix copy(std::max(shape.m, shape.n), shape.k);
+		Matrix c(shape.m, shape.n);
+
+		gemm(GemmTransposed, GemmNormal, shape.m, shape.n, shape.k, storedA.data(), shape.m, b.data(), shape.n,
+			 c.data(), shape.n);
+		float maxError = maxDifference(expected, c);
+		const double aFlagSeconds = timeIt([&]()
+		{
+			gemm(GemmTransposed, GemmNormal, shape.m, shape.n, shape.k, storedA.data(), shape.m, b.data(), shape.n,
+				 c.data(), shape.n);
+		});
+		const double aCopySeconds = timeIt([&]()
+		{
+			transpose(storedA.data(), shape.k, shape.m, shape.m, copy.data(), shape.k);
+			gemm(shape.m, shape.n, shape.k, copy.data(), shape.k, b.data(), shape.n, c.data(), shape.n);
+		});
+		gemm(GemmNormal, GemmTransposed, shape.m, shape.n, shape.k, a.data(), shape.k, storedB.data(), shape.k,
+			 c.data(), shape.n);
+		maxError = std::max(maxError, maxDifference(expected, c));
+		const double bFlagSeconds = timeIt([&]()
+		{
+			gemm(GemmNormal, GemmTransposed, shape.m, shape.n, shape.k, a.data(), shape.k, storedB.data(), shape.k,
+				 c.data(), shape.n);
+		});
+		const double bCopySeconds = timeIt([&]()
+		{
+			transpose(storedB.data(), shape.n, shape.k, shape.k, copy.data(), shape.n);
+			gemm(shape.m, shape.n, shape.k, a.data(), shape.k, copy.data(), shape.n, c.data(), shape.n);
+		});
+		if (maxError > 1e-3f * shape.k)
+		{
+			status = EXIT_FAILURE;
+		}
+
+		const double flops = 2.0 * shape.m * shape.n * shape.k;
+		std::cout << std::left << std::setw(14) << shape.name
+				  << std::setw(18) << (std::to_string(shape.m) + "x" + std::to_string(shape.k) +
+									   "x" + std::to_string(shape.n))
+				  << std::setw(14) << std::fixed << std::setprecision(2) << flops / aFlagSeconds / GFLOP
+				  << std::setw(14) << flops / aCopySeconds / GFLOP
+				  << std::setw(14) << flops / bFlagSeconds / GFLOP
+				  << std::setw(14) << flops / bCopySeconds / GFLOP
+				  << std::scientific << std::setprecision(1) << maxError << std::endl;
+	}
+
+	// bytes read plus bytes written per second
+	const int transposeShapes[][2] = {{ 256, 256 }, { 1024, 1024 }, { 2048, 2048 }, { 4096, 1024 }, { 784, 128 }};
+	std::cout << std::endl << std::left << std::setw(14) << "transpose" << std::setw(14) << "naive GB/s"
+			  << std::setw(16) << "blocked GB/s" << "in place GB/s" << std::endl;
+	for (const auto& shape : transposeShapes)
+	{
+		Matrix a(shape[0], shape[1]);
+		fillRandom(a);
+		Matrix b(shape[1], shape[0]);
+		const double bytes = 2.0 * shape[0] * shape[1] * sizeof(float);
+		const double naiveSeconds = timeIt([&]() { naiveTranspose(a.data(), shape[0], shape[1], b.data()); });
+		const double blockedSeconds = timeIt([&]() { transpose(a.data(), shape[0], shape[1], shape[1], b.data(), shape[0]); });
+		Matrix naive(shape[1], shape[0]);
+		naiveTranspose(a.data(), shape[0], shape[1], naive.data());
+		if (maxDifference(naive, b) != 0)
+		{
+			status = EXIT_FAILURE;
+		}
+		const double inPlaceSeconds = timeIt([&]() { a.transpose(); });
+		std::cout << std::left << std::setw(14) << (std::to_string(shape[0]) + "x" + std::to_string(shape[1]))
+				  << std::setw(14) << std::fixed << std::setprecision(2) << bytes / naiveSeconds / GBYTE
+				  << std::setw(16) << bytes / blockedSeconds / GBYTE
+				  << bytes / inPlaceSeconds / GBYTE << std::endl;
+	}
+	return status;
+}
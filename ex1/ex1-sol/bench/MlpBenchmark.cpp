@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Matrix.h"
+#include "../MatrixView.h"
+#include "../Activation.h"
+#include "../Dense.h"
+#include "../MlpNetwork.h"
+#include "../ModelDescription.h"
+#include "../MappedFile.h"
+#include "../Kernels.h"
+#include "../SparseDense.h"
+
+#define USAGE "Usage: mlp_bench [parameters dir] [images dir]"
+#define MODEL_ERROR "ERROR: unable to load "
+#define MIN_SECONDS 0.2
+#define LATENCY_SAMPLES 20000
+#define THROUGHPUT_BATCH 64
+#define PERCENT 100
+#define PRUNED_DENSITY 0.1
+#define NANO 1e9
+
+/**
+ * A benchmarked product shape, (m * k) times (k * n)
+ */
+typedef struct ProductShape
+{
+	int m, k, n;
+} ProductShape;
+
+const ProductShape productShapes[] = {
+		{ 128, 784, 1 },
+		{ 64, 128, 1 },
+		{ 128, 784, 64 },
+		{ 64, 64, 64 },
+		{ 256, 256, 256 },
+};
+
+/**
+ * Element-wise operands, rows x cols
+ */
+const MatrixDims elementWiseDims[] = {{ 128, 1 }, { 784, 1 }, { 256, 256 }};
+
+/**
+ * Keeps results observable so the timed calls are not optimized away
+ */
+static volatile float sink;
+
+/**
+ * One JSON result
+ */
+typedef struct Result
+{
+	std::string group;
+	std::string name;
+	long iterations;
+	double nsPerOp;
+	double flops;
+} Result;
+
+/**
+ * Magnitude pruning: zeroes all but the largest PRUNED_DENSITY of the groups of width
+ * consecutive weights of a row, ranked by their summed magnitude
+ * @param layer	Dense
+ * @param width	1 for unstructured pruning, SPARSE_BLOCK to keep whole blocks
+ * @return		pruned copy
+ */
+static Dense prune(const Dense& layer, int width)
+{
+	Matrix weights = layer.getWeights();
+	const int rows = weights.getRows();
+	const int cols = weights.getCols();
+	const int groups = (cols + width - 1) / width;
+	std::vector<float> magnitudes((long) rows * groups, 0);
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			magnitudes[(long) row * groups + col / width] += std::fabs(weights(row, col));
+		}
+	}
+	std::vector<float> sorted = magnitudes;
+	const long kept = std::max(1L, (long) (sorted.size() * PRUNED_DENSITY));
+	std::nth_element(sorted.begin(), sorted.begin() + ((long) sorted.size() - kept), sorted.end());
+	const float threshold = sorted[sorted.size() - kept];
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int col = 0; col < cols; ++col)
+		{
+			weights(row, col) = magnitudes[(long) row * groups + col / width] < threshold ? 0 : weights(row, col);
+		}
+	}
+	return Dense(weights, layer.getBias(), layer.getActivation().getActivationType());
+}
+
+/**
+ * Fills a matrix with deterministic values in [-1, 1]
+ * @param matrix	Matrix
+ */
+static void fill(Matrix& matrix)
+{
+	for (int i = 0; i < matrix.getRows() * matrix.getCols(); ++i)
+	{
+		matrix[i] = (float) ((i * 7919) % 2001) / 1000 - 1;
+	}
+}
+
+/**
+ * Repeats function until MIN_SECONDS elapsed, after one warm-up call
+ * @param group		result group
+ * @param name		result name
+ * @param flops		floating point operations per call, 0 if not meaningful
+ * @param function	call to time
+ * @return			Result
+ */
+template<typename Function>
+static Result timeIt(const std::string& group, const std::string& name, double flops, Function function)
+{
+	function();
+	long iterations = 0;
+	const auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		function();
+		++iterations;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+	return Result{ group, name, iterations, elapsed / (double) iterations * NANO, flops };
+}
+
+/**
+ * Value at a percentile of a sample
+ * @param sorted	values, ascending
+ * @param percent	percentile
+ * @return			value
+ */
+static double percentile(const std::vector<double>& sorted, double percent)
+{
+	const size_t index = (size_t) (percent / PERCENT * (double) (sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/**
+ * Dims as "rows x cols"
+ * @param rows	rows
+ * @param cols	cols
+ * @return		string
+ */
+static std::string shape(int rows, int cols)
+{
+	return std::to_string(rows) + "x" + std::to_string(cols);
+}
+
+/**
+ * Prints one result as a JSON object
+ * @param result	Result
+ * @param last		no trailing comma
+ */
+static void printResult(const Result& result, bool last)
+{
+	std::cout << "    {\"group\": \"" << result.group << "\", \"name\": \"" << result.name
+			  << "\", \"iterations\": " << result.iterations
+			  << ", \"ns_per_op\": " << std::fixed << std::setprecision(1) << result.nsPerOp;
+	if (result.flops > 0)
+	{
+		std::cout << ", \"gflops\": " << std::setprecision(3) << result.flops / result.nsPerOp;
+	}
+	std::cout << "}" << (last ? "" : ",") << std::endl;
+}
+
+/**
+ * Times Matrix products and element-wise ops, each Activation, each shipped
+ * Dense layer on its own and the whole MlpNetwork on im0, and prints the results
+ * as JSON on stdout
+ * @param argc	arguments count
+ * @param argv	optional parameters dir and images dir
+ * @return		exit status
+ */
+int main(int argc, char** argv)
+{
+	if (argc > 3)
+	{
+		std::cerr << USAGE << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string parametersDir = argc > 1 ? std::string(argv[1]) + "/" : MLP_SOURCE_DIR "/parameters/";
+	const std::string imagesDir = argc > 2 ? std::string(argv[2]) + "/" : MLP_SOURCE_DIR "/images/";
+
+	std::vector<Dense> layers;
+	MappedFile imageFile;
+	if (!loadModel(parametersDir + "model.txt", layers))
+	{
+		std::cerr << MODEL_ERROR << parametersDir << "model.txt" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!imageFile.open(imagesDir + "im0") || imageFile.size() != imgDims.rows * imgDims.cols * sizeof(float))
+	{
+		std::cerr << MODEL_ERROR << imagesDir << "im0" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const Matrix image(imageFile.view(imgDims.rows * imgDims.cols, 1));
+	std::vector<Result> results;
+
+	for (const ProductShape& product : productShapes)
+	{
+		Matrix a(product.m, product.k);
+		Matrix b(product.k, product.n);
+		fill(a);
+		fill(b);
+		results.push_back(timeIt("matrix", "multiply " + shape(product.m, product.k) + " * " +
+											shape(product.k, product.n), 2.0 * product.m * product.k * product.n,
+								 [&]() { sink = (a * b)[0]; }));
+	}
+
+	for (const MatrixDims& dims : elementWiseDims)
+	{
+		Matrix a(dims.rows, dims.cols);
+		Matrix b(dims.rows, dims.cols);
+		fill(a);
+		fill(b);
+		const double count = (double) dims.rows * dims.cols;
+		results.push_back(timeIt("matrix", "add " + shape(dims.rows, dims.cols), count,
+								 [&]() { sink = (a + b)[0]; }));
+		results.push_back(timeIt("matrix", "add in place " + shape(dims.rows, dims.cols), count,
+								 [&]() { sink = (a += b)[0]; }));
+		results.push_back(timeIt("matrix", "scale " + shape(dims.rows, dims.cols), count,
+								 [&]() { sink = (a * 0.5f)[0]; }));
+		results.push_back(timeIt("matrix", "scale in place " + shape(dims.rows, dims.cols), count,
+								 [&]() { sink = (a *= 1.0f)[0]; }));
+
+		const Activation relu(Relu);
+		const Activation softmax(Softmax);
+		results.push_back(timeIt("activation", "relu " + shape(dims.rows, dims.cols), 0,
+								 [&]() { sink = relu(a)[0]; }));
+		results.push_back(timeIt("activation", "softmax " + shape(dims.rows, dims.cols), 0,
+								 [&]() { sink = softmax(a)[0]; }));
+	}
+
+	Matrix input = image;
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		const Dense& layer = layers[i];
+		const Matrix& weights = layer.getWeights();
+		results.push_back(timeIt("dense", "layer " + std::to_string(i + 1) + " " +
+										  shape(weights.getRows(), weights.getCols()),
+								 2.0 * weights.getRows() * weights.getCols(),
+								 [&]() { sink = layer(input)[0]; }));
+		input = layer(input);
+	}
+
+	// pruned layers: the dense product against SpMV, and SpMM on a batch. CSR runs on
+	// unstructured pruning, blocks on pruning that keeps whole blocks.
+	Matrix sparseInput = image;
+	Matrix sparseBatch(imgDims.rows * imgDims.cols, THROUGHPUT_BATCH);
+	fill(sparseBatch);
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		const Dense pruned = prune(layers[i], 1);
+		const Dense blockPruned = prune(layers[i], SPARSE_BLOCK);
+		const SparseDense csr(pruned, SparseCsr);
+		const SparseDense blocks(blockPruned, SparseBlocks);
+		const Matrix& weights = pruned.getWeights();
+		const std::string name = "layer " + std::to_string(i + 1) + " " +
+								 shape(weights.getRows(), weights.getCols()) + " density " +
+								 std::to_string(SparseDense::density(pruned)).substr(0, 4);
+		const double flops = 2.0 * weights.getRows() * weights.getCols();
+		results.push_back(timeIt("sparse", name + " dense", flops, [&]() { sink = pruned(sparseInput)[0]; }));
+		results.push_back(timeIt("sparse", name + " csr", flops,
+								 [&]() { sink = csr(MatrixView(sparseInput))[0]; }));
+		results.push_back(timeIt("sparse", name + " blocks", flops,
+								 [&]() { sink = blocks(MatrixView(sparseInput))[0]; }));
+		if (i == 0)
+		{
+			const std::string batchName = name + " batch " + std::to_string(THROUGHPUT_BATCH);
+			results.push_back(timeIt("sparse", batchName + " dense", flops * THROUGHPUT_BATCH,
+									 [&]() { sink = pruned(sparseBatch)[0]; }));
+			results.push_back(timeIt("sparse", batchName + " csr", flops * THROUGHPUT_BATCH,
+									 [&]() { sink = csr(MatrixView(sparseBatch))[0]; }));
+			results.push_back(timeIt("sparse", batchName + " blocks", flops * THROUGHPUT_BATCH,
+									 [&]() { sink = blocks(MatrixView(sparseBatch))[0]; }));
+		}
+		sparseInput = pruned(sparseInput);
+	}
+
+	// the output layer's classification: the full softmax then a scan, against the argmax
+	// of the logits and the winner's probability from their log-sum-exp
+	const Matrix logits = input;
+	Matrix normalized(logits.getRows(), 1);
+	results.push_back(timeIt("output", "softmax argmax " + shape(logits.getRows(), 1), 0, [&]()
+	{
+		Activation::softmax(logits.data(), normalized.data(), logits.getRows(), 1, SoftmaxColumns);
+		sink = MlpNetwork::mostProbable(normalized, 0).probability;
+	}));
+	results.push_back(timeIt("output", "logsumexp argmax " + shape(logits.getRows(), 1), 0, [&]()
+	{
+		float logSumExp = 0;
+		Activation::logSumExp(logits.data(), &logSumExp, logits.getRows(), 1, SoftmaxColumns);
+		sink = MlpNetwork::mostProbableLogit(logits, 0, logSumExp).probability;
+	}));
+
+	MlpNetwork mlp(std::move(layers));
+	results.push_back(timeIt("network", "forward im0", 0, [&]() { sink = mlp(image).probability; }));
+	results.push_back(timeIt("network", "top 3 im0", 0, [&]() { sink = mlp.topK(image, 3)[0].probability; }));
+
+	// per call latency distribution of single image passes
+	std::vector<double> latencies(LATENCY_SAMPLES);
+	for (double& latency : latencies)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		sink = mlp(image).probability;
+		latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * NANO;
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	// throughput of batched passes
+	std::vector<Matrix> batch(THROUGHPUT_BATCH, image);
+	const Result batched = timeIt("network", "batch " + std::to_string(THROUGHPUT_BATCH) + " im0", 0,
+								  [&]() { sink = mlp.classifyBatch(batch.data(), THROUGHPUT_BATCH)[0].probability; });
+	results.push_back(batched);
+
+	std::cout << "{" << std::endl;
+	std::cout << "  \"kernels\": \"" << kernels().name << "\"," << std::endl;
+	std::cout << "  \"min_seconds\": " << MIN_SECONDS << "," << std::endl;
+	std::cout << "  \"benchmarks\": [" << std::endl;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		printResult(results[i], i + 1 == results.size());
+	}
+	std::cout << "  ]," << std::endl;
+	std::cout << "  \"network\": {\"latency_ns\": {\"p50\": " << std::fixed << std::setprecision(1)
+			  << percentile(latencies, 50) << ", \"p90\": " << percentile(latencies, 90)
+			  << ", \"p99\": " << percentile(latencies, 99) << "}, \"images_per_s\": {\"single\": "
+			  << std::setprecision(0) << NANO / results[results.size() - 2].nsPerOp
+			  << ", \"batched\": " << NANO * THROUGHPUT_BATCH / batched.nsPerOp << "}}" << std::endl;
+	std::cout << "}" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../MappedFile.h"
+#include "../MlpNetwork.h"
+#include "../ParallelClassifier.h"
+
+#define USAGE "Usage: scaling_bench [max threads] [batch size] [parameters dir] [images dir]"
+#define MAPPING_ERROR "ERROR: unable to map "
+#define DEFAULT_BATCH 32
+#define SAMPLE_IMAGES 10
+#define STREAM_IMAGES 8192
+#define ROUNDS 5
+#define PERCENT 100
+
+/**
+ * Latency at a percentile of a sample
+ * @param sorted	latencies, ascending
+ * @param percent	percentile
+ * @return			seconds
+ */
+static double percentile(const std::vector<double>& sorted, double percent)
+{
+	const size_t index = (size_t) (percent / PERCENT * (double) (sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/**
+ * Maps one raw float file
+ * @param path		file
+ * @param rows		rows
+ * @param cols		cols
+ * @param files		keeps the mapping alive
+ * @return			MatrixView on the mapping
+ */
+static MatrixView mapMatrix(const std::string& path, int rows, int cols, std::vector<MappedFile>& files)
+{
+	files.emplace_back();
+	if (!files.back().open(path))
+	{
+		std::cerr << MAPPING_ERROR << path << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return files.back().view(rows, cols);
+}
+
+/**
+ * Classifies a stream of images with 1 to max threads and prints, per thread count,
+ * throughput, speedup over one thread and per-batch p50 / p99 latency
+ * @param argc	arguments count
+ * @param argv	optional max threads, batch size, parameters dir and images dir
+ * @return		exit status
+ */
+int main(int argc, char** argv)
+{
+	if (argc > 5)
+	{
+		std::cerr << USAGE << std::endl;
+		return EXIT_FAILURE;
+	}
+	const int hardware = (int) std::max(std::thread::hardware_concurrency(), 1u);
+	const int maxThreads = argc > 1 ? std::max(std::atoi(argv[1]), 1) : hardware;
+	const int batchSize = argc > 2 ? std::max(std::atoi(argv[2]), 1) : DEFAULT_BATCH;
+	const std::string parametersDir = argc > 3 ? std::string(argv[3]) + "/" : MLP_SOURCE_DIR "/parameters/";
+	const std::string imagesDir = argc > 4 ? std::string(argv[4]) + "/" : MLP_SOURCE_DIR "/images/";
+
+	std::vector<MappedFile> files;
+	files.reserve(2 * MLP_SIZE + SAMPLE_IMAGES);
+	MatrixView weights[MLP_SIZE] = {
+			mapMatrix(parametersDir + "w1", weightsDims[0].rows, weightsDims[0].cols, files),
+			mapMatrix(parametersDir + "w2", weightsDims[1].rows, weightsDims[1].cols, files),
+			mapMatrix(parametersDir + "w3", weightsDims[2].rows, weightsDims[2].cols, files),
+			mapMatrix(parametersDir + "w4", weightsDims[3].rows, weightsDims[3].cols, files) };
+	MatrixView biases[MLP_SIZE] = {
+			mapMatrix(parametersDir + "b1", biasDims[0].rows, biasDims[0].cols, files),
+			mapMatrix(parametersDir + "b2", biasDims[1].rows, biasDims[1].cols, files),
+			mapMatrix(parametersDir + "b3", biasDims[2].rows, biasDims[2].cols, files),
+			mapMatrix(parametersDir + "b4", biasDims[3].rows, biasDims[3].cols, files) };
+	MlpNetwork mlp(weights, biases);
+
+	std::vector<Matrix> stream;
+	stream.reserve(STREAM_IMAGES);
+	for (int i = 0; i < STREAM_IMAGES; ++i)
+	{
+		const std::string path = imagesDir + "im" + std::to_string(i % SAMPLE_IMAGES);
+		if (i < SAMPLE_IMAGES)
+		{
+			stream.emplace_back(mapMatrix(path, imgDims.rows * imgDims.cols, 1, files));
+		}
+		else
+		{
+			stream.push_back(stream[i % SAMPLE_IMAGES]);
+		}
+	}
+
+	std::cout << "hardware threads: " << hardware << ", batch: " << batchSize
+			  << ", images: " << STREAM_IMAGES << std::endl;
+	std::cout << std::left << std::setw(10) << "threads" << std::setw(14) << "images/s"
+			  << std::setw(10) << "speedup" << std::setw(12) << "p50 ms" << "p99 ms" << std::endl;
+
+	double baseline = 0;
+	for (int threads = 1; threads <= maxThreads; ++threads)
+	{
+		ParallelClassifier classifier(mlp, threads, batchSize);
+		std::vector<double> latencies;
+		std::vector<double> allLatencies;
+		classifier.classify(stream.data(), STREAM_IMAGES, &latencies);
+
+		double best = 0;
+		for (int round = 0; round < ROUNDS; ++round)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			classifier.classify(stream.data(), STREAM_IMAGES, &latencies);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			best = std::max(best, STREAM_IMAGES / seconds);
+			allLatencies.insert(allLatencies.end(), latencies.begin(), latencies.end());
+		}
+		if (threads == 1)
+		{
+			baseline = best;
+		}
+
+		std::sort(allLatencies.begin(), allLatencies.end());
+		std::cout << std::left << std::setw(10) << threads
+				  << std::setw(14) << std::fixed << std::setprecision(0) << best
+				  << std::setw(10) << std::setprecision(2) << best / baseline
+				  << std::setw(12) << std::setprecision(3) << percentile(allLatencies, 50) * 1e3
+				  << percentile(allLatencies, 99) * 1e3 << std::endl;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Kernels.h"
+#include "../MlpNetwork.h"
+#include "../StaticMlp.hpp"
+
+#define USAGE "Usage: static_bench [parameters dir] [images dir]"
+#define READ_ERROR "ERROR: unable to read "
+#define SAMPLE_IMAGES 10
+#define MIN_SECONDS 0.5
+#define MICROSECONDS 1e6
+
+/**
+ * Reads a raw float file into a matrix of matching size
+ * @param path		file
+ * @param matrix	destination
+ */
+static void readMatrix(const std::string& path, Matrix& matrix)
+{
+	std::ifstream is(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!is.is_open() || is.tellg() != (long) (matrix.getRows() * matrix.getCols() * sizeof(float)))
+	{
+		std::cerr << READ_ERROR << path << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	is.seekg(0, std::ios_base::beg);
+	is >> matrix;
+}
+
+/**
+ * Classifies every image until MIN_SECONDS elapsed
+ * @param network	MlpNetwork or StaticMlp
+ * @param images	image views
+ * @return			microseconds per image
+ */
+template<typename Network>
+static double timePerImage(const Network& network, const std::vector<MatrixView>& images)
+{
+	long classified = 0;
+	unsigned int checksum = 0;
+	const auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		for (const MatrixView& image : images)
+		{
+			checksum += network(image).value;
+		}
+		classified += (long) images.size();
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+	return checksum == 0 ? 0 : elapsed / classified * MICROSECONDS;
+}
+
+/**
+ * Prints the latency of the runtime-shaped and the shape-specialized network
+ * @param argc	arguments count
+ * @param argv	optional parameters dir and images dir
+ * @return		exit status, failure if the two networks disagree
+ */
+int main(int argc, char** argv)
+{
+	if (argc > 3)
+	{
+		std::cerr << USAGE << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string parametersDir = argc > 1 ? std::string(argv[1]) + "/" : MLP_SOURCE_DIR "/parameters/";
+	const std::string imagesDir = argc > 2 ? std::string(argv[2]) + "/" : MLP_SOURCE_DIR "/images/";
+
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	std::vector<MatrixView> weightViews;
+	std::vector<MatrixView> biasViews;
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		weights[i] = Matrix(weightsDims[i].rows, weightsDims[i].cols);
+		biases[i] = Matrix(biasDims[i].rows, biasDims[i].cols);
+		readMatrix(parametersDir + "w" + std::to_string(i + 1), weights[i]);
+		readMatrix(parametersDir + "b" + std::to_string(i + 1), biases[i]);
+		weightViews.emplace_back(weights[i]);
+		biasViews.emplace_back(biases[i]);
+	}
+	Matrix images[SAMPLE_IMAGES];
+	std::vector<MatrixView> imageViews;
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		images[i] = Matrix(imgDims.rows * imgDims.cols, 1);
+		readMatrix(imagesDir + "im" + std::to_string(i), images[i]);
+		imageViews.emplace_back(images[i]);
+	}
+
+	const MlpNetwork runtime(weights, biases);
+	const std::unique_ptr<StaticDigitsMlp> specialized(new StaticDigitsMlp(weightViews.data(), biasViews.data()));
+
+	int status = EXIT_SUCCESS;
+	for (const MatrixView& image : imageViews)
+	{
+		const Digit expected = runtime(image);
+		const Digit actual = (*specialized)(image);
+		if (expected.value != actual.value || std::fabs(expected.probability - actual.probability) > 1e-4f)
+		{
+			status = EXIT_FAILURE;
+		}
+	}
+
+	const double runtimeMicros = timePerImage(runtime, imageViews);
+	const double staticMicros = timePerImage(*specialized, imageViews);
+	std::cout << std::fixed << std::setprecision(2) << "kernels: " << kernels().name << std::endl
+			  << "MlpNetwork           " << runtimeMicros << " us / image" << std::endl
+			  << "StaticMlp<784..10>   " << staticMicros << " us / image" << std::endl
+			  << "speedup              " << runtimeMicros / staticMicros << std::endl
+			  << "outputs " << (status == EXIT_SUCCESS ? "match" : "DIFFER") << std::endl;
+	return status;
+}
@@ -1,23 +1,75 @@
+#include <csignal>
 #include <fstream>
+#include <utility>
+#include <vector>
 
 #include "Matrix.h"
+#include "MatrixView.h"
 #include "Activation.h"
 #include "Dense.h"
 #include "MlpNetwork.h"
+#include "MatrixAllocator.h"
+#include "MatrixTrace.h"
+#include "MappedFile.h"
+#include "QuantizedMlp.h"
+#include "ModelDescription.h"
+#include "BulkClassifier.h"
+#include "PackedModel.h"
+#include "SparseMlp.h"
+#include "InferenceServer.h"
 
 #define QUIT "q"
 #define INSERT_IMAGE_PATH "Please insert image path:"
 #define ERROR_INAVLID_PARAMETER "Error: invalid Parameters file for layer: "
+#define ERROR_INVALID_MODEL "Error: invalid model description or pre-quantized parameters file: "
+#define ERROR_INVALID_PACKED "Error: invalid packed model "
+#define ERROR_INVALID_SOURCE "Error: unable to read images or write results: "
+#define ERROR_BULK_QUANTIZED "Error: bulk classification needs fp32 parameters"
+#define ERROR_BULK_SPARSE "Error: bulk classification needs dense parameters, unset " SPARSE_DENSITY_ENV
+#define ERROR_SERVE_QUANTIZED "Error: serving needs fp32 parameters"
+#define ERROR_SERVE_SPARSE "Error: serving needs dense parameters, unset " SPARSE_DENSITY_ENV
+#define ERROR_SERVE_OPTIONS "Error: invalid " SERVER_BATCH_ENV " or " SERVER_WAIT_ENV
+#define ERROR_SERVE_SOCKET "Error: unable to listen on "
 #define ERROR_INVALID_INPUT "Error: Failed to retrieve input. Exiting.."
 #define ERROR_INVALID_IMG "Error: invalid image path or size: "
 #define USAGE_MSG "Usage:\n" \
                   "\t./mlpnetwork w1 w2 w3 w4 b1 b2 b3 b4\n" \
                   "\twi - the i'th layer's weights\n" \
-                  "\tbi - the i'th layer's biases"
+                  "\tbi - the i'th layer's biases\n" \
+                  "\t./mlpnetwork model\n" \
+                  "\tmodel - a packed model written by mlp_pack,\n" \
+                  "\t        a model description (one layer per line:\n" \
+                  "\t        weights-file bias-file rows cols relu|softmax)\n" \
+                  "\t        or INT8 parameters written by mlp_quantize\n" \
+                  "\t./mlpnetwork --dir|--list|--stream source parameters...\n" \
+                  "\tclassifies every image of a directory, of a file listing one path\n" \
+                  "\tper line or of a stream of concatenated images, one line each:\n" \
+                  "\t\tname digit probability\n" \
+                  "\t./mlpnetwork --serve socket parameters...\n" \
+                  "\tserves classifications on a Unix domain socket until interrupted,\n" \
+                  "\tbatching concurrent requests: at most " SERVER_BATCH_ENV " images (64)\n" \
+                  "\tper batch, waiting at most " SERVER_WAIT_ENV " microseconds (1000) for one\n" \
+                  "\tto fill; see InferenceServer.h for the protocol and mlp_loadgen for a client\n" \
+                  "\tMLP_SPARSE=d converts the layers with at most a fraction d of non-zero\n" \
+                  "\tweights to sparse storage at load time, MLP_SPARSE_FORMAT=csr|blocks"
+
+
+#define ALLOC_STATS_ENV "MLP_ALLOC_STATS"
+#define ALLOC_STATS_PREFIX "Matrix allocator: "
+#define MATRIX_COUNTERS_PREFIX "Matrix counters (main thread): "
 
 
 #define ARGS_START_IDX 1
 #define ARGS_COUNT (ARGS_START_IDX + (MLP_SIZE * 2))
+#define MODEL_ARGS_COUNT (ARGS_START_IDX + 1)
+#define BULK_ARGS_COUNT 2
+#define BULK_BATCH 64
+#define BULK_DIRECTORY "--dir"
+#define BULK_LIST "--list"
+#define BULK_STREAM "--stream"
+#define SERVE_FLAG "--serve"
+#define SERVE_STARTED "Serving on "
+#define SERVE_STOPPED "Served requests: "
 #define WEIGHTS_START_IDX ARGS_START_IDX
 #define BIAS_START_IDX (ARGS_START_IDX + MLP_SIZE)
 
@@ -94,6 +146,40 @@ void loadParameters(char *paths[ARGS_COUNT], Matrix weights[MLP_SIZE], Matrix bi
     }
 }
 
+/**
+ * Maps MLP parameters from weights & biases paths read-only, without
+ * reading or copying them, and views them as Weights[] and Biases[].
+ * @param paths array of programs arguments, expected to be mlp parameters
+ *        path.
+ * @param files receives one mapping per path, must outlive the views
+ * @param weights receives weights views, weights[i] is the i'th layer weights
+ * @param biases receives biases views, biases[i] is the i'th layer bias
+ * @return boolean status
+ *          true - success
+ *          false - a file could not be mapped or has the wrong size
+ */
+bool mapParameters(char *paths[ARGS_COUNT], std::vector<MappedFile> &files,
+                   std::vector<MatrixView> &weights, std::vector<MatrixView> &biases)
+{
+    files.clear();
+    files.resize(MLP_SIZE * 2);
+    for(int i = 0; i < MLP_SIZE; i++)
+    {
+        MappedFile &weightsFile = files[i];
+        MappedFile &biasFile = files[MLP_SIZE + i];
+        if(!(weightsFile.open(paths[WEIGHTS_START_IDX + i]) &&
+             biasFile.open(paths[BIAS_START_IDX + i])) ||
+           weightsFile.size() != (size_t) weightsDims[i].rows * weightsDims[i].cols * sizeof(float) ||
+           biasFile.size() != (size_t) biasDims[i].rows * biasDims[i].cols * sizeof(float))
+        {
+            return false;
+        }
+        weights.push_back(weightsFile.view(weightsDims[i].rows, weightsDims[i].cols));
+        biases.push_back(biasFile.view(biasDims[i].rows, biasDims[i].cols));
+    }
+    return true;
+}
+
 /**
  * This programs Command line interface for the mlp network.
  * Looping on: {
@@ -102,9 +188,10 @@ void loadParameters(char *paths[ARGS_COUNT], Matrix weights[MLP_SIZE], Matrix bi
  *                  print image & netowrk prediction
  *             }
  * Exits (code == 1) on fatal errors: unable to read user input path.
- * @param mlp MlpNetwork to use in order to predict img.
+ * @param mlp MlpNetwork, QuantizedMlp or SparseMlp to use in order to predict img.
  */
-void mlpCli(MlpNetwork &mlp)
+template<typename Network>
+void mlpCli(const Network &mlp)
 {
     Matrix img(imgDims.rows, imgDims.cols);
     std::string imgPath;
@@ -121,8 +208,7 @@ void mlpCli(MlpNetwork &mlp)
     {
         if(readFileToMatrix(imgPath, img))
         {
-            Matrix imgVec = img;
-            Digit output = mlp(imgVec.vectorize());
+            Digit output = mlp(MatrixView(img).vectorize());
             std::cout << "Image processed:" << std::endl
                       << img << std::endl;
             std::cout << "Mlp result: " << output.value <<
@@ -143,6 +229,101 @@ void mlpCli(MlpNetwork &mlp)
     }
 }
 
+/**
+ * The server SIGINT and SIGTERM stop, nullptr when not serving
+ */
+static InferenceServer *activeServer = nullptr;
+
+/**
+ * Signal handler, stops the active server
+ * @param signalNumber ignored
+ */
+void stopServing(int signalNumber)
+{
+    (void) signalNumber;
+    if(activeServer != nullptr)
+    {
+        activeServer->stop();
+    }
+}
+
+/**
+ * Serves the network on a Unix domain socket until SIGINT or SIGTERM,
+ * batch bounds from SERVER_BATCH_ENV and SERVER_WAIT_ENV.
+ * Exits (code == 1) if the options are invalid or the socket cannot be bound.
+ * @param mlp MlpNetwork to use in order to predict images.
+ * @param socketPath socket path
+ */
+void serveMlp(const MlpNetwork &mlp, const char *socketPath)
+{
+    int maxBatch = 0;
+    int maxWaitMicros = 0;
+    if(!InferenceServer::loadOptions(maxBatch, maxWaitMicros))
+    {
+        std::cerr << ERROR_SERVE_OPTIONS << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    InferenceServer server(mlp, maxBatch, maxWaitMicros);
+    if(!server.listen(socketPath))
+    {
+        std::cerr << ERROR_SERVE_SOCKET << socketPath << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    activeServer = &server;
+    std::signal(SIGINT, stopServing);
+    std::signal(SIGTERM, stopServing);
+    std::cerr << SERVE_STARTED << socketPath << ", batches of at most " << maxBatch << " within "
+              << maxWaitMicros << " us" << std::endl;
+    server.run();
+    activeServer = nullptr;
+    std::cerr << SERVE_STOPPED << server.served() << " in " << server.batches() << " batches" << std::endl;
+}
+
+/**
+ * Runs the fp32 network: the interactive loop, bulk classification of a source
+ * with results on stdout, or the server. Pruned layers run sparse when
+ * SPARSE_DENSITY_ENV is set.
+ * Exits (code == 1) if the source cannot be read.
+ * @param mlp MlpNetwork to use in order to predict images.
+ * @param bulkType source kind, ignored without a source
+ * @param bulkSource directory, list or stream path, nullptr for the interactive loop
+ * @param serveSocket socket path to serve on, nullptr when not serving
+ */
+void runMlp(const MlpNetwork &mlp, BulkSourceType bulkType, const char *bulkSource, const char *serveSocket)
+{
+    float maxDensity = 0;
+    SparseFormat sparseFormat = SparseBlocks;
+    if(SparseMlp::loadOptions(maxDensity, sparseFormat))
+    {
+        if(bulkSource != nullptr || serveSocket != nullptr)
+        {
+            std::cerr << (serveSocket != nullptr ? ERROR_SERVE_SPARSE : ERROR_BULK_SPARSE) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        SparseMlp sparse(mlp, maxDensity, sparseFormat);
+        mlpCli(sparse);
+        return;
+    }
+
+    if(serveSocket != nullptr)
+    {
+        serveMlp(mlp, serveSocket);
+        return;
+    }
+    if(bulkSource == nullptr)
+    {
+        mlpCli(mlp);
+        return;
+    }
+
+    BulkClassifier classifier(mlp, BULK_BATCH, stdout);
+    if(!classifier.run(bulkType, bulkSource))
+    {
+        std::cerr << ERROR_INVALID_SOURCE << bulkSource << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
 /**
  * Program's main
  * @param argc count of args
@@ -151,20 +332,99 @@ void mlpCli(MlpNetwork &mlp)
  */
 int main(int argc, char **argv)
 {
-    if(argc != ARGS_COUNT)
+    // bulk and server modes: the flag and its path come first, the parameters follow as usual
+    BulkSourceType bulkType = BulkDirectory;
+    const char *bulkSource = nullptr;
+    const char *serveSocket = nullptr;
+    if(argc > ARGS_START_IDX + BULK_ARGS_COUNT)
+    {
+        const std::string flag(argv[ARGS_START_IDX]);
+        if(flag == BULK_DIRECTORY || flag == BULK_LIST || flag == BULK_STREAM)
+        {
+            bulkType = flag == BULK_DIRECTORY ? BulkDirectory : flag == BULK_LIST ? BulkList : BulkStream;
+            bulkSource = argv[ARGS_START_IDX + 1];
+            argv += BULK_ARGS_COUNT;
+            argc -= BULK_ARGS_COUNT;
+        }
+        else if(flag == SERVE_FLAG)
+        {
+            serveSocket = argv[ARGS_START_IDX + 1];
+            argv += BULK_ARGS_COUNT;
+            argc -= BULK_ARGS_COUNT;
+        }
+    }
+
+    if(argc != ARGS_COUNT && argc != MODEL_ARGS_COUNT)
     {
         usage();
         exit(EXIT_FAILURE);
     }
 
-    Matrix weights[MLP_SIZE];
-    Matrix biases[MLP_SIZE];
-    loadParameters(argv, weights, biases);
-
-    MlpNetwork mlp(weights, biases);
+    // zero-copy path: the network borrows the mapped pages
+    std::vector<MappedFile> files;
+    std::vector<MatrixView> weightViews;
+    std::vector<MatrixView> biasViews;
+    if(argc == MODEL_ARGS_COUNT)
+    {
+        QuantizedMlp quantized;
+        std::vector<Dense> layers;
+        MappedFile packedFile;
+        std::string error;
+        if(isPackedModel(argv[ARGS_START_IDX]))
+        {
+            // zero-copy as well: the layers borrow the verified mapping
+            if(!mapPackedModel(argv[ARGS_START_IDX], packedFile, layers, error) ||
+               layers.front().getWeights().getCols() != imgDims.rows * imgDims.cols)
+            {
+                std::cerr << ERROR_INVALID_PACKED << argv[ARGS_START_IDX] << ": "
+                          << (error.empty() ? "input is not an image" : error) << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            MlpNetwork mlp(std::move(layers));
+            runMlp(mlp, bulkType, bulkSource, serveSocket);
+        }
+        else if(quantized.load(argv[ARGS_START_IDX]))
+        {
+            if(bulkSource != nullptr || serveSocket != nullptr)
+            {
+                std::cerr << (serveSocket != nullptr ? ERROR_SERVE_QUANTIZED : ERROR_BULK_QUANTIZED) << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            mlpCli(quantized);
+        }
+        else if(loadModel(argv[ARGS_START_IDX], layers) &&
+                layers.front().getWeights().getCols() == imgDims.rows * imgDims.cols)
+        {
+            MlpNetwork mlp(std::move(layers));
+            runMlp(mlp, bulkType, bulkSource, serveSocket);
+        }
+        else
+        {
+            std::cerr << ERROR_INVALID_MODEL << argv[ARGS_START_IDX] << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if(mapParameters(argv, files, weightViews, biasViews))
+    {
+        MlpNetwork mlp(weightViews.data(), biasViews.data());
+        runMlp(mlp, bulkType, bulkSource, serveSocket);
+    }
+    else
+    {
+        // not mappable (e.g. a pipe): read and copy, reports the failing layer
+        Matrix weights[MLP_SIZE];
+        Matrix biases[MLP_SIZE];
+        loadParameters(argv, weights, biases);
 
-    mlpCli(mlp);
+        MlpNetwork mlp(weights, biases);
+        runMlp(mlp, bulkType, bulkSource, serveSocket);
+    }
 
+    if(std::getenv(ALLOC_STATS_ENV) != nullptr)
+    {
+        std::cerr << ALLOC_STATS_PREFIX << matrixAllocatorStats() << std::endl;
+        std::cerr << MATRIX_COUNTERS_PREFIX << matrixCounters() << std::endl;
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,1470 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "TestHelpers.h"
+#include "../Matrix.h"
+#include "../MatrixView.h"
+#include "../Kernels.h"
+#include "../Gemm.h"
+#include "../MlpNetwork.h"
+#include "../ModelDescription.h"
+#include "../PackedModel.h"
+#include "../MatrixAllocator.h"
+#include "../MatrixTrace.h"
+#include "../MappedFile.h"
+#include "../ThreadPool.h"
+#include "../ParallelClassifier.h"
+#include "../BulkClassifier.h"
+#include "../InferenceServer.h"
+#include "../QuantizedMlp.h"
+#include "../HalfMlp.h"
+#include "../SparseMlp.h"
+#include "../Profiler.h"
+#include "../StaticMlp.hpp"
+#include "../Trainer.h"
+
+#define EPSILON 1e-4f
+#define PARAMETERS_DIR MLP_SOURCE_DIR "/parameters/"
+#define IMAGES_DIR MLP_SOURCE_DIR "/images/"
+#define SAMPLE_IMAGES 10
+#define RESULT_NAME_CHARS 16
+
+/**
+ * Labels of the shipped images im0..im9
+ */
+const unsigned int sampleLabels[SAMPLE_IMAGES] = { 5, 0, 4, 1, 9, 2, 1, 3, 1, 4 };
+
+//-------------------------------------------------------
+// Allocation counting
+//-------------------------------------------------------
+
+/**
+ * Number of global operator new calls so far
+ */
+static std::atomic<long> allocationCount(0);
+
+void* operator new(std::size_t size)
+{
+	++allocationCount;
+	void* pointer = std::malloc(size == 0 ? 1 : size);
+	if (pointer == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+//-------------------------------------------------------
+// Helpers
+//-------------------------------------------------------
+
+/**
+ * Builds a rows * cols matrix with deterministic non-trivial values
+ * @param rows	rows
+ * @param cols	cols
+ * @param seed	value offset
+ * @return		Matrix
+ */
+static Matrix makeMatrix(int rows, int cols, int seed)
+{
+	Matrix matrix(rows, cols);
+	for (int i = 0; i < rows * cols; ++i)
+	{
+		matrix[i] = (float) ((i * 7 + seed) % 13) / 13 - 0.5f;
+	}
+	return matrix;
+}
+
+/**
+ * Reference triple loop product
+ * @param a	left operand
+ * @param b	right operand
+ * @return	a * b
+ */
+static Matrix naiveMultiply(const Matrix& a, const Matrix& b)
+{
+	Matrix c(a.getRows(), b.getCols());
+	for (int row = 0; row < c.getRows(); ++row)
+	{
+		for (int col = 0; col < c.getCols(); ++col)
+		{
+			for (int i = 0; i < a.getCols(); ++i)
+			{
+				c(row, col) += a(row, i) * b(i, col);
+			}
+		}
+	}
+	return c;
+}
+
+/**
+ * Reference element by element transpose
+ * @param a	Matrix
+ * @return	a^T
+ */
+static Matrix naiveTranspose(const Matrix& a)
+{
+	Matrix t(a.getCols(), a.getRows());
+	for (int row = 0; row < a.getRows(); ++row)
+	{
+		for (int col = 0; col < a.getCols(); ++col)
+		{
+			t(col, row) = a(row, col);
+		}
+	}
+	return t;
+}
+
+/**
+ * Element-wise comparison
+ * @param a			Matrix
+ * @param b			Matrix
+ * @param epsilon	allowed absolute difference
+ * @return			true if a and b have the same dims and close values
+ */
+static bool nearlyEqual(const Matrix& a, const Matrix& b, float epsilon)
+{
+	if (a.getRows() != b.getRows() || a.getCols() != b.getCols())
+	{
+		return false;
+	}
+	for (int i = 0; i < a.getRows() * a.getCols(); ++i)
+	{
+		if (std::fabs(a[i] - b[i]) > epsilon)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Reads a raw float file into a matrix of matching size
+ * @param path		file
+ * @param matrix	destination
+ * @return			false if the file is missing or has another size
+ */
+static bool readMatrix(const std::string& path, Matrix& matrix)
+{
+	std::ifstream is(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!is.is_open() || is.tellg() != (long) (matrix.getRows() * matrix.getCols() * sizeof(float)))
+	{
+		return false;
+	}
+	is.seekg(0, std::ios_base::beg);
+	is >> matrix;
+	return true;
+}
+
+/**
+ * Reads the shipped parameters
+ * @param weights	MLP_SIZE matrices
+ * @param biases	MLP_SIZE matrices
+ * @return			false on a missing file
+ */
+static bool readParameters(Matrix weights[], Matrix biases[])
+{
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		weights[i] = Matrix(weightsDims[i].rows, weightsDims[i].cols);
+		biases[i] = Matrix(biasDims[i].rows, biasDims[i].cols);
+		if (!readMatrix(PARAMETERS_DIR "w" + std::to_string(i + 1), weights[i]) ||
+			!readMatrix(PARAMETERS_DIR "b" + std::to_string(i + 1), biases[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Reads the shipped images as column vectors
+ * @param images	SAMPLE_IMAGES matrices
+ * @return			false on a missing file
+ */
+static bool readImages(Matrix images[])
+{
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		images[i] = Matrix(imgDims.rows * imgDims.cols, 1);
+		if (!readMatrix(IMAGES_DIR "im" + std::to_string(i), images[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//-------------------------------------------------------
+// Tests
+//-------------------------------------------------------
+
+int testMultiplyMatchesReference()
+{
+	// edge sizes around the micro-kernel tile and the cache blocks
+	const int sizes[][3] = {{ 1, 1, 1 }, { 5, 3, 17 }, { 6, 16, 16 }, { 7, 300, 33 },
+							{ 145, 257, 20 }, { 128, 784, 1 }, { 13, 9, 4100 }};
+	for (const auto& size : sizes)
+	{
+		Matrix a = makeMatrix(size[0], size[1], 1);
+		Matrix b = makeMatrix(size[1], size[2], 2);
+		ASSERT_TRUE(nearlyEqual(a * b, naiveMultiply(a, b), EPSILON * size[1]))
+
+		// the same product from weights packed once, then reused
+		std::vector<float> packed(packedWeightsSize(size[0], size[1], kernels().gemmMr));
+		packWeights(size[0], size[1], a.data(), size[1], kernels().gemmMr, packed.data());
+		Matrix c(size[0], size[2]);
+		for (int call = 0; call < 2; ++call)
+		{
+			gemmPacked(size[0], size[2], size[1], packed.data(), b.data(), size[2], c.data(), size[2]);
+			ASSERT_TRUE(nearlyEqual(c, naiveMultiply(a, b), EPSILON * size[1]))
+		}
+	}
+	return 1;
+}
+
+int testTransposedOperands()
+{
+	// single rows and columns take the gemv paths, the others the packed blocks
+	const int sizes[][3] = {{ 1, 1, 1 }, { 1, 40, 9 }, { 5, 3, 17 }, { 7, 300, 33 },
+							{ 145, 257, 20 }, { 128, 784, 1 }, { 13, 9, 4100 }};
+	for (const auto& size : sizes)
+	{
+		Matrix a = makeMatrix(size[0], size[1], 1);
+		Matrix b = makeMatrix(size[1], size[2], 2);
+		const Matrix expected = naiveMultiply(a, b);
+		const Matrix storedA[] = { a, naiveTranspose(a) };
+		const Matrix storedB[] = { b, naiveTranspose(b) };
+		for (int opA = GemmNormal; opA <= GemmTransposed; ++opA)
+		{
+			for (int opB = GemmNormal; opB <= GemmTransposed; ++opB)
+			{
+				const Matrix c = multiply(storedA[opA], (GemmOperand) opA, storedB[opB], (GemmOperand) opB);
+				ASSERT_TRUE(nearlyEqual(c, expected, EPSILON * size[1]))
+			}
+		}
+	}
+
+	// out of place from a strided block, in place square and rectangular, tiles and remainders
+	const int shapes[][2] = {{ 1, 1 }, { 1, 9 }, { 9, 1 }, { 16, 16 }, { 33, 33 }, { 3, 17 }, { 70, 33 }, { 200, 5 }};
+	for (const auto& shape : shapes)
+	{
+		Matrix a = makeMatrix(shape[0], shape[1], 4);
+		const Matrix expected = naiveTranspose(a);
+		Matrix wide(shape[0], shape[1] + 3);
+		for (int row = 0; row < shape[0]; ++row)
+		{
+			for (int col = 0; col < shape[1]; ++col)
+			{
+				wide(row, col + 2) = a(row, col);
+			}
+		}
+		ASSERT_TRUE(nearlyEqual(MatrixView(wide).block(0, 2, shape[0], shape[1]).transposed(), expected, 0))
+
+		Matrix inPlace = a;
+		inPlace.transpose();
+		ASSERT_TRUE(nearlyEqual(inPlace, expected, 0))
+		inPlace.transpose();
+		ASSERT_TRUE(nearlyEqual(inPlace, a, 0))
+
+		// a borrowed matrix is never written, it becomes an owned transpose
+		Matrix borrowed = Matrix::borrow(MatrixView(a));
+		borrowed.transpose();
+		ASSERT_TRUE(borrowed.isOwner())
+		ASSERT_TRUE(nearlyEqual(borrowed, expected, 0))
+		ASSERT_TRUE(nearlyEqual(naiveTranspose(expected), a, 0))
+	}
+	return 1;
+}
+
+int testKernelsMatchScalar()
+{
+	const KernelTable* scalar = kernelTable(IsaScalar);
+	const int sizes[] = { 1, 3, 4, 7, 8, 15, 16, 17, 33, 128, 784 };
+	for (int isa = IsaSse2; isa <= IsaAvx512; ++isa)
+	{
+		const KernelTable* table = kernelTable((KernelIsa) isa);
+		if (table == nullptr)
+		{
+			continue;
+		}
+		for (int n : sizes)
+		{
+			Matrix a = makeMatrix(1, n, 3);
+			Matrix b = makeMatrix(1, n, 5);
+			Matrix expected(1, n);
+			Matrix actual(1, n);
+			const float* x = a.data();
+			const float* y = b.data();
+
+			scalar->add(x, y, expected.data(), n);
+			table->add(x, y, actual.data(), n);
+			ASSERT_TRUE(nearlyEqual(expected, actual, 0))
+			scalar->sub(x, y, expected.data(), n);
+			table->sub(x, y, actual.data(), n);
+			ASSERT_TRUE(nearlyEqual(expected, actual, 0))
+			scalar->scale(x, 3.5f, expected.data(), n);
+			table->scale(x, 3.5f, actual.data(), n);
+			ASSERT_TRUE(nearlyEqual(expected, actual, 0))
+			scalar->relu(x, expected.data(), n);
+			table->relu(x, actual.data(), n);
+			ASSERT_TRUE(nearlyEqual(expected, actual, 0))
+			scalar->exp(x, expected.data(), n);
+			table->exp(x, actual.data(), n);
+			ASSERT_TRUE(nearlyEqual(expected, actual, EPSILON))
+			const float expectedSum = scalar->expSum(x, 0.25f, expected.data(), n);
+			const float actualSum = table->expSum(x, 0.25f, actual.data(), n);
+			ASSERT_TRUE(nearlyEqual(expected, actual, EPSILON) && std::fabs(expectedSum - actualSum) < EPSILON * n)
+
+			ASSERT_TRUE(std::fabs(scalar->sum(x, n) - table->sum(x, n)) < EPSILON * n)
+			ASSERT_TRUE(scalar->max(x, n) == table->max(x, n))
+			ASSERT_TRUE(std::fabs(scalar->dot(x, y, n) - table->dot(x, y, n)) < EPSILON * n)
+
+			// INT8 rows are exact, every instruction set must agree bit for bit
+			const int padded = (n + QUANT_PADDING - 1) / QUANT_PADDING * QUANT_PADDING;
+			std::vector<int8_t> quantizedWeights(7 * padded, 0);
+			std::vector<uint8_t> quantizedInput(padded, 0);
+			for (int i = 0; i < n; ++i)
+			{
+				quantizedInput[i] = (uint8_t) ((i * 37) % (QUANT_ACTIVATION_MAX + 1));
+				for (int row = 0; row < 7; ++row)
+				{
+					quantizedWeights[row * padded + i] = (int8_t) ((i * 11 + row * 29) % 255 - QUANT_WEIGHT_MAX);
+				}
+			}
+			int32_t expectedSums[7];
+			int32_t actualSums[7];
+			scalar->denseInt8(7, padded, quantizedWeights.data(), quantizedInput.data(), expectedSums);
+			table->denseInt8(7, padded, quantizedWeights.data(), quantizedInput.data(), actualSums);
+			ASSERT_TRUE(std::equal(expectedSums, expectedSums + 7, actualSums))
+
+			// 7 rows: one full block of fused rows plus a remainder
+			Matrix weights = makeMatrix(7, n, 4);
+			Matrix bias = makeMatrix(7, 1, 6);
+			Matrix expectedRows(7, 1);
+			Matrix actualRows(7, 1);
+			for (bool relu : { false, true })
+			{
+				scalar->dense(7, n, weights.data(), n, x, bias.data(), expectedRows.data(), relu);
+				table->dense(7, n, weights.data(), n, x, bias.data(), actualRows.data(), relu);
+				ASSERT_TRUE(nearlyEqual(expectedRows, actualRows, EPSILON * n))
+				for (int row = 0; row < 7; ++row)
+				{
+					const float value = scalar->dot(weights.data() + row * n, x, n) + bias[row];
+					ASSERT_TRUE(std::fabs(expectedRows[row] - (relu && value < 0 ? 0 : value)) < EPSILON)
+				}
+				for (HalfFormat format : { HalfBf16, HalfFp16 })
+				{
+					std::vector<uint16_t> halfWeights(7 * n);
+					for (int i = 0; i < 7 * n; ++i)
+					{
+						halfWeights[i] = floatToHalf(weights[i], format);
+					}
+					scalar->denseHalf(7, n, halfWeights.data(), x, bias.data(), expectedRows.data(), relu, format);
+					table->denseHalf(7, n, halfWeights.data(), x, bias.data(), actualRows.data(), relu, format);
+					ASSERT_TRUE(nearlyEqual(expectedRows, actualRows, EPSILON * n))
+				}
+
+				// every other block of each row, an odd count exercises the single block tail
+				std::vector<int> rowStart(1, 0);
+				std::vector<int> blockCols;
+				for (int row = 0; row < 7; ++row)
+				{
+					for (int col = row % 2; col + SPARSE_BLOCK <= n; col += 2 * SPARSE_BLOCK)
+					{
+						blockCols.push_back(col);
+					}
+					rowStart.push_back((int) blockCols.size());
+				}
+				if (!blockCols.empty())
+				{
+					scalar->denseBlocks(7, rowStart.data(), blockCols.data(), weights.data(), x, bias.data(),
+										expectedRows.data(), relu);
+					table->denseBlocks(7, rowStart.data(), blockCols.data(), weights.data(), x, bias.data(),
+									   actualRows.data(), relu);
+					ASSERT_TRUE(nearlyEqual(expectedRows, actualRows, EPSILON * n))
+				}
+
+				// prepacked panels of each table's own height, 7 rows leave a padded panel
+				scalar->dense(7, n, weights.data(), n, x, bias.data(), expectedRows.data(), relu);
+				for (const KernelTable* panels : { scalar, table })
+				{
+					std::vector<float> packed(packedWeightsSize(7, n, panels->gemmMr));
+					packWeights(7, n, weights.data(), n, panels->gemmMr, packed.data());
+					panels->densePanels(7, n, packed.data(), x, bias.data(), actualRows.data(), relu);
+					ASSERT_TRUE(nearlyEqual(expectedRows, actualRows, EPSILON * n))
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+int testSoftmaxIsStable()
+{
+	// a wide output layer with logits far beyond exp's float range, 3 samples
+	const int classes = 1000;
+	const int samples = 3;
+	Matrix logits(classes, samples);
+	for (int i = 0; i < classes * samples; ++i)
+	{
+		logits[i] = (float) ((i * 37) % 1009) + 500;
+	}
+	Matrix transposed(samples, classes);
+	for (int row = 0; row < classes; ++row)
+	{
+		for (int col = 0; col < samples; ++col)
+		{
+			transposed(col, row) = logits(row, col);
+		}
+	}
+
+	for (ExpMode mode : { ExpFast, ExpExact })
+	{
+		Activation::setExpMode(mode);
+		Matrix columns(classes, samples);
+		Matrix rows(samples, classes);
+		Matrix logColumns(classes, samples);
+		Matrix logRows = transposed;
+		Activation::softmax(logits.data(), columns.data(), classes, samples, SoftmaxColumns);
+		Activation::softmax(transposed.data(), rows.data(), samples, classes, SoftmaxRows);
+		Activation::logSoftmax(logits.data(), logColumns.data(), classes, samples, SoftmaxColumns);
+		Activation::logSoftmax(logRows.data(), logRows.data(), samples, classes, SoftmaxRows);
+		Matrix logSumColumns(1, samples);
+		Matrix logSumRows(1, samples);
+		Activation::logSumExp(logits.data(), logSumColumns.data(), classes, samples, SoftmaxColumns);
+		Activation::logSumExp(transposed.data(), logSumRows.data(), samples, classes, SoftmaxRows);
+		for (int col = 0; col < samples; ++col)
+		{
+			// reference in double
+			double max = logits(0, col);
+			for (int row = 1; row < classes; ++row)
+			{
+				max = std::max(max, (double) logits(row, col));
+			}
+			double sum = 0;
+			for (int row = 0; row < classes; ++row)
+			{
+				sum += std::exp(logits(row, col) - max);
+			}
+			ASSERT_TRUE(std::fabs(logSumColumns[col] - (max + std::log(sum))) < EPSILON * 10)
+			ASSERT_TRUE(std::fabs(logSumRows[col] - logSumColumns[col]) < EPSILON * 10)
+			for (int row = 0; row < classes; ++row)
+			{
+				const double logExpected = logits(row, col) - max - std::log(sum);
+				ASSERT_TRUE(std::fabs(columns(row, col) - std::exp(logExpected)) < EPSILON)
+				ASSERT_TRUE(std::fabs(rows(col, row) - columns(row, col)) < EPSILON)
+				ASSERT_TRUE(std::fabs(logColumns(row, col) - logExpected) < EPSILON * 10)
+				ASSERT_TRUE(std::fabs(logRows(col, row) - logExpected) < EPSILON * 10)
+			}
+		}
+	}
+	Activation::setExpMode(ExpFast);
+
+	// a row vector Matrix is one sample
+	Matrix row(1, 4);
+	row[3] = 1000;
+	const Matrix probabilities = Activation(Softmax)(row);
+	RETURN_ASSERT_TRUE(probabilities[3] == 1 && probabilities[0] == 0)
+}
+
+int testMoveAndInPlaceDoNotAllocate()
+{
+	Matrix a = makeMatrix(16, 8, 1);
+	Matrix b = makeMatrix(16, 8, 2);
+	Matrix expected = a + b;
+	expected -= b;
+
+	const long before = allocationCount;
+	Matrix moved(std::move(a));
+	moved += b;
+	moved -= b;
+	moved *= 2;
+	moved *= 0.5f;
+	a = std::move(moved);
+	ASSERT_TRUE(allocationCount == before)
+	RETURN_ASSERT_TRUE(nearlyEqual(a, expected, EPSILON))
+}
+
+int testForwardPassAllocations()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		weights[i] = makeMatrix(weightsDims[i].rows, weightsDims[i].cols, i);
+		biases[i] = makeMatrix(biasDims[i].rows, biasDims[i].cols, i + MLP_SIZE);
+	}
+	MlpNetwork mlp(weights, biases);
+	Matrix img = makeMatrix(imgDims.rows * imgDims.cols, 1, 0);
+	mlp(img);
+
+	// layers alternate between the thread's workspace buffers: no allocation at all
+	const long before = allocationCount;
+	const AllocatorStats statsBefore = matrixAllocatorStats();
+	mlp(img);
+	const AllocatorStats statsAfter = matrixAllocatorStats();
+	ASSERT_TRUE(allocationCount == before)
+	RETURN_ASSERT_TRUE(statsAfter.allocations == statsBefore.allocations)
+}
+
+int testModelOfAnyDepth()
+{
+	// odd depth and the widest layer in the middle, so both buffers are reused
+	const int widths[] = { 12, 40, 8, 40, 16, 6, 30, 5 };
+	const int depth = sizeof(widths) / sizeof(widths[0]) - 1;
+	std::vector<Dense> layers;
+	for (int i = 0; i < depth; ++i)
+	{
+		layers.emplace_back(makeMatrix(widths[i + 1], widths[i], i), makeMatrix(widths[i + 1], 1, i + depth),
+							i == depth - 1 ? Softmax : Relu);
+	}
+	Matrix input = makeMatrix(widths[0], 1, 3);
+	Matrix expected = input;
+	for (const Dense& layer : layers)
+	{
+		expected = layer(expected);
+	}
+	const Digit reference = MlpNetwork::mostProbable(expected, 0);
+
+	MlpNetwork deep(std::move(layers));
+	ASSERT_TRUE(deep.getLayers().size() == (size_t) depth && deep.getInputs() == widths[0])
+	MlpWorkspace workspace = deep.makeWorkspace();
+	ASSERT_TRUE(workspace.getWidth() == 40)
+	// warm up: a profiling build adds its entries on the first call
+	deep(MatrixView(input), workspace);
+	const long before = allocationCount;
+	const AllocatorStats statsBefore = matrixAllocatorStats();
+	const Digit digit = deep(MatrixView(input), workspace);
+	const AllocatorStats statsAfter = matrixAllocatorStats();
+	ASSERT_TRUE(allocationCount == before && statsAfter.allocations == statsBefore.allocations)
+	ASSERT_TRUE(digit.value == reference.value && std::fabs(digit.probability - reference.probability) < EPSILON)
+
+	// batches are packed at the network's input width, a partial last batch included
+	const int samples = 7;
+	std::vector<Matrix> inputs;
+	for (int i = 0; i < samples; ++i)
+	{
+		inputs.push_back(makeMatrix(widths[0], 1, 10 + i));
+	}
+	const std::vector<Digit> batched = deep.classifyBatch(inputs.data(), samples);
+	ParallelClassifier parallel(deep, 2, 3);
+	const std::vector<Digit> spread = parallel.classify(inputs.data(), samples);
+	ASSERT_TRUE(batched.size() == (size_t) samples && spread.size() == (size_t) samples)
+	for (int i = 0; i < samples; ++i)
+	{
+		const Digit single = deep(inputs[i]);
+		ASSERT_TRUE(batched[i].value == single.value && spread[i].value == single.value)
+		ASSERT_TRUE(std::fabs(batched[i].probability - single.probability) < EPSILON)
+		ASSERT_TRUE(std::fabs(spread[i].probability - single.probability) < EPSILON)
+	}
+
+	// the shipped description builds the shipped network
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	std::vector<Dense> loaded;
+	std::vector<LayerDescription> descriptions;
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	ASSERT_TRUE(!readModelDescription(IMAGES_DIR "labels.txt", descriptions) && !loadModel("missing", loaded))
+	ASSERT_TRUE(loadModel(PARAMETERS_DIR "model.txt", loaded) && loaded.size() == MLP_SIZE)
+	MlpNetwork described(std::move(loaded));
+	MlpNetwork mlp(weights, biases);
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		const Digit actual = described(images[i]);
+		ASSERT_TRUE(actual.value == sampleLabels[i] && actual.probability == mlp(images[i]).probability)
+	}
+	return 1;
+}
+
+int testPackedModelRoundTrip()
+{
+	const char* packedPath = "packed_test.pack";
+	const char* corruptPath = "packed_test_corrupt.pack";
+	std::vector<Dense> layers;
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(loadModel(PARAMETERS_DIR "model.txt", layers) && readImages(images))
+	ASSERT_TRUE(crc32("123456789", 9) == 0xCBF43926u)
+	ASSERT_TRUE(writePackedModel(packedPath, layers) && isPackedModel(packedPath))
+
+	MappedFile file;
+	std::vector<Dense> packed;
+	std::string error;
+	ASSERT_TRUE(mapPackedModel(packedPath, file, packed, error) && packed.size() == layers.size())
+	for (const Dense& layer : packed)
+	{
+		// borrowed straight from the aligned mapping
+		ASSERT_TRUE((const char*) layer.getWeights().data() >= (const char*) file.data() &&
+					(uintptr_t) layer.getWeights().data() % PACKED_ALIGNMENT == 0 &&
+					(uintptr_t) layer.getBias().data() % PACKED_ALIGNMENT == 0)
+	}
+	MlpNetwork expected(std::move(layers));
+	MlpNetwork actual(std::move(packed));
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		ASSERT_TRUE(actual(images[i]).value == sampleLabels[i] &&
+					actual(images[i]).probability == expected(images[i]).probability)
+	}
+
+	// flip one byte of the last weights, then truncate
+	std::string bytes(static_cast<const char*>(file.data()), file.size());
+	bytes[bytes.size() - PACKED_ALIGNMENT * 2] ^= 1;
+	std::ofstream(corruptPath, std::ios::out | std::ios::binary | std::ios::trunc) << bytes;
+	MappedFile corrupt;
+	const bool flipped = mapPackedModel(corruptPath, corrupt, packed, error);
+	const std::string flippedError = error;
+	std::ofstream(corruptPath, std::ios::out | std::ios::binary | std::ios::trunc) << bytes.substr(0, bytes.size() / 2);
+	const bool truncated = mapPackedModel(corruptPath, corrupt, packed, error);
+	std::remove(packedPath);
+	std::remove(corruptPath);
+	ASSERT_TRUE(!flipped && flippedError.find("checksum") != std::string::npos)
+	RETURN_ASSERT_TRUE(!truncated && error.find("truncated") != std::string::npos && !isPackedModel("missing"))
+}
+
+int testMatrixCopyBudgets()
+{
+	const long bytes = 4 * 4 * (long) sizeof(float);
+	matrixCountersReset();
+	{
+		Matrix a(4, 4);
+		Matrix b = a;
+		Matrix c = std::move(b);
+		a = c;
+		Matrix d = 2.0f * a;
+		MatrixCounters counters = matrixCounters();
+		// the assignment reuses a's buffer, the left scalar product is one fresh result
+		ASSERT_TRUE(counters.constructions == 2 && counters.copies == 2 && counters.moves == 1)
+		ASSERT_TRUE(counters.bytesAllocated == 3 * bytes && counters.liveBytes == 3 * bytes)
+		b = std::move(d);
+	}
+	const MatrixCounters afterScope = matrixCounters();
+	ASSERT_TRUE(afterScope.liveBytes == 0 && afterScope.peakLiveBytes == 3 * bytes && afterScope.moves == 2)
+
+	// one forward pass: no Matrix at all once the thread's workspace exists
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+	mlp(images[0]);
+	matrixCountersReset();
+	mlp(images[1]);
+	MatrixCounters counters = matrixCounters();
+	ASSERT_TRUE(counters.constructions == 0 && counters.copies == 0 && counters.bytesAllocated == 0)
+
+	// a batch: the packed input and one result per layer, nothing copied
+	matrixCountersReset();
+	mlp.classifyBatch(images, SAMPLE_IMAGES);
+	counters = matrixCounters();
+	ASSERT_TRUE(counters.constructions <= MLP_SIZE + 1 && counters.copies == 0 && counters.liveBytes == 0)
+
+	// every sampled copy leaves a stack naming its caller
+	matrixTraceCopies(1);
+	for (int i = 0; i < 3; ++i)
+	{
+		Matrix copy = images[i];
+	}
+	const std::vector<std::pair<std::string, long>> sites = matrixCopySites();
+	matrixTraceCopies(0);
+#ifdef __GLIBC__
+	long samples = 0;
+	for (const std::pair<std::string, long>& site : sites)
+	{
+		samples += site.second;
+	}
+	RETURN_ASSERT_TRUE(samples == 3 && sites.front().first.find('\n') != std::string::npos)
+#else
+	RETURN_ASSERT_TRUE(sites.empty())
+#endif
+}
+
+int testViewsAreZeroCopy()
+{
+	Matrix batch = makeMatrix(12, 10, 4);
+	Matrix weights = makeMatrix(5, 12, 6);
+
+	const long before = allocationCount;
+	MatrixView whole(batch);
+	MatrixView flat = whole.vectorize();
+	MatrixView subBatch = whole.colRange(3, 4);
+	MatrixView sample = whole.column(7);
+	MatrixView block = whole.block(2, 1, 6, 5);
+	ASSERT_TRUE(allocationCount == before)
+
+	ASSERT_TRUE(flat.getRows() == 120 && flat(13, 0) == batch(1, 3))
+	ASSERT_TRUE(subBatch.getLd() == 10 && subBatch(4, 2) == batch(4, 5))
+	ASSERT_TRUE(sample(11, 0) == batch(11, 7))
+	ASSERT_TRUE(block(5, 4) == batch(7, 5))
+
+	// products and sums on strided views match the materialized copies
+	ASSERT_TRUE(nearlyEqual(weights * subBatch, weights * Matrix(subBatch), EPSILON))
+	ASSERT_TRUE(nearlyEqual(weights * sample, weights * Matrix(sample), EPSILON))
+	RETURN_ASSERT_TRUE(nearlyEqual(block + block, Matrix(block) + Matrix(block), EPSILON))
+}
+
+int testAllocatorAlignmentAndReuse()
+{
+	const int sizes[] = { 1, 15, 16, 17, 100, 128 * 784 };
+	for (int count : sizes)
+	{
+		float* first = matrixAllocate(count);
+		ASSERT_TRUE(reinterpret_cast<size_t>(first) % MATRIX_ALIGNMENT == 0)
+		first[count - 1] = 1;
+		matrixFree(first, count);
+
+		const AllocatorStats before = matrixAllocatorStats();
+		float* second = matrixAllocate(count);
+		const AllocatorStats after = matrixAllocatorStats();
+		ASSERT_TRUE(second == first)
+		ASSERT_TRUE(after.poolHits == before.poolHits + 1)
+		matrixFree(second, count);
+	}
+	const AllocatorStats stats = matrixAllocatorStats();
+	RETURN_ASSERT_TRUE(stats.peakBytesReserved >= stats.bytesInUse + stats.bytesCached && stats.bytesCached > 0)
+}
+
+int testMappedParametersAreBorrowed()
+{
+	MappedFile file;
+	ASSERT_TRUE(!file.open(PARAMETERS_DIR "missing"))
+	ASSERT_TRUE(file.open(PARAMETERS_DIR "b1"))
+	ASSERT_TRUE(file.size() == biasDims[0].rows * sizeof(float))
+
+	Matrix expected(biasDims[0].rows, biasDims[0].cols);
+	std::ifstream is(PARAMETERS_DIR "b1", std::ios::in | std::ios::binary);
+	is >> expected;
+
+	const long before = matrixAllocatorStats().allocations;
+	Matrix borrowed = Matrix::borrow(file.view(biasDims[0].rows, biasDims[0].cols));
+	Matrix moved(std::move(borrowed));
+	const Matrix& mapped = moved;
+	ASSERT_TRUE(matrixAllocatorStats().allocations == before)
+	ASSERT_TRUE(!mapped.isOwner() && mapped.data() == file.data())
+	ASSERT_TRUE(nearlyEqual(mapped, expected, 0))
+
+	// copies own their elements and can be written
+	Matrix copy = mapped;
+	copy[0] += 1;
+	ASSERT_TRUE(copy.isOwner() && copy.data() != mapped.data() && copy[0] == mapped[0] + 1)
+
+	// the pages are read-only: every write first copies the matrix into owned storage
+	Matrix indexed = Matrix::borrow(file.view(biasDims[0].rows, biasDims[0].cols));
+	indexed[0] += 1;
+	indexed(1, 0) = 0;
+	Matrix accumulated = Matrix::borrow(file.view(biasDims[0].rows, biasDims[0].cols));
+	accumulated += expected;
+	accumulated -= expected;
+	accumulated *= 2;
+	Matrix read = Matrix::borrow(file.view(biasDims[0].rows, biasDims[0].cols));
+	std::ifstream again(PARAMETERS_DIR "b1", std::ios::in | std::ios::binary);
+	again >> read;
+	Matrix written = Matrix::borrow(file.view(biasDims[0].rows, biasDims[0].cols));
+	written.data()[0] = 0;
+	ASSERT_TRUE(indexed.isOwner() && indexed[0] == expected[0] + 1 && indexed[1] == 0 && indexed[2] == expected[2])
+	ASSERT_TRUE(accumulated.isOwner() && nearlyEqual(accumulated, expected * 2, EPSILON))
+	ASSERT_TRUE(read.isOwner() && nearlyEqual(read, expected, 0))
+	ASSERT_TRUE(written.isOwner() && written[0] == 0 && written[1] == expected[1])
+	RETURN_ASSERT_TRUE(nearlyEqual(mapped, expected, 0) && mapped.data() == file.data())
+}
+
+int testBorrowedNetworkMatchesCopied()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	std::vector<MatrixView> weightViews;
+	std::vector<MatrixView> biasViews;
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		weights[i] = makeMatrix(weightsDims[i].rows, weightsDims[i].cols, i);
+		biases[i] = makeMatrix(biasDims[i].rows, biasDims[i].cols, i + 1);
+		weightViews.emplace_back(weights[i]);
+		biasViews.emplace_back(biases[i]);
+	}
+	MlpNetwork copied(weights, biases);
+	Matrix img = makeMatrix(imgDims.rows * imgDims.cols, 1, 3);
+	Matrix batch[] = { img, makeMatrix(imgDims.rows * imgDims.cols, 1, 4) };
+	const Digit expected = copied(img);
+	const std::vector<Digit> expectedBatch = copied.classifyBatch(batch, 2);
+
+	// borrowed weights are never packed: neither pass keeps a second copy resident
+	const long bytesBefore = matrixAllocatorStats().bytesInUse;
+	MlpNetwork borrowed(weightViews.data(), biasViews.data());
+	const Digit actual = borrowed(img);
+	const std::vector<Digit> actualBatch = borrowed.classifyBatch(batch, 2);
+	ASSERT_TRUE(matrixAllocatorStats().bytesInUse == bytesBefore)
+	ASSERT_TRUE(actualBatch[0].value == expectedBatch[0].value && actualBatch[1].value == expectedBatch[1].value &&
+				std::fabs(actualBatch[1].probability - expectedBatch[1].probability) < EPSILON)
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		const Dense& layer = borrowed.getLayers()[i];
+		ASSERT_TRUE(!layer.getWeights().isOwner() && layer.getWeights().data() == weightViews[i].data() &&
+					!layer.getBias().isOwner() && layer.getBias().data() == biasViews[i].data())
+	}
+	RETURN_ASSERT_TRUE(expected.value == actual.value && expected.probability == actual.probability)
+}
+
+int testBatchMatchesSingleImage()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+
+	const std::vector<Digit> digits = mlp.classifyBatch(images, SAMPLE_IMAGES);
+	ASSERT_TRUE(digits.size() == SAMPLE_IMAGES)
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		const Digit single = mlp(images[i]);
+		ASSERT_TRUE(digits[i].value == sampleLabels[i] && single.value == sampleLabels[i])
+		ASSERT_TRUE(std::fabs(digits[i].probability - single.probability) < EPSILON)
+	}
+	return 1;
+}
+
+int testArgmaxMatchesSoftmax()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		// the reference normalizes the whole output layer
+		Matrix probabilities = Matrix(images[i]).vectorize();
+		for (const Dense& layer : mlp.getLayers())
+		{
+			probabilities = layer(probabilities);
+		}
+		const Digit expected = MlpNetwork::mostProbable(probabilities, 0);
+		const Digit actual = mlp(images[i]);
+		ASSERT_TRUE(actual.value == expected.value && std::fabs(actual.probability - expected.probability) < EPSILON)
+
+		const std::vector<ClassScore> top = mlp.topK(images[i], 3);
+		ASSERT_TRUE(top.size() == 3 && top[0].value == actual.value)
+		for (size_t rank = 0; rank < top.size(); ++rank)
+		{
+			ASSERT_TRUE(std::fabs(top[rank].probability - probabilities[top[rank].value]) < EPSILON)
+			ASSERT_TRUE(rank == 0 || top[rank].logit <= top[rank - 1].logit)
+		}
+
+		// k past the output width ranks every class, their probabilities sum to 1
+		const std::vector<ClassScore> all = mlp.topK(images[i], 100);
+		float sum = 0;
+		for (const ClassScore& score : all)
+		{
+			sum += score.probability;
+		}
+		ASSERT_TRUE(all.size() == (size_t) probabilities.getRows() && std::fabs(sum - 1) < EPSILON)
+		ASSERT_TRUE(mlp.topK(images[i], 0).empty())
+	}
+	return 1;
+}
+
+int testParallelMatchesSerial()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+
+	// more images than workers times batch size so every worker runs and steals
+	const int repeats = 37;
+	std::vector<Matrix> stream;
+	for (int i = 0; i < repeats * SAMPLE_IMAGES; ++i)
+	{
+		stream.push_back(images[i % SAMPLE_IMAGES]);
+	}
+
+	std::atomic<int> ran(0);
+	{
+		ThreadPool pool(3);
+		for (int i = 0; i < 100; ++i)
+		{
+			pool.submit([&ran, &pool](int worker)
+						{
+							if (worker >= 0 && worker < pool.size() && ThreadPool::workerIndex() == worker)
+							{
+								ran++;
+							}
+						});
+		}
+		pool.wait();
+		ASSERT_TRUE(ran == 100)
+	}
+
+	ParallelClassifier classifier(mlp, 4, 8);
+	std::vector<double> latencies;
+	const std::vector<Digit> digits = classifier.classify(stream.data(), (int) stream.size(), &latencies);
+	ASSERT_TRUE(digits.size() == stream.size())
+	ASSERT_TRUE(latencies.size() == (stream.size() + 7) / 8)
+	for (size_t i = 0; i < stream.size(); ++i)
+	{
+		ASSERT_TRUE(digits[i].value == sampleLabels[i % SAMPLE_IMAGES])
+	}
+	for (double latency : latencies)
+	{
+		ASSERT_TRUE(latency > 0)
+	}
+	return 1;
+}
+
+int testBulkMatchesSingleImage()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+
+	// a stream of the sample images and a truncated one, with batches that do not divide it
+	const char* streamPath = "bulk_test.stream";
+	std::ofstream stream(streamPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		stream.write(reinterpret_cast<const char*>(images[i].data()), (long) (images[i].getRows() * sizeof(float)));
+	}
+	stream.write(reinterpret_cast<const char*>(images[0].data()), sizeof(float));
+	stream.close();
+
+	FILE* output = std::tmpfile();
+	ASSERT_TRUE(output != nullptr)
+	BulkClassifier classifier(mlp, 3, output);
+	const bool streamed = classifier.run(BulkStream, streamPath);
+	const bool missing = classifier.run(BulkDirectory, "missing");
+	std::remove(streamPath);
+	ASSERT_TRUE(streamed && !missing && classifier.classified() == SAMPLE_IMAGES)
+
+	std::rewind(output);
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		int index = -1;
+		unsigned int value = 0;
+		float probability = 0;
+		ASSERT_TRUE(std::fscanf(output, "%d %u %f", &index, &value, &probability) == 3)
+		const Digit single = mlp(images[i]);
+		ASSERT_TRUE(index == i && value == sampleLabels[i] && value == single.value)
+		ASSERT_TRUE(std::fabs(probability - single.probability) < EPSILON)
+	}
+	char invalid[RESULT_NAME_CHARS] = {};
+	int index = -1;
+	ASSERT_TRUE(std::fscanf(output, "%d %15s", &index, invalid) == 2)
+	std::fclose(output);
+	RETURN_ASSERT_TRUE(index == SAMPLE_IMAGES && std::string(invalid) == "invalid")
+}
+
+int testServerMatchesSingleImage()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+	const char* socketPath = "server_test.sock";
+	const int inputs = imgDims.rows * imgDims.cols;
+
+	// batches of 4, so the pipelined requests of two connections split across batches
+	InferenceServer server(mlp, 4, 200);
+	ASSERT_TRUE(server.listen(socketPath))
+	std::thread serving([&server]()
+						{ server.run(); });
+	InferenceClient floats;
+	InferenceClient pixels;
+	const bool connected = floats.connect(socketPath) && pixels.connect(socketPath);
+	std::vector<uint8_t> bytes[SAMPLE_IMAGES];
+	Matrix scaled[SAMPLE_IMAGES];
+	bool sent = connected;
+	for (int i = 0; i < SAMPLE_IMAGES && sent; ++i)
+	{
+		bytes[i].resize(inputs);
+		scaled[i] = Matrix(images[i].getRows(), images[i].getCols());
+		for (int j = 0; j < inputs; ++j)
+		{
+			bytes[i][j] = (uint8_t) std::lround(std::min(1.0f, std::max(0.0f, images[i][j])) * 255);
+			scaled[i][j] = bytes[i][j] / 255.0f;
+		}
+		sent = floats.send(images[i].data()) && pixels.send(bytes[i].data());
+	}
+	bool matches = sent;
+	Digit digit;
+	for (int i = 0; i < SAMPLE_IMAGES && matches; ++i)
+	{
+		const Digit expected = mlp(images[i]);
+		const Digit expectedPixels = mlp(scaled[i]);
+		matches = floats.receive(digit) && digit.value == expected.value &&
+				  std::fabs(digit.probability - expected.probability) < EPSILON &&
+				  pixels.receive(digit) && digit.value == expectedPixels.value &&
+				  std::fabs(digit.probability - expectedPixels.probability) < EPSILON;
+	}
+
+	// a burst past the backpressure bounds, sent before any reply is read: the server
+	// pauses the connection rather than buffering it, every reply still arrives in order
+	Digit expectedScaled[SAMPLE_IMAGES];
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		expectedScaled[i] = mlp(scaled[i]);
+	}
+	const int burstRequests = 8 * SERVER_MAX_PENDING;
+	auto runBurst = [&]()
+	{
+		InferenceClient burst;
+		bool burstSent = burst.connect(socketPath);
+		std::thread sender([&]()
+						   {
+							   for (int i = 0; i < burstRequests && burstSent; ++i)
+							   {
+								   burstSent = burst.send(bytes[i % SAMPLE_IMAGES].data());
+							   }
+						   });
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		bool burstMatches = true;
+		Digit reply;
+		for (int i = 0; i < burstRequests && burstMatches; ++i)
+		{
+			burstMatches = burst.receive(reply) && reply.value == expectedScaled[i % SAMPLE_IMAGES].value;
+		}
+		sender.join();
+		return burstSent && burstMatches;
+	};
+	const bool burstServed = runBurst();
+
+	// under load, image buffers go back to the I/O thread that allocated them rather
+	// than piling up in the batcher's cache while the I/O thread reserves new ones
+	const AllocatorStats loaded = matrixAllocatorStats();
+	const bool steadyServed = runBurst();
+	const AllocatorStats steady = matrixAllocatorStats();
+
+	// an unknown format closes only its own connection
+	const int invalid = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+	std::vector<char> frame(1 + inputs * sizeof(float), 0);
+	frame[0] = SERVER_FORMAT_BYTES + 1;
+	char reply = 0;
+	const bool invalidClosed = connect(invalid, (const sockaddr*) &address, sizeof(address)) == 0 &&
+							   write(invalid, frame.data(), frame.size()) == (ssize_t) frame.size() &&
+							   read(invalid, &reply, 1) == 0;
+	close(invalid);
+	const bool stillServing = floats.send(images[1].data()) && floats.receive(digit) &&
+							  digit.value == mlp(images[1]).value;
+	server.stop();
+	serving.join();
+	struct stat status;
+	ASSERT_TRUE(connected && sent && matches && burstServed && steadyServed && invalidClosed && stillServing)
+	ASSERT_TRUE(steady.systemAllocations - loaded.systemAllocations < burstRequests / 16)
+	RETURN_ASSERT_TRUE(server.served() == 2 * SAMPLE_IMAGES + 2 * burstRequests + 1 &&
+					   server.batches() >= (2 * SAMPLE_IMAGES + 2 * burstRequests + 1) / 4 &&
+					   stat(socketPath, &status) != 0)
+}
+
+int testQuantizedMatchesFloat()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+	QuantizedMlp quantized(weights, biases, images, SAMPLE_IMAGES);
+	long weightCount = 0;
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		weightCount += (long) weightsDims[i].rows * weightsDims[i].cols;
+	}
+	ASSERT_TRUE(quantized.weightBytes() == weightCount)
+
+	const std::string path = "quantized_test.q8";
+	QuantizedMlp loaded;
+	ASSERT_TRUE(!loaded.load(PARAMETERS_DIR "w1"))
+	ASSERT_TRUE(quantized.save(path) && loaded.load(path))
+	std::remove(path.c_str());
+
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		const Digit expected = mlp(images[i]);
+		const Digit actual = quantized(images[i]);
+		const Digit reloaded = loaded(images[i]);
+		ASSERT_TRUE(actual.value == sampleLabels[i] && expected.value == actual.value)
+		ASSERT_TRUE(std::fabs(expected.probability - actual.probability) < 0.01f)
+		ASSERT_TRUE(reloaded.value == actual.value && reloaded.probability == actual.probability)
+	}
+	return 1;
+}
+
+int testHalfMatchesFloat()
+{
+	// rounding edges of both formats
+	ASSERT_TRUE(floatToFp16(1.0f) == 0x3C00u && floatToFp16(65504.0f) == 0x7BFFu && floatToFp16(65520.0f) == 0x7C00u)
+	ASSERT_TRUE(fp16ToFloat(0x0001u) == std::ldexp(1.0f, -24) && floatToFp16(std::ldexp(1.0f, -24)) == 0x0001u)
+	ASSERT_TRUE(floatToFp16(std::ldexp(1.0f, -26)) == 0 && fp16ToFloat(floatToFp16(-2.5f)) == -2.5f)
+	ASSERT_TRUE(std::isnan(fp16ToFloat(floatToFp16(NAN))) && std::isnan(bf16ToFloat(floatToBf16(NAN))))
+	ASSERT_TRUE(floatToBf16(1.0f + std::ldexp(1.0f, -8)) == 0x3F80u && floatToBf16(1.0f + std::ldexp(3.0f, -8)) == 0x3F82u)
+
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+	long weightCount = 0;
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		weightCount += (long) weightsDims[i].rows * weightsDims[i].cols;
+	}
+	for (HalfFormat format : { HalfBf16, HalfFp16 })
+	{
+		HalfMlp half(mlp, format);
+		ASSERT_TRUE(half.weightBytes() == weightCount * (long) sizeof(uint16_t))
+		ASSERT_TRUE(half.getLayers()[0].getWeight(3, 200) ==
+					halfToFloat(floatToHalf(weights[0](3, 200), format), format))
+		for (int i = 0; i < SAMPLE_IMAGES; ++i)
+		{
+			const Digit expected = mlp(images[i]);
+			const Digit actual = half(images[i]);
+			ASSERT_TRUE(actual.value == sampleLabels[i] && std::fabs(expected.probability - actual.probability) < 0.01f)
+		}
+	}
+	return 1;
+}
+
+int testSparseMatchesDense()
+{
+	// 23 inputs: two full blocks and a partial one that shifts left, 5 inputs: CSR only
+	for (int cols : { 23, 5 })
+	{
+		Matrix weights = makeMatrix(9, cols, 2);
+		for (int i = 0; i < 9 * cols; ++i)
+		{
+			weights[i] = i % 3 == 0 || (i / cols) % 4 == 1 ? 0 : weights[i];
+		}
+		const Matrix bias = makeMatrix(9, 1, 5);
+		const Matrix input = makeMatrix(cols, 6, 7);
+		for (ActivationType activation : { Relu, Softmax })
+		{
+			const Dense dense(weights, bias, activation);
+			for (SparseFormat format : { SparseCsr, SparseBlocks })
+			{
+				const SparseDense sparse(dense, format);
+				ASSERT_TRUE(sparse.getFormat() == (cols < SPARSE_BLOCK ? SparseCsr : format))
+				ASSERT_TRUE(sparse.storedValues() < 9L * cols)
+				// a batch, a strided single column and a contiguous one
+				ASSERT_TRUE(nearlyEqual(dense(MatrixView(input)), sparse(MatrixView(input)), EPSILON))
+				const MatrixView column = MatrixView(input).block(0, 2, cols, 1);
+				ASSERT_TRUE(nearlyEqual(dense(column), sparse(column), EPSILON))
+				const Matrix contiguous(column);
+				ASSERT_TRUE(nearlyEqual(dense(contiguous), sparse(MatrixView(contiguous)), EPSILON))
+			}
+		}
+		ASSERT_TRUE(std::fabs(SparseDense::density(Dense(weights, bias, Relu)) -
+							  (float) std::count_if(weights.data(), weights.data() + 9 * cols,
+													[](float weight) { return weight != 0; }) / (9.0f * cols)) < EPSILON)
+	}
+
+	// every layer of the shipped network sparse, single images and a batch
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+	Matrix batch(mlp.getInputs(), SAMPLE_IMAGES);
+	mlp.packBatch(images, SAMPLE_IMAGES, batch);
+	ASSERT_TRUE(SparseMlp(mlp, 0, SparseBlocks).sparseLayers() == 0)
+	for (SparseFormat format : { SparseCsr, SparseBlocks })
+	{
+		SparseMlp sparse(mlp, 1, format);
+		ASSERT_TRUE(sparse.sparseLayers() == MLP_SIZE)
+		const std::vector<Digit> digits = sparse.classifyBatch(MatrixView(batch));
+		for (int i = 0; i < SAMPLE_IMAGES; ++i)
+		{
+			const Digit expected = mlp(images[i]);
+			const Digit actual = sparse(images[i]);
+			ASSERT_TRUE(actual.value == sampleLabels[i] && std::fabs(expected.probability - actual.probability) < EPSILON)
+			ASSERT_TRUE(digits[i].value == actual.value && std::fabs(digits[i].probability - actual.probability) < EPSILON)
+		}
+	}
+	return 1;
+}
+
+int testProfilerCounts()
+{
+	Profiler& profiler = Profiler::instance();
+	profiler.reset();
+	const int key = 0;
+	for (int call = 0; call < 3; ++call)
+	{
+		const ProfileScope scope(&key, "dense relu", 4, 8, 64, 144);
+		Matrix scratch(4, 8);
+	}
+	std::vector<ProfileEntry> entries = profiler.entries();
+	ASSERT_TRUE(entries.size() == 1 && entries[0].name == "dense relu 4x8" && entries[0].calls == 3)
+	ASSERT_TRUE(entries[0].flops == 192 && entries[0].bytes == 432 && entries[0].allocations == 3)
+	std::ostringstream json;
+	profiler.writeJson(json);
+	ASSERT_TRUE(json.str().find("\"name\": \"dense relu 4x8\", \"calls\": 3") != std::string::npos)
+	std::ostringstream summary;
+	profiler.writeSummary(summary);
+	ASSERT_TRUE(summary.str().find("dense relu 4x8 3 calls") != std::string::npos)
+
+	// the network and its layers record only when the hooks are compiled in
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	MlpNetwork mlp(weights, biases);
+	mlp(images[0]);
+	profiler.reset();
+	mlp(images[0]);
+	mlp(images[1]);
+	entries = profiler.entries();
+	profiler.reset();
+#ifdef MLP_PROFILE
+	ASSERT_TRUE(entries.size() == MLP_SIZE + 1 && entries.back().name == "network 10x784")
+	for (const ProfileEntry& entry : entries)
+	{
+		ASSERT_TRUE(entry.calls == 2 && entry.allocations == 0 && entry.seconds > 0)
+	}
+	ASSERT_TRUE(entries[0].name == "dense relu 128x784" && entries[0].flops == 2 * 2.0 * 128 * 784)
+	RETURN_ASSERT_TRUE(entries.back().flops == 2 * mlp.flops(1) && entries.back().bytes == 2 * mlp.weightBytes())
+#else
+	RETURN_ASSERT_TRUE(entries.empty())
+#endif
+}
+
+int testStaticMatchesRuntime()
+{
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	Matrix images[SAMPLE_IMAGES];
+	ASSERT_TRUE(readParameters(weights, biases) && readImages(images))
+	std::vector<MatrixView> weightViews(weights, weights + MLP_SIZE);
+	std::vector<MatrixView> biasViews(biases, biases + MLP_SIZE);
+	MlpNetwork mlp(weights, biases);
+	std::unique_ptr<StaticDigitsMlp> specialized(new StaticDigitsMlp(weightViews.data(), biasViews.data()));
+	ASSERT_TRUE(reinterpret_cast<uintptr_t>(specialized.get()) % MATRIX_ALIGNMENT == 0)
+
+	// odd widths exercise the row and lane remainders
+	Matrix small[2] = { makeMatrix(7, 19, 1), makeMatrix(3, 7, 2) };
+	Matrix smallBias[2] = { makeMatrix(7, 1, 3), makeMatrix(3, 1, 4) };
+	MatrixView smallViews[2] = { MatrixView(small[0]), MatrixView(small[1]) };
+	MatrixView smallBiasViews[2] = { MatrixView(smallBias[0]), MatrixView(smallBias[1]) };
+	StaticMlp<19, 7, 3> tiny(smallViews, smallBiasViews);
+	Matrix input = makeMatrix(19, 1, 5);
+	Matrix hidden = small[0] * input + smallBias[0];
+	for (int i = 0; i < hidden.getRows(); ++i)
+	{
+		hidden[i] = hidden[i] < 0 ? 0 : hidden[i];
+	}
+	Matrix logits = small[1] * hidden + smallBias[1];
+	const Digit tinyDigit = tiny(MatrixView(input));
+	for (int i = 0; i < logits.getRows(); ++i)
+	{
+		ASSERT_TRUE(logits[i] <= logits[tinyDigit.value])
+	}
+
+	for (int i = 0; i < SAMPLE_IMAGES; ++i)
+	{
+		const Digit expected = mlp(images[i]);
+		const Digit actual = (*specialized)(MatrixView(images[i]));
+		ASSERT_TRUE(actual.value == sampleLabels[i] && expected.value == actual.value)
+		ASSERT_TRUE(std::fabs(expected.probability - actual.probability) < EPSILON)
+	}
+	return 1;
+}
+
+/**
+ * Copies layers with one parameter shifted
+ * @param layers	Dense layers
+ * @param tensor	index of the tensor, weights and biases interleaved
+ * @param index		element of the tensor
+ * @param delta		shift
+ * @return			the shifted layers
+ */
+static std::vector<Dense> shiftParameter(const std::vector<Dense>& layers, int tensor, int index, float delta)
+{
+	std::vector<Dense> shifted;
+	for (int layer = 0; layer < (int) layers.size(); ++layer)
+	{
+		Matrix weights = layers[layer].getWeights();
+		Matrix bias = layers[layer].getBias();
+		if (tensor / 2 == layer)
+		{
+			(tensor % 2 == 0 ? weights : bias)[index] += delta;
+		}
+		shifted.emplace_back(weights, bias, layers[layer].getActivation().getActivationType());
+	}
+	return shifted;
+}
+
+int testTrainerGradients()
+{
+	const int samples = 10;
+	const Matrix images = makeMatrix(samples, 7, 3);
+	std::vector<int> labels;
+	for (int i = 0; i < samples; ++i)
+	{
+		labels.push_back(i % 3);
+	}
+	TrainingOptions options;
+	options.batchSize = samples;
+	options.optimizer = OptimizerSgd;
+	options.learningRate = 1;
+	Trainer serial({ 7, 9, 5, 3 }, options);
+	const std::vector<Dense> initial = serial.layers();
+	const float loss = serial.trainBatch(images.data(), labels.data(), samples);
+	const std::vector<Dense> stepped = serial.layers();
+
+	// a unit SGD step moves every parameter by minus its gradient, compare with central differences
+	const float shift = 1e-3f;
+	for (int tensor = 0; tensor < 6; ++tensor)
+	{
+		const Matrix& before = tensor % 2 == 0 ? initial[tensor / 2].getWeights() : initial[tensor / 2].getBias();
+		const Matrix& after = tensor % 2 == 0 ? stepped[tensor / 2].getWeights() : stepped[tensor / 2].getBias();
+		for (int index = 0; index < before.getRows() * before.getCols(); index += 4)
+		{
+			const float up = Trainer(shiftParameter(initial, tensor, index, shift), options)
+					.loss(images.data(), labels.data(), samples);
+			const float down = Trainer(shiftParameter(initial, tensor, index, -shift), options)
+					.loss(images.data(), labels.data(), samples);
+			ASSERT_TRUE(std::fabs((up - down) / (2 * shift) - (before[index] - after[index])) < 2e-3f)
+		}
+	}
+	ASSERT_TRUE(std::fabs(Trainer(initial, options).loss(images.data(), labels.data(), samples) - loss) < EPSILON)
+
+	// shards of 3, 3, 3 and 1 samples reduce to the serial gradient, for either optimizer
+	for (Optimizer optimizer : { OptimizerSgd, OptimizerAdam })
+	{
+		options.optimizer = optimizer;
+		options.threads = 1;
+		Trainer one(initial, options);
+		options.threads = 4;
+		Trainer four(initial, options);
+		for (int step = 0; step < 3; ++step)
+		{
+			ASSERT_TRUE(std::fabs(one.trainBatch(images.data(), labels.data(), samples) -
+								  four.trainBatch(images.data(), labels.data(), samples)) < EPSILON)
+		}
+		const std::vector<Dense> expected = one.layers();
+		const std::vector<Dense> actual = four.layers();
+		for (size_t layer = 0; layer < expected.size(); ++layer)
+		{
+			ASSERT_TRUE(nearlyEqual(expected[layer].getWeights(), actual[layer].getWeights(), EPSILON) &&
+						nearlyEqual(expected[layer].getBias(), actual[layer].getBias(), EPSILON))
+		}
+	}
+	return 1;
+}
+
+int testTrainerLearns()
+{
+	// three clusters around one-hot centers of 6 features
+	const int samples = 90;
+	TrainingSet set;
+	set.images = makeMatrix(samples, 6, 1);
+	for (int i = 0; i < samples; ++i)
+	{
+		set.labels.push_back(i % 3);
+		set.images(i, i % 3) += 2;
+	}
+	TrainingOptions options;
+	options.batchSize = 16;
+	options.learningRate = 0.01f;
+	options.threads = 2;
+	Trainer trainer({ 6, 12, 8, 3 }, options);
+	const float first = trainer.trainEpoch(set);
+	float last = first;
+	for (int epoch = 0; epoch < 40; ++epoch)
+	{
+		last = trainer.trainEpoch(set);
+	}
+	float accuracy = 0;
+	trainer.loss(set.images.data(), set.labels.data(), samples, &accuracy);
+	ASSERT_TRUE(last < first / 4 && accuracy == 1)
+
+	// the written parameters load back as a model description
+	const std::string directory = "trainer_test";
+	mkdir(directory.c_str(), 0755);
+	ASSERT_TRUE(trainer.save(directory))
+	std::vector<Dense> layers;
+	const bool loaded = loadModel(directory + "/model.txt", layers);
+	for (const char* file : { "/model.txt", "/w1", "/w2", "/w3", "/b1", "/b2", "/b3" })
+	{
+		std::remove((directory + file).c_str());
+	}
+	rmdir(directory.c_str());
+	ASSERT_TRUE(loaded && layers.size() == 3)
+	MlpNetwork mlp(std::move(layers));
+	for (int i = 0; i < samples; ++i)
+	{
+		Matrix image(6, 1);
+		std::copy(set.images.data() + i * 6, set.images.data() + (i + 1) * 6, image.data());
+		ASSERT_TRUE(mlp(image).value == (unsigned int) set.labels[i])
+	}
+	return 1;
+}
+
+//-------------------------------------------------------
+//  The main entry point
+//-------------------------------------------------------
+int runTests()
+{
+	RUN_TEST(testMultiplyMatchesReference)
+	RUN_TEST(testTransposedOperands)
+	RUN_TEST(testKernelsMatchScalar)
+	RUN_TEST(testSoftmaxIsStable)
+	RUN_TEST(testMoveAndInPlaceDoNotAllocate)
+	RUN_TEST(testForwardPassAllocations)
+	RUN_TEST(testModelOfAnyDepth)
+	RUN_TEST(testPackedModelRoundTrip)
+	RUN_TEST(testMatrixCopyBudgets)
+	RUN_TEST(testViewsAreZeroCopy)
+	RUN_TEST(testAllocatorAlignmentAndReuse)
+	RUN_TEST(testMappedParametersAreBorrowed)
+	RUN_TEST(testBorrowedNetworkMatchesCopied)
+	RUN_TEST(testBatchMatchesSingleImage)
+	RUN_TEST(testArgmaxMatchesSoftmax)
+	RUN_TEST(testParallelMatchesSerial)
+	RUN_TEST(testBulkMatchesSingleImage)
+	RUN_TEST(testServerMatchesSingleImage)
+	RUN_TEST(testQuantizedMatchesFloat)
+	RUN_TEST(testHalfMatchesFloat)
+	RUN_TEST(testSparseMatchesDense)
+	RUN_TEST(testProfilerCounts)
+	RUN_TEST(testStaticMatchesRuntime)
+	RUN_TEST(testTrainerGradients)
+	RUN_TEST(testTrainerLearns)
+	return 1;
+}
+
+int main()
+{
+	return runTests() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,33 @@
+#ifndef TEST_HELPERS_H
+#define TEST_HELPERS_H
+
+#include <iostream>
+
+/**
+ * Runs an "int (void)" test function and returns 0 from the caller on failure
+ * @param testName	test function
+ */
+#define RUN_TEST(testName) if (!testName()) { \
+		std::cerr << "Test "#testName"... FAILED!" << std::endl; \
+		return 0; \
+	} \
+	std::cout << "Test "#testName"... OK!" << std::endl;
+
+/**
+ * Returns 0 from the test when condition does not hold
+ * @param condition	C++ expression to evaluate
+ */
+#define ASSERT_TRUE(condition) if (!(condition)) { \
+		std::cerr << "Assertion failed: "#condition << " (" << __FILE__ << ":" << __LINE__ << ")" \
+				  << std::endl; \
+		return 0; \
+	}
+
+/**
+ * Asserts condition and ends the test successfully
+ * @param condition	C++ expression to evaluate
+ */
+#define RETURN_ASSERT_TRUE(condition) ASSERT_TRUE(condition) \
+	return 1;
+
+#endif
@@ -0,0 +1,239 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+
+#include "../HalfMlp.h"
+#include "../Kernels.h"
+#include "../ModelDescription.h"
+
+#define USAGE "Usage: mlp_half <parameters dir | model description> <images dir> <labels file>\n" \
+              "\tconverts the fp32 weights to bfloat16 and fp16, reports the accuracy of each\n" \
+              "\ton the images im0..im(n-1) against fp32 and their labels (one digit per line),\n" \
+              "\tand the speed of each on the model and on one layer too large for the cache"
+#define MODEL_FILE "/model.txt"
+#define READ_ERROR "ERROR: unable to read "
+#define MIN_SECONDS 0.2
+#define MICROSECONDS 1e6
+#define LARGE_LAYER 4096
+
+/**
+ * Reads a raw float file into a matrix of matching size
+ * @param path		file
+ * @param matrix	destination
+ */
+static void readMatrix(const std::string& path, Matrix& matrix)
+{
+	std::ifstream is(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!is.is_open() || is.tellg() != (long) (matrix.getRows() * matrix.getCols() * sizeof(float)))
+	{
+		std::cerr << READ_ERROR << path << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	is.seekg(0, std::ios_base::beg);
+	is >> matrix;
+}
+
+/**
+ * Classifies every image until MIN_SECONDS elapsed
+ * @param network	MlpNetwork or HalfMlp
+ * @param images	images
+ * @return			microseconds per image
+ */
+template<typename Network>
+static double timePerImage(const Network& network, const std::vector<Matrix>& images)
+{
+	long classified = 0;
+	const auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		for (const Matrix& image : images)
+		{
+			network(image);
+		}
+		classified += (long) images.size();
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+	return elapsed / classified * MICROSECONDS;
+}
+
+/**
+ * Runs one dense layer kernel until MIN_SECONDS elapsed
+ * @param layer	kernel call
+ * @return		microseconds per call
+ */
+template<typename Layer>
+static double timePerLayer(const Layer& layer)
+{
+	long calls = 0;
+	const auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		layer();
+		++calls;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+	return elapsed / calls * MICROSECONDS;
+}
+
+/**
+ * Prints the speed of one LARGE_LAYER square layer per format. Its weights do not fit
+ * in cache, so it shows the bandwidth bound regime the shipped model is too small for.
+ */
+static void reportLargeLayer()
+{
+	const long count = (long) LARGE_LAYER * LARGE_LAYER;
+	std::vector<float> weights(count);
+	std::vector<float> input(LARGE_LAYER);
+	std::vector<float> bias(LARGE_LAYER, 0);
+	std::vector<float> output(LARGE_LAYER);
+	for (long i = 0; i < count; ++i)
+	{
+		weights[i] = (float) (i % 127 - 63) / 64;
+	}
+	for (int i = 0; i < LARGE_LAYER; ++i)
+	{
+		input[i] = (float) (i % 31) / 31;
+	}
+	const double fp32Time = timePerLayer([&]()
+										 {
+											 kernels().dense(LARGE_LAYER, LARGE_LAYER, weights.data(), LARGE_LAYER,
+															 input.data(), bias.data(), output.data(), true);
+										 });
+	std::cout << std::fixed << std::setprecision(2)
+			  << LARGE_LAYER << "x" << LARGE_LAYER << " layer us: fp32 " << fp32Time;
+	for (HalfFormat format : { HalfBf16, HalfFp16 })
+	{
+		std::vector<uint16_t> half(count);
+		for (long i = 0; i < count; ++i)
+		{
+			half[i] = floatToHalf(weights[i], format);
+		}
+		const double halfTime = timePerLayer([&]()
+											 {
+												 kernels().denseHalf(LARGE_LAYER, LARGE_LAYER, half.data(),
+																	 input.data(), bias.data(), output.data(),
+																	 true, format);
+											 });
+		std::cout << (format == HalfBf16 ? ", bf16 " : ", fp16 ") << halfTime
+				  << " (" << fp32Time / halfTime << "x)";
+	}
+	std::cout << std::endl;
+}
+
+/**
+ * Prints the accuracy, size and speed of one 16 bit format against fp32
+ * @param name		format name
+ * @param fp32		MlpNetwork
+ * @param half		HalfMlp
+ * @param images	images
+ * @param labels	one digit per image
+ * @param fp32Time	microseconds per image of fp32
+ */
+static void report(const char* name, const MlpNetwork& fp32, const HalfMlp& half, const std::vector<Matrix>& images,
+				   const std::vector<int>& labels, double fp32Time)
+{
+	int correct = 0;
+	int agree = 0;
+	float maxDelta = 0;
+	double sumDelta = 0;
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		const Digit expected = fp32(images[i]);
+		const Digit actual = half(images[i]);
+		correct += (int) actual.value == labels[i];
+		agree += expected.value == actual.value;
+		const float delta = std::fabs(expected.probability - actual.probability);
+		maxDelta = std::max(maxDelta, delta);
+		sumDelta += delta;
+	}
+
+	const double count = (double) images.size();
+	const double halfTime = timePerImage(half, images);
+	std::cout << std::fixed << std::setprecision(2)
+			  << name << " accuracy: " << 100 * correct / count << "%"
+			  << ", top-1 agreement: " << 100 * agree / count << "%" << std::endl
+			  << std::setprecision(6)
+			  << name << " top-1 probability delta: mean " << sumDelta / count << ", max " << maxDelta << std::endl
+			  << std::setprecision(2)
+			  << name << " weight bytes: " << half.weightBytes()
+			  << ", us / image: " << halfTime << ", speedup: " << fp32Time / halfTime << "x" << std::endl;
+}
+
+/**
+ * Converts the model and prints the accuracy, size and speed of bf16 and fp16 against fp32
+ * @param argc	arguments count
+ * @param argv	parameters dir or model description, images dir, labels file
+ * @return		exit status
+ */
+int main(int argc, char** argv)
+{
+	if (argc != 4)
+	{
+		std::cerr << USAGE << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::string descriptionPath(argv[1]);
+	struct stat status = {};
+	if (stat(descriptionPath.c_str(), &status) == 0 && S_ISDIR(status.st_mode))
+	{
+		descriptionPath += MODEL_FILE;
+	}
+	const std::string imagesDir = std::string(argv[2]) + "/";
+
+	std::vector<Dense> layers;
+	if (!loadModel(descriptionPath, layers))
+	{
+		std::cerr << READ_ERROR << descriptionPath << std::endl;
+		return EXIT_FAILURE;
+	}
+	const MlpNetwork fp32(std::move(layers));
+
+	std::ifstream labelsFile(argv[3]);
+	std::vector<int> labels;
+	int label = 0;
+	while (labelsFile >> label)
+	{
+		labels.push_back(label);
+	}
+	if (labels.empty())
+	{
+		std::cerr << READ_ERROR << argv[3] << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<Matrix> images;
+	for (size_t i = 0; i < labels.size(); ++i)
+	{
+		images.emplace_back(fp32.getInputs(), 1);
+		readMatrix(imagesDir + "im" + std::to_string(i), images.back());
+	}
+
+	long fp32Bytes = 0;
+	for (const Dense& layer : fp32.getLayers())
+	{
+		fp32Bytes += (long) layer.getWeights().getRows() * layer.getWeights().getCols() * (long) sizeof(float);
+	}
+	int fp32Correct = 0;
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		fp32Correct += (int) fp32(images[i]).value == labels[i];
+	}
+	const double fp32Time = timePerImage(fp32, images);
+	std::cout << std::fixed << std::setprecision(2)
+			  << "images: " << images.size() << ", kernels: " << kernels().name << std::endl
+			  << "fp32 accuracy: " << 100 * fp32Correct / (double) images.size() << "%" << std::endl
+			  << "fp32 weight bytes: " << fp32Bytes << ", us / image: " << fp32Time << std::endl;
+
+	report("bf16", fp32, HalfMlp(fp32, HalfBf16), images, labels, fp32Time);
+	report("fp16", fp32, HalfMlp(fp32, HalfFp16), images, labels, fp32Time);
+	reportLargeLayer();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../InferenceServer.h"
+
+#define USAGE "Usage: mlp_loadgen <socket> <image file> [--connections n] [--requests n] [--depth d] [--bytes]\n" \
+              "\tsends the image to an ./mlpnetwork --serve server over n connections (4),\n" \
+              "\teach keeping d requests in flight (1) until it sent its share of the requests\n" \
+              "\t(10000 in total), as floats or with --bytes as pixels; reports the throughput\n" \
+              "\tand the request latency percentiles"
+#define READ_ERROR "ERROR: unable to read "
+#define CONNECT_ERROR "ERROR: unable to connect to "
+#define REQUEST_ERROR "ERROR: connection lost after requests: "
+#define DEFAULT_CONNECTIONS 4
+#define DEFAULT_REQUESTS 10000
+#define DEFAULT_DEPTH 1
+#define MICROSECONDS 1e6
+#define PIXEL_MAX 255
+
+/**
+ * @struct LoadOptions
+ * @brief Command line settings
+ * @var connections - concurrent connections
+ * @var requests - requests over all connections
+ * @var depth - requests in flight per connection
+ * @var bytes - send pixels instead of floats
+ */
+typedef struct LoadOptions
+{
+	int connections;
+	long requests;
+	int depth;
+	bool bytes;
+} LoadOptions;
+
+/**
+ * Parses the optional flags after the two paths
+ * @param argc		argument count
+ * @param argv		arguments
+ * @param options	receives the settings
+ * @return			false on an unknown flag or a non positive count
+ */
+static bool parseOptions(int argc, char* argv[], LoadOptions& options)
+{
+	options = { DEFAULT_CONNECTIONS, DEFAULT_REQUESTS, DEFAULT_DEPTH, false };
+	for (int i = 3; i < argc; ++i)
+	{
+		const std::string flag(argv[i]);
+		if (flag == "--bytes")
+		{
+			options.bytes = true;
+			continue;
+		}
+		if (i + 1 == argc)
+		{
+			return false;
+		}
+		const long value = std::atol(argv[++i]);
+		if (value <= 0)
+		{
+			return false;
+		}
+		if (flag == "--connections")
+		{
+			options.connections = (int) value;
+		}
+		else if (flag == "--requests")
+		{
+			options.requests = value;
+		}
+		else if (flag == "--depth")
+		{
+			options.depth = (int) value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Sends requests on one connection, keeping up to depth of them in flight
+ * @param socketPath	server socket
+ * @param image			imgDims floats
+ * @param pixels		the image as pixels
+ * @param options		settings
+ * @param requests		requests to send
+ * @param latencies		receives the microseconds of each request
+ * @return				false if the connection failed
+ */
+static bool runConnection(const std::string& socketPath, const std::vector<float>& image,
+						  const std::vector<uint8_t>& pixels, const LoadOptions& options, long requests,
+						  std::vector<double>& latencies)
+{
+	InferenceClient client;
+	if (!client.connect(socketPath))
+	{
+		return false;
+	}
+	latencies.reserve(requests);
+	std::vector<std::chrono::steady_clock::time_point> sent(requests);
+	long sentCount = 0;
+	Digit digit;
+	while ((long) latencies.size() < requests)
+	{
+		while (sentCount < requests && sentCount - (long) latencies.size() < options.depth)
+		{
+			sent[sentCount] = std::chrono::steady_clock::now();
+			if (!(options.bytes ? client.send(pixels.data()) : client.send(image.data())))
+			{
+				return false;
+			}
+			++sentCount;
+		}
+		if (!client.receive(digit))
+		{
+			return false;
+		}
+		latencies.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now()
+														  - sent[latencies.size()]).count() * MICROSECONDS);
+	}
+	return true;
+}
+
+/**
+ * Returns a percentile of sorted values, nearest rank
+ * @param sorted		values, ascending
+ * @param percentile	0 .. 100
+ * @return				value
+ */
+static double percentile(const std::vector<double>& sorted, double percentile)
+{
+	const long rank = (long) std::ceil(percentile / 100 * (double) sorted.size());
+	return sorted[std::max(0L, std::min((long) sorted.size() - 1, rank - 1))];
+}
+
+/**
+ * Program's main
+ * @param argc count of args
+ * @param argv args values
+ * @return program exit status code
+ */
+int main(int argc, char* argv[])
+{
+	LoadOptions options;
+	if (argc < 3 || !parseOptions(argc, argv, options))
+	{
+		std::cerr << USAGE << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string socketPath(argv[1]);
+	const int inputs = imgDims.rows * imgDims.cols;
+	std::vector<float> image(inputs);
+	std::ifstream is(argv[2], std::ios::in | std::ios::binary | std::ios::ate);
+	if (!is.is_open() || is.tellg() != (long) (inputs * sizeof(float)))
+	{
+		std::cerr << READ_ERROR << argv[2] << std::endl;
+		return EXIT_FAILURE;
+	}
+	is.seekg(0, std::ios_base::beg);
+	is.read((char*) image.data(), inputs * sizeof(float));
+	std::vector<uint8_t> pixels(inputs);
+	for (int i = 0; i < inputs; ++i)
+	{
+		pixels[i] = (uint8_t) std::lround(std::min(1.0f, std::max(0.0f, image[i])) * PIXEL_MAX);
+	}
+
+	// each connection sends an equal share, the first ones one more for the remainder
+	std::vector<std::vector<double>> latencies(options.connections);
+	std::vector<char> succeeded(options.connections, 0);
+	std::vector<std::thread> threads;
+	const auto start = std::chrono::steady_clock::now();
+	for (int c = 0; c < options.connections; ++c)
+	{
+		const long share = options.requests / options.connections + (c < options.requests % options.connections);
+		threads.emplace_back([&, c, share]()
+							 {
+								 succeeded[c] = runConnection(socketPath, image, pixels, options, share,
+															  latencies[c]);
+							 });
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<double> all;
+	for (int c = 0; c < options.connections; ++c)
+	{
+		all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+	}
+	if (std::find(succeeded.begin(), succeeded.end(), 0) != succeeded.end())
+	{
+		std::cerr << (all.empty() ? CONNECT_ERROR : REQUEST_ERROR) << (all.empty() ? socketPath :
+																	   std::to_string(all.size())) << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::sort(all.begin(), all.end());
+	std::cout << std::fixed << std::setprecision(1)
+			  << "requests " << all.size() << " connections " << options.connections << " depth " << options.depth
+			  << (options.bytes ? " pixels" : " floats") << std::endl
+			  << "throughput " << (double) all.size() / elapsed << " requests/s" << std::endl
+			  << "latency us: p50 " << percentile(all, 50) << " p99 " << percentile(all, 99)
+			  << " max " << all.back() << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "../ModelDescription.h"
+#include "../PackedModel.h"
+
+#define USAGE "Usage: mlp_pack <parameters dir | model description> <output file>\n" \
+              "\tpacks the layers of a model description (model.txt inside a parameters dir)\n" \
+              "\tinto one file with aligned tensors and a CRC-32 per tensor"
+#define MODEL_FILE "/model.txt"
+#define READ_ERROR "ERROR: unable to read "
+#define WRITE_ERROR "ERROR: unable to write "
+#define VERIFY_ERROR "ERROR: written file does not verify: "
+
+/**
+ * Packs a model and checks the result maps back
+ * @param argc	arguments count
+ * @param argv	parameters dir or model description, output file
+ * @return		exit status
+ */
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << USAGE << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::string descriptionPath(argv[1]);
+	struct stat status = {};
+	if (stat(descriptionPath.c_str(), &status) == 0 && S_ISDIR(status.st_mode))
+	{
+		descriptionPath += MODEL_FILE;
+	}
+
+	std::vector<Dense> layers;
+	if (!loadModel(descriptionPath, layers))
+	{
+		std::cerr << READ_ERROR << descriptionPath << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!writePackedModel(argv[2], layers))
+	{
+		std::cerr << WRITE_ERROR << argv[2] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	MappedFile file;
+	std::vector<Dense> packed;
+	std::string error;
+	if (!mapPackedModel(argv[2], file, packed, error))
+	{
+		std::cerr << VERIFY_ERROR << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "layers: " << packed.size() << ", bytes: " << file.size() << std::endl;
+	return EXIT_SUCCESS;
+}
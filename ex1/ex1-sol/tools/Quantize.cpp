@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Kernels.h"
+#include "../MlpNetwork.h"
+#include "../QuantizedMlp.h"
+
+#define USAGE "Usage: mlp_quantize <parameters dir> <images dir> <labels file> [output file]\n" \
+              "\tquantizes w1..w4 to INT8 calibrated on the images im0..im(n-1),\n" \
+              "\treports accuracy against fp32 on their labels (one digit per line)\n" \
+              "\tand optionally writes the pre-quantized parameters file"
+#define READ_ERROR "ERROR: unable to read "
+#define WRITE_ERROR "ERROR: unable to write "
+#define MIN_SECONDS 0.2
+#define MICROSECONDS 1e6
+
+/**
+ * Reads a raw float file into a matrix of matching size
+ * @param path		file
+ * @param matrix	destination
+ */
+static void readMatrix(const std::string& path, Matrix& matrix)
+{
+	std::ifstream is(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!is.is_open() || is.tellg() != (long) (matrix.getRows() * matrix.getCols() * sizeof(float)))
+	{
+		std::cerr << READ_ERROR << path << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	is.seekg(0, std::ios_base::beg);
+	is >> matrix;
+}
+
+/**
+ * Classifies every image until MIN_SECONDS elapsed
+ * @param network	MlpNetwork or QuantizedMlp
+ * @param images	images
+ * @return			microseconds per image
+ */
+template<typename Network>
+static double timePerImage(const Network& network, const std::vector<Matrix>& images)
+{
+	long classified = 0;
+	const auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		for (const Matrix& image : images)
+		{
+			network(image);
+		}
+		classified += (long) images.size();
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+	return elapsed / classified * MICROSECONDS;
+}
+
+/**
+ * Quantizes the parameters and prints the accuracy, size and speed of INT8 against fp32
+ * @param argc	arguments count
+ * @param argv	parameters dir, images dir, labels file, optional output file
+ * @return		exit status
+ */
+int main(int argc, char** argv)
+{
+	if (argc != 4 && argc != 5)
+	{
+		std::cerr << USAGE << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string parametersDir = std::string(argv[1]) + "/";
+	const std::string imagesDir = std::string(argv[2]) + "/";
+
+	Matrix weights[MLP_SIZE];
+	Matrix biases[MLP_SIZE];
+	long fp32Bytes = 0;
+	for (int i = 0; i < MLP_SIZE; ++i)
+	{
+		weights[i] = Matrix(weightsDims[i].rows, weightsDims[i].cols);
+		biases[i] = Matrix(biasDims[i].rows, biasDims[i].cols);
+		readMatrix(parametersDir + "w" + std::to_string(i + 1), weights[i]);
+		readMatrix(parametersDir + "b" + std::to_string(i + 1), biases[i]);
+		fp32Bytes += (long) (weightsDims[i].rows * weightsDims[i].cols * sizeof(float));
+	}
+
+	std::ifstream labelsFile(argv[3]);
+	std::vector<int> labels;
+	int label = 0;
+	while (labelsFile >> label)
+	{
+		labels.push_back(label);
+	}
+	if (labels.empty())
+	{
+		std::cerr << READ_ERROR << argv[3] << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<Matrix> images;
+	for (size_t i = 0; i < labels.size(); ++i)
+	{
+		images.emplace_back(imgDims.rows * imgDims.cols, 1);
+		readMatrix(imagesDir + "im" + std::to_string(i), images.back());
+	}
+
+	const MlpNetwork fp32(weights, biases);
+	const QuantizedMlp int8(weights, biases, images.data(), (int) images.size());
+	if (argc == 5 && !int8.save(argv[4]))
+	{
+		std::cerr << WRITE_ERROR << argv[4] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	int fp32Correct = 0;
+	int int8Correct = 0;
+	int agree = 0;
+	float maxDelta = 0;
+	double sumDelta = 0;
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		const Digit expected = fp32(images[i]);
+		const Digit actual = int8(images[i]);
+		fp32Correct += (int) expected.value == labels[i];
+		int8Correct += (int) actual.value == labels[i];
+		agree += expected.value == actual.value;
+		const float delta = std::fabs(expected.probability - actual.probability);
+		maxDelta = std::max(maxDelta, delta);
+		sumDelta += delta;
+	}
+
+	const double count = (double) images.size();
+	std::cout << std::fixed << std::setprecision(2)
+			  << "images: " << images.size() << ", kernels: " << kernels().name << std::endl
+			  << "fp32 accuracy: " << 100 * fp32Correct / count << "%" << std::endl
+			  << "int8 accuracy: " << 100 * int8Correct / count << "%" << std::endl
+			  << "top-1 agreement: " << 100 * agree / count << "%" << std::endl
+			  << std::setprecision(4)
+			  << "top-1 probability delta: mean " << sumDelta / count << ", max " << maxDelta << std::endl
+			  << "weight bytes: fp32 " << fp32Bytes << ", int8 " << int8.weightBytes() << std::endl
+			  << std::setprecision(2)
+			  << "us / image: fp32 " << timePerImage(fp32, images)
+			  << ", int8 " << timePerImage(int8, images) << std::endl;
+	return EXIT_SUCCESS;
+}
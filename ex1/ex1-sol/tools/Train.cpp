@@ -0,0 +1,148 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "../ModelDescription.h"
+#include "../Trainer.h"
+
+#define USAGE "Usage: mlp_train <images idx> <labels idx> <output dir> [options]\n" \
+              "\ttrains the shipped layer shapes, 784 128 64 20 10, on an MNIST IDX pair and writes\n" \
+              "\tw1..w4 b1..b4 (the files ./mlpnetwork reads) and model.txt to the output dir\n" \
+              "\t--epochs n          passes over the set, 10\n" \
+              "\t--batch n           minibatch size, 64\n" \
+              "\t--rate x            learning rate, 0.001 (Adam) or 0.05 (SGD)\n" \
+              "\t--sgd [momentum]    minibatch SGD instead of Adam\n" \
+              "\t--threads n         minibatch shards trained in parallel, 1\n" \
+              "\t--seed n            initialization and shuffling seed, 1\n" \
+              "\t--init description  continues from a model description instead of random layers\n" \
+              "\t--test images labels  reports the accuracy on a held out IDX pair after every epoch"
+#define READ_ERROR "ERROR: unable to read "
+#define WRITE_ERROR "ERROR: unable to write "
+#define DEFAULT_EPOCHS 10
+#define DEFAULT_SGD_RATE 0.05f
+#define PERCENT 100
+
+/**
+ * Trains a network and writes its parameters
+ * @param argc	arguments count
+ * @param argv	images, labels, output dir and options
+ * @return		exit status
+ */
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		std::cerr << USAGE << std::endl;
+		return EXIT_FAILURE;
+	}
+	TrainingOptions options;
+	int epochs = DEFAULT_EPOCHS;
+	bool rateGiven = false;
+	std::string initPath;
+	std::string testImages;
+	std::string testLabels;
+	for (int i = 4; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--epochs") == 0 && hasValue)
+		{
+			epochs = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--batch") == 0 && hasValue)
+		{
+			options.batchSize = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--rate") == 0 && hasValue)
+		{
+			options.learningRate = std::strtof(argv[++i], nullptr);
+			rateGiven = true;
+		}
+		else if (std::strcmp(argv[i], "--sgd") == 0)
+		{
+			options.optimizer = OptimizerSgd;
+			if (hasValue && argv[i + 1][0] != '-')
+			{
+				options.momentum = std::strtof(argv[++i], nullptr);
+			}
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+		{
+			options.threads = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+		{
+			options.seed = (unsigned) std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--init") == 0 && hasValue)
+		{
+			initPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--test") == 0 && i + 2 < argc)
+		{
+			testImages = argv[++i];
+			testLabels = argv[++i];
+		}
+		else
+		{
+			std::cerr << USAGE << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	if (options.optimizer == OptimizerSgd && !rateGiven)
+	{
+		options.learningRate = DEFAULT_SGD_RATE;
+	}
+
+	TrainingSet train;
+	if (!readIdx(argv[1], argv[2], train))
+	{
+		std::cerr << READ_ERROR << argv[1] << ", " << argv[2] << std::endl;
+		return EXIT_FAILURE;
+	}
+	TrainingSet test;
+	if (!testImages.empty() && !readIdx(testImages, testLabels, test))
+	{
+		std::cerr << READ_ERROR << testImages << ", " << testLabels << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Dense> initial;
+	if (!initPath.empty() && !loadModel(initPath, initial))
+	{
+		std::cerr << READ_ERROR << initPath << std::endl;
+		return EXIT_FAILURE;
+	}
+	Trainer trainer = initial.empty() ? Trainer({ train.images.getCols(), 128, 64, 20, 10 }, options)
+									  : Trainer(initial, options);
+
+	std::cout << std::fixed << std::setprecision(4);
+	for (int epoch = 1; epoch <= epochs; ++epoch)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const float loss = trainer.trainEpoch(train);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "epoch " << epoch << ": loss " << loss << ", " << std::setprecision(2) << seconds << " s, "
+				  << train.images.getRows() / seconds << " samples/s" << std::setprecision(4);
+		if (!test.labels.empty())
+		{
+			float accuracy = 0;
+			const float testLoss = trainer.loss(test.images.data(), test.labels.data(), test.images.getRows(),
+												&accuracy);
+			std::cout << ", test loss " << testLoss << ", test accuracy " << accuracy * PERCENT << "%";
+		}
+		std::cout << std::endl;
+	}
+
+	mkdir(argv[3], 0755);
+	if (!trainer.save(argv[3]))
+	{
+		std::cerr << WRITE_ERROR << argv[3] << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}